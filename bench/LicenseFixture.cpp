@@ -0,0 +1,60 @@
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <Licenses.hpp>
+#include <SigningKey.hpp>
+
+#include "LicenseFixture.hpp"
+
+using namespace ::cryptolens_io::testkit;
+
+LicenseFixture::LicenseFixture(int activated_machines)
+{
+  SigningKey const& key = SigningKey::test_key();
+
+  modulus_base64 = key.get_modulus_base64();
+  exponent_base64 = key.get_exponent_base64();
+
+  LicenseSpec spec;
+  spec.activated_machines = activated_machines;
+
+  product_key = spec.key;
+  product_id = spec.product_id;
+
+  license = make_license(spec);
+  license_base64 = b64_encode(license);
+  signature_base64 = key.sign_base64(license);
+
+  activate_response  = "{\"licenseKey\":\"";
+  activate_response += license_base64;
+  activate_response += "\",\"signature\":\"";
+  activate_response += signature_base64;
+  activate_response += "\",\"result\":0,\"message\":\"\"}";
+
+  saved_license_key  = "v20180502-";
+  saved_license_key += license_base64;
+  saved_license_key += '-';
+  saved_license_key += signature_base64;
+
+  machine_code = machine_code_for(activated_machines > 0 ? activated_machines - 1 : 0);
+}
+
+LicenseFixture const&
+LicenseFixture::get(int activated_machines)
+{
+  static std::mutex mutex;
+  static std::map<int, std::unique_ptr<LicenseFixture>> fixtures;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  std::unique_ptr<LicenseFixture> & fixture = fixtures[activated_machines];
+  if (!fixture) { fixture.reset(new LicenseFixture(activated_machines)); }
+
+  return *fixture;
+}
+
+void
+LicenseFixture::sizes(benchmark::internal::Benchmark * b)
+{
+  b->ArgName("machines")->Arg(0)->Arg(100)->Arg(10000);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+/*
+ * Signed license keys of realistic size for use in the benchmarks.
+ *
+ * The licenses are signed with the test key from the testkit, using the
+ * same algorithm as the Cryptolens Web API. Thus the full pipeline,
+ * including signature verification, succeeds on the payloads.
+ */
+class LicenseFixture {
+public:
+  // Returns a license with the given number of activated machines
+  static LicenseFixture const& get(int activated_machines);
+
+  // Registers the benchmark for licenses with 0, 100 and 10000 activated
+  // machines, e.g. BENCHMARK(BM_x)->Apply(LicenseFixture::sizes)
+  static void sizes(benchmark::internal::Benchmark * b);
+
+  // The public key, as passed to SignatureVerifier::set_modulus_base64()
+  // and set_exponent_base64()
+  std::string modulus_base64;
+  std::string exponent_base64;
+
+  std::string product_key;
+  int product_id;
+
+  // The license key as JSON, and its base64 encoding
+  std::string license;
+  std::string license_base64;
+  std::string signature_base64;
+
+  // The body of a successful response from the Activate method
+  std::string activate_response;
+
+  // The license key in the format of LicenseKey::to_string()
+  std::string saved_license_key;
+
+  // The machine code of the last activated machine, or a machine code
+  // without an activation if there are no activated machines
+  std::string machine_code;
+
+private:
+  explicit LicenseFixture(int activated_machines);
+};
@@ -0,0 +1,105 @@
+#include <benchmark/benchmark.h>
+
+#include <cryptolens/Clock.hpp>
+#include <cryptolens/Error.hpp>
+#include <cryptolens/LicenseKeyChecker.hpp>
+#include <cryptolens/ResponseParser_ArduinoJson5.hpp>
+
+#include "LicenseFixture.hpp"
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+
+namespace {
+
+cryptolens::LicenseKeyInformation
+make_license_key_information(LicenseFixture const& fixture)
+{
+  cryptolens::Error e;
+  cryptolens::ResponseParser_ArduinoJson5 parser(e);
+  return *parser.make_license_key_information_unsafe(e, fixture.license);
+}
+
+} // namespace
+
+static void
+BM_LicenseKeyChecker_features(benchmark::State & state)
+{
+  cryptolens::LicenseKeyInformation license_key = make_license_key_information(LicenseFixture::get(0));
+
+  for (auto _ : state) {
+    bool ok = (bool)license_key.check().has_feature(1).has_not_feature(2).has_feature(3).is_not_blocked();
+    benchmark::DoNotOptimize(ok);
+  }
+}
+BENCHMARK(BM_LicenseKeyChecker_features);
+
+static void
+BM_LicenseKeyChecker_has_not_expired(benchmark::State & state)
+{
+  cryptolens::LicenseKeyInformation license_key = make_license_key_information(LicenseFixture::get(0));
+
+  for (auto _ : state) {
+    bool ok = (bool)license_key.check().has_not_expired(1600000000);
+    benchmark::DoNotOptimize(ok);
+  }
+}
+BENCHMARK(BM_LicenseKeyChecker_has_not_expired);
+
+template<typename Clock>
+static void
+BM_LicenseKeyChecker_has_not_expired_clock(benchmark::State & state)
+{
+  cryptolens::LicenseKeyInformation license_key = make_license_key_information(LicenseFixture::get(0));
+  cryptolens::Clock_fake::set(1600000000);
+
+  for (auto _ : state) {
+    bool ok = (bool)license_key.check().has_not_expired<Clock>();
+    benchmark::DoNotOptimize(ok);
+  }
+}
+BENCHMARK_TEMPLATE(BM_LicenseKeyChecker_has_not_expired_clock, cryptolens::Clock_ctime);
+BENCHMARK_TEMPLATE(BM_LicenseKeyChecker_has_not_expired_clock, cryptolens::Clock_coarse);
+BENCHMARK_TEMPLATE(BM_LicenseKeyChecker_has_not_expired_clock, cryptolens::Clock_fake);
+
+static void
+BM_LicenseKeyChecker_is_on_right_machine(benchmark::State & state)
+{
+  LicenseFixture const& fixture = LicenseFixture::get(state.range(0));
+  cryptolens::LicenseKeyInformation license_key = make_license_key_information(fixture);
+
+  for (auto _ : state) {
+    bool ok = (bool)license_key.check().is_on_right_machine(fixture.machine_code);
+    benchmark::DoNotOptimize(ok);
+  }
+}
+BENCHMARK(BM_LicenseKeyChecker_is_on_right_machine)->Apply(LicenseFixture::sizes);
+
+static void
+BM_LicenseKeyChecker_full_chain(benchmark::State & state)
+{
+  LicenseFixture const& fixture = LicenseFixture::get(state.range(0));
+  cryptolens::LicenseKeyInformation license_key = make_license_key_information(fixture);
+
+  for (auto _ : state) {
+    bool ok = (bool)license_key.check()
+                .has_feature(1)
+                .has_not_feature(2)
+                .is_not_blocked()
+                .has_not_expired(1600000000)
+                .is_on_right_machine(fixture.machine_code);
+    benchmark::DoNotOptimize(ok);
+  }
+}
+BENCHMARK(BM_LicenseKeyChecker_full_chain)->Apply(LicenseFixture::sizes);
+
+static void
+BM_LicenseKeyInformation_int_value_or(benchmark::State & state)
+{
+  cryptolens::LicenseKeyInformation license_key = make_license_key_information(LicenseFixture::get(0));
+
+  for (auto _ : state) {
+    int usage = license_key.int_value_or("usage", 0);
+    benchmark::DoNotOptimize(usage);
+  }
+}
+BENCHMARK(BM_LicenseKeyInformation_int_value_or);
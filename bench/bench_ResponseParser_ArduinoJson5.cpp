@@ -0,0 +1,120 @@
+#include <string>
+
+#include <benchmark/benchmark.h>
+
+#include <cryptolens/Error.hpp>
+#include <cryptolens/MemoryResource.hpp>
+#include <cryptolens/ResponseParser_ArduinoJson5.hpp>
+
+#include "LicenseFixture.hpp"
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+
+static void
+BM_ResponseParser_ArduinoJson5_parse_activate_response(benchmark::State & state)
+{
+  LicenseFixture const& fixture = LicenseFixture::get(state.range(0));
+
+  cryptolens::Error e;
+  cryptolens::ResponseParser_ArduinoJson5 parser(e);
+
+  for (auto _ : state) {
+    auto x = parser.parse_activate_response(e, fixture.activate_response);
+    benchmark::DoNotOptimize(x);
+  }
+
+  if (e) { state.SkipWithError("parse_activate_response failed"); }
+  state.SetBytesProcessed(state.iterations() * fixture.activate_response.size());
+}
+BENCHMARK(BM_ResponseParser_ArduinoJson5_parse_activate_response)->Apply(LicenseFixture::sizes);
+
+static void
+BM_ResponseParser_ArduinoJson5_make_license_key_information_unsafe(benchmark::State & state)
+{
+  LicenseFixture const& fixture = LicenseFixture::get(state.range(0));
+
+  cryptolens::Error e;
+  cryptolens::ResponseParser_ArduinoJson5 parser(e);
+
+  for (auto _ : state) {
+    auto x = parser.make_license_key_information_unsafe(e, fixture.license);
+    benchmark::DoNotOptimize(x);
+  }
+
+  if (e) { state.SkipWithError("make_license_key_information_unsafe failed"); }
+  state.SetBytesProcessed(state.iterations() * fixture.license.size());
+}
+BENCHMARK(BM_ResponseParser_ArduinoJson5_make_license_key_information_unsafe)->Apply(LicenseFixture::sizes);
+
+static void
+BM_ResponseParser_ArduinoJson5_make_license_key_information_unsafe_arena(benchmark::State & state)
+{
+  LicenseFixture const& fixture = LicenseFixture::get(state.range(0));
+
+  cryptolens::Error e;
+  cryptolens::ResponseParser_ArduinoJson5 parser(e);
+  cryptolens::MonotonicBufferResource arena;
+
+  for (auto _ : state) {
+    {
+      auto x = parser.make_license_key_information_unsafe(e, fixture.license, cryptolens::PolymorphicAllocator<char>(&arena));
+      benchmark::DoNotOptimize(x);
+    }
+    arena.release();
+  }
+
+  if (e) { state.SkipWithError("make_license_key_information_unsafe failed"); }
+  state.SetBytesProcessed(state.iterations() * fixture.license.size());
+}
+BENCHMARK(BM_ResponseParser_ArduinoJson5_make_license_key_information_unsafe_arena)->Apply(LicenseFixture::sizes);
+
+static std::string
+make_messages_response(int n)
+{
+  std::string s = "{\"messages\":[";
+  for (int i = 0; i < n; ++i) {
+    if (i > 0) { s += ','; }
+    s += "{\"id\":" + std::to_string(1000 + i)
+       + ",\"content\":\"Version 1." + std::to_string(i) + " is available, see https://example.com/releases\""
+       + ",\"created\":" + std::to_string(1560000000 + 3600 * i)
+       + ",\"channel\":\"stable\"}";
+  }
+  s += "],\"result\":0,\"message\":\"\"}";
+  return s;
+}
+
+static void
+BM_ResponseParser_ArduinoJson5_parse_last_message_response(benchmark::State & state)
+{
+  std::string response = make_messages_response(state.range(0));
+
+  cryptolens::Error e;
+  cryptolens::ResponseParser_ArduinoJson5 parser(e);
+
+  for (auto _ : state) {
+    auto x = parser.parse_last_message_response(e, response);
+    benchmark::DoNotOptimize(x);
+  }
+
+  if (e) { state.SkipWithError("parse_last_message_response failed"); }
+  state.SetBytesProcessed(state.iterations() * response.size());
+}
+BENCHMARK(BM_ResponseParser_ArduinoJson5_parse_last_message_response)->Arg(1)->Arg(10)->Arg(100);
+
+static void
+BM_ResponseParser_ArduinoJson5_parse_get_messages_response(benchmark::State & state)
+{
+  std::string response = make_messages_response(state.range(0));
+
+  cryptolens::Error e;
+  cryptolens::ResponseParser_ArduinoJson5 parser(e);
+
+  for (auto _ : state) {
+    auto x = parser.parse_get_messages_response(e, response);
+    benchmark::DoNotOptimize(x);
+  }
+
+  if (e) { state.SkipWithError("parse_get_messages_response failed"); }
+  state.SetBytesProcessed(state.iterations() * response.size());
+}
+BENCHMARK(BM_ResponseParser_ArduinoJson5_parse_get_messages_response)->Arg(1)->Arg(10)->Arg(100);
@@ -0,0 +1,43 @@
+#include <benchmark/benchmark.h>
+
+#include <cryptolens/Error.hpp>
+#include <cryptolens/SignatureVerifier_OpenSSL.hpp>
+
+#include "LicenseFixture.hpp"
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+
+static void
+BM_SignatureVerifier_OpenSSL_verify_message(benchmark::State & state)
+{
+  LicenseFixture const& fixture = LicenseFixture::get(state.range(0));
+
+  cryptolens::Error e;
+  cryptolens::SignatureVerifier_OpenSSL verifier(e);
+  verifier.set_modulus_base64(e, fixture.modulus_base64);
+  verifier.set_exponent_base64(e, fixture.exponent_base64);
+
+  for (auto _ : state) {
+    bool verified = verifier.verify_message(e, fixture.license, fixture.signature_base64);
+    benchmark::DoNotOptimize(verified);
+  }
+
+  if (e) { state.SkipWithError("verify_message failed"); }
+  state.SetBytesProcessed(state.iterations() * fixture.license.size());
+}
+BENCHMARK(BM_SignatureVerifier_OpenSSL_verify_message)->Apply(LicenseFixture::sizes);
+
+static void
+BM_SignatureVerifier_OpenSSL_set_key(benchmark::State & state)
+{
+  LicenseFixture const& fixture = LicenseFixture::get(0);
+
+  for (auto _ : state) {
+    cryptolens::Error e;
+    cryptolens::SignatureVerifier_OpenSSL verifier(e);
+    verifier.set_modulus_base64(e, fixture.modulus_base64);
+    verifier.set_exponent_base64(e, fixture.exponent_base64);
+    benchmark::DoNotOptimize(e);
+  }
+}
+BENCHMARK(BM_SignatureVerifier_OpenSSL_set_key);
@@ -0,0 +1,21 @@
+#include <benchmark/benchmark.h>
+
+#include <cryptolens/base64.hpp>
+
+#include "LicenseFixture.hpp"
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+
+static void
+BM_b64_decode(benchmark::State & state)
+{
+  LicenseFixture const& fixture = LicenseFixture::get(state.range(0));
+
+  for (auto _ : state) {
+    auto decoded = cryptolens::internal::b64_decode(fixture.license_base64);
+    benchmark::DoNotOptimize(decoded);
+  }
+
+  state.SetBytesProcessed(state.iterations() * fixture.license_base64.size());
+}
+BENCHMARK(BM_b64_decode)->Apply(LicenseFixture::sizes);
@@ -0,0 +1,118 @@
+#include <benchmark/benchmark.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+#include <cryptolens/Configuration_Unix.hpp>
+#include <cryptolens/MachineCodeComputer_static.hpp>
+
+#include "LicenseFixture.hpp"
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+using Cryptolens = cryptolens::basic_Cryptolens<cryptolens::Configuration_Unix<cryptolens::MachineCodeComputer_static>>;
+
+namespace {
+
+void
+make_license_key(benchmark::State & state, std::string const& (*select)(LicenseFixture const&))
+{
+  LicenseFixture const& fixture = LicenseFixture::get(state.range(0));
+  std::string const& s = select(fixture);
+
+  cryptolens::Error e;
+  Cryptolens cryptolens_handle(e);
+  cryptolens_handle.signature_verifier.set_modulus_base64(e, fixture.modulus_base64);
+  cryptolens_handle.signature_verifier.set_exponent_base64(e, fixture.exponent_base64);
+
+  for (auto _ : state) {
+    auto license_key = cryptolens_handle.make_license_key(e, s);
+    benchmark::DoNotOptimize(license_key);
+  }
+
+  if (e) { state.SkipWithError("make_license_key failed"); }
+  state.SetBytesProcessed(state.iterations() * s.size());
+}
+
+std::string const& activate_response(LicenseFixture const& fixture) { return fixture.activate_response; }
+std::string const& saved_license_key(LicenseFixture const& fixture) { return fixture.saved_license_key; }
+
+} // namespace
+
+static void
+BM_basic_Cryptolens_make_license_key_activate_response(benchmark::State & state)
+{
+  make_license_key(state, activate_response);
+}
+BENCHMARK(BM_basic_Cryptolens_make_license_key_activate_response)->Apply(LicenseFixture::sizes);
+
+static void
+BM_basic_Cryptolens_make_license_key_saved(benchmark::State & state)
+{
+  make_license_key(state, saved_license_key);
+}
+BENCHMARK(BM_basic_Cryptolens_make_license_key_saved)->Apply(LicenseFixture::sizes);
+
+static void
+BM_basic_Cryptolens_make_license_key_view(benchmark::State & state)
+{
+  LicenseFixture const& fixture = LicenseFixture::get(state.range(0));
+
+  cryptolens::Error e;
+  Cryptolens cryptolens_handle(e);
+  cryptolens_handle.signature_verifier.set_modulus_base64(e, fixture.modulus_base64);
+  cryptolens_handle.signature_verifier.set_exponent_base64(e, fixture.exponent_base64);
+
+  auto license_key = cryptolens_handle.make_license_key(e, fixture.saved_license_key);
+  std::string binary = license_key ? license_key->to_binary(e) : std::string();
+
+  for (auto _ : state) {
+    auto view = cryptolens_handle.make_license_key_view(e, binary.data(), binary.size());
+    benchmark::DoNotOptimize(view);
+  }
+
+  if (e) { state.SkipWithError("make_license_key_view failed"); }
+  state.SetBytesProcessed(state.iterations() * binary.size());
+}
+BENCHMARK(BM_basic_Cryptolens_make_license_key_view)->Apply(LicenseFixture::sizes);
+
+namespace {
+
+int constexpr BATCH_SIZE = 32;
+
+void
+make_license_keys(benchmark::State & state, cryptolens::Executor * executor)
+{
+  LicenseFixture const& fixture = LicenseFixture::get(state.range(0));
+  std::vector<std::string> s(BATCH_SIZE, fixture.saved_license_key);
+
+  cryptolens::Error e;
+  Cryptolens cryptolens_handle(e);
+  cryptolens_handle.signature_verifier.set_modulus_base64(e, fixture.modulus_base64);
+  cryptolens_handle.signature_verifier.set_exponent_base64(e, fixture.exponent_base64);
+  if (executor) { cryptolens_handle.set_executor(e, *executor); }
+
+  std::vector<cryptolens::basic_Error> errors;
+  for (auto _ : state) {
+    auto license_keys = cryptolens_handle.make_license_keys(e, s, errors);
+    benchmark::DoNotOptimize(license_keys);
+  }
+
+  if (e || errors[0]) { state.SkipWithError("make_license_keys failed"); }
+  state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
+}
+
+} // namespace
+
+static void
+BM_basic_Cryptolens_make_license_keys_inline(benchmark::State & state)
+{
+  cryptolens::Executor_inline executor;
+  make_license_keys(state, &executor);
+}
+BENCHMARK(BM_basic_Cryptolens_make_license_keys_inline)->Apply(LicenseFixture::sizes)->UseRealTime();
+
+static void
+BM_basic_Cryptolens_make_license_keys_default_executor(benchmark::State & state)
+{
+  make_license_keys(state, nullptr);
+}
+BENCHMARK(BM_basic_Cryptolens_make_license_keys_default_executor)->Apply(LicenseFixture::sizes)->UseRealTime();
@@ -0,0 +1,81 @@
+#include <benchmark/benchmark.h>
+
+#include <cryptolens/api.hpp>
+#include <cryptolens/Error.hpp>
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+namespace {
+
+/*
+ * These benchmarks measure basic_Error as configured by the CMake option
+ * CRYPTOLENS_NONVIRTUAL_ERROR. The two configurations are compared by
+ * running them in a build with the option off and one with it on, and the
+ * label of each benchmark tells which configuration it ran in.
+ */
+void
+set_label(benchmark::State & state)
+{
+  state.SetLabel(CRYPTOLENS_CONFIG_NONVIRTUAL_ERROR ? "nonvirtual" : "virtual");
+}
+
+// Mimics the error checks at the start of each function in the library
+BENCH_NOINLINE int
+step(cryptolens::basic_Error & e, int x)
+{
+  if (e) { return 0; }
+  return x + 1;
+}
+
+// Mimics a function in the library failing, and the caller inspecting the
+// error, through references so the calls are not devirtualized
+BENCH_NOINLINE void
+fail(cryptolens::basic_Error & e, int reason)
+{
+  e.set(cryptolens::api::main(), cryptolens::errors::Subsystem::Main, reason);
+  e.set_call(cryptolens::api::main(), cryptolens::errors::Call::BASIC_SKM_ACTIVATE);
+}
+
+BENCH_NOINLINE int
+inspect(cryptolens::basic_Error & e)
+{
+  int reason = e.get_reason(cryptolens::api::main());
+  e.reset(cryptolens::api::main());
+  return reason;
+}
+
+} // namespace
+
+static void
+BM_basic_Error_check_chain(benchmark::State & state)
+{
+  cryptolens::Error e;
+  set_label(state);
+
+  for (auto _ : state) {
+    int x = 0;
+    for (int i = 0; i < 16; ++i) { x = step(e, x); }
+    benchmark::DoNotOptimize(x);
+  }
+}
+BENCHMARK(BM_basic_Error_check_chain);
+
+static void
+BM_basic_Error_set_and_reset(benchmark::State & state)
+{
+  cryptolens::Error e;
+  set_label(state);
+
+  for (auto _ : state) {
+    fail(e, cryptolens::errors::Main::UNKNOWN_SERVER_REPLY);
+    int reason = inspect(e);
+    benchmark::DoNotOptimize(reason);
+  }
+}
+BENCHMARK(BM_basic_Error_set_and_reset);
@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+#include <cryptolens/RequestHandler_v20190401_to_v20180502.hpp>
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+namespace cryptolens_v20180502 = ::cryptolens_io::v20180502;
+
+namespace {
+
+// The body of the last request made using RequestHandler_recording
+std::string recorded_body;
+
+/*
+ * A RequestHandler which encodes the arguments as a request body without
+ * making the request, and answers with an empty response. The body is kept
+ * in recorded_body to compare the arguments of different code paths.
+ */
+class RequestHandler_recording {
+public:
+  class PostBuilder {
+  public:
+    PostBuilder(char const* host, char const* endpoint)
+    {
+      recorded_body.clear();
+      recorded_body += host;
+      recorded_body += endpoint;
+    }
+
+    PostBuilder & add_argument(cryptolens::basic_Error &, char const* key, char const* value)
+    {
+      recorded_body += recorded_body.find('?') == std::string::npos ? '?' : '&';
+      recorded_body += key;
+      recorded_body += '=';
+      recorded_body += value;
+      return *this;
+    }
+
+    std::string make(cryptolens::basic_Error &) { return ""; }
+  };
+
+  explicit RequestHandler_recording(cryptolens::basic_Error &) {}
+
+  PostBuilder post_request(cryptolens::basic_Error &, char const* host, char const* endpoint)
+  {
+    return PostBuilder(host, endpoint);
+  }
+};
+
+using RequestHandler = ::cryptolens_io::internal::RequestHandler_v20190401_to_v20180502<RequestHandler_recording>;
+
+// Never called, since the empty responses fail to parse
+struct SignatureVerifier_none {
+  bool verify_message(cryptolens::basic_Error &, std::string const&, std::string const&) const { return false; }
+};
+
+/*
+ * The Activate request as made by basic_SKM before the arguments were passed
+ * as an array, for comparison.
+ */
+std::string
+make_request_map(cryptolens::basic_Error & e, RequestHandler_recording & inner, char const* method, std::unordered_map<std::string, std::string> const& map)
+{
+  std::string endpoint("/api/key/");
+  endpoint += method;
+
+  auto request = inner.post_request(e, "app.cryptolens.io", endpoint.c_str());
+
+  for (auto x : map) { request.add_argument(e, x.first.c_str(), x.second.c_str()); }
+
+  return request.make(e);
+}
+
+void
+activate_map(cryptolens::basic_Error & e, RequestHandler_recording & inner, SignatureVerifier_none const& signature_verifier, std::string token, std::string product_id, std::string key, std::string machine_code, int fields_to_return)
+{
+  std::unordered_map<std::string,std::string> args;
+  args["token"] = token;
+  args["ProductId"] = product_id;
+  args["Key"] = key;
+  args["Sign"] = "true";
+  args["MachineCode"] = machine_code;
+  std::ostringstream stm; stm << fields_to_return;
+  args["FieldsToReturn"] = stm.str();
+  args["SignMethod"] = "1";
+  args["v"] = "1";
+
+  std::string response = make_request_map(e, inner, "Activate", args);
+
+  auto x = cryptolens_v20180502::handle_activate_raw(e, signature_verifier, response);
+  benchmark::DoNotOptimize(x);
+}
+
+std::string const token = "WyI0NjUiLCJBWTBGTlQwZm9WV0FyVnZzMEV1Mm9LOHJmRDZ1SjF0Vk52WTU0VzB2Il0=";
+std::string const product_id = "3646";
+std::string const key = "MPDWY-PQAOW-FKSCH-SGAAU";
+std::string const machine_code = "289jf2afs3";
+
+// The arguments of a request, in a canonical order
+std::vector<std::string>
+arguments(std::string const& body)
+{
+  std::vector<std::string> arguments;
+  size_t k = body.find('?');
+  while (k != std::string::npos) {
+    size_t next = body.find('&', k + 1);
+    arguments.push_back(body.substr(k + 1, next == std::string::npos ? next : next - k - 1));
+    k = next;
+  }
+  std::sort(arguments.begin(), arguments.end());
+  return arguments;
+}
+
+} // namespace
+
+static void
+BM_basic_SKM_activate_request_map(benchmark::State & state)
+{
+  cryptolens::Error e;
+  cryptolens::Error inner_e;
+  RequestHandler_recording inner(inner_e);
+  SignatureVerifier_none signature_verifier;
+
+  for (auto _ : state) {
+    activate_map(e, inner, signature_verifier, token, product_id, key, machine_code, 0);
+    e.reset(cryptolens::api::main());
+  }
+}
+BENCHMARK(BM_basic_SKM_activate_request_map);
+
+static void
+BM_basic_SKM_activate_request(benchmark::State & state)
+{
+  cryptolens::Error e;
+  cryptolens_v20180502::basic_SKM<RequestHandler, SignatureVerifier_none> skm;
+
+  // Both code paths should make the same request, up to the order of the arguments
+  cryptolens::Error inner_e;
+  RequestHandler_recording inner(inner_e);
+  activate_map(e, inner, skm.signature_verifier, token, product_id, key, machine_code, 0);
+  e.reset(cryptolens::api::main());
+  std::string expected = recorded_body;
+
+  skm.activate_raw(e, token, product_id, key, machine_code, 0);
+  e.reset(cryptolens::api::main());
+  std::string actual = recorded_body;
+
+  size_t k = expected.find('?');
+  if (arguments(actual) != arguments(expected) || actual.compare(0, k, expected, 0, k) != 0) {
+    state.SkipWithError("requests differ");
+    return;
+  }
+
+  for (auto _ : state) {
+    auto x = skm.activate_raw(e, token, product_id, key, machine_code, 0);
+    benchmark::DoNotOptimize(x);
+    e.reset(cryptolens::api::main());
+  }
+}
+BENCHMARK(BM_basic_SKM_activate_request);
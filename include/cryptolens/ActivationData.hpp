@@ -1,22 +1,31 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <string>
 
+#include "MemoryResource.hpp"
+
 namespace cryptolens_io {
 
 namespace v20190401 {
 
 // An immutable class representing an activated machine
 // for a given serial key
-class ActivationData {
+template<typename Allocator>
+class basic_ActivationData {
+public:
+  using allocator_type = Allocator;
+  using string_type = std::basic_string<char, std::char_traits<char>, Allocator>;
+
 private:
-  std::string mid_;
-  std::string ip_;
+  string_type mid_;
+  string_type ip_;
   std::uint64_t time_;
 public:
-  ActivationData
-    ( std::string mid
-    , std::string ip
+  basic_ActivationData
+    ( string_type mid
+    , string_type ip
     , std::uint64_t time
     )
   : mid_(std::move(mid))
@@ -25,15 +34,23 @@ public:
   { }
 
   // Returns the machine id
-  std::string const& get_mid() const { return mid_; }
+  string_type const& get_mid() const { return mid_; }
 
   // Returns the IP when the machine was activated the first time
-  std::string const& get_ip() const { return ip_; }
+  string_type const& get_ip() const { return ip_; }
 
   // Returns the time the machine was activated the first time
   std::uint64_t get_time() const { return time_; }
 };
 
+using ActivationData = basic_ActivationData<std::allocator<char>>;
+
+namespace pmr {
+
+using ActivationData = basic_ActivationData<PolymorphicAllocator<char>>;
+
+} // namespace pmr
+
 } // namespace v20190401
 
 namespace v20180502 {
@@ -44,8 +61,16 @@ using ::cryptolens_io::v20190401::ActivationData;
 
 namespace latest {
 
+template<typename Allocator>
+using basic_ActivationData = ::cryptolens_io::v20190401::basic_ActivationData<Allocator>;
 using ::cryptolens_io::v20190401::ActivationData;
 
+namespace pmr {
+
+using ::cryptolens_io::v20190401::pmr::ActivationData;
+
+} // namespace pmr
+
 } // namespace latest
 
 } // namespace cryptolens_io
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "imports/std/optional"
+
+#include "ActivationData.hpp"
+#include "MemoryResource.hpp"
+#include "StringView.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace internal {
+
+// How the IP of an activated machine is stored in an ActivationDataTable
+int constexpr IP_TEXT = 0;
+int constexpr IP_V4 = 1;
+int constexpr IP_V6 = 2;
+
+/*
+ * Parses an IPv4 or IPv6 address into 16 bytes, with IPv4 addresses stored
+ * as IPv4-mapped IPv6 addresses. Returns IP_TEXT if ip is not an address,
+ * or if it is not written the way ip_format() would write it, e.g. due to
+ * leading zeros or upper case hex digits, so that it is kept as it is.
+ */
+int
+ip_parse(StringView ip, unsigned char (&bytes)[16]);
+
+std::string
+ip_format(int kind, unsigned char const* bytes);
+
+} // namespace internal
+
+// An activated machine in an ActivationDataTable, see ActivationData
+class ActivationDataRef {
+public:
+  ActivationDataRef(StringView mid, int ip_kind, unsigned char const* ip_bytes, StringView ip_text, std::uint64_t time)
+  : mid_(mid), ip_kind_(ip_kind), ip_bytes_(ip_bytes), ip_text_(ip_text), time_(time)
+  {}
+
+  // Returns the machine id
+  StringView    get_mid() const { return mid_; }
+
+  // Returns the IP when the machine was activated the first time, in the
+  // same format as ActivationData::get_ip(). Unlike ActivationData, the IP
+  // is returned by value, since addresses are stored as bytes and formatted
+  // on each call. Use get_ip_bytes() to compare addresses without this
+  std::string   get_ip() const;
+
+  // Returns if the IP is an IPv4 address, see get_ip_bytes()
+  bool          is_ipv4() const { return ip_kind_ == internal::IP_V4; }
+
+  // Returns if the IP is an IPv6 address, see get_ip_bytes()
+  bool          is_ipv6() const { return ip_kind_ == internal::IP_V6; }
+
+  // Returns the 16 bytes of the IP in network byte order, with IPv4
+  // addresses mapped to IPv6 addresses as ::ffff:a.b.c.d, or a null pointer
+  // if the IP is neither an IPv4 nor an IPv6 address
+  unsigned char const* get_ip_bytes() const { return ip_kind_ == internal::IP_TEXT ? nullptr : ip_bytes_; }
+
+  // Returns the time the machine was activated the first time
+  std::uint64_t get_time() const { return time_; }
+
+private:
+  StringView mid_;
+  int ip_kind_;
+  unsigned char const* ip_bytes_;
+  StringView ip_text_;
+  std::uint64_t time_;
+};
+
+/**
+ * The activated machines of a license key, stored column-wise.
+ *
+ * All machine ids are kept back to back in one string, and the IPs as 16
+ * bytes each, so a license key with thousands of activated machines takes
+ * a handful of allocations rather than a few per machine, and searching
+ * the machine ids using find_mid() reads memory sequentially.
+ *
+ * The table can be iterated like a std::vector<ActivationData>, although the
+ * elements are ActivationDataRef objects referring into the table:
+ *
+ *     for (auto m : table) {
+ *       if (m.get_mid() == machine_code) { ... }
+ *     }
+ */
+template<typename Allocator>
+class basic_ActivationDataTable {
+public:
+  using allocator_type = Allocator;
+  using string_type = std::basic_string<char, std::char_traits<char>, Allocator>;
+  using ActivationData = basic_ActivationData<Allocator>;
+  using ActivationDataList = std::vector<ActivationData, typename std::allocator_traits<Allocator>::template rebind_alloc<ActivationData>>;
+
+  class const_iterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = ActivationDataRef;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = ActivationDataRef;
+
+    const_iterator() : table_(nullptr), i_(0) {}
+    const_iterator(basic_ActivationDataTable const* table, size_t i) : table_(table), i_(i) {}
+
+    ActivationDataRef operator*() const { return (*table_)[i_]; }
+    ActivationDataRef operator[](difference_type n) const { return (*table_)[i_ + n]; }
+
+    const_iterator & operator++() { ++i_; return *this; }
+    const_iterator operator++(int) { const_iterator x = *this; ++i_; return x; }
+    const_iterator & operator--() { --i_; return *this; }
+    const_iterator operator--(int) { const_iterator x = *this; --i_; return x; }
+    const_iterator & operator+=(difference_type n) { i_ += n; return *this; }
+    const_iterator & operator-=(difference_type n) { i_ -= n; return *this; }
+
+    friend const_iterator operator+(const_iterator x, difference_type n) { return x += n; }
+    friend const_iterator operator+(difference_type n, const_iterator x) { return x += n; }
+    friend const_iterator operator-(const_iterator x, difference_type n) { return x -= n; }
+    friend difference_type operator-(const_iterator a, const_iterator b) { return (difference_type)a.i_ - (difference_type)b.i_; }
+
+    friend bool operator==(const_iterator a, const_iterator b) { return a.i_ == b.i_; }
+    friend bool operator!=(const_iterator a, const_iterator b) { return a.i_ != b.i_; }
+    friend bool operator<(const_iterator a, const_iterator b) { return a.i_ < b.i_; }
+    friend bool operator>(const_iterator a, const_iterator b) { return a.i_ > b.i_; }
+    friend bool operator<=(const_iterator a, const_iterator b) { return a.i_ <= b.i_; }
+    friend bool operator>=(const_iterator a, const_iterator b) { return a.i_ >= b.i_; }
+
+  private:
+    basic_ActivationDataTable const* table_;
+    size_t i_;
+  };
+
+  explicit basic_ActivationDataTable(Allocator const& allocator = Allocator());
+
+  void reserve(size_t machines, size_t mid_bytes);
+  void push_back(StringView mid, StringView ip, std::uint64_t time);
+
+  size_t size() const { return times_.size(); }
+  bool empty() const { return times_.empty(); }
+
+  ActivationDataRef operator[](size_t i) const;
+
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size()); }
+
+  optional<size_t> find_mid(StringView mid) const;
+
+  ActivationDataList to_list() const;
+
+  allocator_type get_allocator() const { return mids_.get_allocator(); }
+
+private:
+  template<typename T>
+  using vector = std::vector<T, typename std::allocator_traits<Allocator>::template rebind_alloc<T>>;
+
+  struct IPBytes {
+    unsigned char bytes[16];
+  };
+
+  // All machine ids back to back, with machine i in
+  // [mid_offsets_[i], mid_offsets_[i+1])
+  string_type mids_;
+  vector<std::uint32_t> mid_offsets_;
+
+  // IPs which are not stored as bytes, with the offset and length into
+  // ip_texts_ stored in the bytes instead
+  vector<IPBytes> ips_;
+  vector<unsigned char> ip_kinds_;
+  string_type ip_texts_;
+
+  vector<std::uint64_t> times_;
+};
+
+using ActivationDataTable = basic_ActivationDataTable<std::allocator<char>>;
+
+namespace pmr {
+
+using ActivationDataTable = basic_ActivationDataTable<PolymorphicAllocator<char>>;
+
+} // namespace pmr
+
+} // namespace v20190401
+
+namespace latest {
+
+using ActivationDataRef = ::cryptolens_io::v20190401::ActivationDataRef;
+
+template<typename Allocator>
+using basic_ActivationDataTable = ::cryptolens_io::v20190401::basic_ActivationDataTable<Allocator>;
+using ActivationDataTable = ::cryptolens_io::v20190401::ActivationDataTable;
+
+namespace pmr {
+
+using ActivationDataTable = ::cryptolens_io::v20190401::pmr::ActivationDataTable;
+
+} // namespace pmr
+
+} // namespace latest
+
+} // namespace cryptolens_io
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+/*
+ * Clocks are policy classes providing the current time to
+ * NotExpiredValidator_ and LicenseKeyChecker, through a static member
+ * function
+ *
+ *     static std::int64_t now();
+ *
+ * returning a unix timestamp in seconds, or a negative value if the time is
+ * not available.
+ */
+
+/**
+ * The system clock, read using std::time() on each call.
+ */
+struct Clock_ctime {
+  static std::int64_t now() { return (std::int64_t)std::time(NULL); }
+};
+
+/**
+ * The system clock at a resolution of a second, cheaper to read than
+ * Clock_ctime. Intended for checking expiry on hot paths.
+ *
+ * The time is kept in an atomic variable updated just after each second by
+ * a background thread, started the first time the clock is read, thus
+ * reading the clock is a single atomic load. If the thread cannot be
+ * started, and in child processes created using fork(), std::time() is used
+ * instead.
+ */
+struct Clock_coarse {
+  static std::int64_t now()
+  {
+    std::int64_t now = time_.load(std::memory_order_relaxed);
+    return now != 0 ? now : start();
+  }
+
+private:
+  static std::int64_t start();
+
+  // Zero unless kept up to date by the background thread
+  static std::atomic<std::int64_t> time_;
+};
+
+/**
+ * A clock which only changes when told to, for tests and benchmarks. The
+ * time is shared by all users of the clock in the process and is initially
+ * zero.
+ */
+struct Clock_fake {
+  static std::int64_t now() { return time_.load(std::memory_order_relaxed); }
+
+  static void set(std::int64_t now) { time_.store(now, std::memory_order_relaxed); }
+  static void advance(std::int64_t seconds) { time_.fetch_add(seconds, std::memory_order_relaxed); }
+
+private:
+  static std::atomic<std::int64_t> time_;
+};
+
+} // namespace v20190401
+
+namespace latest {
+
+using Clock_ctime = ::cryptolens_io::v20190401::Clock_ctime;
+using Clock_coarse = ::cryptolens_io::v20190401::Clock_coarse;
+using Clock_fake = ::cryptolens_io::v20190401::Clock_fake;
+
+} // namespace latest
+
+} // namespace cryptolens_io
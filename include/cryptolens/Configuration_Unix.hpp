@@ -1,7 +1,9 @@
 #pragma once
 
+#include "Instrumentation.hpp"
 #include "ResponseParser_ArduinoJson5.hpp"
 #include "RequestHandler_curl.hpp"
+#include "RequestPolicy.hpp"
 #include "SignatureVerifier_OpenSSL.hpp"
 
 #include "validators/AndValidator.hpp"
@@ -20,6 +22,8 @@ struct Configuration_Unix {
   using RequestHandler = RequestHandler_curl;
   using SignatureVerifier = SignatureVerifier_OpenSSL;
   using MachineCodeComputer = MachineCodeComputer_;
+  using Instrumentation = Instrumentation_none;
+  using RequestPolicy = RequestPolicy_default;
 
   template<typename Env>
   using ActivateValidator = AndValidator_<Env, CorrectKeyValidator_<Env>
@@ -35,6 +39,8 @@ struct Configuration_Unix_IgnoreExpires {
   using RequestHandler = RequestHandler_curl;
   using SignatureVerifier = SignatureVerifier_OpenSSL;
   using MachineCodeComputer = MachineCodeComputer_;
+  using Instrumentation = Instrumentation_none;
+  using RequestPolicy = RequestPolicy_default;
 
   template<typename Env>
   using ActivateValidator = AndValidator_<Env, CorrectKeyValidator_<Env>
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Instrumentation.hpp"
 #include "ResponseParser_ArduinoJson5.hpp"
 #include "RequestHandler_WinHTTP.hpp"
 #include "SignatureVerifier_CryptoAPI.hpp"
@@ -20,6 +21,7 @@ struct Configuration_Windows {
   using RequestHandler = RequestHandler_WinHTTP;
   using SignatureVerifier = SignatureVerifier_CryptoAPI;
   using MachineCodeComputer = MachineCodeComputer_;
+  using Instrumentation = Instrumentation_none;
 
   template<typename Env>
   using ActivateValidator = AndValidator_<Env, CorrectKeyValidator_<Env>
@@ -35,6 +37,7 @@ struct Configuration_Windows_IgnoreExpires {
   using RequestHandler = RequestHandler_WinHTTP;
   using SignatureVerifier = SignatureVerifier_CryptoAPI;
   using MachineCodeComputer = MachineCodeComputer_;
+  using Instrumentation = Instrumentation_none;
 
   template<typename Env>
   using ActivateValidator = AndValidator_<Env, CorrectKeyValidator_<Env>
@@ -1,23 +1,34 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "MemoryResource.hpp"
+
 namespace cryptolens_io {
 
 namespace v20190401 {
 
 // This immutable class represents a customer
-class Customer {
+template<typename Allocator>
+class basic_Customer {
+public:
+  using allocator_type = Allocator;
+  using string_type = std::basic_string<char, std::char_traits<char>, Allocator>;
+
 private:
   int id_;
-  std::string name_;
-  std::string email_;
-  std::string company_name_;
+  string_type name_;
+  string_type email_;
+  string_type company_name_;
   std::uint64_t created_;
 public:
-  Customer
+  basic_Customer
     ( int id
-    , std::string name
-    , std::string email
-    , std::string company_name
+    , string_type name
+    , string_type email
+    , string_type company_name
     , std::uint64_t created
     )
   : id_(id)
@@ -33,18 +44,26 @@ public:
   int                get_id() const { return id_; }
 
   // Returns the customer name
-  std::string const& get_name() const { return name_; }
+  string_type const& get_name() const { return name_; }
 
   // Returns the customer's email
-  std::string const& get_email() const { return email_; }
+  string_type const& get_email() const { return email_; }
 
   // Returns the customer's company name
-  std::string const& get_company_name() const { return company_name_; }
+  string_type const& get_company_name() const { return company_name_; }
 
   // Returns when the customer's account was created
   std::uint64_t get_created() const { return created_; }
 };
 
+using Customer = basic_Customer<std::allocator<char>>;
+
+namespace pmr {
+
+using Customer = basic_Customer<PolymorphicAllocator<char>>;
+
+} // namespace pmr
+
 } // namespace v20190401
 
 namespace v20180502 {
@@ -55,8 +74,16 @@ using Customer = ::cryptolens_io::v20190401::Customer;
 
 namespace latest {
 
+template<typename Allocator>
+using basic_Customer = ::cryptolens_io::v20190401::basic_Customer<Allocator>;
 using Customer = ::cryptolens_io::v20190401::Customer;
 
+namespace pmr {
+
+using Customer = ::cryptolens_io::v20190401::pmr::Customer;
+
+} // namespace pmr
+
 } // namespace latest
 
 } // namespace cryptolens_io
@@ -1,23 +1,31 @@
 #pragma once
 
+#include <memory>
 #include <string>
 
+#include "MemoryResource.hpp"
+
 namespace cryptolens_io {
 
 namespace v20190401 {
 
 // An immutable class representing an Cryptolens Data Object
-class DataObject {
+template<typename Allocator>
+class basic_DataObject {
+public:
+  using allocator_type = Allocator;
+  using string_type = std::basic_string<char, std::char_traits<char>, Allocator>;
+
 private:
   int id_;
-  std::string name_;
-  std::string string_value_;
+  string_type name_;
+  string_type string_value_;
   int int_value_;
 public:
-  DataObject
+  basic_DataObject
     ( int id
-    , std::string name
-    , std::string string_value
+    , string_type name
+    , string_type string_value
     , int int_value
     )
   : id_(id)
@@ -34,15 +42,23 @@ public:
   int                get_id() const;
 
   // Returns the name of the data object
-  std::string const& get_name() const;
+  string_type const& get_name() const;
 
   // Returns the string value of the data object
-  std::string const& get_string_value() const;
+  string_type const& get_string_value() const;
 
   // Returns the integer value of the data object
   int                get_int_value() const;
 };
 
+using DataObject = basic_DataObject<std::allocator<char>>;
+
+namespace pmr {
+
+using DataObject = basic_DataObject<PolymorphicAllocator<char>>;
+
+} // namespace pmr
+
 } // namespace v20190401
 
 namespace v20180502 {
@@ -53,8 +69,16 @@ using DataObject = ::cryptolens_io::v20190401::DataObject;
 
 namespace latest {
 
+template<typename Allocator>
+using basic_DataObject = ::cryptolens_io::v20190401::basic_DataObject<Allocator>;
 using DataObject = ::cryptolens_io::v20190401::DataObject;
 
+namespace pmr {
+
+using DataObject = ::cryptolens_io::v20190401::pmr::DataObject;
+
+} // namespace pmr
+
 } // namespace latest
 
 } // namespace cryptolens_io
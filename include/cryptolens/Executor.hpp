@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "basic_Error.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace errors {
+
+namespace Executor {
+
+int constexpr THREAD_CREATE = 1;
+
+} // namespace Executor
+
+} // namespace errors
+
+/**
+ * Runs the CPU bound parts of the library, i.e. parsing of responses, base64
+ * decoding and signature verification, when these are performed in batch
+ * or asynchronously. See basic_Cryptolens::make_license_keys() and
+ * basic_Cryptolens::activate_async().
+ *
+ * By default the library uses a process wide Executor_thread_pool, see
+ * default_executor(). Applications that already manage their own threads
+ * can instead provide an adapter to their thread pool, e.g.
+ *
+ *     class Executor_tbb : public cryptolens::Executor {
+ *     public:
+ *       void execute(std::function<void()> task) override { arena_.enqueue(std::move(task)); }
+ *       unsigned concurrency() const override { return arena_.max_concurrency(); }
+ *     private:
+ *       tbb::task_arena arena_;
+ *     };
+ *
+ * and set it on a handle using basic_Cryptolens::set_executor().
+ */
+class Executor {
+public:
+  virtual ~Executor() {}
+
+  /**
+   * Arranges for the task to be called, either on some other thread or
+   * before returning.
+   */
+  virtual void execute(std::function<void()> task) = 0;
+
+  /**
+   * The number of tasks that can run at the same time. This is used to
+   * decide into how many tasks a batch is split.
+   */
+  virtual unsigned concurrency() const { return 1; }
+};
+
+/**
+ * An Executor which runs each task on the calling thread before returning.
+ * This can be used to keep all work on the thread calling the library.
+ */
+class Executor_inline : public Executor {
+public:
+  void execute(std::function<void()> task) override { task(); }
+};
+
+/**
+ * A thread pool with one queue per thread. Tasks submitted from one of the
+ * threads of the pool are placed in the queue of that thread, and threads
+ * that run out of tasks steal from the queues of the other threads.
+ *
+ * If threads is zero, one thread per hardware thread is started.
+ */
+class Executor_thread_pool : public Executor {
+public:
+#ifndef CRYPTOLENS_20190701_ALLOW_IMPLICIT_CONSTRUCTORS
+  explicit
+#endif
+  Executor_thread_pool(basic_Error & e, unsigned threads = 0);
+  Executor_thread_pool(Executor_thread_pool const&) = delete;
+  void operator=(Executor_thread_pool const&) = delete;
+  ~Executor_thread_pool();
+
+  void execute(std::function<void()> task) override;
+  unsigned concurrency() const override;
+
+private:
+  struct Worker {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  bool take(size_t index, std::function<void()> & task);
+  void run(size_t index);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> queued_;
+  std::atomic<size_t> next_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_;
+};
+
+/**
+ * Returns the process wide Executor_thread_pool used by handles without an
+ * Executor of their own. The pool is started on first use.
+ */
+Executor &
+default_executor();
+
+namespace internal {
+
+/*
+ * Calls body(begin, end) for consecutive ranges covering [0, n), running
+ * the ranges as tasks on the executor, and returns once all of them have
+ * finished. The calling thread also processes ranges, thus this finishes
+ * even if all threads of the executor are busy, or if it is called from
+ * one of them.
+ */
+void
+parallel_for(Executor & executor, size_t n, std::function<void(size_t, size_t)> const& body);
+
+} // namespace internal
+
+} // namespace v20190401
+
+namespace latest {
+
+namespace errors {
+
+namespace Executor = ::cryptolens_io::v20190401::errors::Executor;
+
+} // namespace errors
+
+using Executor = ::cryptolens_io::v20190401::Executor;
+using Executor_inline = ::cryptolens_io::v20190401::Executor_inline;
+using Executor_thread_pool = ::cryptolens_io::v20190401::Executor_thread_pool;
+using ::cryptolens_io::v20190401::default_executor;
+
+} // namespace latest
+
+} // namespace cryptolens_io
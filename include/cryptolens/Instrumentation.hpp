@@ -0,0 +1,232 @@
+#pragma once
+
+#include <cstdint>
+
+#include "basic_Error.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace instrumentation {
+
+/*
+ * The stages of the library that are reported to the Instrumentation
+ * policy. The stages nest, e.g. SIGNATURE_VERIFICATION is reported while
+ * RAW_LICENSE_KEY_MAKE is in progress, which in turn is reported while
+ * HANDLE_ACTIVATE is in progress.
+ */
+namespace Stage {
+
+// basic_Cryptolens::activate() and activate_floating(), from start to finish
+int constexpr ACTIVATE = 0;
+// Building and performing a request to the Web API
+int constexpr REQUEST = 1;
+// internal::handle_activate(), i.e. parsing the response and checking the signature
+int constexpr HANDLE_ACTIVATE = 2;
+// ResponseParser::parse_activate_response()
+int constexpr PARSE_ACTIVATE_RESPONSE = 3;
+// RawLicenseKey::make()
+int constexpr RAW_LICENSE_KEY_MAKE = 4;
+// Base64 decoding of the license key in RawLicenseKey::make()
+int constexpr BASE64_DECODE = 5;
+// SignatureVerifier::verify_message()
+int constexpr SIGNATURE_VERIFICATION = 6;
+// ResponseParser::make_license_key_information()
+int constexpr MAKE_LICENSE_KEY_INFORMATION = 7;
+// The ActivateValidator of the Configuration
+int constexpr VALIDATE = 8;
+
+int constexpr COUNT = 9;
+
+} // namespace Stage
+
+} // namespace instrumentation
+
+/**
+ * Statistics about the most recent request made by a RequestHandler.
+ *
+ * All times are given in microseconds and are measured from the start of
+ * the request, i.e. connect_time includes namelookup_time and so on. If a
+ * connection was reused, the name lookup and connect times are zero. The
+ * sizes are the number of bytes of the request and response bodies as
+ * transferred, i.e. before decompression of a compressed response. Fields
+ * the RequestHandler cannot provide are left as zero.
+ */
+struct RequestStatistics {
+  std::uint64_t namelookup_time;
+  std::uint64_t connect_time;
+  std::uint64_t appconnect_time;
+  std::uint64_t pretransfer_time;
+  std::uint64_t starttransfer_time;
+  std::uint64_t total_time;
+  std::uint64_t bytes_sent;
+  std::uint64_t bytes_received;
+};
+
+/**
+ * The default Instrumentation policy. All methods are empty and are
+ * removed entirely by the compiler.
+ *
+ * An Instrumentation policy is selected by the Instrumentation member type
+ * of the Configuration used with basic_Cryptolens, and is available as the
+ * instrumentation member of the handle class. A custom policy must provide
+ * the same methods as this class:
+ *
+ *   - stage_begin() and stage_end() are called when one of the stages listed
+ *     in instrumentation::Stage starts and finishes. Calls to stage_end() are
+ *     made even if an error occured during the stage.
+ *   - request_finished() is called with the RequestHandler after each request
+ *     to the Web API. The RequestHandler is passed instead of the statistics
+ *     so that they are only computed if the policy asks for them, see
+ *     Instrumentation_steady_clock for an example.
+ *   - activation_finished() is called at the end of each call to
+ *     basic_Cryptolens::activate() and activate_floating(), after the
+ *     ACTIVATE stage has ended, with the error object of the call.
+ *
+ * A policy may also provide cache_hit(), which is called by TrialKeyCache
+ * and MessageSubscription each time a result is returned from their cache
+ * without making a request. Unlike the methods above, it may be called from
+ * several threads at once.
+ */
+class Instrumentation_none {
+public:
+#ifndef CRYPTOLENS_20190701_ALLOW_IMPLICIT_CONSTRUCTORS
+  explicit
+#endif
+  Instrumentation_none(basic_Error &) {}
+
+  void stage_begin(int) {}
+  void stage_end(int) {}
+
+  template<typename RequestHandler>
+  void request_finished(RequestHandler const&) {}
+
+  void activation_finished(basic_Error const&) {}
+
+  void cache_hit() const {}
+};
+
+namespace internal {
+
+/*
+ * Reports a stage to an Instrumentation policy for as long as the object is
+ * in scope.
+ */
+template<typename Instrumentation>
+class InstrumentationScope {
+public:
+  InstrumentationScope(Instrumentation & instrumentation, int stage)
+  : instrumentation_(instrumentation), stage_(stage)
+  {
+    instrumentation_.stage_begin(stage_);
+  }
+
+  InstrumentationScope(InstrumentationScope const&) = delete;
+  void operator=(InstrumentationScope const&) = delete;
+
+  ~InstrumentationScope() { instrumentation_.stage_end(stage_); }
+
+private:
+  Instrumentation & instrumentation_;
+  int stage_;
+};
+
+/*
+ * Reports the ACTIVATE stage, followed by the outcome of the activation, to
+ * an Instrumentation policy when the object goes out of scope.
+ */
+template<typename Instrumentation>
+class ActivationInstrumentationScope {
+public:
+  ActivationInstrumentationScope(Instrumentation & instrumentation, basic_Error const& e)
+  : instrumentation_(instrumentation), e_(e)
+  {
+    instrumentation_.stage_begin(instrumentation::Stage::ACTIVATE);
+  }
+
+  ActivationInstrumentationScope(ActivationInstrumentationScope const&) = delete;
+  void operator=(ActivationInstrumentationScope const&) = delete;
+
+  ~ActivationInstrumentationScope()
+  {
+    instrumentation_.stage_end(instrumentation::Stage::ACTIVATE);
+    instrumentation_.activation_finished(e_);
+  }
+
+private:
+  Instrumentation & instrumentation_;
+  basic_Error const& e_;
+};
+
+template<typename T>
+struct void_ { typedef void type; };
+
+/*
+ * Selects Configuration::Instrumentation, or Instrumentation_none for
+ * Configurations that do not specify an Instrumentation policy.
+ */
+template<typename Configuration, typename = void>
+struct configuration_instrumentation {
+  using type = Instrumentation_none;
+};
+
+template<typename Configuration>
+struct configuration_instrumentation<Configuration, typename void_<typename Configuration::Instrumentation>::type> {
+  using type = typename Configuration::Instrumentation;
+};
+
+/*
+ * Obtains the RequestStatistics from a RequestHandler, if the RequestHandler
+ * provides a get_last_request_statistics() method.
+ */
+template<typename RequestHandler>
+auto
+get_last_request_statistics(RequestHandler const& request_handler, int)
+  -> decltype(request_handler.get_last_request_statistics())
+{
+  return request_handler.get_last_request_statistics();
+}
+
+template<typename RequestHandler>
+RequestStatistics
+get_last_request_statistics(RequestHandler const& request_handler, long)
+{
+  return RequestStatistics{0, 0, 0, 0, 0, 0, 0, 0};
+}
+
+/*
+ * Reports a cache hit to an Instrumentation policy, if the policy provides a
+ * cache_hit() method.
+ */
+template<typename Instrumentation>
+auto
+report_cache_hit(Instrumentation const& instrumentation, int)
+  -> decltype(instrumentation.cache_hit())
+{
+  return instrumentation.cache_hit();
+}
+
+template<typename Instrumentation>
+void
+report_cache_hit(Instrumentation const& instrumentation, long)
+{}
+
+} // namespace internal
+
+} // namespace v20190401
+
+namespace latest {
+
+namespace instrumentation {
+
+namespace Stage = ::cryptolens_io::v20190401::instrumentation::Stage;
+
+} // namespace instrumentation
+
+using RequestStatistics = ::cryptolens_io::v20190401::RequestStatistics;
+using Instrumentation_none = ::cryptolens_io::v20190401::Instrumentation_none;
+
+} // namespace latest
+
+} // namespace cryptolens_io
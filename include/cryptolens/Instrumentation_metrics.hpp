@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+
+#include "basic_Error.hpp"
+#include "Instrumentation.hpp"
+#include "Metrics.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+/**
+ * An Instrumentation policy which records the duration of each stage, the
+ * statistics of each request, the outcome of each activation and cache hits
+ * in the process wide Metrics object.
+ *
+ * Example:
+ *
+ *     template<typename MachineCodeComputer>
+ *     struct Configuration_Unix_Metrics : Configuration_Unix<MachineCodeComputer> {
+ *       using Instrumentation = Instrumentation_metrics;
+ *     };
+ *
+ *     // ...
+ *
+ *     std::string exposition = Metrics::get().format_prometheus();
+ */
+class Instrumentation_metrics {
+public:
+#ifndef CRYPTOLENS_20190701_ALLOW_IMPLICIT_CONSTRUCTORS
+  explicit
+#endif
+  Instrumentation_metrics(basic_Error & e);
+
+  void stage_begin(int stage);
+  void stage_end(int stage);
+
+  template<typename RequestHandler>
+  void request_finished(RequestHandler const& request_handler)
+  {
+    metrics_.record_request(internal::get_last_request_statistics(request_handler, 0));
+  }
+
+  void activation_finished(basic_Error const& e);
+
+  void cache_hit() const { metrics_.record_cache_hit(); }
+
+private:
+  Metrics & metrics_;
+  std::chrono::steady_clock::time_point begin_[instrumentation::Stage::COUNT];
+};
+
+} // namespace v20190401
+
+namespace latest {
+
+using Instrumentation_metrics = ::cryptolens_io::v20190401::Instrumentation_metrics;
+
+} // namespace latest
+
+} // namespace cryptolens_io
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+
+#include "basic_Error.hpp"
+#include "Instrumentation.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+/**
+ * An Instrumentation policy which measures the time spent in each stage
+ * of the library using std::chrono::steady_clock.
+ *
+ * After a call to e.g. basic_Cryptolens::activate() the time spent in each
+ * stage during that call can be obtained using get_duration(), and the
+ * statistics reported by the RequestHandler for the last request using
+ * get_request_statistics(). The measurements are overwritten by the next
+ * call, thus this policy is intended to be used in the same way as the
+ * rest of the handle class, i.e. from one thread at a time.
+ *
+ * Example:
+ *
+ *     template<typename MachineCodeComputer>
+ *     struct Configuration_Unix_Timed : Configuration_Unix<MachineCodeComputer> {
+ *       using Instrumentation = Instrumentation_steady_clock;
+ *     };
+ */
+class Instrumentation_steady_clock {
+public:
+#ifndef CRYPTOLENS_20190701_ALLOW_IMPLICIT_CONSTRUCTORS
+  explicit
+#endif
+  Instrumentation_steady_clock(basic_Error & e);
+
+  void stage_begin(int stage);
+  void stage_end(int stage);
+
+  template<typename RequestHandler>
+  void request_finished(RequestHandler const& request_handler)
+  {
+    request_statistics_ = internal::get_last_request_statistics(request_handler, 0);
+  }
+
+  void activation_finished(basic_Error const&) {}
+
+  std::chrono::nanoseconds get_duration(int stage) const;
+  RequestStatistics const& get_request_statistics() const;
+
+  void reset();
+
+private:
+  std::chrono::steady_clock::time_point begin_[instrumentation::Stage::COUNT];
+  std::chrono::nanoseconds duration_[instrumentation::Stage::COUNT];
+  RequestStatistics request_statistics_;
+};
+
+} // namespace v20190401
+
+namespace latest {
+
+using Instrumentation_steady_clock = ::cryptolens_io::v20190401::Instrumentation_steady_clock;
+
+} // namespace latest
+
+} // namespace cryptolens_io
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace internal {
+
+/*
+ * A scanner for JSON text which walks over the text without building a
+ * document, leaving it to the caller to interpret the values it cares about
+ * and skip the rest. Strings are unescaped the same way as by the ArduinoJson
+ * parser used by ResponseParser_ArduinoJson5.
+ *
+ * All methods return false if the text is not valid JSON.
+ */
+class JsonScanner {
+public:
+  /*
+   * A scanned JSON value. Objects and arrays are skipped, and only their
+   * type is recorded. Strings are recorded as their offset and length in the
+   * text, without the quotes.
+   */
+  struct Value {
+    enum Type { JSON_STRING, JSON_NUMBER, JSON_OTHER_NUMBER, JSON_TRUE, JSON_FALSE, JSON_NULL, JSON_OBJECT, JSON_ARRAY };
+
+    Type type;
+    size_t offset;
+    size_t length;
+    bool escaped;
+    std::uint64_t number;
+  };
+
+  // Maximum nesting of objects and arrays in skipped values
+  static int constexpr MAX_DEPTH = 64;
+
+  JsonScanner(char const* text, size_t size)
+  : begin_(text), p_(text), end_(text + size)
+  {}
+
+  // Returns the contents of a scanned string, unescaped
+  std::string
+  string_value(Value const& v)
+  {
+    std::string out;
+    if (v.escaped) { decode(begin_ + v.offset, v.length, out); }
+    else           { out.assign(begin_ + v.offset, v.length); }
+    return out;
+  }
+
+  // Returns if only whitespace is left
+  bool
+  at_end()
+  {
+    ws();
+    return p_ == end_;
+  }
+
+  void
+  ws()
+  {
+    while (p_ != end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) { ++p_; }
+  }
+
+  bool
+  accept(char c)
+  {
+    ws();
+    if (p_ == end_ || *p_ != c) { return false; }
+    ++p_;
+    return true;
+  }
+
+  bool object_begin() { return accept('{'); }
+
+  // After '{', determines if the object has any members
+  bool
+  object_first(bool & more)
+  {
+    ws();
+    if (p_ != end_ && *p_ == '}') { ++p_; more = false; return true; }
+    more = true;
+    return true;
+  }
+
+  // After a member, consumes ',' or '}'
+  bool
+  object_next(bool & more)
+  {
+    ws();
+    if (p_ == end_) { return false; }
+    if (*p_ == ',') { ++p_; more = true; return true; }
+    if (*p_ == '}') { ++p_; more = false; return true; }
+    return false;
+  }
+
+  bool
+  array_first(bool & more)
+  {
+    ws();
+    if (p_ != end_ && *p_ == ']') { ++p_; more = false; return true; }
+    more = true;
+    return true;
+  }
+
+  bool
+  array_next(bool & more)
+  {
+    ws();
+    if (p_ == end_) { return false; }
+    if (*p_ == ',') { ++p_; more = true; return true; }
+    if (*p_ == ']') { ++p_; more = false; return true; }
+    return false;
+  }
+
+  // Scans a string, with p_ at the opening quote
+  bool
+  string(size_t & offset, size_t & length, bool & escaped)
+  {
+    if (p_ == end_ || *p_ != '"') { return false; }
+    ++p_;
+
+    char const* s = p_;
+    escaped = false;
+    for (;;) {
+      if (p_ == end_) { return false; }
+      char c = *p_;
+      if (c == '"') { break; }
+      if (c == '\\') {
+        escaped = true;
+        ++p_;
+        if (p_ == end_) { return false; }
+      }
+      ++p_;
+    }
+
+    offset = s - begin_;
+    length = p_ - s;
+    ++p_;
+    return true;
+  }
+
+  // Unescapes the same way as the ArduinoJson parser used by
+  // ResponseParser_ArduinoJson5, which does not support \\u escapes and
+  // keeps the character following any unknown escape.
+  void
+  decode(char const* s, size_t n, std::string & out)
+  {
+    char const* e = s + n;
+    while (s != e) {
+      char c = *s++;
+      if (c != '\\') { out += c; continue; }
+
+      c = *s++;
+      switch (c) {
+      case 'b': out += '\b'; break;
+      case 'f': out += '\f'; break;
+      case 'n': out += '\n'; break;
+      case 'r': out += '\r'; break;
+      case 't': out += '\t'; break;
+      default: out += c; break;
+      }
+    }
+  }
+
+  bool
+  member_key(std::string & key)
+  {
+    ws();
+    size_t offset, length;
+    bool escaped;
+    if (!string(offset, length, escaped)) { return false; }
+
+    key.clear();
+    if (escaped) {
+      decode(begin_ + offset, length, key);
+    } else {
+      key.assign(begin_ + offset, length);
+    }
+
+    return accept(':');
+  }
+
+  bool
+  literal(char const* s)
+  {
+    size_t n = std::strlen(s);
+    if ((size_t)(end_ - p_) < n || std::memcmp(p_, s, n) != 0) { return false; }
+    p_ += n;
+    return true;
+  }
+
+  bool
+  number(Value & v)
+  {
+    char const* s = p_;
+    bool integer = true;
+
+    if (p_ != end_ && *p_ == '-') { integer = false; ++p_; }
+    if (p_ == end_ || *p_ < '0' || *p_ > '9') { return false; }
+
+    std::uint64_t x = 0;
+    while (p_ != end_ && *p_ >= '0' && *p_ <= '9') {
+      std::uint64_t d = *p_ - '0';
+      if (x > (UINT64_MAX - d) / 10) { integer = false; }
+      x = x * 10 + d;
+      ++p_;
+    }
+    if (p_ != end_ && *p_ == '.') {
+      integer = false;
+      ++p_;
+      if (p_ == end_ || *p_ < '0' || *p_ > '9') { return false; }
+      while (p_ != end_ && *p_ >= '0' && *p_ <= '9') { ++p_; }
+    }
+    if (p_ != end_ && (*p_ == 'e' || *p_ == 'E')) {
+      integer = false;
+      ++p_;
+      if (p_ != end_ && (*p_ == '+' || *p_ == '-')) { ++p_; }
+      if (p_ == end_ || *p_ < '0' || *p_ > '9') { return false; }
+      while (p_ != end_ && *p_ >= '0' && *p_ <= '9') { ++p_; }
+    }
+
+    v.type = integer ? Value::JSON_NUMBER : Value::JSON_OTHER_NUMBER;
+    v.offset = s - begin_;
+    v.length = p_ - s;
+    v.number = x;
+    return true;
+  }
+
+  // Skips the remainder of an object or array after its opening bracket
+  bool
+  skip_container(char close, int depth)
+  {
+    if (depth > MAX_DEPTH) { return false; }
+
+    bool more;
+    if (close == '}' ? !object_first(more) : !array_first(more)) { return false; }
+    while (more) {
+      if (close == '}') {
+        std::string key;
+        if (!member_key(key)) { return false; }
+      }
+      Value v;
+      if (!value(v, depth + 1)) { return false; }
+      if (close == '}' ? !object_next(more) : !array_next(more)) { return false; }
+    }
+    return true;
+  }
+
+  // Scans any value, skipping objects and arrays
+  bool
+  value(Value & v, int depth)
+  {
+    ws();
+    if (p_ == end_) { return false; }
+
+    switch (*p_) {
+    case '"':
+      v.type = Value::JSON_STRING;
+      return string(v.offset, v.length, v.escaped);
+    case '{':
+      ++p_;
+      v.type = Value::JSON_OBJECT;
+      return skip_container('}', depth);
+    case '[':
+      ++p_;
+      v.type = Value::JSON_ARRAY;
+      return skip_container(']', depth);
+    case 't': v.type = Value::JSON_TRUE; return literal("true");
+    case 'f': v.type = Value::JSON_FALSE; return literal("false");
+    case 'n': v.type = Value::JSON_NULL; return literal("null");
+    default: return number(v);
+    }
+  }
+
+  bool
+  peek(char c)
+  {
+    ws();
+    return p_ != end_ && *p_ == c;
+  }
+
+protected:
+  char const* begin_;
+  char const* p_;
+  char const* end_;
+};
+
+} // namespace internal
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
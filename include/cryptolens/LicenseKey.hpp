@@ -7,17 +7,18 @@
 
 #include "basic_Error.hpp"
 #include "ActivationData.hpp"
+#include "ActivationDataTable.hpp"
 #include "Customer.hpp"
 #include "DataObject.hpp"
+#include "LicenseKeyChecker.hpp"
 #include "LicenseKeyInformation.hpp"
 #include "RawLicenseKey.hpp"
+#include "StringView.hpp"
 
 namespace cryptolens_io {
 
 namespace v20190401 {
 
-class LicenseKeyChecker;
-
 /**
  * This immutable class represents a license key.
  *
@@ -47,6 +48,8 @@ public:
 
   std::string to_string() const;
 
+  std::string to_binary(basic_Error & e) const;
+
   LicenseKeyInformation & get_license_key_information() { return info_; }
   LicenseKeyInformation const& get_license_key_information() const { return info_; }
 
@@ -74,9 +77,13 @@ public:
   optional<int>                         const& get_global_id() const;
   optional<Customer>                    const& get_customer() const;
   optional<std::vector<ActivationData>> const& get_activated_machines() const;
+  optional<ActivationDataTable>         const& get_activated_machines_table() const;
   optional<int>                         const& get_maxnoofmachines() const;
   optional<std::string>                 const& get_allowed_machines() const;
   optional<std::vector<DataObject>>     const& get_data_objects() const;
+
+  DataObject const* find_data_object(StringView name) const;
+  int               int_value_or(StringView name, int default_value) const;
 };
 
 } // namespace v20190401
@@ -1,34 +1,86 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "Clock.hpp"
 #include "LicenseKeyInformation.hpp"
+#include "MemoryResource.hpp"
 
 namespace cryptolens_io {
 
 namespace v20190401 {
 
-class LicenseKeyInformation;
+template<typename Allocator>
+class basic_LicenseKeyInformation;
 
-class LicenseKeyChecker {
+template<typename Allocator>
+class basic_LicenseKeyChecker {
   bool status_;
-  LicenseKeyInformation const* key_;
+  basic_LicenseKeyInformation<Allocator> const* key_;
 
 public:
 #ifndef CRYPTOLENS_20190701_ALLOW_IMPLICIT_CONSTRUCTORS
   explicit
 #endif
-  LicenseKeyChecker(LicenseKeyInformation const* license_key);
+  basic_LicenseKeyChecker(basic_LicenseKeyInformation<Allocator> const* license_key);
 
   explicit operator bool() const;
 
-  LicenseKeyChecker& has_feature(int feature);
-  LicenseKeyChecker& has_not_feature(int feature);
-  LicenseKeyChecker& has_expired(std::uint64_t now);
-  LicenseKeyChecker& has_not_expired(std::uint64_t now);
-  LicenseKeyChecker& is_blocked();
-  LicenseKeyChecker& is_not_blocked();
-  LicenseKeyChecker& is_on_right_machine(std::string const& machine_code);
+  basic_LicenseKeyChecker& has_feature(int feature);
+  basic_LicenseKeyChecker& has_not_feature(int feature);
+  basic_LicenseKeyChecker& has_expired(std::uint64_t now);
+  basic_LicenseKeyChecker& has_not_expired(std::uint64_t now);
+  template<typename Clock> basic_LicenseKeyChecker& has_expired();
+  template<typename Clock> basic_LicenseKeyChecker& has_not_expired();
+  basic_LicenseKeyChecker& is_blocked();
+  basic_LicenseKeyChecker& is_not_blocked();
+  basic_LicenseKeyChecker& is_on_right_machine(std::string const& machine_code);
 };
 
+/**
+ * Check that the underlying LicenseKey object has expired, reading the
+ * current time from the Clock policy class, e.g.
+ *
+ *     license_key.check().has_expired<Clock_coarse>()
+ */
+template<typename Allocator>
+template<typename Clock>
+basic_LicenseKeyChecker<Allocator>&
+basic_LicenseKeyChecker<Allocator>::has_expired()
+{
+  std::int64_t now = Clock::now();
+  if (now < 0) { status_ = false; return *this; }
+
+  return has_expired((std::uint64_t)now);
+}
+
+/**
+ * Check that the underlying LicenseKey object has not expired, reading the
+ * current time from the Clock policy class, e.g.
+ *
+ *     license_key.check().has_not_expired<Clock_coarse>()
+ */
+template<typename Allocator>
+template<typename Clock>
+basic_LicenseKeyChecker<Allocator>&
+basic_LicenseKeyChecker<Allocator>::has_not_expired()
+{
+  std::int64_t now = Clock::now();
+  if (now < 0) { status_ = false; return *this; }
+
+  return has_not_expired((std::uint64_t)now);
+}
+
+using LicenseKeyChecker = basic_LicenseKeyChecker<std::allocator<char>>;
+
+namespace pmr {
+
+using LicenseKeyChecker = basic_LicenseKeyChecker<PolymorphicAllocator<char>>;
+
+} // namespace pmr
+
 } // namespace v20190401
 
 namespace v20180502 {
@@ -39,8 +91,16 @@ using LicenseKeyChecker = ::cryptolens_io::v20190401::LicenseKeyChecker;
 
 namespace latest {
 
+template<typename Allocator>
+using basic_LicenseKeyChecker = ::cryptolens_io::v20190401::basic_LicenseKeyChecker<Allocator>;
 using LicenseKeyChecker = ::cryptolens_io::v20190401::LicenseKeyChecker;
 
+namespace pmr {
+
+using LicenseKeyChecker = ::cryptolens_io::v20190401::pmr::LicenseKeyChecker;
+
+} // namespace pmr
+
 } // namespace latest
 
 } // namespace cryptolens_io
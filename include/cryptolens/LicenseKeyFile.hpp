@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "api.hpp"
+#include "basic_Error.hpp"
+#include "LicenseKey.hpp"
+#include "StringView.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace errors {
+
+// Errors for the File subsystem. The extra field holds the errno value, or
+// the value of GetLastError() on Windows
+namespace File {
+
+int constexpr OPEN = 1;
+int constexpr READ = 2;
+int constexpr MAP = 3;
+int constexpr DIRECTORY = 4;
+int constexpr WATCH = 5;
+int constexpr WRITE = 6;
+
+} // namespace File
+
+} // namespace errors
+
+/**
+ * A license key loaded from a file by basic_Cryptolens::load_license_key_files()
+ */
+struct LicenseKeyFile {
+  LicenseKeyFile(std::string path, LicenseKey license_key)
+  : path(std::move(path)), license_key(std::move(license_key))
+  {}
+
+  std::string path;
+  LicenseKey license_key;
+};
+
+std::vector<std::string>
+list_license_key_files(basic_Error & e, std::string const& directory);
+
+std::vector<std::string>
+read_license_key_manifest(basic_Error & e, std::string const& manifest);
+
+namespace internal {
+
+int sync_file(std::FILE * file);
+
+void replace_file(basic_Error & e, std::string const& path, std::string const& contents);
+
+std::string read_file(basic_Error & e, std::string const& path);
+
+/*
+ * A read-only memory mapping of a whole file, which is unmapped when the
+ * object is destroyed.
+ */
+class MappedFile {
+public:
+  MappedFile(basic_Error & e, std::string const& path);
+  ~MappedFile();
+
+  MappedFile(MappedFile const&) = delete;
+  MappedFile & operator=(MappedFile const&) = delete;
+
+  StringView get() const { return StringView(data_, size_); }
+
+private:
+  char const* data_;
+  size_t size_;
+#ifdef _WIN32
+  void * mapping_;
+#endif
+};
+
+} // namespace internal
+
+} // namespace v20190401
+
+namespace latest {
+
+namespace errors {
+
+namespace File = ::cryptolens_io::v20190401::errors::File;
+
+} // namespace errors
+
+using LicenseKeyFile = ::cryptolens_io::v20190401::LicenseKeyFile;
+
+using ::cryptolens_io::v20190401::list_license_key_files;
+using ::cryptolens_io::v20190401::read_license_key_manifest;
+
+} // namespace latest
+
+} // namespace cryptolens_io
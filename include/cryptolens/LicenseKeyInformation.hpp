@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -7,19 +9,89 @@
 
 #include "api.hpp"
 #include "ActivationData.hpp"
+#include "ActivationDataTable.hpp"
 #include "basic_Error.hpp"
 #include "Customer.hpp"
 #include "DataObject.hpp"
+#include "MemoryResource.hpp"
 #include "RawLicenseKey.hpp"
+#include "StringView.hpp"
 
 namespace cryptolens_io {
 
 namespace v20190401 {
 
-class LicenseKeyChecker;
+template<typename Allocator>
+class basic_LicenseKeyChecker;
+
+namespace internal {
+
+/*
+ * A value which is computed the first time it is needed, and stored using
+ * the given allocator. Several threads may call get() at once, in which case
+ * the value may be computed more than once but only one of the results is
+ * kept. Copies start out empty.
+ */
+template<typename T, typename Allocator>
+class LazyValue {
+  using allocator_type = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+  using traits = std::allocator_traits<allocator_type>;
+public:
+  explicit LazyValue(Allocator const& allocator = Allocator()) : allocator_(allocator), value_(nullptr) {}
+  LazyValue(LazyValue const& other) : allocator_(traits::select_on_container_copy_construction(other.allocator_)), value_(nullptr) {}
+  LazyValue(LazyValue && other) : allocator_(other.allocator_), value_(other.value_.exchange(nullptr)) {}
+  ~LazyValue() { destroy(value_.load()); }
+
+  LazyValue & operator=(LazyValue const&)
+  {
+    destroy(value_.exchange(nullptr));
+    return *this;
+  }
+
+  /* The value is freed by the allocator which allocated it, thus it is taken over along with it */
+  LazyValue & operator=(LazyValue && other)
+  {
+    if (this != &other) {
+      destroy(value_.exchange(nullptr));
+      allocator_ = other.allocator_;
+      value_.store(other.value_.exchange(nullptr));
+    }
+    return *this;
+  }
+
+  template<typename F>
+  T const& get(F f) const
+  {
+    T * p = value_.load(std::memory_order_acquire);
+    if (p) { return *p; }
+
+    T * q = traits::allocate(allocator_, 1);
+    traits::construct(allocator_, q, f());
+    if (value_.compare_exchange_strong(p, q, std::memory_order_acq_rel, std::memory_order_acquire)) { return *q; }
+
+    destroy(q);
+    return *p;
+  }
+
+private:
+  void destroy(T * p) const
+  {
+    if (!p) { return; }
+    traits::destroy(allocator_, p);
+    traits::deallocate(allocator_, p, 1);
+  }
+
+  mutable allocator_type allocator_;
+  mutable std::atomic<T *> value_;
+};
+
+} // namespace internal
 
 /**
- * This immutable class represents a license key.
+ * This class represents a license key. The license key information does not
+ * change once constructed, but the list returned by get_activated_machines()
+ * is built from the table of activated machines the first time it is
+ * requested, which may happen from several threads at once.
  *
  * The class is constructed using the static factory make().
  *
@@ -30,10 +102,26 @@ class LicenseKeyChecker;
  *     if (key.check().has_feature(1).has_not_feature(2)) {
  *       DO_SOMETHING();
  *     }
+ *
+ * All strings and vectors of the class use the given allocator. The alias
+ * LicenseKeyInformation uses std::allocator, and pmr::LicenseKeyInformation
+ * uses a PolymorphicAllocator, allowing the license key information to be
+ * placed in a MemoryResource such as a MonotonicBufferResource.
  */
-class LicenseKeyInformation {
+template<typename Allocator>
+class basic_LicenseKeyInformation {
+public:
+  using allocator_type = Allocator;
+  using string_type = std::basic_string<char, std::char_traits<char>, Allocator>;
+  using Customer = basic_Customer<Allocator>;
+  using ActivationData = basic_ActivationData<Allocator>;
+  using DataObject = basic_DataObject<Allocator>;
+  using ActivationDataList = std::vector<ActivationData, typename std::allocator_traits<Allocator>::template rebind_alloc<ActivationData>>;
+  using ActivationDataTable = basic_ActivationDataTable<Allocator>;
+  using DataObjectList = std::vector<DataObject, typename std::allocator_traits<Allocator>::template rebind_alloc<DataObject>>;
+
 private:
-  LicenseKeyInformation();
+  basic_LicenseKeyInformation();
 
   int           product_id_;
   std::uint64_t created_;
@@ -51,17 +139,24 @@ private:
   bool          f7_;
   bool          f8_;
 
-  optional<int>                         id_;
-  optional<std::string>                 key_;
-  optional<std::string>                 notes_;
-  optional<int>                         global_id_;
-  optional<Customer>                    customer_;
-  optional<std::vector<ActivationData>> activated_machines_;
-  optional<int>                         maxnoofmachines_;
-  optional<std::string>                 allowed_machines_;
-  optional<std::vector<DataObject>>     data_objects_;
+  optional<int>                 id_;
+  optional<string_type>         key_;
+  optional<string_type>         notes_;
+  optional<int>                 global_id_;
+  optional<Customer>            customer_;
+  optional<ActivationDataTable> activated_machines_;
+  optional<int>                 maxnoofmachines_;
+  optional<string_type>         allowed_machines_;
+  optional<DataObjectList>      data_objects_;
+
+  internal::LazyValue<optional<ActivationDataList>, Allocator> activated_machines_list_;
+
+  // Indices into data_objects_, sorted by name
+  std::vector<std::uint32_t, typename std::allocator_traits<Allocator>::template rebind_alloc<std::uint32_t>> data_object_index_;
+
+  void index_data_objects();
 public:
-  LicenseKeyInformation(
+  basic_LicenseKeyInformation(
     api::internal::main,
     int           product_id,
     std::uint64_t created,
@@ -79,24 +174,24 @@ public:
     bool          f7,
     bool          f8,
 
-    optional<int>                         id,
-    optional<std::string>                 key,
-    optional<std::string>                 notes,
-    optional<int>                         global_id,
-    optional<Customer>                    customer,
-    optional<std::vector<ActivationData>> activated_machines,
-    optional<int>                         maxnoofmachines,
-    optional<std::string>                 allowed_machines,
-    optional<std::vector<DataObject>>     data_objects
+    optional<int>                 id,
+    optional<string_type>         key,
+    optional<string_type>         notes,
+    optional<int>                 global_id,
+    optional<Customer>            customer,
+    optional<ActivationDataTable> activated_machines,
+    optional<int>                 maxnoofmachines,
+    optional<string_type>         allowed_machines,
+    optional<DataObjectList>      data_objects
   );
 
 #if 1
-  static optional<LicenseKeyInformation> make(basic_Error & e, RawLicenseKey const& raw_license_key);
-  static optional<LicenseKeyInformation> make(basic_Error & e, optional<RawLicenseKey> const& raw_license_key);
-  static optional<LicenseKeyInformation> make_unsafe(basic_Error & e, std::string const& license_key);
+  static optional<basic_LicenseKeyInformation> make(basic_Error & e, RawLicenseKey const& raw_license_key, Allocator const& allocator = Allocator());
+  static optional<basic_LicenseKeyInformation> make(basic_Error & e, optional<RawLicenseKey> const& raw_license_key, Allocator const& allocator = Allocator());
+  static optional<basic_LicenseKeyInformation> make_unsafe(basic_Error & e, std::string const& license_key, Allocator const& allocator = Allocator());
 #endif
 
-  LicenseKeyChecker check() const;
+  basic_LicenseKeyChecker<Allocator> check() const;
 
   int           get_product_id() const;
   std::uint64_t get_created() const;
@@ -114,17 +209,29 @@ public:
   bool          get_f7() const;
   bool          get_f8() const;
 
-  optional<int>                         const& get_id() const;
-  optional<std::string>                 const& get_key() const;
-  optional<std::string>                 const& get_notes() const;
-  optional<int>                         const& get_global_id() const;
-  optional<Customer>                    const& get_customer() const;
-  optional<std::vector<ActivationData>> const& get_activated_machines() const;
-  optional<int>                         const& get_maxnoofmachines() const;
-  optional<std::string>                 const& get_allowed_machines() const;
-  optional<std::vector<DataObject>>     const& get_data_objects() const;
+  optional<int>                 const& get_id() const;
+  optional<string_type>         const& get_key() const;
+  optional<string_type>         const& get_notes() const;
+  optional<int>                 const& get_global_id() const;
+  optional<Customer>            const& get_customer() const;
+  optional<ActivationDataList>  const& get_activated_machines() const;
+  optional<ActivationDataTable> const& get_activated_machines_table() const;
+  optional<int>                 const& get_maxnoofmachines() const;
+  optional<string_type>         const& get_allowed_machines() const;
+  optional<DataObjectList>      const& get_data_objects() const;
+
+  DataObject const* find_data_object(StringView name) const;
+  int               int_value_or(StringView name, int default_value) const;
 };
 
+using LicenseKeyInformation = basic_LicenseKeyInformation<std::allocator<char>>;
+
+namespace pmr {
+
+using LicenseKeyInformation = basic_LicenseKeyInformation<PolymorphicAllocator<char>>;
+
+} // namespace pmr
+
 } // namespace v20190401
 
 namespace v20180502 {
@@ -135,8 +242,16 @@ using LicenseKeyInformation = ::cryptolens_io::v20190401::LicenseKeyInformation;
 
 namespace latest {
 
+template<typename Allocator>
+using basic_LicenseKeyInformation = ::cryptolens_io::v20190401::basic_LicenseKeyInformation<Allocator>;
 using LicenseKeyInformation = ::cryptolens_io::v20190401::LicenseKeyInformation;
 
+namespace pmr {
+
+using LicenseKeyInformation = ::cryptolens_io::v20190401::pmr::LicenseKeyInformation;
+
+} // namespace pmr
+
 } // namespace latest
 
 } // namespace cryptolens_io
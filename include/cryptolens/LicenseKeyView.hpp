@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "imports/std/optional"
+
+#include "api.hpp"
+#include "basic_Error.hpp"
+#include "StringView.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace errors {
+
+// Errors for the Binary subsystem
+namespace Binary {
+
+int constexpr TRUNCATED = 1;
+int constexpr MAGIC = 2;
+int constexpr VERSION = 3;
+int constexpr INDEX_MISMATCH = 4;
+
+} // namespace Binary
+
+} // namespace errors
+
+namespace internal {
+
+std::string
+license_key_binary_encode(basic_Error & e, std::string const& license, std::string const& signature);
+
+} // namespace internal
+
+// The customer of a LicenseKeyView, see Customer
+class CustomerView {
+public:
+  CustomerView(int id, StringView name, StringView email, StringView company_name, std::uint64_t created)
+  : id_(id), name_(name), email_(email), company_name_(company_name), created_(created)
+  {}
+
+  int           get_id() const { return id_; }
+  StringView    get_name() const { return name_; }
+  StringView    get_email() const { return email_; }
+  StringView    get_company_name() const { return company_name_; }
+  std::uint64_t get_created() const { return created_; }
+
+private:
+  int id_;
+  StringView name_;
+  StringView email_;
+  StringView company_name_;
+  std::uint64_t created_;
+};
+
+// An activated machine of a LicenseKeyView, see ActivationData
+class ActivationDataView {
+public:
+  ActivationDataView(StringView mid, StringView ip, std::uint64_t time)
+  : mid_(mid), ip_(ip), time_(time)
+  {}
+
+  StringView    get_mid() const { return mid_; }
+  StringView    get_ip() const { return ip_; }
+  std::uint64_t get_time() const { return time_; }
+
+private:
+  StringView mid_;
+  StringView ip_;
+  std::uint64_t time_;
+};
+
+// A data object of a LicenseKeyView, see DataObject
+class DataObjectView {
+public:
+  DataObjectView(int id, StringView name, StringView string_value, int int_value)
+  : id_(id), name_(name), string_value_(string_value), int_value_(int_value)
+  {}
+
+  int        get_id() const { return id_; }
+  StringView get_name() const { return name_; }
+  StringView get_string_value() const { return string_value_; }
+  int        get_int_value() const { return int_value_; }
+
+private:
+  int id_;
+  StringView name_;
+  StringView string_value_;
+  int int_value_;
+};
+
+/**
+ * Read-only access to a license key stored in the binary format produced by
+ * LicenseKey::to_binary().
+ *
+ * The binary format contains the signed license exactly as returned by the
+ * Web API, its signature, and an index with the location and value of each
+ * field. Loading a LicenseKeyView verifies the signature over the signed
+ * license and checks the index against it, but does not base64 decode,
+ * build a JSON document or copy any field. Instead the getters read
+ * directly from the buffer passed to make(), which must be kept alive and
+ * unchanged for as long as the LicenseKeyView is used.
+ *
+ * The getters correspond to those of LicenseKey, except that strings are
+ * returned as a StringView into the buffer.
+ */
+class LicenseKeyView {
+public:
+  template<typename SignatureVerifier>
+  static
+  optional<LicenseKeyView>
+  make(basic_Error & e, SignatureVerifier const& verifier, char const* data, size_t size)
+  {
+    if (e) { return nullopt; }
+
+    LicenseKeyView view;
+    view.load(e, data, size);
+    if (e) { return nullopt; }
+
+    bool verified = verifier.verify_message(e, view.get_license().to_string(), view.get_signature().to_string());
+    if (!verified || e) { return nullopt; }
+
+    view.check_index(e);
+    if (e) { return nullopt; }
+
+    return make_optional(view);
+  }
+
+  StringView get_license() const;
+  StringView get_signature() const;
+
+  int           get_product_id() const;
+  std::uint64_t get_created() const;
+  std::uint64_t get_expires() const;
+  int           get_period() const;
+  bool          get_block() const;
+  bool          get_trial_activation() const;
+  std::uint64_t get_sign_date() const;
+  bool          get_f1() const;
+  bool          get_f2() const;
+  bool          get_f3() const;
+  bool          get_f4() const;
+  bool          get_f5() const;
+  bool          get_f6() const;
+  bool          get_f7() const;
+  bool          get_f8() const;
+
+  optional<int>          get_id() const;
+  optional<StringView>   get_key() const;
+  optional<StringView>   get_notes() const;
+  optional<int>          get_global_id() const;
+  optional<CustomerView> get_customer() const;
+  optional<int>          get_maxnoofmachines() const;
+  optional<StringView>   get_allowed_machines() const;
+
+  optional<size_t>   get_activated_machines_count() const;
+  ActivationDataView get_activated_machine(size_t i) const;
+
+  optional<size_t> get_data_objects_count() const;
+  DataObjectView   get_data_object(size_t i) const;
+
+private:
+  LicenseKeyView();
+
+  void load(basic_Error & e, char const* data, size_t size);
+  void check_index(basic_Error & e) const;
+
+  std::uint32_t kind(size_t i) const;
+  std::uint64_t number(size_t i) const;
+  StringView string(size_t i) const;
+
+  char const* entries_;
+  size_t entry_count_;
+  char const* license_;
+  size_t license_size_;
+  char const* signature_;
+  size_t signature_size_;
+  char const* strings_;
+  size_t strings_size_;
+};
+
+} // namespace v20190401
+
+namespace latest {
+
+namespace errors {
+
+namespace Binary = ::cryptolens_io::v20190401::errors::Binary;
+
+} // namespace errors
+
+using CustomerView = ::cryptolens_io::v20190401::CustomerView;
+using ActivationDataView = ::cryptolens_io::v20190401::ActivationDataView;
+using DataObjectView = ::cryptolens_io::v20190401::DataObjectView;
+using LicenseKeyView = ::cryptolens_io::v20190401::LicenseKeyView;
+
+} // namespace latest
+
+} // namespace cryptolens_io
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "api.hpp"
+#include "basic_Error.hpp"
+#include "LicenseKey.hpp"
+#include "LicenseKeyFile.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace internal {
+
+/*
+ * Watches a set of files using inotify, calling on_change with the path of
+ * a file from a background thread whenever it has been written or replaced.
+ *
+ * The directories containing the files are watched rather than the files
+ * themselves, since files are commonly replaced by renaming a new file over
+ * the old one.
+ */
+class FileWatcher_inotify {
+public:
+  FileWatcher_inotify(basic_Error & e, std::function<void(std::string const&)> on_change);
+  ~FileWatcher_inotify();
+
+  FileWatcher_inotify(FileWatcher_inotify const&) = delete;
+  FileWatcher_inotify & operator=(FileWatcher_inotify const&) = delete;
+
+  void add(basic_Error & e, std::string const& path);
+
+  void stop();
+
+private:
+  void run();
+
+  std::function<void(std::string const&)> on_change_;
+  int fd_;
+  int stop_fd_;
+  std::thread thread_;
+
+  std::mutex mutex_;
+  std::map<std::pair<int, std::string>, std::string> files_;
+};
+
+} // namespace internal
+
+/**
+ * Keeps license keys saved in files up to date while the application is
+ * running, without polling. For example:
+ *
+ *     cryptolens::LicenseKeyWatcher_inotify<Cryptolens> watcher(e, cryptolens_handle);
+ *     watcher.add(e, "/etc/myapp/license.skm");
+ *     ...
+ *     std::shared_ptr<cryptolens::LicenseKey const> license_key = watcher.get("/etc/myapp/license.skm");
+ *
+ * When a registered file is written or replaced, only that file is loaded
+ * again, on the Executor of the handle, see
+ * basic_Cryptolens::load_license_key_file(). If the signature is valid the
+ * new LicenseKey replaces the previous one, otherwise the previous one is
+ * kept. Either way, the function set using set_on_reload() is called.
+ *
+ * The handle must outlive the watcher. This class is only available on
+ * Linux.
+ */
+template<typename Cryptolens>
+class LicenseKeyWatcher_inotify {
+public:
+  using OnReload = std::function<void(std::string const& path, std::shared_ptr<LicenseKey const> const& license_key, basic_Error const& e)>;
+
+  LicenseKeyWatcher_inotify(basic_Error & e, Cryptolens & cryptolens_handle)
+  : cryptolens_handle_(cryptolens_handle)
+  , watcher_(e, [this](std::string const& path) { reload(path); })
+  , pending_(0)
+  {}
+
+  ~LicenseKeyWatcher_inotify()
+  {
+    watcher_.stop();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return pending_ == 0; });
+  }
+
+  LicenseKeyWatcher_inotify(LicenseKeyWatcher_inotify const&) = delete;
+  LicenseKeyWatcher_inotify & operator=(LicenseKeyWatcher_inotify const&) = delete;
+
+  void add(basic_Error & e, std::string const& path);
+
+  std::shared_ptr<LicenseKey const> get(std::string const& path) const;
+
+  void set_on_reload(basic_Error & e, OnReload on_reload);
+
+private:
+  struct Entry {
+    Entry() : requested(0), published(0) {}
+
+    std::shared_ptr<LicenseKey const> license_key;
+    unsigned long requested;
+    unsigned long published;
+  };
+
+  void reload(std::string const& path);
+  void load(std::string const& path, unsigned long generation);
+
+  Cryptolens & cryptolens_handle_;
+  internal::FileWatcher_inotify watcher_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable done_;
+  std::map<std::string, Entry> entries_;
+  OnReload on_reload_;
+  unsigned pending_;
+};
+
+/**
+ * Starts watching the file and loads it. If the file cannot be loaded, e is
+ * set, but the file is still watched and is loaded once it has been
+ * replaced with a valid license key.
+ */
+template<typename Cryptolens>
+void
+LicenseKeyWatcher_inotify<Cryptolens>::add(basic_Error & e, std::string const& path)
+{
+  if (e) { return; }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.count(path)) { return; }
+    entries_[path];
+  }
+
+  watcher_.add(e, path);
+  if (e) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.erase(path);
+    return;
+  }
+
+  optional<LicenseKey> license_key = cryptolens_handle_.load_license_key_file(e, path);
+  if (e) { return; }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry & entry = entries_[path];
+  if (entry.published == 0) {
+    entry.license_key = std::make_shared<LicenseKey const>(std::move(*license_key));
+  }
+}
+
+/**
+ * Returns the most recently loaded license key of the file, or an empty
+ * pointer if the file has not been added or no valid license key has been
+ * loaded from it.
+ */
+template<typename Cryptolens>
+std::shared_ptr<LicenseKey const>
+LicenseKeyWatcher_inotify<Cryptolens>::get(std::string const& path) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  typename std::map<std::string, Entry>::const_iterator it = entries_.find(path);
+  return it == entries_.end() ? std::shared_ptr<LicenseKey const>() : it->second.license_key;
+}
+
+/**
+ * Sets a function which is called each time a file has been loaded again
+ * after a change, with the current license key of the file and the error,
+ * if any, from loading it. The function is called on the Executor of the
+ * handle and must not call set_on_reload().
+ */
+template<typename Cryptolens>
+void
+LicenseKeyWatcher_inotify<Cryptolens>::set_on_reload(basic_Error & e, OnReload on_reload)
+{
+  if (e) { return; }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  on_reload_ = std::move(on_reload);
+}
+
+template<typename Cryptolens>
+void
+LicenseKeyWatcher_inotify<Cryptolens>::reload(std::string const& path)
+{
+  unsigned long generation;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    typename std::map<std::string, Entry>::iterator it = entries_.find(path);
+    if (it == entries_.end()) { return; }
+    generation = ++it->second.requested;
+    ++pending_;
+  }
+
+  cryptolens_handle_.get_executor().execute([this, path, generation]() { load(path, generation); });
+}
+
+template<typename Cryptolens>
+void
+LicenseKeyWatcher_inotify<Cryptolens>::load(std::string const& path, unsigned long generation)
+{
+  // The file is read rather than mapped, since it may be truncated by the
+  // writer while it is loaded
+  basic_Error e;
+  optional<LicenseKey> loaded = cryptolens_handle_.load_license_key_file(e, path);
+
+  std::shared_ptr<LicenseKey const> license_key;
+  OnReload on_reload;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry & entry = entries_[path];
+
+    // Changes in quick succession may finish loading out of order
+    if (!e && generation > entry.published) {
+      entry.license_key = std::make_shared<LicenseKey const>(std::move(*loaded));
+      entry.published = generation;
+    }
+
+    license_key = entry.license_key;
+    on_reload = on_reload_;
+  }
+
+  if (on_reload) { on_reload(path, license_key, e); }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (--pending_ == 0) { done_.notify_all(); }
+}
+
+} // namespace v20190401
+
+namespace latest {
+
+template<typename Cryptolens>
+using LicenseKeyWatcher_inotify = ::cryptolens_io::v20190401::LicenseKeyWatcher_inotify<Cryptolens>;
+
+} // namespace latest
+
+} // namespace cryptolens_io
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+/**
+ * A source of memory, similar to std::pmr::memory_resource, which is not
+ * available in C++11.
+ *
+ * License key information can be placed in a MemoryResource using the
+ * pmr::LicenseKeyInformation class and the overloads of the response parser
+ * taking a MemoryResource, see MonotonicBufferResource.
+ */
+class MemoryResource {
+public:
+  virtual ~MemoryResource() {}
+
+  virtual void * allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) = 0;
+  virtual void deallocate(void * p, size_t bytes, size_t alignment = alignof(std::max_align_t)) = 0;
+};
+
+/**
+ * Returns a MemoryResource using operator new and operator delete, which is
+ * used by default-constructed PolymorphicAllocator objects.
+ */
+MemoryResource &
+new_delete_resource();
+
+/**
+ * A MemoryResource which hands out memory from a sequence of increasingly
+ * large blocks, and only frees it when release() is called or the object is
+ * destroyed, similar to std::pmr::monotonic_buffer_resource. For example,
+ * in a service which checks many license keys
+ *
+ *     cryptolens::MonotonicBufferResource arena;
+ *     for (;;) {
+ *       auto info = cryptolens::pmr::LicenseKeyInformation::make(e, raw_license_key, &arena);
+ *       ...
+ *       arena.release();
+ *     }
+ *
+ * all memory for the parsed license and the temporaries used while parsing
+ * it is taken from the arena, and the blocks are reused for the next
+ * license.
+ *
+ * Objects of this class must not be used by several threads at once.
+ */
+class MonotonicBufferResource : public MemoryResource {
+public:
+  explicit MonotonicBufferResource(size_t initial_size = 4096, MemoryResource * upstream = &new_delete_resource());
+  ~MonotonicBufferResource();
+
+  MonotonicBufferResource(MonotonicBufferResource const&) = delete;
+  MonotonicBufferResource & operator=(MonotonicBufferResource const&) = delete;
+
+  void * allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) override;
+  void deallocate(void *, size_t, size_t = alignof(std::max_align_t)) override {}
+
+  void release();
+
+private:
+  struct Block {
+    Block * next;
+    size_t size;
+  };
+
+  MemoryResource * upstream_;
+  Block * blocks_;
+  Block * current_;
+  char * next_;
+  char * end_;
+  size_t initial_size_;
+};
+
+/**
+ * An allocator taking memory from a MemoryResource, similar to
+ * std::pmr::polymorphic_allocator.
+ */
+template<typename T>
+class PolymorphicAllocator {
+public:
+  using value_type = T;
+
+  PolymorphicAllocator() : resource_(&new_delete_resource()) {}
+  PolymorphicAllocator(MemoryResource * resource) : resource_(resource) {}
+
+  template<typename U>
+  PolymorphicAllocator(PolymorphicAllocator<U> const& other) : resource_(other.resource()) {}
+
+  T * allocate(size_t n) { return static_cast<T *>(resource_->allocate(n * sizeof(T), alignof(T))); }
+  void deallocate(T * p, size_t n) { resource_->deallocate(p, n * sizeof(T), alignof(T)); }
+
+  MemoryResource * resource() const { return resource_; }
+
+private:
+  MemoryResource * resource_;
+};
+
+template<typename T, typename U>
+bool operator==(PolymorphicAllocator<T> const& a, PolymorphicAllocator<U> const& b) { return a.resource() == b.resource(); }
+
+template<typename T, typename U>
+bool operator!=(PolymorphicAllocator<T> const& a, PolymorphicAllocator<U> const& b) { return !(a == b); }
+
+} // namespace v20190401
+
+namespace latest {
+
+using MemoryResource = ::cryptolens_io::v20190401::MemoryResource;
+using MonotonicBufferResource = ::cryptolens_io::v20190401::MonotonicBufferResource;
+using ::cryptolens_io::v20190401::new_delete_resource;
+
+template<typename T>
+using PolymorphicAllocator = ::cryptolens_io::v20190401::PolymorphicAllocator<T>;
+
+} // namespace latest
+
+} // namespace cryptolens_io
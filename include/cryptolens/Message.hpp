@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+// An immutable class representing a message posted to a channel, as
+// returned by basic_Cryptolens::get_messages()
+class Message {
+private:
+  int id_;
+  std::string content_;
+  std::int64_t created_;
+  std::string channel_;
+public:
+  Message
+    ( int id
+    , std::string content
+    , std::int64_t created
+    , std::string channel
+    )
+  : id_(id)
+  , content_(std::move(content))
+  , created_(created)
+  , channel_(std::move(channel))
+  { }
+
+  // Returns the id of the message
+  int get_id() const { return id_; }
+
+  // Returns the content of the message
+  std::string const& get_content() const { return content_; }
+
+  // Returns the time the message was created, as a unix timestamp
+  std::int64_t get_created() const { return created_; }
+
+  // Returns the channel of the message
+  std::string const& get_channel() const { return channel_; }
+};
+
+} // namespace v20190401
+
+namespace latest {
+
+using Message = ::cryptolens_io::v20190401::Message;
+
+} // namespace latest
+
+} // namespace cryptolens_io
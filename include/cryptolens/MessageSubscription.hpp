@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "api.hpp"
+#include "basic_Cryptolens.hpp"
+#include "basic_Error.hpp"
+#include "Message.hpp"
+#include "SingleFlight.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+/**
+ * Polls message channels for new messages. For example:
+ *
+ *     cryptolens::MessageSubscription<Configuration> messages(e, "access token");
+ *     ...
+ *     for (auto const& m : messages.poll(e, "stable")) {
+ *       show_notification(m.get_content());
+ *     }
+ *
+ * Each channel has a cursor, the time of the latest message seen, and only
+ * messages posted around or after it are requested, rather than every
+ * message posted to the channel. poll() returns only the messages which
+ * have not been returned by an earlier poll, and get_messages() returns
+ * all messages seen so far without making a request.
+ *
+ * poll() can be called from several threads. Threads polling the same
+ * channel at the same time share one request and get the same messages.
+ *
+ * The subscription uses its own basic_Cryptolens handle, which can be
+ * configured using get_cryptolens_handle(), and makes one request at a
+ * time.
+ */
+template<typename Configuration>
+class MessageSubscription {
+public:
+  MessageSubscription(basic_Error & e, std::string token)
+  : cryptolens_handle_(e), token_(std::move(token))
+  {}
+
+  MessageSubscription(MessageSubscription const&) = delete;
+  MessageSubscription & operator=(MessageSubscription const&) = delete;
+
+  std::vector<Message> poll(basic_Error & e, std::string const& channel);
+
+  std::vector<Message> get_messages(std::string const& channel) const;
+
+  void set_start_time(basic_Error & e, std::string const& channel, std::int64_t since_unix_timestamp);
+
+  basic_Cryptolens<Configuration> & get_cryptolens_handle() { return cryptolens_handle_; }
+
+private:
+  struct Channel {
+    Channel() : since(0), polled(false) {}
+
+    // The time passed to get_messages() by the next poll
+    std::int64_t since;
+    std::set<int> seen;
+    std::vector<Message> messages;
+    bool polled;
+  };
+
+  basic_Cryptolens<Configuration> cryptolens_handle_;
+  std::string token_;
+
+  // Held while making a request, since the handle is not thread safe
+  std::mutex request_mutex_;
+
+  mutable std::mutex mutex_;
+  std::map<std::string, Channel> channels_;
+  internal::SingleFlight<std::string, std::vector<Message>> polls_;
+};
+
+/**
+ * Returns the messages posted to the channel which have not been returned
+ * by an earlier call, ordered by the time they were created. The first call
+ * for a channel returns all messages since the start time, which is the
+ * beginning of time unless set using set_start_time().
+ */
+template<typename Configuration>
+std::vector<Message>
+MessageSubscription<Configuration>::poll(basic_Error & e, std::string const& channel)
+{
+  if (e) { return std::vector<Message>(); }
+
+  api::main api;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  std::vector<Message> fresh;
+  if (!polls_.join(lock, e, channel, fresh)) { return fresh; }
+
+  Channel & c = channels_[channel];
+  std::int64_t since = c.since;
+  lock.unlock();
+
+  basic_Error request_error;
+  std::vector<Message> messages;
+  {
+    std::lock_guard<std::mutex> request_lock(request_mutex_);
+    messages = cryptolens_handle_.get_messages(request_error, token_, channel, since);
+  }
+
+  std::sort(messages.begin(), messages.end(), [](Message const& a, Message const& b) {
+    return a.get_created() != b.get_created() ? a.get_created() < b.get_created() : a.get_id() < b.get_id();
+  });
+
+  lock.lock();
+
+  for (Message & m : messages) {
+    if (!c.seen.insert(m.get_id()).second) { continue; }
+
+    // Messages created in the same second as the latest one seen may not
+    // have been posted yet, thus that second is requested again
+    if (m.get_created() - 1 > c.since) { c.since = m.get_created() - 1; }
+
+    c.messages.push_back(m);
+    fresh.push_back(std::move(m));
+  }
+
+  c.polled = true;
+  polls_.finish(channel, request_error, fresh);
+  lock.unlock();
+
+  if (request_error) { e.set(api, request_error); }
+  return fresh;
+}
+
+/**
+ * Returns the messages of the channel returned by poll() so far, without
+ * making a request.
+ */
+template<typename Configuration>
+std::vector<Message>
+MessageSubscription<Configuration>::get_messages(std::string const& channel) const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  typename std::map<std::string, Channel>::const_iterator it = channels_.find(channel);
+  if (it == channels_.end()) { return std::vector<Message>(); }
+
+  internal::report_cache_hit(cryptolens_handle_.instrumentation, 0);
+  return it->second.messages;
+}
+
+/**
+ * Makes the first poll of the channel return only messages created after
+ * the given time. Has no effect once the channel has been polled.
+ */
+template<typename Configuration>
+void
+MessageSubscription<Configuration>::set_start_time(basic_Error & e, std::string const& channel, std::int64_t since_unix_timestamp)
+{
+  if (e) { return; }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Channel & c = channels_[channel];
+  if (!c.polled && !polls_.in_flight(channel)) { c.since = since_unix_timestamp; }
+}
+
+} // namespace v20190401
+
+namespace latest {
+
+template<typename Configuration>
+using MessageSubscription = ::cryptolens_io::v20190401::MessageSubscription<Configuration>;
+
+} // namespace latest
+
+} // namespace cryptolens_io
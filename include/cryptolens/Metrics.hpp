@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "basic_Error.hpp"
+#include "Instrumentation.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace internal {
+
+class MetricsRegistry;
+
+} // namespace internal
+
+/**
+ * Process wide counters and latency histograms for the library.
+ *
+ * The following is recorded:
+ *   - The number of activations, and the number of failed activations
+ *     broken down by subsystem and reason of the error.
+ *   - The time spent in each stage listed in instrumentation::Stage.
+ *   - The connect, TLS handshake, time to first byte and total time of
+ *     each request to the Web API, if reported by the RequestHandler.
+ *   - The number of bytes sent and received.
+ *   - The number of results returned from the cache of a TrialKeyCache or
+ *     MessageSubscription without making a request.
+ *
+ * Measurements are normally recorded by selecting Instrumentation_metrics as
+ * the Instrumentation policy of the Configuration, but may also be recorded
+ * directly using the record_*() methods.
+ *
+ * Each thread records into its own set of counters and histograms, thus
+ * recording never takes a lock or contends with other threads. The latencies
+ * are kept in histograms with logarithmically sized buckets with a relative
+ * error of at most 1/16, covering 1 ns to 2^40 ns (about 18 minutes). Longer
+ * durations are counted in the last bucket, but are included as measured in
+ * the sum and maximum.
+ *
+ * The combined measurements of all threads can be exported in the Prometheus
+ * text exposition format using format_prometheus() or as a JSON document
+ * using format_json().
+ */
+class Metrics {
+public:
+  static Metrics & get();
+
+  Metrics(Metrics const&) = delete;
+  void operator=(Metrics const&) = delete;
+
+  void record_stage(int stage, std::uint64_t nanoseconds);
+  void record_request(RequestStatistics const& statistics);
+  void record_activation(basic_Error const& e);
+  void record_cache_hit();
+
+  std::string format_prometheus() const;
+  std::string format_json() const;
+
+private:
+  Metrics();
+
+  internal::MetricsRegistry * registry_;
+};
+
+} // namespace v20190401
+
+namespace latest {
+
+using Metrics = ::cryptolens_io::v20190401::Metrics;
+
+} // namespace latest
+
+} // namespace cryptolens_io
@@ -6,6 +6,7 @@
 
 #include "basic_Error.hpp"
 #include "base64.hpp"
+#include "Instrumentation.hpp"
 
 namespace cryptolens_io {
 
@@ -51,17 +52,41 @@ public:
     , std::string base64_license
     , std::string signature
     )
+  {
+    Instrumentation_none instrumentation(e);
+    return make(e, instrumentation, verifier, std::move(base64_license), std::move(signature));
+  }
+
+  template<typename Instrumentation, typename SignatureVerifier>
+  static
+  optional<RawLicenseKey>
+  make
+    ( basic_Error & e
+    , Instrumentation & instrumentation
+    , SignatureVerifier const& verifier
+    , std::string base64_license
+    , std::string signature
+    )
   {
     if (e) { return nullopt; }
 
+    using namespace instrumentation;
+    internal::InstrumentationScope<Instrumentation> scope(instrumentation, Stage::RAW_LICENSE_KEY_MAKE);
+
+    instrumentation.stage_begin(Stage::BASE64_DECODE);
     optional<std::string> decoded = ::cryptolens_io::v20190401::internal::b64_decode(base64_license);
+    instrumentation.stage_end(Stage::BASE64_DECODE);
 
     if (!decoded) {
       e.set(api::main(), errors::Subsystem::Base64);
       return nullopt;
     }
 
-    if (verifier.verify_message(e, *decoded, signature)) {
+    instrumentation.stage_begin(Stage::SIGNATURE_VERIFICATION);
+    bool verified = verifier.verify_message(e, *decoded, signature);
+    instrumentation.stage_end(Stage::SIGNATURE_VERIFICATION);
+
+    if (verified) {
       return make_optional(
         RawLicenseKey
           ( std::move(base64_license)
@@ -1,11 +1,17 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "imports/curl/curl.h"
 
 #include "basic_Error.hpp"
+#include "Instrumentation.hpp"
 #include "RequestHandler_v20190401_to_v20180502.hpp"
+#include "RequestPolicy.hpp"
 
 namespace cryptolens_io {
 
@@ -24,14 +30,34 @@ int constexpr SETOPT_VERIFYPEER = 6;
 int constexpr SETOPT_VERIFYHOST = 7;
 int constexpr PERFORM = 8;
 int constexpr SETOPT_POSTFIELDS = 9;
+int constexpr SETOPT_PINNEDPUBLICKEY = 10;
+int constexpr SAVE_TLS_SESSIONS = 11;
+int constexpr SETOPT_HTTP_VERSION = 12;
+int constexpr MULTI_INIT = 13;
+int constexpr SETOPT_ACCEPT_ENCODING = 14;
+int constexpr DEADLINE_EXCEEDED = 15;
+
+/*
+ * For PERFORM and DEADLINE_EXCEEDED errors, the extra data holds the CURLcode
+ * of the last attempt in the lowest 16 bits, the number of retries made in
+ * the following 8 bits, and whether a hedged request was sent in bit 24.
+ * Thus the extra data is just the CURLcode if no retries or hedged requests
+ * were made.
+ */
+inline CURLcode perform_error_curlcode(size_t extra) { return (CURLcode)(extra & 0xFFFF); }
+inline unsigned perform_error_retries(size_t extra) { return (unsigned)((extra >> 16) & 0xFF); }
+inline bool perform_error_hedged(size_t extra) { return ((extra >> 24) & 1) != 0; }
 
 } // namespace RequestHandler_curl
 
 } // namespace errors
 
+class RequestHandler_curl;
+class RequestHandler_curl_Multi;
+
 class RequestHandler_curl_PostBuilder {
 public:
-  RequestHandler_curl_PostBuilder(CURL * curl, char const* host, char const* endpoint);
+  RequestHandler_curl_PostBuilder(CURL * curl, char const* host, char const* endpoint, RequestHandler_curl * handler = nullptr);
 
   RequestHandler_curl_PostBuilder &
   add_argument(basic_Error & e, char const* key, char const* value);
@@ -39,8 +65,13 @@ public:
   std::string
   make(basic_Error & e);
 
+  void
+  make_async(basic_Error & e, std::string & response, std::function<void()> done);
+
 private:
   CURL *curl_;
+  RequestHandler_curl * handler_;
+  bool idempotent_;
   char separator_;
   std::string postfields_;
   std::string url_;
@@ -54,6 +85,25 @@ private:
  *
  * No particular initialization is needed in order to use this
  * RequestHandler.
+ *
+ * TLS sessions are shared by all RequestHandler_curl objects in the process,
+ * thus only the first connection to the Web API needs a full TLS handshake.
+ * Optionally, the sessions can be stored in a file using
+ * set_tls_session_file() so that they can be resumed after the process
+ * restarts, and the public key of the server can be pinned using
+ * set_pinned_public_key().
+ *
+ * With set_http2_multiplexing(), requests from all RequestHandler_curl
+ * objects in the process are made as concurrent HTTP/2 streams over a
+ * few shared connections, rather than each object using its own
+ * HTTP/1.1 connection.
+ *
+ * Responses are requested in compressed form, using any of the encodings
+ * supported by libcurl, unless disabled with set_response_compression().
+ *
+ * Timeouts, retries and hedging of requests are controlled by a
+ * RequestPolicy, see set_request_policy(). When used with basic_Cryptolens
+ * the policy is taken from the RequestPolicy of the Configuration.
  */
 class RequestHandler_curl
 {
@@ -74,8 +124,56 @@ public:
 
   PostBuilder
   post_request(basic_Error & e, char const* host, char const* endpoint);
+
+  RequestStatistics
+  get_last_request_statistics() const;
+
+  void
+  set_tls_session_file(basic_Error & e, std::string path);
+
+  void
+  save_tls_sessions(basic_Error & e);
+
+  void
+  set_pinned_public_key(basic_Error & e, std::string pinned_public_key);
+
+  void
+  set_response_compression(basic_Error & e, bool enabled);
+
+  void
+  set_http2_multiplexing(basic_Error & e, bool enabled);
+
+  void
+  set_request_policy(basic_Error & e, RequestPolicy const& policy);
+
+  RequestPolicy
+  get_request_policy() const;
 private:
+  friend class RequestHandler_curl_PostBuilder;
+
+  void
+  perform(basic_Error & e, std::string & response, bool idempotent);
+
+  void
+  perform_async(basic_Error & e, std::string & response, std::function<void()> done);
+
+  CURLcode
+  perform_attempt(std::string & response, long timeout, bool idempotent, long & status, bool & hedged);
+
+  CURLcode
+  perform_hedged(std::string & response, long timeout, std::uint64_t hedge_delay, long & status, bool & hedged);
+
+  std::uint64_t
+  hedge_delay() const;
+
   CURL *curl;
+  std::string tls_session_file_;
+  std::shared_ptr<RequestHandler_curl_Multi> multi_;
+  std::shared_ptr<RequestHandler_curl_Multi> async_multi_;
+  RequestPolicy policy_;
+  CURLM *hedge_multi_;
+  std::vector<std::uint32_t> latencies_;
+  size_t latencies_next_;
 };
 
 } // namespace v20190401
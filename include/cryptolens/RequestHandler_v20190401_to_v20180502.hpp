@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstring>
+#include <string>
+
 #include "api.hpp"
 #include "basic_Error.hpp"
 #include "Error.hpp"
@@ -8,6 +11,9 @@ namespace cryptolens_io {
 
 namespace internal {
 
+inline char const* request_argument_c_str(char const* s) { return s; }
+inline char const* request_argument_c_str(std::string const& s) { return s.c_str(); }
+
 template<typename RequestHandler>
 class RequestHandler_v20190401_to_v20180502
 {
@@ -17,9 +23,9 @@ public:
 #endif
   RequestHandler_v20190401_to_v20180502();
 
-  template<typename Map>
+  template<typename Arguments>
   std::string
-  make_request(::cryptolens_io::v20180502::basic_Error & e, char const* method, Map const& map);
+  make_request(::cryptolens_io::v20180502::basic_Error & e, char const* method, Arguments const& arguments);
 
 private:
   ::cryptolens_io::v20190401::Error e_;
@@ -31,10 +37,15 @@ RequestHandler_v20190401_to_v20180502<RequestHandler>::RequestHandler_v20190401_
 : e_(), inner_(e_)
 {}
 
+/*
+ * Makes a request to the given method of the Web API. The arguments are a
+ * range of pairs with the name and value of each argument, either as
+ * std::string or as C strings, e.g. a map or an array.
+ */
 template<typename RequestHandler>
-template<typename Map>
+template<typename Arguments>
 std::string
-RequestHandler_v20190401_to_v20180502<RequestHandler>::make_request(::cryptolens_io::v20180502::basic_Error & e, char const* method, Map const& map)
+RequestHandler_v20190401_to_v20180502<RequestHandler>::make_request(::cryptolens_io::v20180502::basic_Error & e, char const* method, Arguments const& arguments)
 {
   namespace api = ::cryptolens_io::v20180502::api;
   namespace errors = ::cryptolens_io::v20180502::errors;
@@ -45,12 +56,28 @@ RequestHandler_v20190401_to_v20180502<RequestHandler>::make_request(::cryptolens
     return "";
   }
 
-  std::string endpoint("/api/key/");
-  endpoint += method;
+  // The endpoint is built on the stack unless the method name is unusually long
+  char const prefix[] = "/api/key/";
+  size_t const prefix_size = sizeof(prefix) - 1;
+  char buffer[64];
+  std::string long_endpoint;
+  char const* endpoint = buffer;
 
-  auto request = inner_.post_request(e, "app.cryptolens.io", endpoint.c_str());
+  size_t method_size = std::strlen(method);
+  if (prefix_size + method_size < sizeof(buffer)) {
+    std::memcpy(buffer, prefix, prefix_size);
+    std::memcpy(buffer + prefix_size, method, method_size + 1);
+  } else {
+    long_endpoint = prefix;
+    long_endpoint += method;
+    endpoint = long_endpoint.c_str();
+  }
 
-  for (auto x : map) { request.add_argument(e, x.first.c_str(), x.second.c_str()); }
+  auto request = inner_.post_request(e, "app.cryptolens.io", endpoint);
+
+  for (auto const& x : arguments) {
+    request.add_argument(e, request_argument_c_str(x.first), request_argument_c_str(x.second));
+  }
 
   return request.make(e);
 }
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+
+#include "basic_Error.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+/**
+ * Controls timeouts, retries and hedging of the requests made by a
+ * RequestHandler. All times are given in milliseconds, and zero disables
+ * the corresponding limit.
+ *
+ * connect_timeout and attempt_timeout limit a single attempt, i.e.
+ * establishing the connection and the request as a whole, respectively.
+ * deadline limits the entire call, including all retries and the time
+ * spent waiting between them.
+ *
+ * Failed attempts are retried up to max_retries times, waiting a random
+ * time between zero and initial_backoff * 2^n (at most max_backoff) before
+ * the n:th retry. Calls that are not idempotent, such as creating a trial
+ * key, are only retried if the failed attempt never sent the request.
+ *
+ * If hedge_percentile is non-zero, a second identical request is sent if
+ * the first one has not completed within the given percentile of the
+ * latencies recently observed by the RequestHandler (but at least
+ * hedge_min_delay), and whichever request completes first is used. Only
+ * idempotent calls are hedged, since the server may act on both requests.
+ */
+struct RequestPolicy {
+  std::uint32_t connect_timeout;
+  std::uint32_t attempt_timeout;
+  std::uint32_t deadline;
+  std::uint32_t max_retries;
+  std::uint32_t initial_backoff;
+  std::uint32_t max_backoff;
+  std::uint32_t hedge_percentile;
+  std::uint32_t hedge_min_delay;
+};
+
+/**
+ * The RequestPolicy used unless the Configuration specifies another one:
+ * a 10 second connect timeout, a 30 second timeout for each attempt, a one
+ * minute deadline, two retries and no hedging.
+ *
+ * A Configuration selects a different policy by providing a type with a
+ * static get() method returning the RequestPolicy, e.g.
+ *
+ *     struct MyRequestPolicy {
+ *       static RequestPolicy get() { return RequestPolicy{2000, 5000, 15000, 3, 100, 1000, 95, 50}; }
+ *     };
+ *
+ *     struct MyConfiguration : Configuration_Unix<MachineCodeComputer_static> {
+ *       using RequestPolicy = MyRequestPolicy;
+ *     };
+ */
+struct RequestPolicy_default {
+  static RequestPolicy get() { return RequestPolicy{10000, 30000, 60000, 2, 200, 2000, 0, 0}; }
+};
+
+namespace internal {
+
+template<typename T>
+struct request_policy_void_ { typedef void type; };
+
+/*
+ * Applies Configuration::RequestPolicy to the RequestHandler, if the
+ * Configuration specifies a RequestPolicy and the RequestHandler provides
+ * a set_request_policy() method. Otherwise the RequestHandler is left with
+ * its own defaults.
+ */
+template<typename Configuration, typename = void>
+struct configuration_request_policy {
+  template<typename RequestHandler>
+  static void apply(basic_Error &, RequestHandler &) { }
+};
+
+template<typename Configuration>
+struct configuration_request_policy<Configuration, typename request_policy_void_<typename Configuration::RequestPolicy>::type> {
+  template<typename RequestHandler>
+  static auto
+  apply_(basic_Error & e, RequestHandler & request_handler, int)
+    -> decltype(request_handler.set_request_policy(e, Configuration::RequestPolicy::get()))
+  {
+    return request_handler.set_request_policy(e, Configuration::RequestPolicy::get());
+  }
+
+  template<typename RequestHandler>
+  static void apply_(basic_Error &, RequestHandler &, long) { }
+
+  template<typename RequestHandler>
+  static void apply(basic_Error & e, RequestHandler & request_handler) { apply_(e, request_handler, 0); }
+};
+
+} // namespace internal
+
+} // namespace v20190401
+
+namespace latest {
+
+using RequestPolicy = ::cryptolens_io::v20190401::RequestPolicy;
+using RequestPolicy_default = ::cryptolens_io::v20190401::RequestPolicy_default;
+
+} // namespace latest
+
+} // namespace cryptolens_io
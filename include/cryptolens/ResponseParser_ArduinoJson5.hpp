@@ -3,9 +3,11 @@
 #include "imports/std/optional"
 
 #include <utility>
+#include <vector>
 
 #include "basic_Error.hpp"
 #include "LicenseKeyInformation.hpp"
+#include "Message.hpp"
 #include "RawLicenseKey.hpp"
 
 namespace cryptolens_io {
@@ -27,10 +29,19 @@ public:
   optional<LicenseKeyInformation> make_license_key_information(basic_Error & e, optional<RawLicenseKey> const& raw_license_key) const;
   optional<LicenseKeyInformation> make_license_key_information_unsafe(basic_Error & e, std::string const& license_key) const;
 
+  template<typename Allocator>
+  optional<basic_LicenseKeyInformation<Allocator>> make_license_key_information(basic_Error & e, RawLicenseKey const& raw_license_key, Allocator const& allocator) const;
+  template<typename Allocator>
+  optional<basic_LicenseKeyInformation<Allocator>> make_license_key_information(basic_Error & e, optional<RawLicenseKey> const& raw_license_key, Allocator const& allocator) const;
+  template<typename Allocator>
+  optional<basic_LicenseKeyInformation<Allocator>> make_license_key_information_unsafe(basic_Error & e, std::string const& license_key, Allocator const& allocator) const;
+
   optional<std::pair<std::string, std::string>> parse_activate_response(basic_Error & e, std::string const& server_response) const;
   void parse_deactivate_response(basic_Error & e, std::string const& server_response) const;
+  void parse_increment_int_value_response(basic_Error & e, std::string const& server_response) const;
   std::string parse_create_trial_key_response(basic_Error & e, std::string const& server_response) const;
   std::string parse_last_message_response(basic_Error & e, std::string const& server_response) const;
+  std::vector<Message> parse_get_messages_response(basic_Error & e, std::string const& server_response) const;
 };
 
 } // namespace latest
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "api.hpp"
+#include "basic_Error.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace internal {
+
+/*
+ * Coalesces concurrent requests for the same key, such that only the first
+ * caller makes the request and the others wait for its outcome.
+ *
+ * The object is protected by a mutex of its owner, which is held when
+ * calling the methods below. This allows the owner to check its own cache
+ * and join a request in flight without releasing the lock in between.
+ *
+ *     std::unique_lock<std::mutex> lock(mutex_);
+ *     if (!requests_.join(lock, e, key, result)) { return result; }
+ *     lock.unlock();
+ *     ... make the request, setting request_error and result ...
+ *     lock.lock();
+ *     requests_.finish(key, request_error, result);
+ */
+template<typename Key, typename Result>
+class SingleFlight {
+public:
+  bool join(std::unique_lock<std::mutex> & lock, basic_Error & e, Key const& key, Result & result);
+  void finish(Key const& key, basic_Error const& error, Result const& result);
+
+  bool in_flight(Key const& key) const { return flights_.count(key) != 0; }
+
+private:
+  struct Flight {
+    Flight() : done(false) {}
+
+    bool done;
+    Result result;
+    basic_Error error;
+  };
+
+  std::condition_variable done_;
+  std::map<Key, std::shared_ptr<Flight>> flights_;
+};
+
+/*
+ * Returns true if no request for the key is in flight, in which case the
+ * caller makes the request and must report its outcome using finish().
+ * Otherwise waits for the request in flight, temporarily releasing the lock,
+ * sets result and e to its outcome and returns false.
+ */
+template<typename Key, typename Result>
+bool
+SingleFlight<Key, Result>::join(std::unique_lock<std::mutex> & lock, basic_Error & e, Key const& key, Result & result)
+{
+  std::shared_ptr<Flight> & pending = flights_[key];
+  if (!pending) { pending = std::make_shared<Flight>(); return true; }
+
+  std::shared_ptr<Flight> flight = pending;
+  done_.wait(lock, [&flight]() { return flight->done; });
+
+  result = flight->result;
+  if (flight->error) { e.set(api::main(), flight->error); }
+  return false;
+}
+
+/*
+ * Hands the outcome of the request for the key to the callers waiting for
+ * it. Later calls to join() for the key make a new request.
+ */
+template<typename Key, typename Result>
+void
+SingleFlight<Key, Result>::finish(Key const& key, basic_Error const& error, Result const& result)
+{
+  api::main api;
+
+  typename std::map<Key, std::shared_ptr<Flight>>::iterator it = flights_.find(key);
+  if (it == flights_.end()) { return; }
+
+  Flight & flight = *it->second;
+  flight.done = true;
+  flight.result = result;
+  if (error) { flight.error.set(api, error); }
+
+  flights_.erase(it);
+  done_.notify_all();
+}
+
+} // namespace internal
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+/**
+ * A reference to a sequence of characters owned by someone else, similar to
+ * std::string_view, which is not available in C++11.
+ *
+ * The characters are not necessarily followed by a null character.
+ */
+class StringView {
+public:
+  StringView() : data_(""), size_(0) {}
+  StringView(char const* data, size_t size) : data_(data), size_(size) {}
+  StringView(char const* s) : data_(s), size_(std::strlen(s)) {}
+  StringView(std::string const& s) : data_(s.data()), size_(s.size()) {}
+#if __cplusplus >= 201703L
+  StringView(std::string_view s) : data_(s.data()), size_(s.size()) {}
+#endif
+
+  char const* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  char operator[](size_t i) const { return data_[i]; }
+
+  std::string to_string() const { return std::string(data_, size_); }
+
+#if __cplusplus >= 201703L
+  operator std::string_view() const { return std::string_view(data_, size_); }
+#endif
+
+  friend bool
+  operator==(StringView a, StringView b)
+  {
+    return a.size_ == b.size_ && (a.size_ == 0 || std::memcmp(a.data_, b.data_, a.size_) == 0);
+  }
+
+  friend bool operator!=(StringView a, StringView b) { return !(a == b); }
+
+private:
+  char const* data_;
+  size_t size_;
+};
+
+} // namespace v20190401
+
+namespace latest {
+
+using StringView = ::cryptolens_io::v20190401::StringView;
+
+} // namespace latest
+
+} // namespace cryptolens_io
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "api.hpp"
+#include "basic_Cryptolens.hpp"
+#include "basic_Error.hpp"
+#include "SingleFlight.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace internal {
+
+/*
+ * The trial keys of a TrialKeyCache by product id and machine code, and the
+ * file they are saved in, if any.
+ *
+ * Changes are made in memory by insert() and clear(), which return the new
+ * contents of the file. These are written by save(), which the caller may
+ * do without holding the lock protecting the store. save() is thread safe
+ * and skips contents older than those already saved.
+ */
+class TrialKeyStore {
+public:
+  struct Snapshot {
+    Snapshot() : version(0) {}
+
+    std::string path;
+    std::string contents;
+    unsigned long version;
+  };
+
+  TrialKeyStore() : version_(0), saved_version_(0) {}
+
+  void load(basic_Error & e, std::string const& path);
+
+  std::string const* find(int product_id, std::string const& machine_code) const;
+
+  Snapshot insert(int product_id, std::string const& machine_code, std::string const& key);
+  Snapshot clear();
+
+  void save(basic_Error & e, Snapshot const& snapshot);
+
+private:
+  Snapshot snapshot();
+
+  std::string path_;
+  std::map<std::pair<int, std::string>, std::string> keys_;
+  unsigned long version_;
+
+  std::mutex save_mutex_;
+  unsigned long saved_version_;
+};
+
+} // namespace internal
+
+/**
+ * Caches the trial keys returned by basic_Cryptolens::create_trial_key().
+ * The Web API returns the same trial key each time for a given product and
+ * machine, thus only the first call for a product makes a request. For
+ * example:
+ *
+ *     cryptolens::TrialKeyCache<Configuration> trial_keys(e, "access token");
+ *     trial_keys.set_file(e, "/var/lib/myapp/trial_keys");
+ *     ...
+ *     std::string key = trial_keys.create_trial_key(e, product_id);
+ *
+ * Keys are cached by product id and machine code. The machine code is
+ * computed by the first call to create_trial_key() and not again, and keys
+ * loaded from a file are only used if they were created for the same
+ * machine code.
+ *
+ * create_trial_key() can be called from several threads, and concurrent
+ * calls for the same product share a single request.
+ *
+ * The cache uses its own basic_Cryptolens handle, which can be configured
+ * using get_cryptolens_handle(), and makes one request at a time.
+ */
+template<typename Configuration>
+class TrialKeyCache {
+public:
+  TrialKeyCache(basic_Error & e, std::string token)
+  : cryptolens_handle_(e), token_(std::move(token))
+  {}
+
+  TrialKeyCache(TrialKeyCache const&) = delete;
+  TrialKeyCache & operator=(TrialKeyCache const&) = delete;
+
+  void set_file(basic_Error & e, std::string const& path);
+
+  std::string create_trial_key(basic_Error & e, int product_id);
+
+  void clear(basic_Error & e);
+
+  basic_Cryptolens<Configuration> & get_cryptolens_handle() { return cryptolens_handle_; }
+
+private:
+  basic_Cryptolens<Configuration> cryptolens_handle_;
+  std::string token_;
+
+  // Held while making a request or computing the machine code, since the
+  // handle is not thread safe
+  std::mutex request_mutex_;
+
+  std::mutex mutex_;
+  internal::TrialKeyStore store_;
+  internal::SingleFlight<int, std::string> requests_;
+  std::string machine_code_;
+};
+
+/**
+ * Sets the file the cached keys are saved in. Keys already saved in the file
+ * are loaded, and each key returned by the Web API is added to it, so that
+ * create_trial_key() does not make a request after the process restarts.
+ *
+ * Should be called before create_trial_key().
+ */
+template<typename Configuration>
+void
+TrialKeyCache<Configuration>::set_file(basic_Error & e, std::string const& path)
+{
+  if (e) { return; }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  store_.load(e, path);
+}
+
+/**
+ * Returns the trial key for the product and the machine code of this
+ * machine, using basic_Cryptolens::create_trial_key() unless the key is
+ * already cached.
+ *
+ * Failed requests are not cached, thus the next call makes a new request.
+ * If the key cannot be added to the file set using set_file(), the key is
+ * still cached in memory and returned, and e is set with the File subsystem.
+ * The file is written without blocking callers whose key is cached.
+ */
+template<typename Configuration>
+std::string
+TrialKeyCache<Configuration>::create_trial_key(basic_Error & e, int product_id)
+{
+  if (e) { return ""; }
+
+  api::main api;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  if (!machine_code_.empty()) {
+    std::string const* key = store_.find(product_id, machine_code_);
+    if (key) { internal::report_cache_hit(cryptolens_handle_.instrumentation, 0); return *key; }
+  }
+
+  std::string key;
+  if (!requests_.join(lock, e, product_id, key)) { return key; }
+  lock.unlock();
+
+  basic_Error request_error;
+  bool cached = false;
+  {
+    std::lock_guard<std::mutex> request_lock(request_mutex_);
+
+    std::string machine_code;
+    {
+      std::lock_guard<std::mutex> machine_code_lock(mutex_);
+      machine_code = machine_code_;
+    }
+
+    if (machine_code.empty()) {
+      machine_code = cryptolens_handle_.machine_code_computer.get_machine_code(request_error);
+      if (!request_error) {
+        std::lock_guard<std::mutex> machine_code_lock(mutex_);
+        machine_code_ = machine_code;
+
+        // The key may have been loaded from the file
+        std::string const* x = store_.find(product_id, machine_code_);
+        if (x) { key = *x; cached = true; }
+      }
+    }
+
+    if (!request_error && !cached) {
+      key = cryptolens_handle_.create_trial_key(request_error, token_, product_id);
+    }
+  }
+
+  basic_Error save_error;
+  if (!request_error && !cached) {
+    lock.lock();
+    internal::TrialKeyStore::Snapshot snapshot = store_.insert(product_id, machine_code_, key);
+    lock.unlock();
+
+    store_.save(save_error, snapshot);
+  }
+
+  basic_Error const& error = request_error ? request_error : save_error;
+  if (request_error) { key.clear(); }
+
+  lock.lock();
+  requests_.finish(product_id, error, key);
+  lock.unlock();
+
+  if (error) { e.set(api, error); }
+  if (cached) { internal::report_cache_hit(cryptolens_handle_.instrumentation, 0); }
+  return key;
+}
+
+/**
+ * Removes all cached keys, including those saved in the file set using
+ * set_file().
+ */
+template<typename Configuration>
+void
+TrialKeyCache<Configuration>::clear(basic_Error & e)
+{
+  if (e) { return; }
+
+  internal::TrialKeyStore::Snapshot snapshot;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    snapshot = store_.clear();
+  }
+
+  store_.save(e, snapshot);
+}
+
+} // namespace v20190401
+
+namespace latest {
+
+template<typename Configuration>
+using TrialKeyCache = ::cryptolens_io::v20190401::TrialKeyCache<Configuration>;
+
+} // namespace latest
+
+} // namespace cryptolens_io
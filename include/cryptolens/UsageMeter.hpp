@@ -0,0 +1,395 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "api.hpp"
+#include "basic_Cryptolens.hpp"
+#include "basic_Error.hpp"
+#include "LicenseKeyFile.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace internal {
+
+/*
+ * The amount added to a counter of a UsageMeter since it was last taken,
+ * spread over several stripes on separate cache lines so that threads
+ * adding to the same counter do not contend for one. Each thread always
+ * adds to the same stripe.
+ */
+struct UsageCounter {
+  UsageCounter(int product_id, std::string key, int data_object_id);
+
+  UsageCounter(UsageCounter const&) = delete;
+  UsageCounter & operator=(UsageCounter const&) = delete;
+
+  /*
+   * Returns true if this call made the stripe of the calling thread reach
+   * the threshold, or false if threshold is zero.
+   */
+  bool add(std::int64_t n, std::int64_t threshold)
+  {
+    std::int64_t before = stripes_[stripe()].value.fetch_add(n, std::memory_order_relaxed);
+    std::int64_t after = before + n;
+    return threshold > 0 && (before < 0 ? -before : before) < threshold && (after < 0 ? -after : after) >= threshold;
+  }
+
+  std::int64_t take();
+
+  static size_t stripe()
+  {
+    static thread_local size_t const stripe = next_stripe();
+    return stripe;
+  }
+
+  int const product_id;
+  std::string const key;
+  int const data_object_id;
+
+  // Amounts taken from the stripes which have not yet been sent, with their
+  // sequence numbers in the journal. Guarded by the flush mutex of the meter
+  std::vector<std::pair<std::uint64_t, std::int64_t>> unsent;
+
+private:
+  static size_t constexpr STRIPES = 16;
+
+  static size_t next_stripe();
+
+  struct Stripe {
+    Stripe() : value(0) {}
+
+    std::atomic<std::int64_t> value;
+    char padding[64 - sizeof(std::atomic<std::int64_t>)];
+  };
+
+  Stripe stripes_[STRIPES];
+};
+
+struct UsageJournalRecord {
+  std::uint64_t seq;
+  int product_id;
+  int data_object_id;
+  std::int64_t delta;
+  std::string key;
+};
+
+/*
+ * An append-only file recording amounts before they are sent and, using
+ * their sequence numbers, which of them have been sent. Whatever was
+ * recorded but not marked as sent when the process stopped is sent again
+ * after a restart.
+ *
+ * Records are buffered until sync() is called, which writes them and waits
+ * until they are on disk.
+ */
+class UsageJournal {
+public:
+  UsageJournal() : file_(NULL), empty_(true) {}
+  ~UsageJournal() { close(); }
+
+  UsageJournal(UsageJournal const&) = delete;
+  UsageJournal & operator=(UsageJournal const&) = delete;
+
+  std::vector<UsageJournalRecord> replay(basic_Error & e, std::string const& path);
+
+  bool is_set() const { return !path_.empty(); }
+
+  void append_delta(UsageCounter const& counter, std::uint64_t seq, std::int64_t delta);
+  void append_sent(std::uint64_t seq);
+
+  void sync(basic_Error & e);
+  void clear(basic_Error & e);
+  void rewrite(basic_Error & e, std::vector<UsageJournalRecord> const& records);
+
+private:
+  void close();
+
+  std::FILE * file_;
+  std::string path_;
+  bool empty_;
+};
+
+/*
+ * The parts of UsageMeter which do not depend on the Configuration. The
+ * accumulated amounts are sent using send, on the thread calling flush().
+ */
+class UsageMeterCore {
+public:
+  using Send = std::function<void(basic_Error & e, UsageCounter const& counter, int int_value)>;
+  using OnFlush = std::function<void(basic_Error const& e)>;
+
+  explicit UsageMeterCore(Send send);
+  ~UsageMeterCore();
+
+  UsageMeterCore(UsageMeterCore const&) = delete;
+  UsageMeterCore & operator=(UsageMeterCore const&) = delete;
+
+  UsageCounter * counter(int product_id, std::string const& key, int data_object_id);
+
+  void set_journal(basic_Error & e, std::string const& path);
+  void set_flush_interval(std::chrono::milliseconds flush_interval);
+  void set_flush_threshold(std::int64_t flush_threshold) { flush_threshold_.store(flush_threshold, std::memory_order_relaxed); }
+  void set_on_flush(OnFlush on_flush);
+
+  std::int64_t get_flush_threshold() const { return flush_threshold_.load(std::memory_order_relaxed); }
+
+  void start(basic_Error & e);
+  void stop();
+  void flush(basic_Error & e);
+  void request_flush();
+
+private:
+  void run();
+  void stop_thread();
+
+  std::vector<UsageCounter *> counters();
+  void flush_(basic_Error & e);
+  void sync_journal(basic_Error & e, std::vector<UsageCounter *> const& counters);
+
+  Send send_;
+  std::atomic<std::int64_t> flush_threshold_;
+
+  // Guards the fields below it
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::map<std::tuple<int, std::string, int>, std::unique_ptr<UsageCounter>> counters_;
+  std::chrono::milliseconds flush_interval_;
+  OnFlush on_flush_;
+  bool flush_requested_;
+  bool stopping_;
+  std::thread thread_;
+
+  // Held while flushing, guards the fields below it
+  std::mutex flush_mutex_;
+  UsageJournal journal_;
+  bool journal_dirty_;
+  std::uint64_t last_seq_;
+};
+
+} // namespace internal
+
+/**
+ * Meters usage against the int values of data objects associated with
+ * license keys, e.g. the number of documents processed. Events are counted
+ * locally and the accumulated amounts are sent using
+ * basic_Cryptolens::increment_int_value() from a background thread, one
+ * request per license key and data object for each flush rather than one
+ * per event. For example:
+ *
+ *     cryptolens::UsageMeter<Configuration> meter(e, "access token");
+ *     meter.set_journal(e, "/var/lib/myapp/usage.journal");
+ *     meter.start(e);
+ *
+ *     auto documents = meter.counter(e, product_id, key, data_object_id);
+ *     ...
+ *     documents.add(1);
+ *
+ * Counter::add() only performs an atomic addition on a cache line shared
+ * with few if any other threads, and can be called from any number of
+ * threads.
+ *
+ * Amounts which fail to be sent are kept and sent, added to whatever has
+ * been counted since, on the next flush. If a journal has been set using
+ * set_journal(), amounts are also recorded there before being sent, so that
+ * they are sent after a restart if the process stops before they have been
+ * sent. Amounts may then be sent twice, if the process stopped after a
+ * request succeeded but before this was recorded. Events counted since the
+ * last flush are not recorded and are lost if the process stops without
+ * destroying the meter.
+ *
+ * The meter uses its own basic_Cryptolens handle, since requests are made
+ * from the background thread, which can be configured using
+ * get_cryptolens_handle() before start() is called.
+ */
+template<typename Configuration>
+class UsageMeter {
+public:
+  using OnFlush = internal::UsageMeterCore::OnFlush;
+
+  /**
+   * A counter of a UsageMeter for one license key and data object. Copies
+   * refer to the same counter, and remain valid as long as the meter.
+   */
+  class Counter {
+  public:
+    Counter() : counter_(nullptr), core_(nullptr) {}
+
+    void add(std::int64_t n = 1)
+    {
+      if (counter_ && counter_->add(n, core_->get_flush_threshold())) { core_->request_flush(); }
+    }
+
+  private:
+    friend class UsageMeter;
+
+    Counter(internal::UsageCounter * counter, internal::UsageMeterCore * core) : counter_(counter), core_(core) {}
+
+    internal::UsageCounter * counter_;
+    internal::UsageMeterCore * core_;
+  };
+
+  UsageMeter(basic_Error & e, std::string token)
+  : cryptolens_handle_(e)
+  , token_(std::move(token))
+  , core_([this](basic_Error & e, internal::UsageCounter const& counter, int int_value) {
+      cryptolens_handle_.increment_int_value(e, token_, counter.product_id, counter.key, counter.data_object_id, int_value);
+    })
+  {}
+
+  ~UsageMeter() { core_.stop(); }
+
+  UsageMeter(UsageMeter const&) = delete;
+  UsageMeter & operator=(UsageMeter const&) = delete;
+
+  Counter counter(basic_Error & e, int product_id, std::string const& key, int data_object_id);
+
+  void set_journal(basic_Error & e, std::string const& path);
+  void set_flush_interval(basic_Error & e, std::chrono::milliseconds flush_interval);
+  void set_flush_threshold(basic_Error & e, std::int64_t flush_threshold);
+  void set_on_flush(basic_Error & e, OnFlush on_flush);
+
+  void start(basic_Error & e);
+  void flush(basic_Error & e);
+  void stop();
+
+  basic_Cryptolens<Configuration> & get_cryptolens_handle() { return cryptolens_handle_; }
+
+private:
+  basic_Cryptolens<Configuration> cryptolens_handle_;
+  std::string token_;
+  internal::UsageMeterCore core_;
+};
+
+/**
+ * Returns the counter for the data object with id data_object_id of the
+ * license key key, creating it if this is the first call with these
+ * arguments.
+ */
+template<typename Configuration>
+typename UsageMeter<Configuration>::Counter
+UsageMeter<Configuration>::counter(basic_Error & e, int product_id, std::string const& key, int data_object_id)
+{
+  if (e) { return Counter(); }
+
+  return Counter(core_.counter(product_id, key, data_object_id), &core_);
+}
+
+/**
+ * Sets the file used for recording amounts until they have been sent. If
+ * the file exists, the amounts recorded in it which were not sent are
+ * added to the meter, and are sent on the next flush.
+ *
+ * Must be called before start().
+ */
+template<typename Configuration>
+void
+UsageMeter<Configuration>::set_journal(basic_Error & e, std::string const& path)
+{
+  if (e) { return; }
+
+  core_.set_journal(e, path);
+}
+
+/**
+ * Sets how often the background thread flushes the meter. The default is
+ * one minute.
+ */
+template<typename Configuration>
+void
+UsageMeter<Configuration>::set_flush_interval(basic_Error & e, std::chrono::milliseconds flush_interval)
+{
+  if (e) { return; }
+
+  core_.set_flush_interval(flush_interval);
+}
+
+/**
+ * Makes the background thread flush the meter before the flush interval has
+ * passed once a thread has added flush_threshold to a counter since the
+ * last flush. Zero, the default, disables this.
+ */
+template<typename Configuration>
+void
+UsageMeter<Configuration>::set_flush_threshold(basic_Error & e, std::int64_t flush_threshold)
+{
+  if (e) { return; }
+
+  core_.set_flush_threshold(flush_threshold);
+}
+
+/**
+ * Sets a function which is called after each flush with the error, if any,
+ * from the flush. For flushes made by the background thread this is the
+ * only way to learn about errors.
+ */
+template<typename Configuration>
+void
+UsageMeter<Configuration>::set_on_flush(basic_Error & e, OnFlush on_flush)
+{
+  if (e) { return; }
+
+  core_.set_on_flush(std::move(on_flush));
+}
+
+/**
+ * Starts the background thread, which flushes the meter each flush interval.
+ */
+template<typename Configuration>
+void
+UsageMeter<Configuration>::start(basic_Error & e)
+{
+  if (e) { return; }
+
+  core_.start(e);
+}
+
+/**
+ * Sends the amounts counted since the last flush, together with any amounts
+ * which could not be sent before. If a request fails, e is set and the
+ * amount is kept for the next flush.
+ */
+template<typename Configuration>
+void
+UsageMeter<Configuration>::flush(basic_Error & e)
+{
+  if (e) { return; }
+
+  core_.flush(e);
+}
+
+/**
+ * Stops the background thread, if started, and flushes the meter a last
+ * time. Called by the destructor.
+ */
+template<typename Configuration>
+void
+UsageMeter<Configuration>::stop()
+{
+  core_.stop();
+}
+
+} // namespace v20190401
+
+namespace latest {
+
+template<typename Configuration>
+using UsageMeter = ::cryptolens_io::v20190401::UsageMeter<Configuration>;
+
+} // namespace latest
+
+} // namespace cryptolens_io
@@ -0,0 +1,293 @@
+#pragma once
+
+/*
+ * Support for C++20 coroutines. The asynchronous methods of basic_Cryptolens,
+ * such as activate_async(), are only available when this header finds
+ * coroutine support, in which case CRYPTOLENS_HAS_COROUTINES is defined.
+ */
+
+#if defined(__has_include)
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#define CRYPTOLENS_HAS_COROUTINES 1
+#endif
+#endif
+
+#ifdef CRYPTOLENS_HAS_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "basic_Error.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+template<typename T = void>
+class Task;
+
+namespace internal {
+
+class TaskPromiseBase {
+public:
+  struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+
+    template<typename Promise>
+    std::coroutine_handle<>
+    await_suspend(std::coroutine_handle<Promise> h) noexcept
+    {
+      std::coroutine_handle<> continuation = h.promise().continuation_;
+      return continuation ? continuation : std::noop_coroutine();
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  FinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() { exception_ = std::current_exception(); }
+
+  std::coroutine_handle<> continuation_;
+
+protected:
+  void
+  rethrow_if_exception()
+  {
+    if (exception_) { std::rethrow_exception(exception_); }
+  }
+
+private:
+  std::exception_ptr exception_;
+};
+
+template<typename T>
+class TaskPromise : public TaskPromiseBase {
+public:
+  Task<T> get_return_object();
+
+  template<typename U>
+  void return_value(U && value) { value_.emplace(std::forward<U>(value)); }
+
+  T
+  result()
+  {
+    rethrow_if_exception();
+    return std::move(*value_);
+  }
+
+private:
+  std::optional<T> value_;
+};
+
+template<>
+class TaskPromise<void> : public TaskPromiseBase {
+public:
+  Task<void> get_return_object();
+
+  void return_void() {}
+
+  void result() { rethrow_if_exception(); }
+};
+
+} // namespace internal
+
+/**
+ * The result of an asynchronous method such as
+ * basic_Cryptolens::activate_async().
+ *
+ * A Task does not start running until it is awaited using co_await, which
+ * resumes the awaiting coroutine with the result once the Task has finished.
+ * Use spawn() to start a Task from code that is not a coroutine.
+ */
+template<typename T>
+class Task {
+public:
+  using promise_type = internal::TaskPromise<T>;
+
+  Task(Task && other) noexcept : h_(std::exchange(other.h_, {})) {}
+  Task(Task const&) = delete;
+  void operator=(Task const&) = delete;
+  void operator=(Task &&) = delete;
+
+  ~Task() { if (h_) { h_.destroy(); } }
+
+  bool await_ready() const noexcept { return false; }
+
+  std::coroutine_handle<>
+  await_suspend(std::coroutine_handle<> continuation) noexcept
+  {
+    h_.promise().continuation_ = continuation;
+    return h_;
+  }
+
+  T await_resume() { return h_.promise().result(); }
+
+private:
+  friend promise_type;
+
+  explicit Task(std::coroutine_handle<promise_type> h) : h_(h) {}
+
+  std::coroutine_handle<promise_type> h_;
+};
+
+namespace internal {
+
+template<typename T>
+Task<T>
+TaskPromise<T>::get_return_object()
+{
+  return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline
+Task<void>
+TaskPromise<void>::get_return_object()
+{
+  return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+/*
+ * Awaits the response to a request made with a PostBuilder of a
+ * RequestHandler, resuming the awaiting coroutine on the executor.
+ *
+ * If the PostBuilder provides make_async() the calling coroutine is
+ * suspended while the request is in progress without occupying any thread.
+ * Otherwise the blocking make() is called on a thread started for the
+ * request, rather than on the executor, since the executor may be an event
+ * loop or a thread pool which must not be blocked for the duration of a
+ * request.
+ */
+template<typename PostBuilder, typename ResumeExecutor>
+class RequestAwaitable {
+public:
+  RequestAwaitable(basic_Error & e, PostBuilder & request, ResumeExecutor & executor)
+  : e_(e), request_(request), executor_(executor)
+  {}
+
+  bool await_ready() const noexcept { return static_cast<bool>(e_); }
+
+  void await_suspend(std::coroutine_handle<> h) { start(h, 0); }
+
+  std::string await_resume() { return std::move(response_); }
+
+private:
+  template<typename P = PostBuilder>
+  auto
+  start(std::coroutine_handle<> h, int)
+    -> decltype(std::declval<P &>().make_async(std::declval<basic_Error &>(), std::declval<std::string &>(), std::function<void()>()))
+  {
+    ResumeExecutor * executor = &executor_;
+    request_.make_async(e_, response_, [executor, h]() { (*executor)([h]() { h.resume(); }); });
+  }
+
+  void
+  start(std::coroutine_handle<> h, long)
+  {
+    ResumeExecutor * executor = &executor_;
+    std::thread([this, executor, h]() {
+      response_ = request_.make(e_);
+      (*executor)([h]() { h.resume(); });
+    }).detach();
+  }
+
+  basic_Error & e_;
+  PostBuilder & request_;
+  ResumeExecutor & executor_;
+  std::string response_;
+};
+
+template<typename PostBuilder, typename ResumeExecutor>
+RequestAwaitable<PostBuilder, ResumeExecutor>
+make_request_async(basic_Error & e, PostBuilder & request, ResumeExecutor & executor)
+{
+  return RequestAwaitable<PostBuilder, ResumeExecutor>(e, request, executor);
+}
+
+/*
+ * Resumes the awaiting coroutine on the executor.
+ */
+template<typename ResumeExecutor>
+class ScheduleAwaitable {
+public:
+  explicit ScheduleAwaitable(ResumeExecutor & executor) : executor_(executor) {}
+
+  bool await_ready() const noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> h) { executor_([h]() { h.resume(); }); }
+
+  void await_resume() const noexcept {}
+
+private:
+  ResumeExecutor & executor_;
+};
+
+template<typename ResumeExecutor>
+ScheduleAwaitable<ResumeExecutor>
+schedule(ResumeExecutor & executor)
+{
+  return ScheduleAwaitable<ResumeExecutor>(executor);
+}
+
+struct Detached {
+  struct promise_type {
+    Detached get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+template<typename T, typename F>
+Detached
+spawn_(Task<T> task, F on_complete)
+{
+  on_complete(co_await std::move(task));
+}
+
+template<typename F>
+Detached
+spawn_(Task<void> task, F on_complete)
+{
+  co_await std::move(task);
+  on_complete();
+}
+
+} // namespace internal
+
+/**
+ * Starts the Task without waiting for it to finish, and calls on_complete
+ * with its result once it has. This is useful for integrating with code
+ * that is not written using coroutines, e.g. callback based event loops.
+ *
+ * The Task runs on the calling thread until it first suspends, and then on
+ * the executor it was created with. If the Task throws an exception,
+ * std::terminate() is called.
+ */
+template<typename T, typename F>
+void
+spawn(Task<T> task, F on_complete)
+{
+  internal::spawn_(std::move(task), std::move(on_complete));
+}
+
+} // namespace v20190401
+
+namespace latest {
+
+template<typename T = void>
+using Task = ::cryptolens_io::v20190401::Task<T>;
+
+using ::cryptolens_io::v20190401::spawn;
+
+} // namespace latest
+
+} // namespace cryptolens_io
+
+#endif /* CRYPTOLENS_HAS_COROUTINES */
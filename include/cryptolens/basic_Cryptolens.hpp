@@ -1,18 +1,28 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <string>
 #include <sstream>
+#include <vector>
 
 #include "imports/std/optional"
 
 #include "ActivateError.hpp"
 #include "api.hpp"
+#include "async.hpp"
 #include "basic_Error.hpp"
+#include "Executor.hpp"
+#include "Instrumentation.hpp"
 #include "LicenseKey.hpp"
 #include "LicenseKeyChecker.hpp"
+#include "LicenseKeyFile.hpp"
 #include "LicenseKeyInformation.hpp"
+#include "LicenseKeyView.hpp"
+#include "Message.hpp"
 #include "RawLicenseKey.hpp"
+#include "RequestPolicy.hpp"
 #include "ResponseParser_ArduinoJson5.hpp"
 
 namespace cryptolens_io {
@@ -21,6 +31,32 @@ namespace v20190401 {
 
 namespace internal {
 
+inline
+bool
+is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Activate responses are JSON objects, unlike the format of LicenseKey::to_string()
+inline
+bool
+is_json_object(StringView s)
+{
+  size_t i = 0;
+  while (i < s.size() && is_space(s[i])) { ++i; }
+  return i < s.size() && s[i] == '{';
+}
+
+inline
+StringView
+trim_right(StringView s)
+{
+  size_t n = s.size();
+  while (n > 0 && is_space(s[n - 1])) { --n; }
+  return StringView(s.data(), n);
+}
+
 template<typename ResponseParser, typename SignatureVerifier>
 optional<RawLicenseKey>
 handle_activate
@@ -30,6 +66,16 @@ handle_activate
   , std::string const& response
   );
 
+template<typename Instrumentation, typename ResponseParser, typename SignatureVerifier>
+optional<RawLicenseKey>
+handle_activate
+  ( basic_Error & e
+  , Instrumentation & instrumentation
+  , ResponseParser const& response_parser
+  , SignatureVerifier const& signature_verifier
+  , std::string const& response
+  );
+
 int
 activate_parse_server_error_message(char const* server_response);
 
@@ -159,6 +205,13 @@ handle_activate
  * requests to the Web API, respectivly. Consult the documentation for the
  * chosen policy classes since in some cases special initialization may be
  * neccessary.
+ *
+ * When compiled as C++20, the methods ending in _async return a Task which
+ * can be awaited using co_await, see activate_async().
+ *
+ * Parsing and signature verification in batch and asynchronous calls run on
+ * an Executor, which is the process wide default_executor() unless another
+ * one has been set using set_executor().
  */
 template<typename Configuration>
 class basic_Cryptolens
@@ -169,8 +222,10 @@ public:
 #endif
   basic_Cryptolens(basic_Error & e)
   : response_parser(e), request_handler(e), signature_verifier(e), machine_code_computer(e)
-  , activate_validator(e)
-  { }
+  , activate_validator(e), instrumentation(e), base_url_("app.cryptolens.io"), executor_(nullptr)
+  {
+    internal::configuration_request_policy<Configuration>::apply(e, request_handler);
+  }
 
   optional<LicenseKey>
   activate
@@ -235,6 +290,16 @@ public:
     , bool floating = false
     );
 
+  void
+  increment_int_value
+    ( basic_Error & e
+    , std::string token
+    , int product_id
+    , std::string key
+    , int data_object_id
+    , int int_value
+    );
+
   std::string
   last_message
     ( basic_Error & e
@@ -243,16 +308,104 @@ public:
     , int since_unix_timestamp
     );
 
+  std::vector<Message>
+  get_messages
+    ( basic_Error & e
+    , std::string token
+    , std::string channel
+    , std::int64_t since_unix_timestamp
+    );
+
   optional<LicenseKey>
   make_license_key(basic_Error & e, std::string const& s);
 
+  std::vector<optional<LicenseKey>>
+  make_license_keys(basic_Error & e, std::vector<std::string> const& s, std::vector<basic_Error> & errors);
+
+  optional<LicenseKeyView>
+  make_license_key_view(basic_Error & e, char const* data, size_t size);
+
+  std::vector<LicenseKeyFile>
+  load_license_key_files(basic_Error & e, std::vector<std::string> const& paths, std::vector<basic_Error> & errors);
+
+  optional<LicenseKey>
+  load_license_key_file(basic_Error & e, std::string const& path);
+
+  void
+  set_executor(basic_Error & e, Executor & executor);
+
+  Executor &
+  get_executor();
+
+#ifdef CRYPTOLENS_HAS_COROUTINES
+  template<typename ResumeExecutor>
+  Task<optional<LicenseKey>>
+  activate_async
+    ( ResumeExecutor executor
+    , basic_Error & e
+    , std::string token
+    , int product_id
+    , std::string key
+    , int fields_to_return = 0
+    );
+
+  template<typename ResumeExecutor>
+  Task<optional<LicenseKey>>
+  activate_floating_async
+    ( ResumeExecutor executor
+    , basic_Error & e
+    , std::string token
+    , int product_id
+    , std::string key
+    , long floating_time_interval
+    , int fields_to_return = 0
+    );
+
+  template<typename ResumeExecutor>
+  Task<void>
+  deactivate_async
+    ( ResumeExecutor executor
+    , basic_Error & e
+    , std::string token
+    , int product_id
+    , std::string key
+    , bool floating = false
+    );
+#endif /* CRYPTOLENS_HAS_COROUTINES */
+
+  void
+  set_base_url(basic_Error & e, std::string base_url);
+
+  std::string const&
+  get_base_url() const;
+
   typename Configuration::ResponseParser response_parser;
   typename Configuration::RequestHandler request_handler;
   typename Configuration::SignatureVerifier signature_verifier;
   typename Configuration::MachineCodeComputer machine_code_computer;
   typename Configuration::template ActivateValidator<internal::ActivateEnvironment> activate_validator;
+  typename internal::configuration_instrumentation<Configuration>::type instrumentation;
 
 private:
+  std::string base_url_;
+  Executor * executor_;
+
+  template<typename Instrumentation>
+  optional<LicenseKey>
+  make_license_key_(basic_Error & e, Instrumentation & instrumentation_, std::string const& s);
+
+  template<typename Instrumentation>
+  optional<LicenseKey>
+  make_license_key_(basic_Error & e, Instrumentation & instrumentation_, optional<RawLicenseKey> raw_license_key);
+
+  template<typename Instrumentation>
+  optional<RawLicenseKey>
+  make_raw_license_key_saved_(basic_Error & e, Instrumentation & instrumentation_, StringView s);
+
+  template<typename Instrumentation>
+  optional<LicenseKey>
+  make_license_key_file_(basic_Error & e, Instrumentation & instrumentation_, StringView s);
+
   optional<RawLicenseKey>
   activate_
     ( basic_Error & e
@@ -291,6 +444,16 @@ private:
     , bool floating
     );
 
+  void
+  increment_int_value_
+    ( basic_Error & e
+    , std::string & token
+    , int product_id
+    , std::string & key
+    , int data_object_id
+    , int int_value
+    );
+
   std::string
   last_message_
     ( basic_Error & e
@@ -298,6 +461,29 @@ private:
     , std::string channel
     , int since_unix_timestamp
     );
+
+  std::string
+  get_messages_
+    ( basic_Error & e
+    , std::string & token
+    , std::string & channel
+    , std::int64_t since_unix_timestamp
+    );
+
+#ifdef CRYPTOLENS_HAS_COROUTINES
+  template<typename ResumeExecutor>
+  Task<optional<LicenseKey>>
+  activate_async_
+    ( ResumeExecutor executor
+    , basic_Error & e
+    , std::string token
+    , int product_id
+    , std::string key
+    , bool floating
+    , long floating_time_interval
+    , int fields_to_return
+    );
+#endif /* CRYPTOLENS_HAS_COROUTINES */
 };
 
 /**
@@ -324,6 +510,9 @@ basic_Cryptolens<Configuration>::activate
 {
   if (e) { return nullopt; }
 
+  using namespace instrumentation;
+  internal::ActivationInstrumentationScope<decltype(this->instrumentation)> scope(this->instrumentation, e);
+
   std::string machine_code = machine_code_computer.get_machine_code(e);
 
   optional<RawLicenseKey> x = this->activate_
@@ -334,11 +523,16 @@ basic_Cryptolens<Configuration>::activate
       , machine_code // NOTE: Copy is performed here
       , fields_to_return
       );
+
+  this->instrumentation.stage_begin(Stage::MAKE_LICENSE_KEY_INFORMATION);
   optional<LicenseKeyInformation> y = response_parser.make_license_key_information(e, x);
+  this->instrumentation.stage_end(Stage::MAKE_LICENSE_KEY_INFORMATION);
   if (e) { e.set_call(api::main(), errors::Call::BASIC_SKM_ACTIVATE); return nullopt; }
 
   typename internal::ActivateEnvironment env(*y, product_id, key, machine_code, fields_to_return, false);
+  this->instrumentation.stage_begin(Stage::VALIDATE);
   activate_validator.validate(e, env);
+  this->instrumentation.stage_end(Stage::VALIDATE);
   if (e) { e.set_call(api::main(), errors::Call::BASIC_SKM_ACTIVATE); return nullopt; }
 
   return LicenseKey(std::move(*y), std::move(*x));
@@ -453,6 +647,9 @@ basic_Cryptolens<Configuration>::activate_floating
 {
   if (e) { return nullopt; }
 
+  using namespace instrumentation;
+  internal::ActivationInstrumentationScope<decltype(this->instrumentation)> scope(this->instrumentation, e);
+
   std::string machine_code = machine_code_computer.get_machine_code(e);
 
   optional<RawLicenseKey> x = this->activate_floating_
@@ -464,11 +661,16 @@ basic_Cryptolens<Configuration>::activate_floating
       , floating_time_interval
       , fields_to_return
       );
+
+  this->instrumentation.stage_begin(Stage::MAKE_LICENSE_KEY_INFORMATION);
   optional<LicenseKeyInformation> y = response_parser.make_license_key_information(e, x);
+  this->instrumentation.stage_end(Stage::MAKE_LICENSE_KEY_INFORMATION);
   if (e) { e.set_call(api::main(), errors::Call::BASIC_SKM_ACTIVATE_FLOATING); return nullopt; }
 
   typename internal::ActivateEnvironment env(*y, product_id, key, machine_code, fields_to_return, true);
+  this->instrumentation.stage_begin(Stage::VALIDATE);
   activate_validator.validate(e, env);
+  this->instrumentation.stage_end(Stage::VALIDATE);
   if (e) { e.set_call(api::main(), errors::Call::BASIC_SKM_ACTIVATE_FLOATING); return nullopt; }
 
   return LicenseKey(std::move(*y), std::move(*x));
@@ -489,6 +691,39 @@ basic_Cryptolens<Configuration>::create_trial_key
   return key;
 }
 
+/**
+ * Adds int_value to the int value of a data object associated with a
+ * license key, using the IncrementIntValueToKey method of the Web API, or
+ * DecrementIntValueToKey if int_value is negative.
+ *
+ * Arguments:
+ *   token - acces token to use
+ *   product_id - the product id
+ *   key - the serial key string, e.g. ABCDE-EFGHI-JKLMO-PQRST
+ *   data_object_id - the id of the data object
+ *   int_value - the amount to add
+ *
+ * See UsageMeter for counting frequent events locally and sending the
+ * accumulated amounts using this method.
+ */
+template<typename Configuration>
+void
+basic_Cryptolens<Configuration>::increment_int_value
+  ( basic_Error & e
+  , std::string token
+  , int product_id
+  , std::string key
+  , int data_object_id
+  , int int_value
+  )
+{
+  if (e) { return; }
+
+  increment_int_value_(e, token, product_id, key, data_object_id, int_value);
+
+  if (e) { e.set_call(api::main(), errors::Call::BASIC_SKM_INCREMENT_INT_VALUE); return; }
+}
+
 template<typename Configuration>
 optional<RawLicenseKey>
 basic_Cryptolens<Configuration>::activate_
@@ -502,7 +737,9 @@ basic_Cryptolens<Configuration>::activate_
 {
   if (e) { return nullopt; }
 
-  auto request = request_handler.post_request(e, "app.cryptolens.io", "/api/key/Activate");
+  this->instrumentation.stage_begin(instrumentation::Stage::REQUEST);
+
+  auto request = request_handler.post_request(e, base_url_.c_str(), "/api/key/Activate");
 
   std::ostringstream product_id_; product_id_ << product_id;
   std::ostringstream fields_to_return_; fields_to_return_ << fields_to_return;
@@ -518,7 +755,12 @@ basic_Cryptolens<Configuration>::activate_
            .add_argument(e, "v"             , "1")
            .make(e);
 
-  return handle_activate_raw(e, this->signature_verifier, response);
+  this->instrumentation.stage_end(instrumentation::Stage::REQUEST);
+  this->instrumentation.request_finished(request_handler);
+
+  optional<RawLicenseKey> x = internal::handle_activate(e, this->instrumentation, this->response_parser, this->signature_verifier, response);
+  if (e) { e.set_call(api::main(), errors::Call::BASIC_SKM_HANDLE_ACTIVATE_RAW); }
+  return x;
 }
 
 template<typename Configuration>
@@ -534,7 +776,9 @@ basic_Cryptolens<Configuration>::deactivate_
 {
   if (e) { return; }
 
-  auto request = request_handler.post_request(e, "app.cryptolens.io", "/api/key/Deactivate");
+  this->instrumentation.stage_begin(instrumentation::Stage::REQUEST);
+
+  auto request = request_handler.post_request(e, base_url_.c_str(), "/api/key/Deactivate");
 
   std::ostringstream product_id_; product_id_ << product_id;
   std::ostringstream floating_; floating_ << floating;
@@ -548,9 +792,51 @@ basic_Cryptolens<Configuration>::deactivate_
            .add_argument(e, "v"           , "1")
            .make(e);
 
+  this->instrumentation.stage_end(instrumentation::Stage::REQUEST);
+  this->instrumentation.request_finished(request_handler);
+
   response_parser.parse_deactivate_response(e, response);
 }
 
+template<typename Configuration>
+void
+basic_Cryptolens<Configuration>::increment_int_value_
+  ( basic_Error & e
+  , std::string & token
+  , int product_id
+  , std::string & key
+  , int data_object_id
+  , int int_value
+  )
+{
+  if (e) { return; }
+
+  this->instrumentation.stage_begin(instrumentation::Stage::REQUEST);
+
+  char const* method = int_value < 0 ? "/api/data/DecrementIntValueToKey" : "/api/data/IncrementIntValueToKey";
+  auto request = request_handler.post_request(e, base_url_.c_str(), method);
+
+  std::ostringstream product_id_; product_id_ << product_id;
+  std::ostringstream data_object_id_; data_object_id_ << data_object_id;
+  // Computed as a long long since -INT_MIN does not fit in an int
+  std::ostringstream int_value_; int_value_ << (int_value < 0 ? -(long long)int_value : (long long)int_value);
+
+  std::string response =
+    request.add_argument(e, "token"    , token.c_str())
+           .add_argument(e, "ProductId", product_id_.str().c_str())
+           .add_argument(e, "Key"      , key.c_str())
+           .add_argument(e, "Id"       , data_object_id_.str().c_str())
+           .add_argument(e, "IntValue" , int_value_.str().c_str())
+           .make(e);
+
+  this->instrumentation.stage_end(instrumentation::Stage::REQUEST);
+  this->instrumentation.request_finished(request_handler);
+
+  if (e) { return; }
+
+  response_parser.parse_increment_int_value_response(e, response);
+}
+
 template<typename Configuration>
 optional<RawLicenseKey>
 basic_Cryptolens<Configuration>::activate_floating_
@@ -565,7 +851,9 @@ basic_Cryptolens<Configuration>::activate_floating_
 {
   if (e) { return nullopt; }
 
-  auto request = request_handler.post_request(e, "app.cryptolens.io", "/api/key/Activate");
+  this->instrumentation.stage_begin(instrumentation::Stage::REQUEST);
+
+  auto request = request_handler.post_request(e, base_url_.c_str(), "/api/key/Activate");
 
   std::ostringstream product_id_; product_id_ << product_id;
   std::ostringstream fields_to_return_; fields_to_return_ << fields_to_return;
@@ -583,7 +871,12 @@ basic_Cryptolens<Configuration>::activate_floating_
            .add_argument(e, "FloatingTimeInterval", floating_time_interval_.str().c_str())
            .make(e);
 
-  return handle_activate_raw(e, this->signature_verifier, response);
+  this->instrumentation.stage_end(instrumentation::Stage::REQUEST);
+  this->instrumentation.request_finished(request_handler);
+
+  optional<RawLicenseKey> x = internal::handle_activate(e, this->instrumentation, this->response_parser, this->signature_verifier, response);
+  if (e) { e.set_call(api::main(), errors::Call::BASIC_SKM_HANDLE_ACTIVATE_RAW); }
+  return x;
 }
 
 /**
@@ -637,6 +930,31 @@ basic_Cryptolens<Configuration>::last_message
   return message;
 }
 
+/**
+ * Returns the messages posted to channel since the given time, using the
+ * GetMessages method of the Web API. Unlike last_message(), which returns
+ * the content of the latest message, all messages are returned, in the
+ * order returned by the Web API.
+ *
+ * See MessageSubscription for polling channels for new messages.
+ */
+template<typename Configuration>
+std::vector<Message>
+basic_Cryptolens<Configuration>::get_messages
+  ( basic_Error & e
+  , std::string token
+  , std::string channel
+  , std::int64_t since_unix_timestamp
+  )
+{
+  if (e) { return std::vector<Message>(); }
+
+  std::string response = get_messages_(e, token, channel, since_unix_timestamp);
+  std::vector<Message> messages = response_parser.parse_get_messages_response(e, response);
+  if (e) { e.set_call(api::main(), errors::Call::BASIC_SKM_GET_MESSAGES); return std::vector<Message>(); }
+  return messages;
+}
+
 template<typename Configuration>
 std::string
 basic_Cryptolens<Configuration>::create_trial_key_
@@ -649,7 +967,9 @@ basic_Cryptolens<Configuration>::create_trial_key_
 
   std::string machine_code = machine_code_computer.get_machine_code(e);
 
-  auto request = request_handler.post_request(e, "app.cryptolens.io", "/api/Key/CreateTrialKey");
+  this->instrumentation.stage_begin(instrumentation::Stage::REQUEST);
+
+  auto request = request_handler.post_request(e, base_url_.c_str(), "/api/Key/CreateTrialKey");
 
   std::ostringstream product_id_; product_id_ << product_id;
 
@@ -659,6 +979,9 @@ basic_Cryptolens<Configuration>::create_trial_key_
            .add_argument(e, "MachineCode", machine_code.c_str())
            .make(e);
 
+  this->instrumentation.stage_end(instrumentation::Stage::REQUEST);
+  this->instrumentation.request_finished(request_handler);
+
   if (e) { return ""; }
 
   return response_parser.parse_create_trial_key_response(e, response);
@@ -675,7 +998,9 @@ basic_Cryptolens<Configuration>::last_message_
 {
   if (e) { return ""; }
 
-  auto request = request_handler.post_request(e, "app.cryptolens.io", "/api/message/GetMessages");
+  this->instrumentation.stage_begin(instrumentation::Stage::REQUEST);
+
+  auto request = request_handler.post_request(e, base_url_.c_str(), "/api/message/GetMessages");
 
   std::ostringstream stm; stm << since_unix_timestamp;
 
@@ -685,52 +1010,480 @@ basic_Cryptolens<Configuration>::last_message_
            .add_argument(e, "Time"   , stm.str().c_str())
            .make(e);
 
+  this->instrumentation.stage_end(instrumentation::Stage::REQUEST);
+  this->instrumentation.request_finished(request_handler);
+
   if (e) { return ""; }
 
   return response_parser.parse_last_message_response(e, response);
 }
 
+template<typename Configuration>
+std::string
+basic_Cryptolens<Configuration>::get_messages_
+  ( basic_Error & e
+  , std::string & token
+  , std::string & channel
+  , std::int64_t since_unix_timestamp
+  )
+{
+  if (e) { return ""; }
+
+  this->instrumentation.stage_begin(instrumentation::Stage::REQUEST);
+
+  auto request = request_handler.post_request(e, base_url_.c_str(), "/api/message/GetMessages");
+
+  std::ostringstream stm; stm << since_unix_timestamp;
+
+  std::string response =
+    request.add_argument(e, "token"  , token.c_str())
+           .add_argument(e, "Channel", channel.c_str())
+           .add_argument(e, "Time"   , stm.str().c_str())
+           .make(e);
+
+  this->instrumentation.stage_end(instrumentation::Stage::REQUEST);
+  this->instrumentation.request_finished(request_handler);
+
+  return response;
+}
+
+/**
+ * Sets the location of the Cryptolens Web API used by this handle. This is
+ * only needed when requests should be sent somewhere other than the default,
+ * app.cryptolens.io, e.g. a local server used for testing.
+ *
+ * The base url consists of a host, optionally preceded by a scheme and
+ * followed by a port, e.g.
+ *
+ *     cryptolens_handle.set_base_url(e, "http://localhost:8080");
+ *
+ * If the scheme is omitted https is used.
+ */
+template<typename Configuration>
+void
+basic_Cryptolens<Configuration>::set_base_url(basic_Error & e, std::string base_url)
+{
+  if (e) { return; }
+
+  base_url_ = std::move(base_url);
+}
+
+/**
+ * Returns the location of the Cryptolens Web API used by this handle, see
+ * set_base_url().
+ */
+template<typename Configuration>
+std::string const&
+basic_Cryptolens<Configuration>::get_base_url() const
+{
+  return base_url_;
+}
+
 template<typename Configuration>
 optional<LicenseKey>
 basic_Cryptolens<Configuration>::make_license_key(basic_Error & e, std::string const& s)
+{
+  return make_license_key_(e, this->instrumentation, s);
+}
+
+/**
+ * Batch version of make_license_key(), which parses and verifies the license
+ * keys in parallel on the Executor of this handle.
+ *
+ * The result has one element per element of s, which is nullopt if the
+ * license key could not be made. In that case the corresponding element of
+ * errors, which is resized to the size of s, holds the reason. e is only
+ * set if the batch as a whole failed.
+ *
+ * Each license key is recorded with a separate Instrumentation object, thus
+ * Instrumentation policies which keep their measurements in the object,
+ * rather than e.g. in Metrics, do not see the calls made by this method.
+ */
+template<typename Configuration>
+std::vector<optional<LicenseKey>>
+basic_Cryptolens<Configuration>::make_license_keys(basic_Error & e, std::vector<std::string> const& s, std::vector<basic_Error> & errors)
+{
+  std::vector<optional<LicenseKey>> license_keys(s.size());
+  std::vector<basic_Error>(s.size()).swap(errors);
+  if (e) { return license_keys; }
+
+  internal::parallel_for(get_executor(), s.size(), [this, &s, &errors, &license_keys](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      typename internal::configuration_instrumentation<Configuration>::type instrumentation(errors[i]);
+      license_keys[i] = make_license_key_(errors[i], instrumentation, s[i]);
+    }
+  });
+
+  return license_keys;
+}
+
+/**
+ * Loads a license key stored using LicenseKey::to_binary(), verifying its
+ * signature with the SignatureVerifier of this handle. The returned
+ * LicenseKeyView refers directly to the buffer, see LicenseKeyView.
+ */
+template<typename Configuration>
+optional<LicenseKeyView>
+basic_Cryptolens<Configuration>::make_license_key_view(basic_Error & e, char const* data, size_t size)
 {
   if (e) { return nullopt; }
 
-  optional<RawLicenseKey> raw_license_key;
+  optional<LicenseKeyView> x = LicenseKeyView::make(e, this->signature_verifier, data, size);
+  if (e) { e.set_call(api::main(), errors::Call::BASIC_SKM_MAKE_LICENSE_KEY); return nullopt; }
+  return x;
+}
+
+/**
+ * Loads license keys saved using LicenseKey::to_string() or as activate
+ * responses, one per file, e.g. as listed by list_license_key_files() or
+ * read_license_key_manifest(). The files are memory mapped, and decoded and
+ * verified in parallel on the Executor of this handle.
+ *
+ * The result contains the license keys that could be loaded, sorted by key
+ * and then by path. errors is resized to the size of paths, and holds the
+ * reason for each file that could not be loaded. e is only set if the batch
+ * as a whole failed.
+ *
+ * See make_license_keys() regarding the Instrumentation used.
+ */
+template<typename Configuration>
+std::vector<LicenseKeyFile>
+basic_Cryptolens<Configuration>::load_license_key_files(basic_Error & e, std::vector<std::string> const& paths, std::vector<basic_Error> & errors)
+{
+  std::vector<LicenseKeyFile> files;
+  std::vector<basic_Error>(paths.size()).swap(errors);
+  if (e) { return files; }
+
+  std::vector<optional<LicenseKey>> license_keys(paths.size());
+  internal::parallel_for(get_executor(), paths.size(), [this, &paths, &errors, &license_keys](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      typename internal::configuration_instrumentation<Configuration>::type instrumentation(errors[i]);
+
+      internal::MappedFile file(errors[i], paths[i]);
+      license_keys[i] = make_license_key_file_(errors[i], instrumentation, file.get());
+    }
+  });
+
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (license_keys[i]) { files.emplace_back(paths[i], std::move(*license_keys[i])); }
+  }
+
+  std::sort(files.begin(), files.end(), [](LicenseKeyFile const& a, LicenseKeyFile const& b) {
+    optional<std::string> const& x = a.license_key.get_key();
+    optional<std::string> const& y = b.license_key.get_key();
+    if (x != y) { return x < y; }
+    return a.path < b.path;
+  });
+
+  return files;
+}
+
+/**
+ * Loads a license key file in the same way as load_license_key_files(), but
+ * reads the file into a buffer instead of mapping it. Unlike a mapping, this
+ * is safe if the file may be truncated by another process while it is being
+ * loaded, as for files being watched for changes.
+ *
+ * See make_license_keys() regarding the Instrumentation used.
+ */
+template<typename Configuration>
+optional<LicenseKey>
+basic_Cryptolens<Configuration>::load_license_key_file(basic_Error & e, std::string const& path)
+{
+  if (e) { return nullopt; }
+
+  std::string contents = internal::read_file(e, path);
+  if (e) { return nullopt; }
 
-  raw_license_key =
-    ::cryptolens_io::v20190401::internal::handle_activate(e, this->response_parser, this->signature_verifier, s);
+  typename internal::configuration_instrumentation<Configuration>::type instrumentation(e);
+  return make_license_key_file_(e, instrumentation, contents);
+}
 
-  if (e) {
-    e.reset(api::main());
+/**
+ * Sets the Executor used by this handle for the CPU bound parts of batch and
+ * asynchronous calls. The executor must outlive the handle.
+ */
+template<typename Configuration>
+void
+basic_Cryptolens<Configuration>::set_executor(basic_Error & e, Executor & executor)
+{
+  if (e) { return; }
 
-    size_t k = s.find('-');
-    if (k == std::string::npos) { e.set(api::main(), errors::Subsystem::Main, errors::Main::UNKNOWN_SERVER_REPLY); return nullopt; }
+  executor_ = &executor;
+}
 
-    std::string version = s.substr(0, k);
-    std::string rem = s.substr(k+1, std::string::npos);
-    // NOTE: s.substr(s.size(), _) returns empty string, thus the previous line does never throw
+/**
+ * Returns the Executor used by this handle, see set_executor().
+ */
+template<typename Configuration>
+Executor &
+basic_Cryptolens<Configuration>::get_executor()
+{
+  return executor_ ? *executor_ : default_executor();
+}
 
-    k = rem.find('-');
-    if (k == std::string::npos) { e.set(api::main(), errors::Subsystem::Main, errors::Main::UNKNOWN_SERVER_REPLY); return nullopt; }
+template<typename Configuration>
+template<typename Instrumentation>
+optional<LicenseKey>
+basic_Cryptolens<Configuration>::make_license_key_(basic_Error & e, Instrumentation & instrumentation_, std::string const& s)
+{
+  if (e) { return nullopt; }
 
-    std::string license = rem.substr(0, k);
-    std::string signature = rem.substr(k+1, std::string::npos); // k+1 is fine, see comment above
+  optional<RawLicenseKey> raw_license_key;
 
+  if (internal::is_json_object(s)) {
     raw_license_key =
-        RawLicenseKey::make
-             ( e
-             , signature_verifier
-             , license
-             , signature
-             );
+      ::cryptolens_io::v20190401::internal::handle_activate(e, instrumentation_, this->response_parser, this->signature_verifier, s);
+  } else {
+    raw_license_key = make_raw_license_key_saved_(e, instrumentation_, s);
   }
 
+  return make_license_key_(e, instrumentation_, std::move(raw_license_key));
+}
+
+template<typename Configuration>
+template<typename Instrumentation>
+optional<LicenseKey>
+basic_Cryptolens<Configuration>::make_license_key_(basic_Error & e, Instrumentation & instrumentation_, optional<RawLicenseKey> raw_license_key)
+{
+  instrumentation_.stage_begin(instrumentation::Stage::MAKE_LICENSE_KEY_INFORMATION);
   optional<LicenseKeyInformation> license_key_information = response_parser.make_license_key_information(e, raw_license_key);
+  instrumentation_.stage_end(instrumentation::Stage::MAKE_LICENSE_KEY_INFORMATION);
   if (e) { e.set_call(api::main(), errors::Call::BASIC_SKM_MAKE_LICENSE_KEY); return nullopt; }
   return LicenseKey(std::move(*license_key_information), std::move(*raw_license_key));
 }
 
+/*
+ * Makes a LicenseKey from the contents of a file written using
+ * LicenseKey::to_string() or holding an activate response.
+ */
+template<typename Configuration>
+template<typename Instrumentation>
+optional<LicenseKey>
+basic_Cryptolens<Configuration>::make_license_key_file_(basic_Error & e, Instrumentation & instrumentation_, StringView s)
+{
+  if (e) { return nullopt; }
+
+  s = internal::trim_right(s);
+  if (internal::is_json_object(s)) {
+    return make_license_key_(e, instrumentation_, s.to_string());
+  }
+
+  return make_license_key_(e, instrumentation_, make_raw_license_key_saved_(e, instrumentation_, s));
+}
+
+/*
+ * Makes a RawLicenseKey from the "<version>-<base64 license>-<signature>"
+ * format written by LicenseKey::to_string().
+ */
+template<typename Configuration>
+template<typename Instrumentation>
+optional<RawLicenseKey>
+basic_Cryptolens<Configuration>::make_raw_license_key_saved_(basic_Error & e, Instrumentation & instrumentation_, StringView s)
+{
+  if (e) { return nullopt; }
+
+  char const* begin = s.data();
+  char const* end = begin + s.size();
+
+  char const* k = std::find(begin, end, '-');
+  char const* l = k == end ? end : std::find(k + 1, end, '-');
+  if (l == end) { e.set(api::main(), errors::Subsystem::Main, errors::Main::UNKNOWN_SERVER_REPLY); return nullopt; }
+
+  return
+    RawLicenseKey::make
+      ( e
+      , instrumentation_
+      , signature_verifier
+      , std::string(k + 1, l)
+      , std::string(l + 1, end)
+      );
+}
+
+#ifdef CRYPTOLENS_HAS_COROUTINES
+/**
+ * Asynchronous version of activate(), which does not block the calling
+ * thread while waiting for the response from the Web API. For example:
+ *
+ *     cryptolens_io::latest::Task<void> check_license(Cryptolens & cryptolens_handle, ResumeExecutor executor)
+ *     {
+ *       cryptolens_io::latest::Error e;
+ *       auto license_key = co_await cryptolens_handle.activate_async(executor, e, token, 3646, key);
+ *       ...
+ *     }
+ *
+ * The executor is any copyable function object which takes a function object
+ * without arguments and arranges for it to be called, e.g. on a thread pool
+ * or an event loop. Once the response has arrived, it is parsed and its
+ * signature verified on the Executor of this handle (see set_executor()),
+ * after which the coroutine is resumed through the executor. The executor
+ * should not call the function object before returning, since it may be
+ * called from a thread of the library. If the RequestHandler cannot make
+ * requests without blocking, the request is made on a separate thread, so
+ * that neither executor is held up while waiting for the response. With
+ * Boost.Asio, a suitable executor is
+ *
+ *     [ex = io_context.get_executor()](auto f) { boost::asio::post(ex, std::move(f)); }
+ *
+ * The arguments and result are the same as for activate(). The error object
+ * must be kept alive until the Task has finished, and at most one request at
+ * a time may be in progress on each handle.
+ *
+ * NOTE: Asynchronous requests are made as a single attempt using the
+ *       timeouts of the RequestPolicy, i.e. failed requests are not retried
+ *       or hedged.
+ */
+template<typename Configuration>
+template<typename ResumeExecutor>
+Task<optional<LicenseKey>>
+basic_Cryptolens<Configuration>::activate_async
+  ( ResumeExecutor executor
+  , basic_Error & e
+  , std::string token
+  , int product_id
+  , std::string key
+  , int fields_to_return
+  )
+{
+  return activate_async_(std::move(executor), e, std::move(token), product_id, std::move(key), false, 0, fields_to_return);
+}
+
+/**
+ * Asynchronous version of activate_floating(), see activate_async().
+ */
+template<typename Configuration>
+template<typename ResumeExecutor>
+Task<optional<LicenseKey>>
+basic_Cryptolens<Configuration>::activate_floating_async
+  ( ResumeExecutor executor
+  , basic_Error & e
+  , std::string token
+  , int product_id
+  , std::string key
+  , long floating_time_interval
+  , int fields_to_return
+  )
+{
+  return activate_async_(std::move(executor), e, std::move(token), product_id, std::move(key), true, floating_time_interval, fields_to_return);
+}
+
+/**
+ * Asynchronous version of deactivate(), see activate_async().
+ */
+template<typename Configuration>
+template<typename ResumeExecutor>
+Task<void>
+basic_Cryptolens<Configuration>::deactivate_async
+  ( ResumeExecutor executor
+  , basic_Error & e
+  , std::string token
+  , int product_id
+  , std::string key
+  , bool floating
+  )
+{
+  if (e) { co_return; }
+
+  std::string machine_code = machine_code_computer.get_machine_code(e);
+
+  this->instrumentation.stage_begin(instrumentation::Stage::REQUEST);
+
+  auto request = request_handler.post_request(e, base_url_.c_str(), "/api/key/Deactivate");
+
+  std::ostringstream product_id_; product_id_ << product_id;
+  std::ostringstream floating_; floating_ << floating;
+
+  request.add_argument(e, "token"       , token.c_str())
+         .add_argument(e, "ProductId"   , product_id_.str().c_str())
+         .add_argument(e, "Key"         , key.c_str())
+         .add_argument(e, "MachineCode" , machine_code.c_str())
+         .add_argument(e, "Floating"    , floating_.str().c_str())
+         .add_argument(e, "v"           , "1");
+
+  std::string response = co_await internal::make_request_async(e, request, executor);
+
+  this->instrumentation.stage_end(instrumentation::Stage::REQUEST);
+  this->instrumentation.request_finished(request_handler);
+
+  response_parser.parse_deactivate_response(e, response);
+  if (e) { e.set_call(api::main(), errors::Call::BASIC_SKM_DEACTIVATE); }
+}
+
+template<typename Configuration>
+template<typename ResumeExecutor>
+Task<optional<LicenseKey>>
+basic_Cryptolens<Configuration>::activate_async_
+  ( ResumeExecutor executor
+  , basic_Error & e
+  , std::string token
+  , int product_id
+  , std::string key
+  , bool floating
+  , long floating_time_interval
+  , int fields_to_return
+  )
+{
+  if (e) { co_return nullopt; }
+
+  int call = floating ? errors::Call::BASIC_SKM_ACTIVATE_FLOATING : errors::Call::BASIC_SKM_ACTIVATE;
+
+  using namespace instrumentation;
+  internal::ActivationInstrumentationScope<decltype(this->instrumentation)> scope(this->instrumentation, e);
+
+  std::string machine_code = machine_code_computer.get_machine_code(e);
+
+  this->instrumentation.stage_begin(Stage::REQUEST);
+
+  auto request = request_handler.post_request(e, base_url_.c_str(), "/api/key/Activate");
+
+  std::ostringstream product_id_; product_id_ << product_id;
+  std::ostringstream fields_to_return_; fields_to_return_ << fields_to_return;
+
+  request.add_argument(e, "token"         , token.c_str())
+         .add_argument(e, "ProductId"     , product_id_.str().c_str())
+         .add_argument(e, "Key"           , key.c_str())
+         .add_argument(e, "Sign"          , "true")
+         .add_argument(e, "MachineCode"   , machine_code.c_str())
+         .add_argument(e, "FieldsToReturn", fields_to_return_.str().c_str())
+         .add_argument(e, "SignMethod"    , "1")
+         .add_argument(e, "v"             , "1");
+
+  if (floating) {
+    std::ostringstream floating_time_interval_; floating_time_interval_ << floating_time_interval;
+    request.add_argument(e, "FloatingTimeInterval", floating_time_interval_.str().c_str());
+  }
+
+  // The CPU bound stages run on the Executor of this handle, rather than
+  // holding up the executor of the caller
+  Executor * cpu_executor = &get_executor();
+  auto cpu_executor_ = [cpu_executor](std::function<void()> f) { cpu_executor->execute(std::move(f)); };
+
+  std::string response = co_await internal::make_request_async(e, request, cpu_executor_);
+
+  this->instrumentation.stage_end(Stage::REQUEST);
+  this->instrumentation.request_finished(request_handler);
+
+  optional<RawLicenseKey> x = internal::handle_activate(e, this->instrumentation, this->response_parser, this->signature_verifier, response);
+
+  this->instrumentation.stage_begin(Stage::MAKE_LICENSE_KEY_INFORMATION);
+  optional<LicenseKeyInformation> y = response_parser.make_license_key_information(e, x);
+  this->instrumentation.stage_end(Stage::MAKE_LICENSE_KEY_INFORMATION);
+
+  if (!e) {
+    typename internal::ActivateEnvironment env(*y, product_id, key, machine_code, fields_to_return, floating);
+    this->instrumentation.stage_begin(Stage::VALIDATE);
+    activate_validator.validate(e, env);
+    this->instrumentation.stage_end(Stage::VALIDATE);
+  }
+
+  co_await internal::schedule(executor);
+
+  if (e) { e.set_call(api::main(), call); co_return nullopt; }
+
+  co_return LicenseKey(std::move(*y), std::move(*x));
+}
+#endif /* CRYPTOLENS_HAS_COROUTINES */
+
 namespace internal {
 
 template<typename ResponseParser, typename SignatureVerifier>
@@ -741,17 +1494,37 @@ handle_activate
   , SignatureVerifier const& signature_verifier
   , std::string const& response
   )
+{
+  Instrumentation_none instrumentation(e);
+  return handle_activate(e, instrumentation, response_parser, signature_verifier, response);
+}
+
+template<typename Instrumentation, typename ResponseParser, typename SignatureVerifier>
+optional<RawLicenseKey>
+handle_activate
+  ( basic_Error & e
+  , Instrumentation & instrumentation
+  , ResponseParser const& response_parser
+  , SignatureVerifier const& signature_verifier
+  , std::string const& response
+  )
 {
   if (e) { return nullopt; }
 
+  using namespace ::cryptolens_io::v20190401::instrumentation;
+  InstrumentationScope<Instrumentation> scope(instrumentation, Stage::HANDLE_ACTIVATE);
+
+  instrumentation.stage_begin(Stage::PARSE_ACTIVATE_RESPONSE);
   optional<std::pair<std::string, std::string>> x = response_parser.parse_activate_response(e, response);
+  instrumentation.stage_end(Stage::PARSE_ACTIVATE_RESPONSE);
   if (e) { return nullopt; }
 
   return RawLicenseKey::make
            ( e
+           , instrumentation
            , signature_verifier
-           , x->first
-           , x->second
+           , std::move(x->first)
+           , std::move(x->second)
            );
 }
 
@@ -2,7 +2,13 @@
 
 #include <stdlib.h>
 
+#include <string>
+#include <type_traits>
+
+#include <cryptolens/cryptolens_config.hpp>
+
 #include "api.hpp"
+#include "cryptolens_internals.hpp"
 
 namespace cryptolens_io {
 
@@ -22,6 +28,9 @@ int constexpr Json = 2;
 int constexpr Base64 = 3;
 int constexpr RequestHandler = 4;
 int constexpr SignatureVerifier = 5;
+int constexpr Executor = 6;
+int constexpr Binary = 7;
+int constexpr File = 8;
 
 } // namespace Subsystem
 
@@ -60,6 +69,12 @@ int constexpr BASIC_CRYPTOLENS_CREATE_TRIAL_KEY = BASIC_SKM_CREATE_TRIAL_KEY;
 int constexpr BASIC_SKM_DEACTIVATE = 10;
 int constexpr BASIC_CRYPTOLENS_DEACTIVATE = BASIC_SKM_ACTIVATE;
 
+int constexpr BASIC_SKM_INCREMENT_INT_VALUE = 11;
+int constexpr BASIC_CRYPTOLENS_INCREMENT_INT_VALUE = BASIC_SKM_INCREMENT_INT_VALUE;
+
+int constexpr BASIC_SKM_GET_MESSAGES = 12;
+int constexpr BASIC_CRYPTOLENS_GET_MESSAGES = BASIC_SKM_GET_MESSAGES;
+
 } // namespace Call
 
 // Errors for the Main subsystem
@@ -79,6 +94,20 @@ constexpr int KEY_EXPIRED               = 9;
 
 } // namespace errors
 
+#ifndef CRYPTOLENS_CONFIG_NONVIRTUAL_ERROR
+#error "cryptolens_config.hpp does not set CRYPTOLENS_CONFIG_NONVIRTUAL_ERROR"
+#endif
+
+#ifdef CRYPTOLENS_NONVIRTUAL_ERROR
+#error "CRYPTOLENS_NONVIRTUAL_ERROR is a CMake option, not a macro; it is read from cryptolens_config.hpp"
+#endif
+
+#if CRYPTOLENS_CONFIG_NONVIRTUAL_ERROR
+#define CRYPTOLENS_ERROR_VIRTUAL
+#else
+#define CRYPTOLENS_ERROR_VIRTUAL virtual
+#endif
+
 /**
  * This error is used by all methods in this library that can fail.
  *
@@ -89,6 +118,15 @@ constexpr int KEY_EXPIRED               = 9;
  *     Maybe add a user version of this tracking too.
  *   - Summary information about the error
  *   - Detailed information for debugging
+ *
+ * The methods of this class are virtual, so applications can derive from it
+ * and override them. Applications which do not need this can configure the
+ * library with the CMake option CRYPTOLENS_NONVIRTUAL_ERROR, which removes
+ * the vtable and allows the methods to be inlined. Overrides in derived
+ * classes are then ignored by the library. Since this changes the layout of
+ * the class, the option is written to the generated cryptolens_config.hpp
+ * rather than passed as a definition, so the library and all code using it
+ * see the same class.
  */
 class basic_Error {
 private:
@@ -96,6 +134,7 @@ private:
   int    subsystem_;
   int    reason_;
   size_t extra_;
+  std::string server_message_;
 public:
   basic_Error(): call_(0), subsystem_(errors::Subsystem::Ok), reason_(0), extra_(0) { }
   basic_Error(basic_Error const& e) = delete;
@@ -109,9 +148,26 @@ public:
    */
   explicit operator bool() const { return subsystem_ != errors::Subsystem::Ok; }
 
-  virtual int get_subsystem(api::main api) const noexcept { return subsystem_; }
-  virtual int get_reason(api::main api) const noexcept { return reason_; }
-  virtual size_t get_extra(api::main api) const noexcept { return extra_; }
+  CRYPTOLENS_ERROR_VIRTUAL int get_subsystem(api::main api) const noexcept { return subsystem_; }
+  CRYPTOLENS_ERROR_VIRTUAL int get_reason(api::main api) const noexcept { return reason_; }
+  CRYPTOLENS_ERROR_VIRTUAL size_t get_extra(api::main api) const noexcept { return extra_; }
+
+  /**
+   * Returns the error message sent by the Web API if the error was caused by
+   * the server rejecting a request, and an empty string otherwise.
+   *
+   * Messages which map to a known reason in the Main subsystem are not
+   * stored, their text is instead recovered from the reason. Other messages,
+   * reported as UNKNOWN_SERVER_REPLY, are kept as sent by the server.
+   */
+  CRYPTOLENS_ERROR_VIRTUAL char const* get_server_message(api::main api) const noexcept
+  {
+    if (!server_message_.empty()) { return server_message_.c_str(); }
+    if (subsystem_ != errors::Subsystem::Main) { return ""; }
+
+    char const* message = internal::activate_server_error_message(reason_);
+    return message ? message : "";
+  }
 
   /**
    * Can be used to reset the Error object to the initial state.
@@ -119,14 +175,30 @@ public:
    * Can be used for reusing the same Error object after an error
    * has occured.
    */
-  virtual void reset(api::main api) { subsystem_ = errors::Subsystem::Ok; reason_ = 0; extra_ = 0; }
+  CRYPTOLENS_ERROR_VIRTUAL void reset(api::main api) { subsystem_ = errors::Subsystem::Ok; reason_ = 0; extra_ = 0; server_message_.clear(); }
 
-  virtual void set(api::main api, int subsystem) { subsystem_ = subsystem; }
-  virtual void set(api::main api, int subsystem, int reason) { subsystem_ = subsystem; reason_ = reason; }
-  virtual void set(api::main api, int subsystem, int reason, size_t extra) { subsystem_ = subsystem; reason_ = reason; extra_ = extra; }
-  virtual void set_call(api::main api, int call) { call_ = call; }
+  CRYPTOLENS_ERROR_VIRTUAL void set(api::main api, int subsystem) { subsystem_ = subsystem; server_message_.clear(); }
+  CRYPTOLENS_ERROR_VIRTUAL void set(api::main api, int subsystem, int reason) { subsystem_ = subsystem; reason_ = reason; server_message_.clear(); }
+  CRYPTOLENS_ERROR_VIRTUAL void set(api::main api, int subsystem, int reason, size_t extra) { subsystem_ = subsystem; reason_ = reason; extra_ = extra; server_message_.clear(); }
+
+  /**
+   * Sets this object to the same error as another one, including the
+   * message sent by the server. Since Error objects cannot be copied, this
+   * is used to hand an error over to another object.
+   */
+  CRYPTOLENS_ERROR_VIRTUAL void set(api::main api, basic_Error const& error)
+  {
+    set(api, error.get_subsystem(api), error.get_reason(api), error.get_extra(api));
+    server_message_ = error.server_message_;
+  }
+
+  CRYPTOLENS_ERROR_VIRTUAL void set_call(api::main api, int call) { call_ = call; }
+  CRYPTOLENS_ERROR_VIRTUAL void set_server_message(api::main api, char const* message) { server_message_ = message ? message : ""; }
 };
 
+static_assert(std::is_polymorphic<basic_Error>::value == !CRYPTOLENS_CONFIG_NONVIRTUAL_ERROR,
+              "basic_Error does not match CRYPTOLENS_CONFIG_NONVIRTUAL_ERROR in cryptolens_config.hpp");
+
 } // namespace v20190401
 
 namespace v20180502 {
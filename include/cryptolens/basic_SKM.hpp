@@ -1,9 +1,9 @@
 #pragma once
 
+#include <cstdio>
 #include <cstring>
 #include <string>
-#include <sstream>
-#include <unordered_map>
+#include <utility>
 
 #include "imports/std/optional"
 
@@ -312,18 +312,19 @@ basic_SKM<RequestHandler, SignatureVerifier>::activate_
 {
   if (e) { return nullopt; }
 
-  std::unordered_map<std::string,std::string> args;
-  args["token"] = token;
-  args["ProductId"] = product_id;
-  args["Key"] = key;
-  args["Sign"] = "true";
-  args["MachineCode"] = machine_code;
-  // Fix since to_string is not available everywhere
-  //args["FieldsToReturn"] = std::to_string(fields_to_return);
-  std::ostringstream stm; stm << fields_to_return;
-  args["FieldsToReturn"] = stm.str();
-  args["SignMethod"] = "1";
-  args["v"] = "1";
+  char fields_to_return_[16];
+  std::snprintf(fields_to_return_, sizeof(fields_to_return_), "%d", fields_to_return);
+
+  std::pair<char const*, char const*> const args[] =
+    { { "token"         , token.c_str()        }
+    , { "ProductId"     , product_id.c_str()   }
+    , { "Key"           , key.c_str()          }
+    , { "Sign"          , "true"               }
+    , { "MachineCode"   , machine_code.c_str() }
+    , { "FieldsToReturn", fields_to_return_    }
+    , { "SignMethod"    , "1"                  }
+    , { "v"             , "1"                  }
+    };
 
   std::string response = request_handler.make_request(e, "Activate", args);
 
@@ -344,20 +345,22 @@ basic_SKM<RequestHandler, SignatureVerifier>::activate_floating_
 {
   if (e) { return nullopt; }
 
-  std::unordered_map<std::string,std::string> args;
-  args["token"] = token;
-  args["ProductId"] = product_id;
-  args["Key"] = key;
-  args["Sign"] = "true";
-  args["MachineCode"] = machine_code;
-  // Fix since to_string is not available everywhere
-  //args["FieldsToReturn"] = std::to_string(fields_to_return);
-  std::ostringstream stm; stm << fields_to_return;
-  args["FieldsToReturn"] = stm.str();
-  args["SignMethod"] = "1";
-  args["v"] = "1";
-  stm.str(""); stm.clear(); stm << floating_time_interval;
-  args["FloatingTimeInterval"] = stm.str();
+  char fields_to_return_[16];
+  std::snprintf(fields_to_return_, sizeof(fields_to_return_), "%d", fields_to_return);
+  char floating_time_interval_[24];
+  std::snprintf(floating_time_interval_, sizeof(floating_time_interval_), "%ld", floating_time_interval);
+
+  std::pair<char const*, char const*> const args[] =
+    { { "token"               , token.c_str()           }
+    , { "ProductId"           , product_id.c_str()      }
+    , { "Key"                 , key.c_str()             }
+    , { "Sign"                , "true"                  }
+    , { "MachineCode"         , machine_code.c_str()    }
+    , { "FieldsToReturn"      , fields_to_return_       }
+    , { "SignMethod"          , "1"                     }
+    , { "v"                   , "1"                     }
+    , { "FloatingTimeInterval", floating_time_interval_ }
+    };
 
   std::string response = request_handler.make_request(e, "Activate", args);
 
@@ -469,8 +472,7 @@ handle_activate
       return nullopt;
     }
 
-    int reason = activate_parse_server_error_message(j["message"].as<char const*>());
-    e.set(api, Subsystem::Main, reason);
+    ::cryptolens_io::v20190401::internal::activate_set_server_error(e, j["message"].as<char const*>());
     return nullopt;
   }
 
@@ -2,6 +2,7 @@
 
 #include "ActivateError.hpp"
 #include "ActivationData.hpp"
+#include "ActivationDataTable.hpp"
 #include "api.hpp"
 #include "basic_Error.hpp"
 #include "basic_Cryptolens.hpp"
@@ -9,6 +10,8 @@
 #include "Customer.hpp"
 #include "DataObject.hpp"
 #include "LicenseKeyChecker.hpp"
+#include "LicenseKeyFile.hpp"
 #include "LicenseKey.hpp"
 #include "LicenseKeyInformation.hpp"
+#include "LicenseKeyView.hpp"
 #include "RawLicenseKey.hpp"
@@ -2,10 +2,16 @@ namespace cryptolens_io {
 
 namespace v20190401 {
 
+class basic_Error;
+
 namespace internal {
 
 int activate_parse_server_error_message(char const* server_response);
 
+char const* activate_server_error_message(int reason);
+
+void activate_set_server_error(basic_Error & e, char const* server_response);
+
 } // namespace internal
 
 } // namespace v20190401
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#include "../api.hpp"
+#include "../basic_Error.hpp"
+#include "../Clock.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+/**
+ * Checks that the license key has not expired, reading the current time from
+ * the Clock policy class, e.g. Clock_ctime or Clock_coarse.
+ */
+template<typename Env, typename Clock>
+class NotExpiredValidator_ {
+public:
+#ifndef CRYPTOLENS_20190701_ALLOW_IMPLICIT_CONSTRUCTORS
+  explicit
+#endif
+  NotExpiredValidator_(basic_Error & e) {}
+
+  void validate(basic_Error & e, Env & env) {
+    std::uint64_t expires = env.get_license_key_information().get_expires();
+
+    std::int64_t current = Clock::now();
+    if (current < 0 || expires < (std::uint64_t)current) {
+      using namespace errors;
+      e.set(api::main(), Subsystem::Main, Main::KEY_EXPIRED);
+    }
+  }
+};
+
+} // namespace v20190401
+
+namespace latest {
+
+template<typename Env, typename Clock>
+using NotExpiredValidator_ = ::cryptolens_io::v20190401::NotExpiredValidator_<Env, Clock>;
+
+} // namespace latest
+
+} // namespace cryptolens_io
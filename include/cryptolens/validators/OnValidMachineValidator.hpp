@@ -22,7 +22,7 @@ public:
     auto const& expected_machine_code = env.get_machine_code();
     bool floating = env.get_floating();
 
-    auto const& machines = license_key_information.get_activated_machines();
+    auto const& machines = license_key_information.get_activated_machines_table();
     auto const& maxnoofmachines = license_key_information.get_maxnoofmachines();
     bool valid = (maxnoofmachines && *maxnoofmachines == 0)
 	      || !machines;
@@ -31,11 +31,8 @@ public:
       if (floating) { full_expected_machine_code += "floating:"; }
       full_expected_machine_code += expected_machine_code;
 
-      for (auto const& m : *machines) {
-        if (m.get_mid() == full_expected_machine_code) {
-          valid = true;
-          break;
-        }
+      if (machines->find_mid(full_expected_machine_code)) {
+        valid = true;
       }
     }
 
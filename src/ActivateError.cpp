@@ -1,6 +1,5 @@
-#include <cstring>
-
 #include "ActivateError.hpp"
+#include "cryptolens_internals.hpp"
 
 namespace cryptolens_io {
 
@@ -19,36 +18,9 @@ ActivateError::from_reason(int reason)
 ActivateError
 ActivateError::from_server_response(char const* server_response)
 {
-  int reason = UNKNOWN_SERVER_REPLY;
-  if (server_response == NULL) { return ActivateError(reason); }
-
-  if (0 == std::strcmp(server_response, "Unable to authenticate.")) {
-    reason = INVALID_ACCESS_TOKEN;
-  }
-
-  if (0 == std::strcmp(server_response, "Access denied.")) {
-    reason = ACCESS_DENIED;
-  }
-
-  if (0 == std::strcmp(server_response, "The input parameters were incorrect.")) {
-    reason = INCORRECT_INPUT_PARAMETER;
-  }
-
-  if (0 == std::strcmp(server_response, "Could not find the product.")) {
-    reason = PRODUCT_NOT_FOUND;
-  }
-
-  if (0 == std::strcmp(server_response, "Could not find the key.")) {
-    reason = KEY_NOT_FOUND;
-  }
-
-  if (0 == std::strcmp(server_response, "The key is blocked and cannot be accessed.")) {
-    reason = KEY_BLOCKED;
-  }
-
-  if (0 == std::strcmp(server_response, "Cannot activate the new device as the limit has been reached.")) {
-    reason = DEVICE_LIMIT_REACHED;
-  }
+  // The reasons of this class are the same as those in errors::Main,
+  // shifted down by one.
+  int reason = internal::activate_parse_server_error_message(server_response) - 1;
 
   return ActivateError(reason);
 }
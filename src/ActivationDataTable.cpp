@@ -0,0 +1,308 @@
+#include <cstdio>
+#include <cstring>
+
+#include "ActivationDataTable.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace internal {
+
+namespace {
+
+int
+hex_digit(char c)
+{
+  if ('0' <= c && c <= '9') { return c - '0'; }
+  if ('a' <= c && c <= 'f') { return c - 'a' + 10; }
+  if ('A' <= c && c <= 'F') { return c - 'A' + 10; }
+  return -1;
+}
+
+/*
+ * Parses an IPv4 address in dotted decimal, as formatted by ip_format(),
+ * thus without leading zeros.
+ */
+bool
+ipv4_parse(StringView ip, unsigned char (&bytes)[16])
+{
+  size_t i = 0;
+  for (int part = 0; part < 4; ++part) {
+    if (part > 0) {
+      if (i == ip.size() || ip[i] != '.') { return false; }
+      ++i;
+    }
+
+    unsigned value = 0;
+    size_t digits = 0;
+    for (; i < ip.size() && '0' <= ip[i] && ip[i] <= '9' && digits < 3; ++i, ++digits) {
+      value = 10 * value + (ip[i] - '0');
+    }
+    if (digits == 0 || value > 255) { return false; }
+    if (digits > 1 && ip[i - digits] == '0') { return false; }
+
+    bytes[12 + part] = (unsigned char)value;
+  }
+
+  if (i != ip.size()) { return false; }
+
+  std::memset(bytes, 0, 10);
+  bytes[10] = 0xff;
+  bytes[11] = 0xff;
+  return true;
+}
+
+/*
+ * Parses an IPv6 address in the form recommended by RFC 5952, as formatted
+ * by ip_format(). Other ways of writing the same address are rejected.
+ */
+bool
+ipv6_parse(StringView ip, unsigned char (&bytes)[16])
+{
+  unsigned groups[8];
+  size_t n = 0;
+  size_t gap = 8; // Index in groups where "::" was seen, if any
+
+  size_t i = 0;
+  if (ip.size() >= 2 && ip[0] == ':' && ip[1] == ':') {
+    gap = 0;
+    i = 2;
+  }
+
+  while (i < ip.size()) {
+    unsigned value = 0;
+    size_t digits = 0;
+    for (; i < ip.size() && hex_digit(ip[i]) >= 0 && digits < 4; ++i, ++digits) {
+      if ('A' <= ip[i] && ip[i] <= 'F') { return false; }
+      value = 16 * value + hex_digit(ip[i]);
+    }
+    if (digits == 0 || n == 8) { return false; }
+    if (digits > 1 && ip[i - digits] == '0') { return false; }
+    groups[n++] = value;
+
+    if (i == ip.size()) { break; }
+    if (ip[i] != ':') { return false; }
+    ++i;
+
+    if (i < ip.size() && ip[i] == ':') {
+      // "::" stands for at least two groups
+      if (gap != 8 || n > 6) { return false; }
+      gap = n;
+      ++i;
+    } else if (i == ip.size()) {
+      return false;
+    }
+  }
+
+  if (gap == 8 ? n != 8 : n > 6) { return false; }
+
+  // "::" stands for the first longest run of at least two zero groups, thus
+  // it is not next to a zero group, and a run of zero groups which is
+  // written out is shorter, or as long if it comes after it
+  size_t compressed = gap == 8 ? 0 : 8 - n;
+  if (gap != 8 && ((gap > 0 && groups[gap - 1] == 0) || (gap < n && groups[gap] == 0))) { return false; }
+
+  for (size_t k = 0; k < n; ) {
+    if (groups[k] != 0) { ++k; continue; }
+
+    size_t j = k;
+    while (j < n && groups[j] == 0) { ++j; }
+    if (j - k >= 2 && (j - k > compressed || (j - k == compressed && k < gap))) { return false; }
+    k = j;
+  }
+
+  std::memset(bytes, 0, 16);
+  size_t tail = gap == 8 ? 0 : n - gap;
+  for (size_t k = 0; k < n; ++k) {
+    size_t j = k < n - tail ? k : 8 - (n - k);
+    bytes[2*j] = (unsigned char)(groups[k] >> 8);
+    bytes[2*j + 1] = (unsigned char)(groups[k] & 0xff);
+  }
+
+  return true;
+}
+
+} // namespace
+
+int
+ip_parse(StringView ip, unsigned char (&bytes)[16])
+{
+  if (ipv4_parse(ip, bytes)) { return IP_V4; }
+  if (ipv6_parse(ip, bytes)) { return IP_V6; }
+  return IP_TEXT;
+}
+
+/*
+ * Formats IPv4 addresses in dotted decimal and IPv6 addresses as
+ * recommended in RFC 5952, i.e. in lower case without leading zeros and
+ * with the first longest run of at least two zero groups replaced by "::"
+ */
+std::string
+ip_format(int kind, unsigned char const* bytes)
+{
+  char buffer[48];
+
+  if (kind == IP_V4) {
+    std::snprintf(buffer, sizeof(buffer), "%u.%u.%u.%u", bytes[12], bytes[13], bytes[14], bytes[15]);
+    return buffer;
+  }
+
+  unsigned groups[8];
+  for (int j = 0; j < 8; ++j) { groups[j] = (bytes[2*j] << 8) | bytes[2*j + 1]; }
+
+  int best = -1, best_length = 1;
+  for (int j = 0; j < 8; ) {
+    if (groups[j] != 0) { ++j; continue; }
+
+    int k = j;
+    while (k < 8 && groups[k] == 0) { ++k; }
+    if (k - j > best_length) { best = j; best_length = k - j; }
+    j = k;
+  }
+
+  std::string result;
+  for (int j = 0; j < 8; ++j) {
+    if (j == best) {
+      result += "::";
+      j += best_length - 1;
+      continue;
+    }
+
+    if (!result.empty() && result[result.size() - 1] != ':') { result += ':'; }
+    std::snprintf(buffer, sizeof(buffer), "%x", groups[j]);
+    result += buffer;
+  }
+
+  return result;
+}
+
+} // namespace internal
+
+std::string
+ActivationDataRef::get_ip() const
+{
+  if (ip_kind_ == internal::IP_TEXT) { return ip_text_.to_string(); }
+
+  return internal::ip_format(ip_kind_, ip_bytes_);
+}
+
+template<typename Allocator>
+basic_ActivationDataTable<Allocator>::basic_ActivationDataTable(Allocator const& allocator)
+: mids_(allocator)
+, mid_offsets_(1, 0, allocator)
+, ips_(allocator)
+, ip_kinds_(allocator)
+, ip_texts_(allocator)
+, times_(allocator)
+{}
+
+/**
+ * Reserves space for a number of machines whose machine ids are mid_bytes
+ * long in total.
+ */
+template<typename Allocator>
+void
+basic_ActivationDataTable<Allocator>::reserve(size_t machines, size_t mid_bytes)
+{
+  mids_.reserve(mid_bytes);
+  mid_offsets_.reserve(machines + 1);
+  ips_.reserve(machines);
+  ip_kinds_.reserve(machines);
+  times_.reserve(machines);
+}
+
+/**
+ * Adds a machine to the end of the table. If ip is an IPv4 or IPv6 address
+ * it is stored as 16 bytes, otherwise it is stored as it is.
+ */
+template<typename Allocator>
+void
+basic_ActivationDataTable<Allocator>::push_back(StringView mid, StringView ip, std::uint64_t time)
+{
+  mids_.append(mid.data(), mid.size());
+  mid_offsets_.push_back((std::uint32_t)mids_.size());
+
+  IPBytes b;
+  int kind = internal::ip_parse(ip, b.bytes);
+  if (kind == internal::IP_TEXT) {
+    std::uint64_t offset = ip_texts_.size();
+    std::uint64_t length = ip.size();
+    std::memcpy(b.bytes, &offset, 8);
+    std::memcpy(b.bytes + 8, &length, 8);
+    ip_texts_.append(ip.data(), ip.size());
+  }
+
+  ips_.push_back(b);
+  ip_kinds_.push_back((unsigned char)kind);
+  times_.push_back(time);
+}
+
+template<typename Allocator>
+ActivationDataRef
+basic_ActivationDataTable<Allocator>::operator[](size_t i) const
+{
+  int kind = ip_kinds_[i];
+  unsigned char const* bytes = ips_[i].bytes;
+
+  StringView ip_text;
+  if (kind == internal::IP_TEXT) {
+    std::uint64_t offset, length;
+    std::memcpy(&offset, bytes, 8);
+    std::memcpy(&length, bytes + 8, 8);
+    ip_text = StringView(ip_texts_.data() + offset, (size_t)length);
+  }
+
+  StringView mid(mids_.data() + mid_offsets_[i], mid_offsets_[i+1] - mid_offsets_[i]);
+
+  return ActivationDataRef(mid, kind, bytes, ip_text, times_[i]);
+}
+
+/**
+ * Returns the index of the first machine with the given machine id, if any.
+ */
+template<typename Allocator>
+optional<size_t>
+basic_ActivationDataTable<Allocator>::find_mid(StringView mid) const
+{
+  char const* mids = mids_.data();
+  for (size_t i = 0; i < size(); ++i) {
+    std::uint32_t begin = mid_offsets_[i];
+    if (mid_offsets_[i+1] - begin == mid.size() && std::memcmp(mids + begin, mid.data(), mid.size()) == 0) {
+      return i;
+    }
+  }
+
+  return nullopt;
+}
+
+/**
+ * Returns the machines as ActivationData objects, using the allocator of the
+ * table.
+ */
+template<typename Allocator>
+typename basic_ActivationDataTable<Allocator>::ActivationDataList
+basic_ActivationDataTable<Allocator>::to_list() const
+{
+  Allocator allocator = get_allocator();
+
+  ActivationDataList list(allocator);
+  list.reserve(size());
+  for (size_t i = 0; i < size(); ++i) {
+    ActivationDataRef m = (*this)[i];
+    std::string ip = m.get_ip();
+    list.emplace_back( string_type(m.get_mid().data(), m.get_mid().size(), allocator)
+                     , string_type(ip.data(), ip.size(), allocator)
+                     , m.get_time()
+                     );
+  }
+
+  return list;
+}
+
+template class basic_ActivationDataTable<std::allocator<char>>;
+template class basic_ActivationDataTable<PolymorphicAllocator<char>>;
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
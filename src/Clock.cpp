@@ -0,0 +1,89 @@
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+#include "Clock.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+std::atomic<std::int64_t> Clock_fake::time_(0);
+
+std::atomic<std::int64_t> Clock_coarse::time_(0);
+
+namespace {
+
+std::once_flag coarse_clock_once;
+
+#ifndef _WIN32
+std::atomic<std::int64_t> * coarse_clock_time = nullptr;
+
+// The background thread does not exist in the child, which thus falls back
+// to std::time()
+void
+coarse_clock_atfork_child()
+{
+  coarse_clock_time->store(0, std::memory_order_relaxed);
+}
+#endif
+
+/*
+ * Keeps the time of Clock_coarse up to date by waking up just after each
+ * second.
+ */
+void
+run_coarse_clock(std::atomic<std::int64_t> & time)
+{
+  using Clock = std::chrono::system_clock;
+
+  for (;;) {
+    Clock::time_point now = Clock::now();
+    time.store((std::int64_t)Clock::to_time_t(now), std::memory_order_relaxed);
+
+    Clock::time_point next = std::chrono::time_point_cast<std::chrono::seconds>(now) + std::chrono::seconds(1);
+    std::this_thread::sleep_until(next);
+  }
+}
+
+void
+start_coarse_clock(std::atomic<std::int64_t> & time)
+{
+  // The thread is never stopped, since the clock may be read until the
+  // process exits
+  try {
+    std::thread(run_coarse_clock, std::ref(time)).detach();
+  } catch (std::system_error const&) {
+    return;
+  }
+
+#ifndef _WIN32
+  coarse_clock_time = &time;
+  pthread_atfork(NULL, NULL, coarse_clock_atfork_child);
+#endif
+}
+
+} // namespace
+
+/*
+ * Called while the time is not kept up to date by the background thread,
+ * i.e. the first time the clock is read, or if the thread could not be
+ * started or the process has forked since.
+ */
+std::int64_t
+Clock_coarse::start()
+{
+  std::call_once(coarse_clock_once, start_coarse_clock, std::ref(time_));
+
+  return (std::int64_t)std::time(NULL);
+}
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
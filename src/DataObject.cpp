@@ -4,30 +4,37 @@ namespace cryptolens_io {
 
 namespace v20190401 {
 
+template<typename Allocator>
 int
-DataObject::get_id() const
+basic_DataObject<Allocator>::get_id() const
 {
   return id_;
 }
 
-std::string const&
-DataObject::get_name() const
+template<typename Allocator>
+typename basic_DataObject<Allocator>::string_type const&
+basic_DataObject<Allocator>::get_name() const
 {
   return name_;
 }
 
-std::string const&
-DataObject::get_string_value() const
+template<typename Allocator>
+typename basic_DataObject<Allocator>::string_type const&
+basic_DataObject<Allocator>::get_string_value() const
 {
   return string_value_;
 }
 
+template<typename Allocator>
 int
-DataObject::get_int_value() const
+basic_DataObject<Allocator>::get_int_value() const
 {
   return int_value_;
 }
 
+template class basic_DataObject<std::allocator<char>>;
+template class basic_DataObject<PolymorphicAllocator<char>>;
+
 } // namespace v20190401
 
 } // namespace cryptolens_io
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <system_error>
+
+#include "api.hpp"
+#include "Executor.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace {
+
+// The pool and queue index of the current thread, if it belongs to a pool
+thread_local Executor_thread_pool const* current_pool = nullptr;
+thread_local size_t current_index = 0;
+
+} // namespace
+
+/**
+ * Starts the threads of the pool. If not all threads could be started, e is
+ * set and the pool runs with the threads that were started. If no thread
+ * could be started, tasks are run on the thread calling execute().
+ */
+Executor_thread_pool::Executor_thread_pool(basic_Error & e, unsigned threads)
+: queued_(0), next_(0), stop_(false)
+{
+  if (threads == 0) { threads = std::max(1u, std::thread::hardware_concurrency()); }
+
+  for (unsigned i = 0; i < threads; ++i) {
+    workers_.emplace_back(new Worker());
+  }
+
+  for (unsigned i = 0; i < threads; ++i) {
+    try {
+      threads_.emplace_back(&Executor_thread_pool::run, this, (size_t)i);
+    } catch (std::system_error const&) {
+      if (!e) { e.set(api::main(), errors::Subsystem::Executor, errors::Executor::THREAD_CREATE); }
+      break;
+    }
+  }
+
+  // Queues without a thread of their own are emptied by the other threads
+  if (threads_.empty()) { workers_.clear(); }
+}
+
+/**
+ * Waits for the queued tasks to finish and stops the threads of the pool.
+ */
+Executor_thread_pool::~Executor_thread_pool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+
+  for (std::thread & thread : threads_) { thread.join(); }
+}
+
+void
+Executor_thread_pool::execute(std::function<void()> task)
+{
+  if (workers_.empty()) { task(); return; }
+
+  size_t index = current_pool == this ? current_index : next_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+
+  Worker & worker = *workers_[index];
+  {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    worker.tasks.push_back(std::move(task));
+  }
+
+  queued_.fetch_add(1);
+
+  // Taking the lock makes sure a thread about to wait sees the new task
+  { std::lock_guard<std::mutex> lock(mutex_); }
+  cv_.notify_one();
+}
+
+unsigned
+Executor_thread_pool::concurrency() const
+{
+  return (unsigned)std::max<size_t>(1, workers_.size());
+}
+
+/*
+ * Takes the most recently added task of the given queue, or otherwise the
+ * oldest task of another queue.
+ */
+bool
+Executor_thread_pool::take(size_t index, std::function<void()> & task)
+{
+  {
+    Worker & worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (!worker.tasks.empty()) {
+      task = std::move(worker.tasks.back());
+      worker.tasks.pop_back();
+      return true;
+    }
+  }
+
+  for (size_t i = 1; i < workers_.size(); ++i) {
+    Worker & victim = *workers_[(index + i) % workers_.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void
+Executor_thread_pool::run(size_t index)
+{
+  current_pool = this;
+  current_index = index;
+
+  std::function<void()> task;
+
+  for (;;) {
+    if (take(index, task)) {
+      queued_.fetch_sub(1);
+      task();
+      task = nullptr;
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return stop_ || queued_.load() > 0; });
+    if (stop_ && queued_.load() == 0) { return; }
+  }
+}
+
+Executor &
+default_executor()
+{
+  static basic_Error e;
+  static Executor_thread_pool executor(e);
+  return executor;
+}
+
+namespace internal {
+
+namespace {
+
+struct ParallelFor {
+  std::function<void(size_t, size_t)> const* body;
+  size_t n;
+  size_t grain;
+  std::atomic<size_t> next;
+  std::atomic<size_t> remaining;
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  // Processes ranges until there are none left
+  void
+  work()
+  {
+    for (;;) {
+      size_t begin = next.fetch_add(grain);
+      if (begin >= n) { return; }
+
+      size_t end = std::min(n, begin + grain);
+      (*body)(begin, end);
+
+      if (remaining.fetch_sub(end - begin) == end - begin) {
+        std::lock_guard<std::mutex> lock(mutex);
+        cv.notify_all();
+      }
+    }
+  }
+};
+
+} // namespace
+
+void
+parallel_for(Executor & executor, size_t n, std::function<void(size_t, size_t)> const& body)
+{
+  if (n == 0) { return; }
+
+  size_t tasks = std::min<size_t>(executor.concurrency(), n);
+  if (tasks <= 1) { body(0, n); return; }
+
+  // A few ranges per task evens out differences in the cost of the items
+  std::shared_ptr<ParallelFor> state = std::make_shared<ParallelFor>();
+  state->body = &body;
+  state->n = n;
+  state->grain = std::max<size_t>(1, n / (4 * tasks));
+  state->next = 0;
+  state->remaining = n;
+
+  // The tasks keep the state alive, but only call body while there are
+  // ranges left, i.e. before this function returns
+  for (size_t i = 1; i < tasks; ++i) {
+    executor.execute([state]() { state->work(); });
+  }
+
+  state->work();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->cv.wait(lock, [&state]() { return state->remaining.load() == 0; });
+}
+
+} // namespace internal
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
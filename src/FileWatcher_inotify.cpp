@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "api.hpp"
+#include "Executor.hpp"
+#include "LicenseKeyWatcher_inotify.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace internal {
+
+FileWatcher_inotify::FileWatcher_inotify(basic_Error & e, std::function<void(std::string const&)> on_change)
+: on_change_(std::move(on_change)), fd_(-1), stop_fd_(-1)
+{
+  if (e) { return; }
+
+  using namespace errors;
+  api::main api;
+
+  fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd_ < 0) { e.set(api, Subsystem::File, File::WATCH, errno); return; }
+
+  stop_fd_ = eventfd(0, EFD_CLOEXEC);
+  if (stop_fd_ < 0) { e.set(api, Subsystem::File, File::WATCH, errno); return; }
+
+  try {
+    thread_ = std::thread(&FileWatcher_inotify::run, this);
+  } catch (std::system_error const&) {
+    e.set(api, Subsystem::Executor, Executor::THREAD_CREATE);
+  }
+}
+
+FileWatcher_inotify::~FileWatcher_inotify()
+{
+  stop();
+
+  if (fd_ >= 0) { close(fd_); }
+  if (stop_fd_ >= 0) { close(stop_fd_); }
+}
+
+void
+FileWatcher_inotify::add(basic_Error & e, std::string const& path)
+{
+  if (e) { return; }
+
+  using namespace errors;
+  api::main api;
+
+  if (fd_ < 0) { e.set(api, Subsystem::File, File::WATCH); return; }
+
+  size_t k = path.rfind('/');
+  std::string directory = k == std::string::npos ? std::string(".") : path.substr(0, k + 1);
+  std::string name = k == std::string::npos ? path : path.substr(k + 1);
+
+  // Writes in place are seen as IN_CLOSE_WRITE, and files replaced by
+  // rename as IN_MOVED_TO
+  int wd = inotify_add_watch(fd_, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+  if (wd < 0) { e.set(api, Subsystem::File, File::WATCH, errno); return; }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  files_[std::make_pair(wd, name)] = path;
+}
+
+/*
+ * Stops the background thread. Once this returns, on_change is no longer
+ * called.
+ */
+void
+FileWatcher_inotify::stop()
+{
+  if (!thread_.joinable()) { return; }
+
+  std::uint64_t one = 1;
+  ssize_t r = write(stop_fd_, &one, sizeof(one));
+  (void)r;
+
+  thread_.join();
+}
+
+void
+FileWatcher_inotify::run()
+{
+  // Large enough for at least one event with a name of maximum length
+  alignas(struct inotify_event) char buffer[4096];
+
+  struct pollfd fds[2];
+  fds[0].fd = fd_;
+  fds[0].events = POLLIN;
+  fds[1].fd = stop_fd_;
+  fds[1].events = POLLIN;
+
+  for (;;) {
+    int r = poll(fds, 2, -1);
+    if (r < 0 && errno == EINTR) { continue; }
+    if (r < 0 || fds[1].revents) { return; }
+
+    // Several events for the same file, e.g. from a number of writes, are
+    // reported once per read
+    std::vector<std::string> changed;
+    for (;;) {
+      ssize_t n = read(fd_, buffer, sizeof(buffer));
+      if (n <= 0) { break; }
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (char * p = buffer; p < buffer + n; ) {
+        struct inotify_event * event = reinterpret_cast<struct inotify_event *>(p);
+        p += sizeof(struct inotify_event) + event->len;
+
+        if (event->len == 0) { continue; }
+
+        std::map<std::pair<int, std::string>, std::string>::const_iterator it =
+          files_.find(std::make_pair(event->wd, std::string(event->name)));
+        if (it == files_.end()) { continue; }
+
+        if (std::find(changed.begin(), changed.end(), it->second) == changed.end()) {
+          changed.push_back(it->second);
+        }
+      }
+    }
+
+    for (size_t i = 0; i < changed.size(); ++i) { on_change_(changed[i]); }
+  }
+}
+
+} // namespace internal
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
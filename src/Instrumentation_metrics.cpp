@@ -0,0 +1,36 @@
+#include "Instrumentation_metrics.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+Instrumentation_metrics::Instrumentation_metrics(basic_Error &)
+: metrics_(Metrics::get())
+{}
+
+void
+Instrumentation_metrics::stage_begin(int stage)
+{
+  if (stage < 0 || stage >= instrumentation::Stage::COUNT) { return; }
+
+  begin_[stage] = std::chrono::steady_clock::now();
+}
+
+void
+Instrumentation_metrics::stage_end(int stage)
+{
+  if (stage < 0 || stage >= instrumentation::Stage::COUNT) { return; }
+
+  std::chrono::nanoseconds duration = std::chrono::steady_clock::now() - begin_[stage];
+  metrics_.record_stage(stage, duration.count());
+}
+
+void
+Instrumentation_metrics::activation_finished(basic_Error const& e)
+{
+  metrics_.record_activation(e);
+}
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
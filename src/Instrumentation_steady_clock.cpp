@@ -0,0 +1,64 @@
+#include "Instrumentation_steady_clock.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+Instrumentation_steady_clock::Instrumentation_steady_clock(basic_Error &)
+{
+  reset();
+}
+
+void
+Instrumentation_steady_clock::stage_begin(int stage)
+{
+  if (stage < 0 || stage >= instrumentation::Stage::COUNT) { return; }
+
+  begin_[stage] = std::chrono::steady_clock::now();
+}
+
+void
+Instrumentation_steady_clock::stage_end(int stage)
+{
+  if (stage < 0 || stage >= instrumentation::Stage::COUNT) { return; }
+
+  duration_[stage] = std::chrono::steady_clock::now() - begin_[stage];
+}
+
+/**
+ * Returns the time spent in the given stage during the last time the stage
+ * was performed, or zero if the stage has not been performed since the
+ * object was created or reset() was called.
+ */
+std::chrono::nanoseconds
+Instrumentation_steady_clock::get_duration(int stage) const
+{
+  if (stage < 0 || stage >= instrumentation::Stage::COUNT) { return std::chrono::nanoseconds::zero(); }
+
+  return duration_[stage];
+}
+
+/**
+ * Returns the statistics for the last request made to the Web API. If the
+ * RequestHandler does not provide any statistics all fields are zero.
+ */
+RequestStatistics const&
+Instrumentation_steady_clock::get_request_statistics() const
+{
+  return request_statistics_;
+}
+
+void
+Instrumentation_steady_clock::reset()
+{
+  for (int i = 0; i < instrumentation::Stage::COUNT; ++i) {
+    begin_[i] = std::chrono::steady_clock::time_point();
+    duration_[i] = std::chrono::nanoseconds::zero();
+  }
+
+  request_statistics_ = RequestStatistics{0, 0, 0, 0, 0, 0, 0, 0};
+}
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
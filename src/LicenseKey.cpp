@@ -2,6 +2,7 @@
 #include "basic_Cryptolens.hpp"
 #include "LicenseKey.hpp"
 #include "LicenseKeyInformation.hpp"
+#include "LicenseKeyView.hpp"
 #include "RawLicenseKey.hpp"
 
 namespace cryptolens_io {
@@ -24,6 +25,17 @@ LicenseKey::to_string() const {
   return s;
 }
 
+/**
+ * Returns the license key in the binary format read by LicenseKeyView.
+ *
+ * Like to_string(), the result contains the license as signed by the Web API
+ * and thus can be stored and loaded later without contacting the Web API.
+ */
+std::string
+LicenseKey::to_binary(basic_Error & e) const {
+  return internal::license_key_binary_encode(e, raw_.get_license(), raw_.get_signature());
+}
+
 /**
  * Return a LicenseKeyChecker working on this LicenseKey object
  */
@@ -228,6 +240,15 @@ LicenseKey::get_activated_machines() const
   return info_.get_activated_machines();
 }
 
+/**
+ * Returns the table of activated machines
+ */
+optional<ActivationDataTable> const&
+LicenseKey::get_activated_machines_table() const
+{
+  return info_.get_activated_machines_table();
+}
+
 /**
  * Returns the maximum number of machines/devices that may activate this
  * license key.
@@ -258,6 +279,26 @@ LicenseKey::get_data_objects() const
   return info_.get_data_objects();
 }
 
+/**
+ * Returns the first data object with the given name, or a null pointer if
+ * there is none, see LicenseKeyInformation::find_data_object().
+ */
+DataObject const*
+LicenseKey::find_data_object(StringView name) const
+{
+  return info_.find_data_object(name);
+}
+
+/**
+ * Returns the integer value of the first data object with the given name,
+ * or default_value if there is none.
+ */
+int
+LicenseKey::int_value_or(StringView name, int default_value) const
+{
+  return info_.int_value_or(name, default_value);
+}
+
 } // namespace v20190401
 
 } // namespace cryptolens_io
@@ -15,7 +15,8 @@ namespace v20190401 {
  *
  *     LicenseKeyChecker(license_key)
  */
-LicenseKeyChecker::LicenseKeyChecker(LicenseKeyInformation const* license_key)
+template<typename Allocator>
+basic_LicenseKeyChecker<Allocator>::basic_LicenseKeyChecker(basic_LicenseKeyInformation<Allocator> const* license_key)
 : status_(true), key_(license_key)
 { }
 
@@ -27,15 +28,17 @@ LicenseKeyChecker::LicenseKeyChecker(LicenseKeyInformation const* license_key)
  *       DO_SOMETHING
  *     }
  */
-LicenseKeyChecker::operator bool() const {
+template<typename Allocator>
+basic_LicenseKeyChecker<Allocator>::operator bool() const {
   return status_;
 }
 
 /**
  * Check that the underlying LicenseKey object has a certain feature.
  */
-LicenseKeyChecker&
-LicenseKeyChecker::has_feature(int feature) {
+template<typename Allocator>
+basic_LicenseKeyChecker<Allocator>&
+basic_LicenseKeyChecker<Allocator>::has_feature(int feature) {
   switch (feature) {
   case 1:
     if (!key_->get_f1()) { status_ = false; }
@@ -83,8 +86,9 @@ LicenseKeyChecker::has_feature(int feature) {
  * Check that the underlying LicenseKey object does not have a
  * certain feature.
  */
-LicenseKeyChecker&
-LicenseKeyChecker::has_not_feature(int feature) {
+template<typename Allocator>
+basic_LicenseKeyChecker<Allocator>&
+basic_LicenseKeyChecker<Allocator>::has_not_feature(int feature) {
   switch (feature) {
   case 1:
     if (key_->get_f1()) { status_ = false; }
@@ -133,8 +137,9 @@ LicenseKeyChecker::has_not_feature(int feature) {
  *
  * Time is given as a unix time stamp measured in seconds.
  */
-LicenseKeyChecker&
-LicenseKeyChecker::has_expired(std::uint64_t now)
+template<typename Allocator>
+basic_LicenseKeyChecker<Allocator>&
+basic_LicenseKeyChecker<Allocator>::has_expired(std::uint64_t now)
 {
   if (now < key_->get_expires()) {
     status_ = false;
@@ -148,8 +153,9 @@ LicenseKeyChecker::has_expired(std::uint64_t now)
  *
  * Time is given as a unix time stamp measured in seconds.
  */
-LicenseKeyChecker&
-LicenseKeyChecker::has_not_expired(std::uint64_t now)
+template<typename Allocator>
+basic_LicenseKeyChecker<Allocator>&
+basic_LicenseKeyChecker<Allocator>::has_not_expired(std::uint64_t now)
 {
   if (key_->get_expires() < now) {
     status_ = false;
@@ -161,8 +167,9 @@ LicenseKeyChecker::has_not_expired(std::uint64_t now)
 /**
  * Check that the underlying LicenseKey object is blocked.
  */
-LicenseKeyChecker&
-LicenseKeyChecker::is_blocked()
+template<typename Allocator>
+basic_LicenseKeyChecker<Allocator>&
+basic_LicenseKeyChecker<Allocator>::is_blocked()
 {
   if (!key_->get_block()) { status_ = false; }
 
@@ -172,8 +179,9 @@ LicenseKeyChecker::is_blocked()
 /**
  * Check that the underlying LicenseKey object is not blocked.
  */
-LicenseKeyChecker&
-LicenseKeyChecker::is_not_blocked()
+template<typename Allocator>
+basic_LicenseKeyChecker<Allocator>&
+basic_LicenseKeyChecker<Allocator>::is_not_blocked()
 {
   if (key_->get_block()) { status_ = false; }
 
@@ -184,14 +192,13 @@ LicenseKeyChecker::is_not_blocked()
  * Check that machine_code is among the allowed machines for the
  * underlying LicenseKey object.
  */
-LicenseKeyChecker&
-LicenseKeyChecker::is_on_right_machine(std::string const& machine_code)
+template<typename Allocator>
+basic_LicenseKeyChecker<Allocator>&
+basic_LicenseKeyChecker<Allocator>::is_on_right_machine(std::string const& machine_code)
 {
-  if (key_->get_activated_machines()) {
-    for (auto const& m : *(key_->get_activated_machines())) {
-      if (m.get_mid() == machine_code) {
-        return *this;
-      }
+  if (key_->get_activated_machines_table()) {
+    if (key_->get_activated_machines_table()->find_mid(machine_code)) {
+      return *this;
     }
   }
 
@@ -199,6 +206,9 @@ LicenseKeyChecker::is_on_right_machine(std::string const& machine_code)
   return *this;
 }
 
+template class basic_LicenseKeyChecker<std::allocator<char>>;
+template class basic_LicenseKeyChecker<PolymorphicAllocator<char>>;
+
 } // namespace v20190401
 
 } // namespace cryptolens_io
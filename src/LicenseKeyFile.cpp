@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "api.hpp"
+#include "LicenseKeyFile.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace {
+
+#ifdef _WIN32
+char const PATH_SEPARATORS[] = "/\\";
+#else
+char const PATH_SEPARATORS[] = "/";
+#endif
+
+std::string
+join_path(std::string const& directory, std::string const& name)
+{
+  if (directory.empty() || std::strchr(PATH_SEPARATORS, directory.back())) { return directory + name; }
+  return directory + '/' + name;
+}
+
+bool
+is_absolute_path(std::string const& path)
+{
+#ifdef _WIN32
+  return (path.size() >= 1 && std::strchr(PATH_SEPARATORS, path[0]))
+      || (path.size() >= 2 && path[1] == ':');
+#else
+  return !path.empty() && path[0] == '/';
+#endif
+}
+
+} // namespace
+
+/**
+ * Returns the paths of the files in the directory, sorted by name. Hidden
+ * files, i.e. those with a name starting with '.', and subdirectories are
+ * skipped.
+ *
+ * The result can be passed to basic_Cryptolens::load_license_key_files().
+ */
+std::vector<std::string>
+list_license_key_files(basic_Error & e, std::string const& directory)
+{
+  std::vector<std::string> paths;
+  if (e) { return paths; }
+
+  using namespace errors;
+  api::main api;
+
+#ifdef _WIN32
+  WIN32_FIND_DATAA data;
+  HANDLE h = FindFirstFileA(join_path(directory, "*").c_str(), &data);
+  if (h == INVALID_HANDLE_VALUE) {
+    e.set(api, Subsystem::File, File::DIRECTORY, GetLastError());
+    return paths;
+  }
+
+  do {
+    if (data.cFileName[0] == '.') { continue; }
+    if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) { continue; }
+    paths.push_back(join_path(directory, data.cFileName));
+  } while (FindNextFileA(h, &data));
+
+  FindClose(h);
+#else
+  DIR * dir = opendir(directory.c_str());
+  if (dir == NULL) {
+    e.set(api, Subsystem::File, File::DIRECTORY, errno);
+    return paths;
+  }
+
+  while (struct dirent * entry = readdir(dir)) {
+    if (entry->d_name[0] == '.') { continue; }
+
+    std::string path = join_path(directory, entry->d_name);
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) { continue; }
+    paths.push_back(std::move(path));
+  }
+
+  closedir(dir);
+#endif
+
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+/**
+ * Reads a manifest listing license key files, one path per line. Empty lines
+ * and lines starting with '#' are ignored, and relative paths are relative
+ * to the directory containing the manifest.
+ *
+ * The result can be passed to basic_Cryptolens::load_license_key_files().
+ */
+std::vector<std::string>
+read_license_key_manifest(basic_Error & e, std::string const& manifest)
+{
+  std::vector<std::string> paths;
+  if (e) { return paths; }
+
+  std::ifstream in(manifest.c_str());
+  if (!in) {
+    e.set(api::main(), errors::Subsystem::File, errors::File::OPEN, errno);
+    return paths;
+  }
+
+  size_t k = manifest.find_last_of(PATH_SEPARATORS);
+  std::string directory = k == std::string::npos ? std::string() : manifest.substr(0, k + 1);
+
+  std::string line;
+  while (std::getline(in, line)) {
+    size_t end = line.find_last_not_of(" \t\r");
+    if (end == std::string::npos) { continue; }
+    line.erase(end + 1);
+
+    size_t begin = line.find_first_not_of(" \t");
+    if (line[begin] == '#') { continue; }
+    line.erase(0, begin);
+
+    paths.push_back(is_absolute_path(line) ? line : join_path(directory, line));
+  }
+
+  if (in.bad()) {
+    e.set(api::main(), errors::Subsystem::File, errors::File::READ, errno);
+    paths.clear();
+  }
+
+  return paths;
+}
+
+namespace internal {
+
+/*
+ * Writes the buffered data of the file and waits until it is on disk.
+ * Returns zero or the errno value.
+ */
+int
+sync_file(std::FILE * file)
+{
+  if (std::fflush(file) != 0) { return errno; }
+#ifdef _WIN32
+  if (_commit(_fileno(file)) != 0) { return errno; }
+#else
+  if (fsync(fileno(file)) != 0) { return errno; }
+#endif
+  return 0;
+}
+
+namespace {
+
+#ifndef _WIN32
+// Makes a rename within the directory containing path durable
+int
+sync_directory(std::string const& path)
+{
+  size_t k = path.rfind('/');
+  std::string directory = k == std::string::npos ? std::string(".") : path.substr(0, k + 1);
+
+  int fd = open(directory.c_str(), O_RDONLY);
+  if (fd < 0) { return errno; }
+  int r = fsync(fd) == 0 ? 0 : errno;
+  close(fd);
+  return r;
+}
+#endif
+
+} // namespace
+
+/*
+ * Reads the whole file at path into a string. Unlike MappedFile, the
+ * contents are copied, so the file may be truncated or rewritten while it
+ * is being read without the process being killed by SIGBUS.
+ */
+std::string
+read_file(basic_Error & e, std::string const& path)
+{
+  if (e) { return ""; }
+
+  using namespace errors;
+  api::main api;
+
+  std::FILE * file = std::fopen(path.c_str(), "rb");
+  if (!file) { e.set(api, Subsystem::File, File::OPEN, errno); return ""; }
+
+  std::string contents;
+  char buffer[4096];
+  size_t n;
+  while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) { contents.append(buffer, n); }
+
+  int r = std::ferror(file) ? errno : 0;
+  std::fclose(file);
+  if (r != 0) { e.set(api, Subsystem::File, File::READ, r); return ""; }
+
+  return contents;
+}
+
+/*
+ * Replaces the contents of the file at path, by writing a new file and
+ * renaming it over the old one, such that a reader sees either the old or
+ * the new contents even if the process stops half way.
+ */
+void
+replace_file(basic_Error & e, std::string const& path, std::string const& contents)
+{
+  if (e) { return; }
+
+  using namespace errors;
+  api::main api;
+
+  std::string tmp = path + ".tmp";
+  std::FILE * file = std::fopen(tmp.c_str(), "wb");
+  if (!file) { e.set(api, Subsystem::File, File::OPEN, errno); return; }
+
+  int r = 0;
+  if (std::fwrite(contents.data(), 1, contents.size(), file) != contents.size()) { r = errno; }
+  if (r == 0) { r = sync_file(file); }
+  if (std::fclose(file) != 0 && r == 0) { r = errno; }
+  if (r != 0) { e.set(api, Subsystem::File, File::WRITE, r); std::remove(tmp.c_str()); return; }
+
+#ifdef _WIN32
+  if (!MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+    e.set(api, Subsystem::File, File::WRITE, GetLastError());
+    std::remove(tmp.c_str());
+  }
+#else
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) { e.set(api, Subsystem::File, File::WRITE, errno); std::remove(tmp.c_str()); return; }
+  r = sync_directory(path);
+  if (r != 0) { e.set(api, Subsystem::File, File::WRITE, r); }
+#endif
+}
+
+#ifdef _WIN32
+MappedFile::MappedFile(basic_Error & e, std::string const& path)
+: data_(""), size_(0), mapping_(NULL)
+{
+  if (e) { return; }
+
+  using namespace errors;
+  api::main api;
+
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) { e.set(api, Subsystem::File, File::OPEN, GetLastError()); return; }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    e.set(api, Subsystem::File, File::READ, GetLastError());
+    CloseHandle(file);
+    return;
+  }
+
+  // Empty files cannot be mapped
+  if (size.QuadPart == 0) { CloseHandle(file); return; }
+
+  mapping_ = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (mapping_ == NULL) { e.set(api, Subsystem::File, File::MAP, GetLastError()); return; }
+
+  void * p = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+  if (p == NULL) {
+    e.set(api, Subsystem::File, File::MAP, GetLastError());
+    CloseHandle(mapping_);
+    mapping_ = NULL;
+    return;
+  }
+
+  data_ = static_cast<char const*>(p);
+  size_ = (size_t)size.QuadPart;
+}
+
+MappedFile::~MappedFile()
+{
+  if (mapping_ == NULL) { return; }
+
+  UnmapViewOfFile(data_);
+  CloseHandle(mapping_);
+}
+#else
+MappedFile::MappedFile(basic_Error & e, std::string const& path)
+: data_(""), size_(0)
+{
+  if (e) { return; }
+
+  using namespace errors;
+  api::main api;
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) { e.set(api, Subsystem::File, File::OPEN, errno); return; }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    e.set(api, Subsystem::File, File::READ, errno);
+    close(fd);
+    return;
+  }
+
+  // Empty files cannot be mapped
+  if (st.st_size == 0) { close(fd); return; }
+
+  void * p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) { e.set(api, Subsystem::File, File::MAP, errno); return; }
+
+  data_ = static_cast<char const*>(p);
+  size_ = (size_t)st.st_size;
+}
+
+MappedFile::~MappedFile()
+{
+  if (size_ == 0) { return; }
+
+  munmap(const_cast<char *>(data_), size_);
+}
+#endif
+
+} // namespace internal
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
@@ -1,5 +1,8 @@
+#include <algorithm>
+
 #include "api.hpp"
 #include "basic_Cryptolens.hpp"
+#include "LicenseKeyChecker.hpp"
 #include "LicenseKeyInformation.hpp"
 #include "ResponseParser_ArduinoJson5.hpp"
 
@@ -7,10 +10,12 @@ namespace cryptolens_io {
 
 namespace v20190401 {
 
-LicenseKeyInformation::LicenseKeyInformation()
+template<typename Allocator>
+basic_LicenseKeyInformation<Allocator>::basic_LicenseKeyInformation()
 {}
 
-LicenseKeyInformation::LicenseKeyInformation(
+template<typename Allocator>
+basic_LicenseKeyInformation<Allocator>::basic_LicenseKeyInformation(
   api::internal::main,
   int           product_id,
   std::uint64_t created,
@@ -28,15 +33,15 @@ LicenseKeyInformation::LicenseKeyInformation(
   bool          f7,
   bool          f8,
 
-  optional<int>                         id,
-  optional<std::string>                 key,
-  optional<std::string>                 notes,
-  optional<int>                         global_id,
-  optional<Customer>                    customer,
-  optional<std::vector<ActivationData>> activated_machines,
-  optional<int>                         maxnoofmachines,
-  optional<std::string>                 allowed_machines,
-  optional<std::vector<DataObject>>     data_objects
+  optional<int>                 id,
+  optional<string_type>         key,
+  optional<string_type>         notes,
+  optional<int>                 global_id,
+  optional<Customer>            customer,
+  optional<ActivationDataTable> activated_machines,
+  optional<int>                 maxnoofmachines,
+  optional<string_type>         allowed_machines,
+  optional<DataObjectList>      data_objects
   )
   : product_id_(product_id)
   , created_(created)
@@ -63,31 +68,59 @@ LicenseKeyInformation::LicenseKeyInformation(
   , maxnoofmachines_(std::move(maxnoofmachines))
   , allowed_machines_(std::move(allowed_machines))
   , data_objects_(std::move(data_objects))
-  { };
+  , activated_machines_list_(activated_machines_ ? Allocator(activated_machines_->get_allocator()) : Allocator())
+  , data_object_index_(data_objects_ ? Allocator(data_objects_->get_allocator()) : Allocator())
+  {
+    index_data_objects();
+  };
+
+/*
+ * Sorts the indices of the data objects by name, keeping data objects with
+ * the same name in their original order, so that find_data_object() can
+ * binary search for them.
+ */
+template<typename Allocator>
+void
+basic_LicenseKeyInformation<Allocator>::index_data_objects()
+{
+  if (!data_objects_) { return; }
+
+  DataObjectList const& data_objects = *data_objects_;
+
+  data_object_index_.resize(data_objects.size());
+  for (size_t i = 0; i < data_objects.size(); ++i) { data_object_index_[i] = (std::uint32_t)i; }
+
+  std::stable_sort(data_object_index_.begin(), data_object_index_.end(),
+    [&data_objects](std::uint32_t a, std::uint32_t b) {
+      return data_objects[a].get_name() < data_objects[b].get_name();
+    });
+}
 
 #if 1
 /**
  * Attempt to construct a LicenseKeyInformation from a RawLicenseKey
  */
-optional<LicenseKeyInformation>
-LicenseKeyInformation::make(basic_Error & e, RawLicenseKey const& raw_license_key)
+template<typename Allocator>
+optional<basic_LicenseKeyInformation<Allocator>>
+basic_LicenseKeyInformation<Allocator>::make(basic_Error & e, RawLicenseKey const& raw_license_key, Allocator const& allocator)
 {
   if (e) { return nullopt; }
 
-  return LicenseKeyInformation::make_unsafe(e, raw_license_key.get_license());
+  return basic_LicenseKeyInformation::make_unsafe(e, raw_license_key.get_license(), allocator);
 }
 
 /**
  * Attempt to construct a LicenseKeyInformation from an optional containing a RawLicenseKey
  */
-optional<LicenseKeyInformation>
-LicenseKeyInformation::make(basic_Error & e, optional<RawLicenseKey> const& raw_license_key)
+template<typename Allocator>
+optional<basic_LicenseKeyInformation<Allocator>>
+basic_LicenseKeyInformation<Allocator>::make(basic_Error & e, optional<RawLicenseKey> const& raw_license_key, Allocator const& allocator)
 {
   if (e) { return nullopt; }
 
   if (!raw_license_key) { return nullopt; }
 
-  return LicenseKeyInformation::make(e, *raw_license_key);
+  return basic_LicenseKeyInformation::make(e, *raw_license_key, allocator);
 }
 
 /**
@@ -99,29 +132,33 @@ LicenseKeyInformation::make(basic_Error & e, optional<RawLicenseKey> const& raw_
  * a RawLicenseKey object. A LicenseKeyInformation object can then be constructed
  * from the RawLicenseKey using another static factory.
  */
-optional<LicenseKeyInformation>
-LicenseKeyInformation::make_unsafe(basic_Error & e, std::string const& license_key)
+template<typename Allocator>
+optional<basic_LicenseKeyInformation<Allocator>>
+basic_LicenseKeyInformation<Allocator>::make_unsafe(basic_Error & e, std::string const& license_key, Allocator const& allocator)
 {
   if (e) { return nullopt; }
 
   ResponseParser_ArduinoJson5 response_parser(e);
 
-  return response_parser.make_license_key_information_unsafe(e, license_key);
+  return response_parser.make_license_key_information_unsafe(e, license_key, allocator);
 }
 #endif
 
 /**
  * Return a LicenseKeyChecker working on this LicenseKeyInformation object
  */
-LicenseKeyChecker
-LicenseKeyInformation::check() const {
-  return LicenseKeyChecker(this);
+template<typename Allocator>
+basic_LicenseKeyChecker<Allocator>
+basic_LicenseKeyInformation<Allocator>::check() const {
+  return basic_LicenseKeyChecker<Allocator>(this);
 }
 
 /**
  * Returns the product Id of he license key
  */
-int LicenseKeyInformation::get_product_id() const
+template<typename Allocator>
+int
+basic_LicenseKeyInformation<Allocator>::get_product_id() const
 {
   return product_id_;
 }
@@ -129,8 +166,9 @@ int LicenseKeyInformation::get_product_id() const
 /**
  * Returns the date and time the license key was created
  */
+template<typename Allocator>
 std::uint64_t
-LicenseKeyInformation::get_created() const
+basic_LicenseKeyInformation<Allocator>::get_created() const
 {
   return created_;
 }
@@ -138,8 +176,9 @@ LicenseKeyInformation::get_created() const
 /**
  * Returns the date and time the license key expires
  */
+template<typename Allocator>
 std::uint64_t
-LicenseKeyInformation::get_expires() const
+basic_LicenseKeyInformation<Allocator>::get_expires() const
 {
   return expires_;
 }
@@ -147,8 +186,9 @@ LicenseKeyInformation::get_expires() const
 /**
  * Returns the duration of current license cycle eg. 30 days
  */
+template<typename Allocator>
 int
-LicenseKeyInformation::get_period() const
+basic_LicenseKeyInformation<Allocator>::get_period() const
 {
   return period_;
 }
@@ -156,8 +196,9 @@ LicenseKeyInformation::get_period() const
 /**
  * Returns if the license key is blocked
  */
+template<typename Allocator>
 bool
-LicenseKeyInformation::get_block() const
+basic_LicenseKeyInformation<Allocator>::get_block() const
 {
   return block_;
 }
@@ -165,8 +206,9 @@ LicenseKeyInformation::get_block() const
 /**
  * Returns if trial activation is enabled
  */
+template<typename Allocator>
 bool
-LicenseKeyInformation::get_trial_activation() const
+basic_LicenseKeyInformation<Allocator>::get_trial_activation() const
 {
   return trial_activation_;
 }
@@ -174,8 +216,9 @@ LicenseKeyInformation::get_trial_activation() const
 /**
  * Returns the date the license key was created by the Web API
  */
+template<typename Allocator>
 std::uint64_t
-LicenseKeyInformation::get_sign_date() const
+basic_LicenseKeyInformation<Allocator>::get_sign_date() const
 {
   return sign_date_;
 }
@@ -183,8 +226,9 @@ LicenseKeyInformation::get_sign_date() const
 /**
  * Returns if the license key has feature 1
  */
+template<typename Allocator>
 bool
-LicenseKeyInformation::get_f1() const
+basic_LicenseKeyInformation<Allocator>::get_f1() const
 {
   return f1_;
 }
@@ -192,8 +236,9 @@ LicenseKeyInformation::get_f1() const
 /**
  * Returns if the license key has feature 2
  */
+template<typename Allocator>
 bool
-LicenseKeyInformation::get_f2() const
+basic_LicenseKeyInformation<Allocator>::get_f2() const
 {
   return f2_;
 }
@@ -201,8 +246,9 @@ LicenseKeyInformation::get_f2() const
 /**
  * Returns if the license key has feature 3
  */
+template<typename Allocator>
 bool
-LicenseKeyInformation::get_f3() const
+basic_LicenseKeyInformation<Allocator>::get_f3() const
 {
   return f3_;
 }
@@ -210,8 +256,9 @@ LicenseKeyInformation::get_f3() const
 /**
  * Returns if the license key has feature 4
  */
+template<typename Allocator>
 bool
-LicenseKeyInformation::get_f4() const
+basic_LicenseKeyInformation<Allocator>::get_f4() const
 {
   return f4_;
 }
@@ -219,8 +266,9 @@ LicenseKeyInformation::get_f4() const
 /**
  * Returns if the license key has feature 5
  */
+template<typename Allocator>
 bool
-LicenseKeyInformation::get_f5() const
+basic_LicenseKeyInformation<Allocator>::get_f5() const
 {
   return f5_;
 }
@@ -228,8 +276,9 @@ LicenseKeyInformation::get_f5() const
 /**
  * Returns if the license key has feature 6
  */
+template<typename Allocator>
 bool
-LicenseKeyInformation::get_f6() const
+basic_LicenseKeyInformation<Allocator>::get_f6() const
 {
   return f6_;
 }
@@ -237,8 +286,9 @@ LicenseKeyInformation::get_f6() const
 /**
  * Returns if the license key has feature 7
  */
+template<typename Allocator>
 bool
-LicenseKeyInformation::get_f7() const
+basic_LicenseKeyInformation<Allocator>::get_f7() const
 {
   return f7_;
 }
@@ -246,8 +296,9 @@ LicenseKeyInformation::get_f7() const
 /**
  * Returns if the license key has feature 8
  */
+template<typename Allocator>
 bool
-LicenseKeyInformation::get_f8() const
+basic_LicenseKeyInformation<Allocator>::get_f8() const
 {
   return f8_;
 }
@@ -255,8 +306,9 @@ LicenseKeyInformation::get_f8() const
 /**
  * Returns the Id of the license key
  */
+template<typename Allocator>
 optional<int> const&
-LicenseKeyInformation::get_id() const
+basic_LicenseKeyInformation<Allocator>::get_id() const
 {
   return id_;
 }
@@ -264,8 +316,9 @@ LicenseKeyInformation::get_id() const
 /**
  * Return the license key string, eg. ABCDE-EFGHI-JKLMO-PQRST
  */
-optional<std::string> const&
-LicenseKeyInformation::get_key() const
+template<typename Allocator>
+optional<typename basic_LicenseKeyInformation<Allocator>::string_type> const&
+basic_LicenseKeyInformation<Allocator>::get_key() const
 {
   return key_;
 }
@@ -273,8 +326,9 @@ LicenseKeyInformation::get_key() const
 /**
  * Returns the notes field of the license key
  */
-optional<std::string> const&
-LicenseKeyInformation::get_notes() const
+template<typename Allocator>
+optional<typename basic_LicenseKeyInformation<Allocator>::string_type> const&
+basic_LicenseKeyInformation<Allocator>::get_notes() const
 {
   return notes_;
 }
@@ -282,8 +336,9 @@ LicenseKeyInformation::get_notes() const
 /**
  * Returns a unique global identifier for the license key
  */
+template<typename Allocator>
 optional<int> const&
-LicenseKeyInformation::get_global_id() const
+basic_LicenseKeyInformation<Allocator>::get_global_id() const
 {
   return global_id_;
 }
@@ -291,17 +346,37 @@ LicenseKeyInformation::get_global_id() const
 /**
  * Returns the customer object assigned to the license key
  */
-optional<Customer> const&
-LicenseKeyInformation::get_customer() const
+template<typename Allocator>
+optional<typename basic_LicenseKeyInformation<Allocator>::Customer> const&
+basic_LicenseKeyInformation<Allocator>::get_customer() const
 {
   return customer_;
 }
 
 /**
  * Returns the list of activated machines
+ *
+ * The activated machines are stored in an ActivationDataTable, and the list
+ * is built from the table the first time this method is called. Prefer
+ * get_activated_machines_table() for license keys with many activated
+ * machines.
+ */
+template<typename Allocator>
+optional<typename basic_LicenseKeyInformation<Allocator>::ActivationDataList> const&
+basic_LicenseKeyInformation<Allocator>::get_activated_machines() const
+{
+  optional<ActivationDataTable> const& table = activated_machines_;
+  return activated_machines_list_.get([&table]() {
+      return table ? make_optional(table->to_list()) : optional<ActivationDataList>();
+    });
+}
+
+/**
+ * Returns the table of activated machines
  */
-optional<std::vector<ActivationData>> const&
-LicenseKeyInformation::get_activated_machines() const
+template<typename Allocator>
+optional<typename basic_LicenseKeyInformation<Allocator>::ActivationDataTable> const&
+basic_LicenseKeyInformation<Allocator>::get_activated_machines_table() const
 {
   return activated_machines_;
 }
@@ -310,8 +385,9 @@ LicenseKeyInformation::get_activated_machines() const
  * Returns the maximum number of machines/devices that may activate this
  * license key.
  */
+template<typename Allocator>
 optional<int> const&
-LicenseKeyInformation::get_maxnoofmachines() const
+basic_LicenseKeyInformation<Allocator>::get_maxnoofmachines() const
 {
   return maxnoofmachines_;
 }
@@ -321,8 +397,9 @@ LicenseKeyInformation::get_maxnoofmachines() const
  * during activation. Even if the limit is achieved, these will still be
  * activated.
  */
-optional<std::string> const&
-LicenseKeyInformation::get_allowed_machines() const
+template<typename Allocator>
+optional<typename basic_LicenseKeyInformation<Allocator>::string_type> const&
+basic_LicenseKeyInformation<Allocator>::get_allowed_machines() const
 {
   return allowed_machines_;
 }
@@ -330,12 +407,58 @@ LicenseKeyInformation::get_allowed_machines() const
 /**
  * Returns the data objects associated with the license key.
  */
-optional<std::vector<DataObject>> const&
-LicenseKeyInformation::get_data_objects() const
+template<typename Allocator>
+optional<typename basic_LicenseKeyInformation<Allocator>::DataObjectList> const&
+basic_LicenseKeyInformation<Allocator>::get_data_objects() const
 {
   return data_objects_;
 }
 
+/**
+ * Returns the first data object with the given name, or a null pointer if
+ * there is none. The data objects are indexed by name when the
+ * LicenseKeyInformation is constructed, so this does not scan the list of
+ * data objects nor allocate memory.
+ */
+template<typename Allocator>
+typename basic_LicenseKeyInformation<Allocator>::DataObject const*
+basic_LicenseKeyInformation<Allocator>::find_data_object(StringView name) const
+{
+  if (!data_objects_) { return nullptr; }
+
+  DataObjectList const& data_objects = *data_objects_;
+
+  auto it = std::lower_bound(data_object_index_.begin(), data_object_index_.end(), name,
+    [&data_objects](std::uint32_t a, StringView name) {
+      string_type const& x = data_objects[a].get_name();
+      return x.compare(0, x.size(), name.data(), name.size()) < 0;
+    });
+
+  if (it == data_object_index_.end()) { return nullptr; }
+
+  DataObject const& data_object = data_objects[*it];
+  if (data_object.get_name().compare(0, data_object.get_name().size(), name.data(), name.size()) != 0) { return nullptr; }
+
+  return &data_object;
+}
+
+/**
+ * Returns the integer value of the first data object with the given name,
+ * or default_value if there is none. E.g.
+ *
+ *     int max_users = license_key.int_value_or("max_users", 5);
+ */
+template<typename Allocator>
+int
+basic_LicenseKeyInformation<Allocator>::int_value_or(StringView name, int default_value) const
+{
+  DataObject const* data_object = find_data_object(name);
+  return data_object ? data_object->get_int_value() : default_value;
+}
+
+template class basic_LicenseKeyInformation<std::allocator<char>>;
+template class basic_LicenseKeyInformation<PolymorphicAllocator<char>>;
+
 } // namespace v20190401
 
 } // namespace cryptolens_io
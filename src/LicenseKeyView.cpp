@@ -0,0 +1,643 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "api.hpp"
+#include "JsonScanner.hpp"
+#include "LicenseKeyView.hpp"
+
+/*
+ * The binary format consists of a header followed by four sections:
+ *
+ *     "CLKB"                  magic
+ *     u16                     version, currently 1
+ *     u16                     reserved, zero
+ *     u32 entry_count         number of index entries
+ *     u32 license_size        size of the signed license
+ *     u32 signature_size      size of the base64 encoded signature
+ *     u32 strings_size        size of the decoded strings
+ *     entry_count * 16 bytes  the index
+ *     license_size bytes      the signed license, as returned by the Web API
+ *     signature_size bytes    the signature, as returned by the Web API
+ *     strings_size bytes      strings which contain escape sequences in the
+ *                             license, in decoded form
+ *
+ * All integers are little endian. Each index entry consists of a u32 kind, a
+ * u32 length and a u64 value. Numbers and booleans are stored in the value.
+ * For strings the value is the offset of the string in the license, or in
+ * the decoded strings if the kind is STRING_DECODED, and length is its size.
+ *
+ * The index starts with one entry per field listed in Field, followed by
+ * MACHINE_FIELDS entries per activated machine and DATA_OBJECT_FIELDS entries
+ * per data object.
+ *
+ * The index is not covered by the signature. Instead, when loading a license
+ * the index is built again from the signed license and compared with the one
+ * in the buffer.
+ */
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace {
+
+char const MAGIC[4] = { 'C', 'L', 'K', 'B' };
+std::uint16_t constexpr VERSION = 1;
+size_t constexpr HEADER_SIZE = 24;
+size_t constexpr ENTRY_SIZE = 16;
+
+std::uint32_t constexpr ABSENT = 0;
+std::uint32_t constexpr NUMBER = 1;
+std::uint32_t constexpr BOOLEAN = 2;
+std::uint32_t constexpr STRING = 3;
+std::uint32_t constexpr STRING_DECODED = 4;
+std::uint32_t constexpr PRESENT = 5;
+
+enum Field {
+  PRODUCT_ID, CREATED, EXPIRES, PERIOD, BLOCK, TRIAL_ACTIVATION, SIGN_DATE,
+  F1, F2, F3, F4, F5, F6, F7, F8,
+  ID, KEY, NOTES, GLOBAL_ID, MAXNOOFMACHINES, ALLOWED_MACHINES,
+  CUSTOMER, CUSTOMER_ID, CUSTOMER_NAME, CUSTOMER_EMAIL, CUSTOMER_COMPANY_NAME, CUSTOMER_CREATED,
+  ACTIVATED_MACHINES, DATA_OBJECTS,
+  FIELD_COUNT
+};
+
+enum MachineField { MACHINE_MID, MACHINE_IP, MACHINE_TIME, MACHINE_FIELDS };
+enum DataObjectField { DATA_OBJECT_ID, DATA_OBJECT_NAME, DATA_OBJECT_STRING_VALUE, DATA_OBJECT_INT_VALUE, DATA_OBJECT_FIELDS };
+
+struct Entry {
+  std::uint32_t kind;
+  std::uint32_t length;
+  std::uint64_t value;
+};
+
+void
+put_u16(std::string & out, std::uint16_t x)
+{
+  out += (char)(x & 0xFF);
+  out += (char)(x >> 8);
+}
+
+void
+put_u32(std::string & out, std::uint32_t x)
+{
+  for (int i = 0; i < 4; ++i) { out += (char)((x >> (8 * i)) & 0xFF); }
+}
+
+void
+put_u64(std::string & out, std::uint64_t x)
+{
+  for (int i = 0; i < 8; ++i) { out += (char)((x >> (8 * i)) & 0xFF); }
+}
+
+std::uint64_t
+get_le(char const* p, int n)
+{
+  std::uint64_t x = 0;
+  for (int i = n - 1; i >= 0; --i) { x = (x << 8) | (unsigned char)p[i]; }
+  return x;
+}
+
+/*
+ * Builds the index of a license by a single pass over the JSON, without
+ * building a document. Fields are interpreted the same way as by
+ * ResponseParser_ArduinoJson5.
+ */
+class IndexBuilder : private internal::JsonScanner {
+public:
+  IndexBuilder(char const* license, size_t size, std::vector<Entry> & entries, std::string & strings)
+  : JsonScanner(license, size), entries_(entries), strings_(strings)
+  {}
+
+  bool
+  build()
+  {
+    entries_.assign(FIELD_COUNT, Entry{ABSENT, 0, 0});
+    machines_.clear();
+    data_objects_.clear();
+    strings_.clear();
+
+    if (!object_begin()) { return false; }
+
+    bool more;
+    if (!object_first(more)) { return false; }
+    while (more) {
+      std::string key;
+      if (!member_key(key)) { return false; }
+      if (!top_level_member(key)) { return false; }
+      if (!object_next(more)) { return false; }
+    }
+
+    ws();
+    if (p_ != end_) { return false; }
+
+    static Field const numbers[] = { PRODUCT_ID, CREATED, EXPIRES, PERIOD, SIGN_DATE };
+    static Field const booleans[] = { BLOCK, TRIAL_ACTIVATION, F1, F2, F3, F4, F5, F6, F7, F8 };
+    for (Field f : numbers) { if (entries_[f].kind != NUMBER) { return false; } }
+    for (Field f : booleans) { if (entries_[f].kind != BOOLEAN) { return false; } }
+
+    entries_.insert(entries_.end(), machines_.begin(), machines_.end());
+    entries_.insert(entries_.end(), data_objects_.begin(), data_objects_.end());
+
+    return true;
+  }
+
+private:
+  std::vector<Entry> & entries_;
+  std::string & strings_;
+  std::vector<Entry> machines_;
+  std::vector<Entry> data_objects_;
+
+  Entry
+  number_entry(Value const& v)
+  {
+    if (v.type != Value::JSON_NUMBER) { return Entry{ABSENT, 0, 0}; }
+    return Entry{NUMBER, 0, v.number};
+  }
+
+  Entry
+  boolean_entry(Value const& v)
+  {
+    if (v.type != Value::JSON_TRUE && v.type != Value::JSON_FALSE) { return Entry{ABSENT, 0, 0}; }
+    return Entry{BOOLEAN, 0, v.type == Value::JSON_TRUE ? 1u : 0u};
+  }
+
+  bool
+  string_entry(Value const& v, Entry & entry)
+  {
+    entry = Entry{ABSENT, 0, 0};
+    if (v.type != Value::JSON_STRING) { return true; }
+
+    if (!v.escaped) {
+      entry = Entry{STRING, (std::uint32_t)v.length, v.offset};
+      return true;
+    }
+
+    size_t offset = strings_.size();
+    decode(begin_ + v.offset, v.length, strings_);
+    entry = Entry{STRING_DECODED, (std::uint32_t)(strings_.size() - offset), offset};
+    return true;
+  }
+
+  // Sets a field of the index, failing on duplicate keys
+  static bool
+  set(Entry & slot, bool & seen, Entry entry)
+  {
+    if (seen) { return false; }
+    seen = true;
+    slot = entry;
+    return true;
+  }
+
+  bool
+  top_level_member(std::string const& key)
+  {
+    static char const* const names[FIELD_COUNT] = {
+      "ProductId", "Created", "Expires", "Period", "Block", "TrialActivation", "SignDate",
+      "F1", "F2", "F3", "F4", "F5", "F6", "F7", "F8",
+      "ID", "Key", "Notes", "GlobalId", "MaxNoOfMachines", "AllowedMachines",
+      "Customer", NULL, NULL, NULL, NULL, NULL,
+      "ActivatedMachines", "DataObjects"
+    };
+
+    int field = -1;
+    for (int i = 0; i < FIELD_COUNT; ++i) {
+      if (names[i] != NULL && key == names[i]) { field = i; break; }
+    }
+
+    if (field == -1) { Value v; return value(v, 0); }
+
+    if (seen_[field]) { return false; }
+    seen_[field] = true;
+
+    switch (field) {
+    case CUSTOMER: return customer();
+    case ACTIVATED_MACHINES: return array(machines_, ACTIVATED_MACHINES, MACHINE_FIELDS);
+    case DATA_OBJECTS: return array(data_objects_, DATA_OBJECTS, DATA_OBJECT_FIELDS);
+    default: break;
+    }
+
+    Value v;
+    if (!value(v, 0)) { return false; }
+
+    switch (field) {
+    case BLOCK: case TRIAL_ACTIVATION:
+    case F1: case F2: case F3: case F4: case F5: case F6: case F7: case F8:
+      entries_[field] = boolean_entry(v);
+      return true;
+    case KEY: case NOTES: case ALLOWED_MACHINES:
+      return string_entry(v, entries_[field]);
+    default:
+      entries_[field] = number_entry(v);
+      return true;
+    }
+  }
+
+  bool
+  customer()
+  {
+    if (!peek('{')) { Value v; return value(v, 0); }
+    ++p_;
+
+    Entry fields[5] = {};
+    bool seen[5] = {};
+    static char const* const names[5] = { "Id", "Name", "Email", "CompanyName", "Created" };
+
+    bool more;
+    if (!object_first(more)) { return false; }
+    while (more) {
+      std::string key;
+      if (!member_key(key)) { return false; }
+
+      Value v;
+      if (!value(v, 1)) { return false; }
+
+      int i = 0;
+      while (i < 5 && key != names[i]) { ++i; }
+      if (i == 0 || i == 4) {
+        if (!set(fields[i], seen[i], number_entry(v))) { return false; }
+      } else if (i < 5) {
+        Entry entry;
+        if (!string_entry(v, entry)) { return false; }
+        if (!set(fields[i], seen[i], entry)) { return false; }
+      }
+
+      if (!object_next(more)) { return false; }
+    }
+
+    if (fields[0].kind != NUMBER || fields[4].kind != NUMBER) { return true; }
+
+    entries_[CUSTOMER] = Entry{PRESENT, 0, 0};
+    for (int i = 0; i < 5; ++i) { entries_[CUSTOMER_ID + i] = fields[i]; }
+    return true;
+  }
+
+  // Reads one element of ActivatedMachines or DataObjects into fields
+  bool
+  element(int field, Entry * fields, bool & valid)
+  {
+    static char const* const machine_names[MACHINE_FIELDS] = { "Mid", "IP", "Time" };
+    static char const* const data_object_names[DATA_OBJECT_FIELDS] = { "Id", "Name", "StringValue", "IntValue" };
+
+    int n = field == ACTIVATED_MACHINES ? (int)MACHINE_FIELDS : (int)DATA_OBJECT_FIELDS;
+    char const* const* names = field == ACTIVATED_MACHINES ? machine_names : data_object_names;
+
+    if (!peek('{')) { valid = false; Value v; return value(v, 1); }
+    ++p_;
+
+    bool seen[DATA_OBJECT_FIELDS] = {};
+    for (int i = 0; i < n; ++i) { fields[i] = Entry{ABSENT, 0, 0}; }
+
+    bool more;
+    if (!object_first(more)) { return false; }
+    while (more) {
+      std::string key;
+      if (!member_key(key)) { return false; }
+
+      Value v;
+      if (!value(v, 2)) { return false; }
+
+      int i = 0;
+      while (i < n && key != names[i]) { ++i; }
+      if (i < n) {
+        bool numeric = field == ACTIVATED_MACHINES ? i == MACHINE_TIME : (i == DATA_OBJECT_ID || i == DATA_OBJECT_INT_VALUE);
+        Entry entry;
+        if (numeric) {
+          entry = number_entry(v);
+        } else if (!string_entry(v, entry)) {
+          return false;
+        }
+        if (!set(fields[i], seen[i], entry)) { return false; }
+      }
+
+      if (!object_next(more)) { return false; }
+    }
+
+    for (int i = 0; i < n; ++i) {
+      if (fields[i].kind == ABSENT) { valid = false; }
+    }
+    return true;
+  }
+
+  /*
+   * Reads ActivatedMachines or DataObjects. As with ResponseParser_ArduinoJson5,
+   * the whole array is left out if any of the elements is invalid.
+   */
+  bool
+  array(std::vector<Entry> & out, int field, int n)
+  {
+    if (!peek('[')) { Value v; return value(v, 0); }
+    ++p_;
+
+    size_t strings_size = strings_.size();
+    bool valid = true;
+    std::uint64_t count = 0;
+
+    bool more;
+    if (!array_first(more)) { return false; }
+    while (more) {
+      Entry fields[DATA_OBJECT_FIELDS];
+      if (!element(field, fields, valid)) { return false; }
+      if (valid) {
+        out.insert(out.end(), fields, fields + n);
+        ++count;
+      }
+      if (!array_next(more)) { return false; }
+    }
+
+    if (!valid) {
+      out.clear();
+      strings_.resize(strings_size);
+      return true;
+    }
+
+    entries_[field] = Entry{PRESENT, 0, count};
+    return true;
+  }
+
+  bool seen_[FIELD_COUNT] = {};
+};
+
+bool
+build_index(char const* license, size_t size, std::vector<Entry> & entries, std::string & strings)
+{
+  IndexBuilder builder(license, size, entries, strings);
+  return builder.build();
+}
+
+void
+put_entries(std::string & out, std::vector<Entry> const& entries)
+{
+  for (Entry const& entry : entries) {
+    put_u32(out, entry.kind);
+    put_u32(out, entry.length);
+    put_u64(out, entry.value);
+  }
+}
+
+} // namespace
+
+namespace internal {
+
+/*
+ * Encodes a signed license and its signature in the binary format.
+ */
+std::string
+license_key_binary_encode(basic_Error & e, std::string const& license, std::string const& signature)
+{
+  if (e) { return ""; }
+
+  std::vector<Entry> entries;
+  std::string strings;
+  if (!build_index(license.data(), license.size(), entries, strings)) {
+    e.set(api::main(), errors::Subsystem::Json);
+    return "";
+  }
+
+  std::string out;
+  out.reserve(HEADER_SIZE + ENTRY_SIZE * entries.size() + license.size() + signature.size() + strings.size());
+
+  out.append(MAGIC, sizeof(MAGIC));
+  put_u16(out, VERSION);
+  put_u16(out, 0);
+  put_u32(out, (std::uint32_t)entries.size());
+  put_u32(out, (std::uint32_t)license.size());
+  put_u32(out, (std::uint32_t)signature.size());
+  put_u32(out, (std::uint32_t)strings.size());
+  put_entries(out, entries);
+  out += license;
+  out += signature;
+  out += strings;
+
+  return out;
+}
+
+} // namespace internal
+
+LicenseKeyView::LicenseKeyView()
+: entries_(nullptr), entry_count_(0), license_(nullptr), license_size_(0)
+, signature_(nullptr), signature_size_(0), strings_(nullptr), strings_size_(0)
+{}
+
+/*
+ * Locates the sections of the buffer. The index is not checked until
+ * check_index() is called.
+ */
+void
+LicenseKeyView::load(basic_Error & e, char const* data, size_t size)
+{
+  if (e) { return; }
+
+  using namespace errors;
+  api::main api;
+
+  if (size < HEADER_SIZE) { e.set(api, Subsystem::Binary, Binary::TRUNCATED); return; }
+  if (std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) { e.set(api, Subsystem::Binary, Binary::MAGIC); return; }
+  if (get_le(data + 4, 2) != VERSION || get_le(data + 6, 2) != 0) { e.set(api, Subsystem::Binary, Binary::VERSION); return; }
+
+  entry_count_ = get_le(data + 8, 4);
+  license_size_ = get_le(data + 12, 4);
+  signature_size_ = get_le(data + 16, 4);
+  strings_size_ = get_le(data + 20, 4);
+
+  std::uint64_t total = HEADER_SIZE + (std::uint64_t)ENTRY_SIZE * entry_count_
+                      + (std::uint64_t)license_size_ + signature_size_ + strings_size_;
+  if (total != size || entry_count_ < FIELD_COUNT) { e.set(api, Subsystem::Binary, Binary::TRUNCATED); return; }
+
+  entries_ = data + HEADER_SIZE;
+  license_ = entries_ + ENTRY_SIZE * entry_count_;
+  signature_ = license_ + license_size_;
+  strings_ = signature_ + signature_size_;
+}
+
+/*
+ * Checks that the index and decoded strings are those of the signed license.
+ */
+void
+LicenseKeyView::check_index(basic_Error & e) const
+{
+  if (e) { return; }
+
+  // Reused between calls to avoid allocating for every license
+  thread_local std::vector<Entry> entries;
+  thread_local std::string strings;
+  thread_local std::string encoded;
+
+  if (!build_index(license_, license_size_, entries, strings)) {
+    e.set(api::main(), errors::Subsystem::Json);
+    return;
+  }
+
+  encoded.clear();
+  put_entries(encoded, entries);
+
+  bool same =
+       entries.size() == entry_count_
+    && std::memcmp(encoded.data(), entries_, encoded.size()) == 0
+    && strings.size() == strings_size_
+    && std::memcmp(strings.data(), strings_, strings_size_) == 0;
+
+  if (!same) { e.set(api::main(), errors::Subsystem::Binary, errors::Binary::INDEX_MISMATCH); }
+}
+
+std::uint32_t
+LicenseKeyView::kind(size_t i) const
+{
+  return (std::uint32_t)get_le(entries_ + ENTRY_SIZE * i, 4);
+}
+
+std::uint64_t
+LicenseKeyView::number(size_t i) const
+{
+  return get_le(entries_ + ENTRY_SIZE * i + 8, 8);
+}
+
+StringView
+LicenseKeyView::string(size_t i) const
+{
+  char const* entry = entries_ + ENTRY_SIZE * i;
+  std::uint32_t k = (std::uint32_t)get_le(entry, 4);
+  size_t length = get_le(entry + 4, 4);
+  size_t offset = get_le(entry + 8, 8);
+
+  if (k == STRING) { return StringView(license_ + offset, length); }
+  if (k == STRING_DECODED) { return StringView(strings_ + offset, length); }
+  return StringView();
+}
+
+/**
+ * Returns the signed license, i.e. the license key as JSON
+ */
+StringView LicenseKeyView::get_license() const { return StringView(license_, license_size_); }
+
+/**
+ * Returns the base64 encoded signature of the license
+ */
+StringView LicenseKeyView::get_signature() const { return StringView(signature_, signature_size_); }
+
+int           LicenseKeyView::get_product_id() const { return (int)number(PRODUCT_ID); }
+std::uint64_t LicenseKeyView::get_created() const { return number(CREATED); }
+std::uint64_t LicenseKeyView::get_expires() const { return number(EXPIRES); }
+int           LicenseKeyView::get_period() const { return (int)number(PERIOD); }
+bool          LicenseKeyView::get_block() const { return number(BLOCK) != 0; }
+bool          LicenseKeyView::get_trial_activation() const { return number(TRIAL_ACTIVATION) != 0; }
+std::uint64_t LicenseKeyView::get_sign_date() const { return number(SIGN_DATE); }
+bool          LicenseKeyView::get_f1() const { return number(F1) != 0; }
+bool          LicenseKeyView::get_f2() const { return number(F2) != 0; }
+bool          LicenseKeyView::get_f3() const { return number(F3) != 0; }
+bool          LicenseKeyView::get_f4() const { return number(F4) != 0; }
+bool          LicenseKeyView::get_f5() const { return number(F5) != 0; }
+bool          LicenseKeyView::get_f6() const { return number(F6) != 0; }
+bool          LicenseKeyView::get_f7() const { return number(F7) != 0; }
+bool          LicenseKeyView::get_f8() const { return number(F8) != 0; }
+
+optional<int>
+LicenseKeyView::get_id() const
+{
+  if (kind(ID) == ABSENT) { return nullopt; }
+  return (int)number(ID);
+}
+
+optional<StringView>
+LicenseKeyView::get_key() const
+{
+  if (kind(KEY) == ABSENT) { return nullopt; }
+  return string(KEY);
+}
+
+optional<StringView>
+LicenseKeyView::get_notes() const
+{
+  if (kind(NOTES) == ABSENT) { return nullopt; }
+  return string(NOTES);
+}
+
+optional<int>
+LicenseKeyView::get_global_id() const
+{
+  if (kind(GLOBAL_ID) == ABSENT) { return nullopt; }
+  return (int)number(GLOBAL_ID);
+}
+
+optional<CustomerView>
+LicenseKeyView::get_customer() const
+{
+  if (kind(CUSTOMER) == ABSENT) { return nullopt; }
+
+  return CustomerView
+    ( (int)number(CUSTOMER_ID)
+    , string(CUSTOMER_NAME)
+    , string(CUSTOMER_EMAIL)
+    , string(CUSTOMER_COMPANY_NAME)
+    , number(CUSTOMER_CREATED)
+    );
+}
+
+optional<int>
+LicenseKeyView::get_maxnoofmachines() const
+{
+  if (kind(MAXNOOFMACHINES) == ABSENT) { return nullopt; }
+  return (int)number(MAXNOOFMACHINES);
+}
+
+optional<StringView>
+LicenseKeyView::get_allowed_machines() const
+{
+  if (kind(ALLOWED_MACHINES) == ABSENT) { return nullopt; }
+  return string(ALLOWED_MACHINES);
+}
+
+/**
+ * Returns the number of activated machines, or nullopt if the license key
+ * does not include the activated machines.
+ */
+optional<size_t>
+LicenseKeyView::get_activated_machines_count() const
+{
+  if (kind(ACTIVATED_MACHINES) == ABSENT) { return nullopt; }
+  return (size_t)number(ACTIVATED_MACHINES);
+}
+
+/**
+ * Returns the i:th activated machine, where i is less than
+ * get_activated_machines_count().
+ */
+ActivationDataView
+LicenseKeyView::get_activated_machine(size_t i) const
+{
+  size_t k = FIELD_COUNT + MACHINE_FIELDS * i;
+  return ActivationDataView(string(k + MACHINE_MID), string(k + MACHINE_IP), number(k + MACHINE_TIME));
+}
+
+/**
+ * Returns the number of data objects, or nullopt if the license key does
+ * not include the data objects.
+ */
+optional<size_t>
+LicenseKeyView::get_data_objects_count() const
+{
+  if (kind(DATA_OBJECTS) == ABSENT) { return nullopt; }
+  return (size_t)number(DATA_OBJECTS);
+}
+
+/**
+ * Returns the i:th data object, where i is less than
+ * get_data_objects_count().
+ */
+DataObjectView
+LicenseKeyView::get_data_object(size_t i) const
+{
+  size_t machines = kind(ACTIVATED_MACHINES) == ABSENT ? 0 : (size_t)number(ACTIVATED_MACHINES);
+  size_t k = FIELD_COUNT + MACHINE_FIELDS * machines + DATA_OBJECT_FIELDS * i;
+  return DataObjectView
+    ( (int)number(k + DATA_OBJECT_ID)
+    , string(k + DATA_OBJECT_NAME)
+    , string(k + DATA_OBJECT_STRING_VALUE)
+    , (int)number(k + DATA_OBJECT_INT_VALUE)
+    );
+}
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
@@ -0,0 +1,127 @@
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include "MemoryResource.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace {
+
+char *
+align_up(char * p, size_t alignment)
+{
+  std::uintptr_t x = reinterpret_cast<std::uintptr_t>(p);
+  return p + ((alignment - x % alignment) % alignment);
+}
+
+/*
+ * Before C++17, operator new only guarantees alignof(std::max_align_t), thus
+ * larger alignments are obtained by allocating more memory than asked for.
+ * The pointer returned by operator new is kept just before the aligned
+ * memory handed out.
+ */
+class MemoryResource_new_delete : public MemoryResource {
+public:
+  void *
+  allocate(size_t bytes, size_t alignment) override
+  {
+    if (alignment <= alignof(std::max_align_t)) { return ::operator new(bytes); }
+
+    char * p = static_cast<char *>(::operator new(bytes + alignment + sizeof(void *)));
+    char * q = align_up(p + sizeof(void *), alignment);
+    std::memcpy(q - sizeof(void *), &p, sizeof(p));
+    return q;
+  }
+
+  void
+  deallocate(void * p, size_t, size_t alignment) override
+  {
+    if (alignment > alignof(std::max_align_t)) { std::memcpy(&p, static_cast<char *>(p) - sizeof(void *), sizeof(p)); }
+    ::operator delete(p);
+  }
+};
+
+} // namespace
+
+MemoryResource &
+new_delete_resource()
+{
+  static MemoryResource_new_delete resource;
+  return resource;
+}
+
+MonotonicBufferResource::MonotonicBufferResource(size_t initial_size, MemoryResource * upstream)
+: upstream_(upstream), blocks_(nullptr), current_(nullptr), next_(nullptr), end_(nullptr)
+, initial_size_(initial_size < 64 ? 64 : initial_size)
+{}
+
+MonotonicBufferResource::~MonotonicBufferResource()
+{
+  while (blocks_) {
+    Block * next = blocks_->next;
+    upstream_->deallocate(blocks_, blocks_->size);
+    blocks_ = next;
+  }
+}
+
+/**
+ * Returns memory from the current block, moving on to the next block, or
+ * allocating a new one twice as large as the previous, if it is full.
+ */
+void *
+MonotonicBufferResource::allocate(size_t bytes, size_t alignment)
+{
+  for (;;) {
+    if (next_) {
+      char * p = align_up(next_, alignment);
+      if (p <= end_ && bytes <= (size_t)(end_ - p)) {
+        next_ = p + bytes;
+        return p;
+      }
+    }
+
+    // Reuse the blocks kept by release() before allocating new ones
+    Block * block = current_ ? current_->next : blocks_;
+    if (block && block->size < sizeof(Block) + bytes + alignment) { block = nullptr; }
+
+    if (!block) {
+      size_t size = current_ ? 2 * current_->size : initial_size_;
+      if (size < sizeof(Block) + bytes + alignment) { size = sizeof(Block) + bytes + alignment; }
+
+      block = static_cast<Block *>(upstream_->allocate(size));
+      block->size = size;
+
+      // Insert after the current block, keeping any blocks after it for later
+      if (current_) {
+        block->next = current_->next;
+        current_->next = block;
+      } else {
+        block->next = blocks_;
+        blocks_ = block;
+      }
+    }
+
+    current_ = block;
+    next_ = reinterpret_cast<char *>(block + 1);
+    end_ = reinterpret_cast<char *>(block) + block->size;
+  }
+}
+
+/**
+ * Makes all memory handed out by this resource available again, without
+ * returning the blocks to the upstream resource.
+ */
+void
+MonotonicBufferResource::release()
+{
+  current_ = nullptr;
+  next_ = nullptr;
+  end_ = nullptr;
+}
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
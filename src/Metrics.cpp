@@ -0,0 +1,566 @@
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "api.hpp"
+#include "Metrics.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace internal {
+
+namespace {
+
+int constexpr SUBSYSTEMS = 16;
+int constexpr REASONS = 64;
+
+// Phases of a request, as reported in RequestStatistics
+int constexpr PHASE_NAMELOOKUP = 0;
+int constexpr PHASE_CONNECT = 1;
+int constexpr PHASE_APPCONNECT = 2;
+int constexpr PHASE_STARTTRANSFER = 3;
+int constexpr PHASE_TOTAL = 4;
+int constexpr PHASES = 5;
+
+char const* const stage_names[instrumentation::Stage::COUNT] = {
+  "activate",
+  "request",
+  "handle_activate",
+  "parse_activate_response",
+  "raw_license_key_make",
+  "base64_decode",
+  "signature_verification",
+  "make_license_key_information",
+  "validate",
+};
+
+char const* const phase_names[PHASES] = {
+  "namelookup",
+  "connect",
+  "appconnect",
+  "starttransfer",
+  "total",
+};
+
+char const* const subsystem_names[] = {
+  "Ok",
+  "Main",
+  "Json",
+  "Base64",
+  "RequestHandler",
+  "SignatureVerifier",
+  "Executor",
+  "Binary",
+  "File",
+};
+
+int constexpr subsystem_names_size = sizeof(subsystem_names) / sizeof(subsystem_names[0]);
+
+/*
+ * The counters below are only written by the thread owning the shard they
+ * belong to. Thus a relaxed load followed by a relaxed store is sufficient,
+ * and avoids the locked instructions of fetch_add() on the hot path.
+ */
+void
+increment(std::atomic<std::uint64_t> & counter, std::uint64_t n = 1)
+{
+  counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+int
+most_significant_bit(std::uint64_t v)
+{
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(v);
+#else
+  int r = 0;
+  while (v >>= 1) { ++r; }
+  return r;
+#endif
+}
+
+} // namespace
+
+/*
+ * A histogram in the style of HdrHistogram. Values below 32 have a bucket
+ * each, after that each power of two is split into 16 buckets of equal
+ * width. This gives a relative error of at most 1/16 over the whole range.
+ * Values of MAX_VALUE and above are counted in the last bucket.
+ */
+class LatencyHistogram {
+public:
+  static int constexpr SUB_BUCKET_BITS = 5;
+  static int constexpr SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static int constexpr HALF_SUB_BUCKETS = SUB_BUCKETS / 2;
+  static int constexpr MAX_BITS = 40;
+  static int constexpr BUCKETS = SUB_BUCKETS + (MAX_BITS - SUB_BUCKET_BITS) * HALF_SUB_BUCKETS;
+
+  static std::uint64_t constexpr MAX_VALUE = (std::uint64_t(1) << MAX_BITS) - 1;
+
+  LatencyHistogram()
+  {
+    for (int i = 0; i < BUCKETS; ++i) { counts_[i].store(0, std::memory_order_relaxed); }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+  }
+
+  static int
+  index_of(std::uint64_t v)
+  {
+    if (v > MAX_VALUE) { v = MAX_VALUE; }
+    if (v < SUB_BUCKETS) { return (int)v; }
+
+    int shift = most_significant_bit(v) - (SUB_BUCKET_BITS - 1);
+    return SUB_BUCKETS + (shift - 1) * HALF_SUB_BUCKETS + (int)((v >> shift) - HALF_SUB_BUCKETS);
+  }
+
+  // Returns the largest value that is recorded in the given bucket
+  static std::uint64_t
+  highest_value_of(int index)
+  {
+    if (index < SUB_BUCKETS) { return index; }
+
+    int k = index - SUB_BUCKETS;
+    int shift = k / HALF_SUB_BUCKETS + 1;
+    std::uint64_t sub = k % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+  }
+
+  void
+  record(std::uint64_t v)
+  {
+    increment(counts_[index_of(v)]);
+    increment(count_);
+    increment(sum_, v);
+    if (v > max_.load(std::memory_order_relaxed)) { max_.store(v, std::memory_order_relaxed); }
+  }
+
+  std::atomic<std::uint64_t> counts_[BUCKETS];
+  std::atomic<std::uint64_t> count_;
+  std::atomic<std::uint64_t> sum_;
+  std::atomic<std::uint64_t> max_;
+};
+
+struct MetricsShard {
+  MetricsShard()
+  {
+    activations.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < SUBSYSTEMS; ++i) {
+      for (int j = 0; j < REASONS; ++j) { failures[i][j].store(0, std::memory_order_relaxed); }
+    }
+    requests.store(0, std::memory_order_relaxed);
+    bytes_sent.store(0, std::memory_order_relaxed);
+    bytes_received.store(0, std::memory_order_relaxed);
+    cache_hits.store(0, std::memory_order_relaxed);
+  }
+
+  std::atomic<std::uint64_t> activations;
+  // The last reason is used for reasons out of range
+  std::atomic<std::uint64_t> failures[SUBSYSTEMS][REASONS];
+  std::atomic<std::uint64_t> requests;
+  std::atomic<std::uint64_t> bytes_sent;
+  std::atomic<std::uint64_t> bytes_received;
+  std::atomic<std::uint64_t> cache_hits;
+  LatencyHistogram stages[instrumentation::Stage::COUNT];
+  LatencyHistogram phases[PHASES];
+};
+
+/*
+ * Owns the shards of all threads. A thread obtains its shard the first time
+ * it records something, and hands it back when it exits so that the next
+ * new thread can continue recording into it. Shards are never freed, thus
+ * the totals are not affected by threads exiting.
+ */
+class MetricsRegistry {
+public:
+  MetricsShard &
+  local()
+  {
+    struct Handle {
+      MetricsRegistry * registry = nullptr;
+      MetricsShard * shard = nullptr;
+
+      ~Handle() { if (shard) { registry->release(shard); } }
+    };
+
+    static thread_local Handle handle;
+
+    if (!handle.shard) {
+      handle.registry = this;
+      handle.shard = acquire();
+    }
+
+    return *handle.shard;
+  }
+
+  template<typename F>
+  void
+  for_each(F f) const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto const& shard : shards_) { f(*shard); }
+  }
+
+private:
+  MetricsShard *
+  acquire()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!free_.empty()) {
+      MetricsShard * shard = free_.back();
+      free_.pop_back();
+      return shard;
+    }
+
+    shards_.emplace_back(new MetricsShard());
+    return shards_.back().get();
+  }
+
+  void
+  release(MetricsShard * shard)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(shard);
+  }
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<MetricsShard>> shards_;
+  std::vector<MetricsShard *> free_;
+};
+
+namespace {
+
+struct HistogramSnapshot {
+  HistogramSnapshot() : counts(LatencyHistogram::BUCKETS, 0), count(0), sum(0), max(0) {}
+
+  void
+  add(LatencyHistogram const& h)
+  {
+    for (int i = 0; i < LatencyHistogram::BUCKETS; ++i) { counts[i] += h.counts_[i].load(std::memory_order_relaxed); }
+    count += h.count_.load(std::memory_order_relaxed);
+    sum += h.sum_.load(std::memory_order_relaxed);
+    std::uint64_t m = h.max_.load(std::memory_order_relaxed);
+    if (m > max) { max = m; }
+  }
+
+  std::uint64_t
+  value_at_quantile(double q) const
+  {
+    std::uint64_t total = 0;
+    for (std::uint64_t c : counts) { total += c; }
+    if (total == 0) { return 0; }
+
+    std::uint64_t rank = (std::uint64_t)(q * total + 0.5);
+    if (rank < 1) { rank = 1; }
+
+    std::uint64_t seen = 0;
+    for (int i = 0; i < LatencyHistogram::BUCKETS; ++i) {
+      seen += counts[i];
+      if (seen >= rank) {
+        std::uint64_t v = LatencyHistogram::highest_value_of(i);
+        return v < max ? v : max;
+      }
+    }
+
+    return max;
+  }
+
+  std::vector<std::uint64_t> counts;
+  std::uint64_t count;
+  std::uint64_t sum;
+  std::uint64_t max;
+};
+
+struct Snapshot {
+  Snapshot()
+  : activations(0), failures(SUBSYSTEMS * REASONS, 0), requests(0), bytes_sent(0), bytes_received(0)
+  , cache_hits(0), stages(instrumentation::Stage::COUNT), phases(PHASES)
+  {}
+
+  void
+  add(MetricsShard const& shard)
+  {
+    activations += shard.activations.load(std::memory_order_relaxed);
+    for (int i = 0; i < SUBSYSTEMS; ++i) {
+      for (int j = 0; j < REASONS; ++j) {
+        failures[i * REASONS + j] += shard.failures[i][j].load(std::memory_order_relaxed);
+      }
+    }
+    requests += shard.requests.load(std::memory_order_relaxed);
+    bytes_sent += shard.bytes_sent.load(std::memory_order_relaxed);
+    bytes_received += shard.bytes_received.load(std::memory_order_relaxed);
+    cache_hits += shard.cache_hits.load(std::memory_order_relaxed);
+    for (int i = 0; i < instrumentation::Stage::COUNT; ++i) { stages[i].add(shard.stages[i]); }
+    for (int i = 0; i < PHASES; ++i) { phases[i].add(shard.phases[i]); }
+  }
+
+  std::uint64_t activations;
+  std::vector<std::uint64_t> failures;
+  std::uint64_t requests;
+  std::uint64_t bytes_sent;
+  std::uint64_t bytes_received;
+  std::uint64_t cache_hits;
+  std::vector<HistogramSnapshot> stages;
+  std::vector<HistogramSnapshot> phases;
+};
+
+double const quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+char const* const quantile_names[] = { "0.5", "0.9", "0.99", "0.999" };
+char const* const quantile_json_names[] = { "p50_ns", "p90_ns", "p99_ns", "p999_ns" };
+
+void
+write_subsystem_name(std::ostream & out, int subsystem)
+{
+  if (subsystem < subsystem_names_size) { out << subsystem_names[subsystem]; }
+  else                                  { out << subsystem; }
+}
+
+void
+write_reason(std::ostream & out, int reason)
+{
+  if (reason == REASONS - 1) { out << "other"; }
+  else                       { out << reason; }
+}
+
+void
+write_prometheus_counter(std::ostream & out, char const* name, char const* help, std::uint64_t value)
+{
+  out << "# HELP " << name << ' ' << help << '\n';
+  out << "# TYPE " << name << " counter\n";
+  out << name << ' ' << value << '\n';
+}
+
+void
+write_prometheus_summary
+  ( std::ostream & out
+  , char const* name
+  , char const* help
+  , char const* label
+  , char const* const* label_values
+  , std::vector<HistogramSnapshot> const& histograms
+  )
+{
+  out << "# HELP " << name << ' ' << help << '\n';
+  out << "# TYPE " << name << " summary\n";
+  for (size_t i = 0; i < histograms.size(); ++i) {
+    HistogramSnapshot const& h = histograms[i];
+    if (h.count == 0) { continue; }
+
+    for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); ++q) {
+      out << name << '{' << label << "=\"" << label_values[i] << "\",quantile=\"" << quantile_names[q] << "\"} "
+          << h.value_at_quantile(quantiles[q]) / 1e9 << '\n';
+    }
+    out << name << "_sum{" << label << "=\"" << label_values[i] << "\"} " << h.sum / 1e9 << '\n';
+    out << name << "_count{" << label << "=\"" << label_values[i] << "\"} " << h.count << '\n';
+  }
+}
+
+void
+write_json_histograms
+  ( std::ostream & out
+  , char const* const* names
+  , std::vector<HistogramSnapshot> const& histograms
+  )
+{
+  out << '{';
+  bool first = true;
+  for (size_t i = 0; i < histograms.size(); ++i) {
+    HistogramSnapshot const& h = histograms[i];
+    if (h.count == 0) { continue; }
+
+    if (!first) { out << ','; }
+    first = false;
+
+    out << '"' << names[i] << "\":{\"count\":" << h.count << ",\"sum_ns\":" << h.sum << ",\"max_ns\":" << h.max;
+    for (size_t q = 0; q < sizeof(quantiles) / sizeof(quantiles[0]); ++q) {
+      out << ",\"" << quantile_json_names[q] << "\":" << h.value_at_quantile(quantiles[q]);
+    }
+    out << '}';
+  }
+  out << '}';
+}
+
+} // namespace
+
+} // namespace internal
+
+Metrics::Metrics()
+: registry_(new internal::MetricsRegistry())
+{}
+
+/**
+ * Returns the process wide Metrics object.
+ */
+Metrics &
+Metrics::get()
+{
+  // NOTE: Intentionally never destroyed, since threads may still record
+  //       measurements while static objects are being destroyed.
+  static Metrics * metrics = new Metrics();
+  return *metrics;
+}
+
+/**
+ * Records that a stage took the given number of nanoseconds.
+ */
+void
+Metrics::record_stage(int stage, std::uint64_t nanoseconds)
+{
+  if (stage < 0 || stage >= instrumentation::Stage::COUNT) { return; }
+
+  registry_->local().stages[stage].record(nanoseconds);
+}
+
+/**
+ * Records the statistics of a request made to the Web API.
+ */
+void
+Metrics::record_request(RequestStatistics const& statistics)
+{
+  using namespace internal;
+  MetricsShard & shard = registry_->local();
+
+  increment(shard.requests);
+  increment(shard.bytes_sent, statistics.bytes_sent);
+  increment(shard.bytes_received, statistics.bytes_received);
+
+  // A total time of zero means that the RequestHandler does not report timings
+  if (statistics.total_time == 0) { return; }
+
+  shard.phases[PHASE_NAMELOOKUP].record(statistics.namelookup_time * 1000);
+  shard.phases[PHASE_CONNECT].record(statistics.connect_time * 1000);
+  shard.phases[PHASE_APPCONNECT].record(statistics.appconnect_time * 1000);
+  shard.phases[PHASE_STARTTRANSFER].record(statistics.starttransfer_time * 1000);
+  shard.phases[PHASE_TOTAL].record(statistics.total_time * 1000);
+}
+
+/**
+ * Records the outcome of an activation. If the error object is in an error
+ * state the activation is counted as failed.
+ */
+void
+Metrics::record_activation(basic_Error const& e)
+{
+  using namespace internal;
+  MetricsShard & shard = registry_->local();
+
+  increment(shard.activations);
+
+  if (!e) { return; }
+
+  int subsystem = e.get_subsystem(api::main());
+  int reason = e.get_reason(api::main());
+  if (subsystem < 0 || subsystem >= SUBSYSTEMS) { return; }
+  if (reason < 0 || reason >= REASONS - 1) { reason = REASONS - 1; }
+
+  increment(shard.failures[subsystem][reason]);
+}
+
+/**
+ * Records a cache hit.
+ */
+void
+Metrics::record_cache_hit()
+{
+  internal::increment(registry_->local().cache_hits);
+}
+
+/**
+ * Returns the measurements of all threads in the Prometheus text exposition
+ * format. Durations are given in seconds.
+ */
+std::string
+Metrics::format_prometheus() const
+{
+  using namespace internal;
+  Snapshot snapshot;
+  registry_->for_each([&snapshot](MetricsShard const& shard) { snapshot.add(shard); });
+
+  std::ostringstream out;
+
+  write_prometheus_counter(out, "cryptolens_activations_total", "Number of activations performed.", snapshot.activations);
+
+  out << "# HELP cryptolens_activation_failures_total Number of failed activations by error subsystem and reason.\n";
+  out << "# TYPE cryptolens_activation_failures_total counter\n";
+  for (int i = 0; i < SUBSYSTEMS; ++i) {
+    for (int j = 0; j < REASONS; ++j) {
+      std::uint64_t n = snapshot.failures[i * REASONS + j];
+      if (n == 0) { continue; }
+
+      out << "cryptolens_activation_failures_total{subsystem=\"";
+      write_subsystem_name(out, i);
+      out << "\",reason=\"";
+      write_reason(out, j);
+      out << "\"} " << n << '\n';
+    }
+  }
+
+  write_prometheus_counter(out, "cryptolens_requests_total", "Number of requests made to the Web API.", snapshot.requests);
+  write_prometheus_counter(out, "cryptolens_bytes_sent_total", "Number of bytes sent to the Web API.", snapshot.bytes_sent);
+  write_prometheus_counter(out, "cryptolens_bytes_received_total", "Number of bytes received from the Web API.", snapshot.bytes_received);
+  write_prometheus_counter(out, "cryptolens_cache_hits_total", "Number of cache hits.", snapshot.cache_hits);
+
+  write_prometheus_summary(out, "cryptolens_stage_duration_seconds", "Time spent in each stage of the library.", "stage", stage_names, snapshot.stages);
+  write_prometheus_summary(out, "cryptolens_request_phase_seconds", "Time from the start of a request until the end of each phase.", "phase", phase_names, snapshot.phases);
+
+  return out.str();
+}
+
+/**
+ * Returns the measurements of all threads as a JSON document. Durations are
+ * given in nanoseconds.
+ */
+std::string
+Metrics::format_json() const
+{
+  using namespace internal;
+  Snapshot snapshot;
+  registry_->for_each([&snapshot](MetricsShard const& shard) { snapshot.add(shard); });
+
+  std::ostringstream out;
+
+  out << "{\"activations\":" << snapshot.activations;
+
+  out << ",\"activation_failures\":[";
+  bool first = true;
+  for (int i = 0; i < SUBSYSTEMS; ++i) {
+    for (int j = 0; j < REASONS; ++j) {
+      std::uint64_t n = snapshot.failures[i * REASONS + j];
+      if (n == 0) { continue; }
+
+      if (!first) { out << ','; }
+      first = false;
+
+      out << "{\"subsystem\":\"";
+      write_subsystem_name(out, i);
+      out << "\",\"reason\":\"";
+      write_reason(out, j);
+      out << "\",\"count\":" << n << '}';
+    }
+  }
+  out << ']';
+
+  out << ",\"requests\":" << snapshot.requests;
+  out << ",\"bytes_sent\":" << snapshot.bytes_sent;
+  out << ",\"bytes_received\":" << snapshot.bytes_received;
+  out << ",\"cache_hits\":" << snapshot.cache_hits;
+
+  out << ",\"stages\":";
+  write_json_histograms(out, stage_names, snapshot.stages);
+  out << ",\"request_phases\":";
+  write_json_histograms(out, phase_names, snapshot.phases);
+
+  out << '}';
+
+  return out.str();
+}
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cstdlib>
 #include <iterator>
 #include <string>
 #include <vector>
@@ -85,6 +86,33 @@ RequestHandler_WinHTTP_PostBuilder::make(basic_Error & e)
   std::string response;
   std::vector<char> resp_temp;
 
+  // The host may include the scheme and port, e.g. http://localhost:8080 or
+  // http://[::1]:8080
+  std::string host(host_);
+  bool secure = true;
+  INTERNET_PORT port = INTERNET_DEFAULT_HTTPS_PORT;
+
+  size_t k = host.find("://");
+  if (k != std::string::npos) {
+    if (host.compare(0, k, "http") == 0) { secure = false; port = INTERNET_DEFAULT_HTTP_PORT; }
+    host.erase(0, k + 3);
+  }
+
+  k = host.find('/');
+  if (k != std::string::npos) { host.erase(k); }
+
+  // An IPv6 address contains colons itself, thus the port is only looked
+  // for after the closing bracket
+  size_t address_end;
+  address_end = host.compare(0, 1, "[") == 0 ? host.find(']') : 0;
+  if (address_end == std::string::npos) { address_end = 0; }
+
+  k = host.find(':', address_end);
+  if (k != std::string::npos) { port = (INTERNET_PORT)std::atoi(host.c_str() + k + 1); host.erase(k); }
+
+  // WinHttpConnect() takes the address without the brackets
+  if (address_end != 0) { host = host.substr(1, address_end - 1); }
+
   if (postfields_.size() > 0xFFFFFFFF) { e.set(api, Subsystem::RequestHandler, err::WINHTTP_POSTFIELDS_TOO_LARGE, GetLastError()); goto cleanup; }
 
   int size, res;
@@ -94,10 +122,10 @@ RequestHandler_WinHTTP_PostBuilder::make(basic_Error & e)
   res = MultiByteToWideChar(CP_UTF8, 0, endpoint_, -1, endpoint_w, size);
   if (res == 0) { e.set(api, Subsystem::RequestHandler, err::MULTIBYTETOWIDE_ENDPOINT, GetLastError()); goto cleanup; }
 
-  size = MultiByteToWideChar(CP_UTF8, 0, host_, -1, NULL, 0);
+  size = MultiByteToWideChar(CP_UTF8, 0, host.c_str(), -1, NULL, 0);
   if (size == 0) { e.set(api, Subsystem::RequestHandler, err::MULTIBYTETOWIDE_HOST, GetLastError()); goto cleanup; }
   host_w = new wchar_t[size];
-  res = MultiByteToWideChar(CP_UTF8, 0, host_, -1, host_w, size);
+  res = MultiByteToWideChar(CP_UTF8, 0, host.c_str(), -1, host_w, size);
   if (res == 0) { e.set(api, Subsystem::RequestHandler, err::MULTIBYTETOWIDE_HOST, GetLastError()); goto cleanup; }
 
 
@@ -108,7 +136,7 @@ RequestHandler_WinHTTP_PostBuilder::make(basic_Error & e)
                         , 0);
   if (!hSession) { e.set(api, Subsystem::RequestHandler, err::WINHTTP_OPEN_FAILED, GetLastError()); goto cleanup; }
 
-  hConnect = WinHttpConnect(hSession, host_w, INTERNET_DEFAULT_HTTPS_PORT, 0);
+  hConnect = WinHttpConnect(hSession, host_w, port, 0);
   if (!hConnect) { e.set(api, Subsystem::RequestHandler, err::WINHTTP_CONNECT_FAILED, GetLastError()); goto cleanup; }
 
   hRequest = WinHttpOpenRequest( hConnect
@@ -117,7 +145,7 @@ RequestHandler_WinHTTP_PostBuilder::make(basic_Error & e)
                                , NULL
                                , WINHTTP_NO_REFERER
                                , WINHTTP_DEFAULT_ACCEPT_TYPES
-                               , WINHTTP_FLAG_SECURE);
+                               , secure ? WINHTTP_FLAG_SECURE : 0);
   if (!hRequest) { e.set(api, Subsystem::RequestHandler, err::WINHTTP_OPEN_REQUEST_FAILED, GetLastError()); goto cleanup; }
 
   result =  WinHttpSendRequest( hRequest
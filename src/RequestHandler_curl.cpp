@@ -1,6 +1,23 @@
-#ifdef CRYPTOLENS_CURL_EMBED_CACERTS
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
 #include <vector>
 
+#include <unistd.h>
+
+#ifdef CRYPTOLENS_CURL_EMBED_CACERTS
+#include <cstddef>
+
 #include "imports/openssl/ssl.h"
 #endif /* CRYPTOLENS_CURL_EMBED_CACERTS */
 
@@ -10,35 +27,994 @@ namespace cryptolens_io {
 
 namespace v20190401 {
 
+namespace {
+
+/*
+ * The TLS session cache shared by all handles in the process. The share is
+ * never freed, since it must outlive every handle using it.
+ */
+CURLSH * tls_session_share = NULL;
+std::once_flag tls_session_share_once;
+std::mutex tls_session_share_locks[CURL_LOCK_DATA_LAST];
+
+void
+tls_session_share_lock(CURL *, curl_lock_data data, curl_lock_access, void *)
+{
+  tls_session_share_locks[data].lock();
+}
+
+void
+tls_session_share_unlock(CURL *, curl_lock_data data, void *)
+{
+  tls_session_share_locks[data].unlock();
+}
+
+void
+init_tls_session_share()
+{
+  CURLSH * share = curl_share_init();
+  if (share == NULL) { return; }
+
+  if (curl_share_setopt(share, CURLSHOPT_LOCKFUNC, tls_session_share_lock) != CURLSHE_OK ||
+      curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, tls_session_share_unlock) != CURLSHE_OK ||
+      curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION) != CURLSHE_OK)
+  {
+    curl_share_cleanup(share);
+    return;
+  }
+
+  tls_session_share = share;
+}
+
+#if LIBCURL_VERSION_NUM >= 0x080c00
+
+/*
+ * The file written by save_tls_sessions() starts with the magic string below,
+ * followed by one record per session:
+ *
+ *     u32 size, session key | u32 size, shmac | u32 size, session data | i64 valid until
+ *
+ * with integers stored in native byte order.
+ */
+char const tls_session_file_magic[] = "CRYPTOLENS-TLS-SESSIONS-1\n";
+
+void
+write_u32(std::ostream & out, std::uint32_t x)
+{
+  out.write((char const*)&x, sizeof(x));
+}
+
+void
+write_bytes(std::ostream & out, void const* p, size_t n)
+{
+  write_u32(out, (std::uint32_t)n);
+  if (n > 0) { out.write((char const*)p, n); }
+}
+
+bool
+read_bytes(std::istream & in, std::string & s)
+{
+  std::uint32_t n;
+  if (!in.read((char *)&n, sizeof(n))) { return false; }
+  // Sessions are a few kilobytes at most, anything larger is a corrupt file
+  if (n > (1 << 20)) { return false; }
+  s.resize(n);
+  return n == 0 || (bool)in.read(&s[0], n);
+}
+
+CURLcode
+export_tls_session
+  ( CURL *
+  , void * userptr
+  , char const* session_key
+  , unsigned char const* shmac
+  , size_t shmac_len
+  , unsigned char const* sdata
+  , size_t sdata_len
+  , curl_off_t valid_until
+  , int
+  , char const*
+  , size_t
+  )
+{
+  std::ostream & out = *(std::ostream *)userptr;
+
+  write_bytes(out, session_key, session_key ? std::strlen(session_key) : 0);
+  write_bytes(out, shmac, shmac_len);
+  write_bytes(out, sdata, sdata_len);
+  std::int64_t t = valid_until;
+  out.write((char const*)&t, sizeof(t));
+
+  return out ? CURLE_OK : CURLE_WRITE_ERROR;
+}
+
+/*
+ * The name of the temporary file written by save_tls_sessions() before it
+ * replaces the session file. Several handles, in this or other processes,
+ * may save the same file at once, thus the name includes the process id and
+ * a counter.
+ */
+std::string
+tls_session_tmp_file(std::string const& path)
+{
+  static std::atomic<unsigned long> counter(0);
+  return path + ".tmp." + std::to_string((long)getpid()) + "." + std::to_string(counter++);
+}
+
+/*
+ * Imports the sessions stored in the file. Since resuming a session is only
+ * an optimization, a missing or corrupt file is silently ignored.
+ */
+void
+import_tls_sessions(CURL * curl, std::string const& path)
+{
+  std::ifstream in(path.c_str(), std::ios::binary);
+  if (!in) { return; }
+
+  std::string magic(sizeof(tls_session_file_magic) - 1, '\0');
+  if (!in.read(&magic[0], magic.size()) || magic != tls_session_file_magic) { return; }
+
+  std::int64_t now = std::time(NULL);
+  std::string session_key, shmac, sdata;
+  std::int64_t valid_until;
+  while (read_bytes(in, session_key) && read_bytes(in, shmac) && read_bytes(in, sdata) &&
+         in.read((char *)&valid_until, sizeof(valid_until)))
+  {
+    if (valid_until <= now) { continue; }
+
+    curl_easy_ssls_import
+      ( curl
+      , session_key.empty() ? NULL : session_key.c_str()
+      , (unsigned char const*)shmac.data(), shmac.size()
+      , (unsigned char const*)sdata.data(), sdata.size()
+      );
+  }
+}
+
+#endif
+
+} // namespace
+
+/*
+ * RequestHandler_curl_Multi
+ *
+ * Performs the requests of all handles with HTTP/2 multiplexing enabled on a
+ * single curl multi handle, which owns the connections. Each request is
+ * handed over to a background thread driving the multi handle, while the
+ * calling thread waits for the transfer to finish. This way concurrent
+ * requests to the same host become streams on a shared connection.
+ *
+ * Asynchronous requests are performed the same way, except that a callback
+ * is called on the background thread when the transfer has finished.
+ *
+ * The engine is shared by all RequestHandler_curl objects using it, and is
+ * shut down when the last of them is destroyed.
+ */
+
+class RequestHandler_curl_Multi
+{
+public:
+  RequestHandler_curl_Multi();
+  RequestHandler_curl_Multi(RequestHandler_curl_Multi const&) = delete;
+  void operator=(RequestHandler_curl_Multi const&) = delete;
+  ~RequestHandler_curl_Multi();
+
+  static std::shared_ptr<RequestHandler_curl_Multi>
+  acquire();
+
+  CURLcode
+  perform(CURL * curl);
+
+  void
+  perform_async(CURL * curl, std::function<void(CURLcode)> callback);
+
+private:
+  struct Transfer {
+    CURL * curl;
+    CURLcode result;
+    bool done;
+    std::condition_variable cv;
+    // Set for asynchronous transfers, which are owned by the engine
+    std::function<void(CURLcode)> callback;
+  };
+
+  void
+  run();
+
+  CURLM * multi_;
+  std::mutex mutex_;
+  std::vector<Transfer *> pending_;
+  bool stop_;
+  std::thread thread_;
+};
+
+RequestHandler_curl_Multi::RequestHandler_curl_Multi()
+: multi_(curl_multi_init()), stop_(false)
+{
+#if LIBCURL_VERSION_NUM >= 0x074400
+  if (multi_ == NULL) { return; }
+
+  curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+  thread_ = std::thread(&RequestHandler_curl_Multi::run, this);
+#endif
+}
+
+RequestHandler_curl_Multi::~RequestHandler_curl_Multi()
+{
+#if LIBCURL_VERSION_NUM >= 0x074400
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    curl_multi_wakeup(multi_);
+    thread_.join();
+  }
+#endif
+
+  if (multi_) { curl_multi_cleanup(multi_); }
+}
+
+/*
+ * Returns the engine shared by all handles, starting it if needed. Returns an
+ * empty pointer if the engine could not be started, or if libcurl is too old
+ * to support it.
+ */
+std::shared_ptr<RequestHandler_curl_Multi>
+RequestHandler_curl_Multi::acquire()
+{
+  static std::mutex mutex;
+  static std::weak_ptr<RequestHandler_curl_Multi> shared;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  std::shared_ptr<RequestHandler_curl_Multi> multi = shared.lock();
+  if (multi) { return multi; }
+
+  multi = std::make_shared<RequestHandler_curl_Multi>();
+  if (!multi->thread_.joinable()) { return std::shared_ptr<RequestHandler_curl_Multi>(); }
+
+  shared = multi;
+  return multi;
+}
+
+/*
+ * Performs the transfer set up on the easy handle, blocking until it has
+ * finished. The easy handle must not be used by the caller in the meantime.
+ */
+CURLcode
+RequestHandler_curl_Multi::perform(CURL * curl)
+{
+#if LIBCURL_VERSION_NUM >= 0x074400
+  Transfer transfer;
+  transfer.curl = curl;
+  transfer.result = CURLE_OK;
+  transfer.done = false;
+
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, (void *)&transfer);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  pending_.push_back(&transfer);
+  curl_multi_wakeup(multi_);
+  transfer.cv.wait(lock, [&transfer] { return transfer.done; });
+
+  return transfer.result;
+#else
+  return curl_easy_perform(curl);
+#endif
+}
+
+/*
+ * Starts the transfer set up on the easy handle and returns immediately.
+ * The callback is called on the background thread once the transfer has
+ * finished, and the easy handle must not be used before that.
+ */
+void
+RequestHandler_curl_Multi::perform_async(CURL * curl, std::function<void(CURLcode)> callback)
+{
+#if LIBCURL_VERSION_NUM >= 0x074400
+  Transfer * transfer = new Transfer();
+  transfer->curl = curl;
+  transfer->result = CURLE_OK;
+  transfer->done = false;
+  transfer->callback = std::move(callback);
+
+  curl_easy_setopt(curl, CURLOPT_PRIVATE, (void *)transfer);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_.push_back(transfer);
+  curl_multi_wakeup(multi_);
+#else
+  callback(curl_easy_perform(curl));
+#endif
+}
+
+void
+RequestHandler_curl_Multi::run()
+{
+#if LIBCURL_VERSION_NUM >= 0x074400
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  std::vector<Transfer *> failed;
+
+  while (!stop_) {
+    for (Transfer * transfer : pending_) {
+      if (curl_multi_add_handle(multi_, transfer->curl) == CURLM_OK) { continue; }
+
+      if (transfer->callback) {
+        failed.push_back(transfer);
+      } else {
+        transfer->result = CURLE_FAILED_INIT;
+        transfer->done = true;
+        transfer->cv.notify_one();
+      }
+    }
+    pending_.clear();
+
+    lock.unlock();
+
+    // Callbacks are called without holding the lock, since they may start
+    // new asynchronous transfers
+    for (Transfer * transfer : failed) {
+      std::function<void(CURLcode)> callback = std::move(transfer->callback);
+      delete transfer;
+      callback(CURLE_FAILED_INIT);
+    }
+    failed.clear();
+
+    int running;
+    curl_multi_perform(multi_, &running);
+
+    CURLMsg * msg;
+    int queued;
+    while ((msg = curl_multi_info_read(multi_, &queued)) != NULL) {
+      if (msg->msg != CURLMSG_DONE) { continue; }
+
+      // The message is invalidated by curl_multi_remove_handle()
+      CURL * curl = msg->easy_handle;
+      CURLcode result = msg->data.result;
+
+      char * p = NULL;
+      curl_easy_getinfo(curl, CURLINFO_PRIVATE, &p);
+      Transfer * transfer = (Transfer *)p;
+
+      curl_multi_remove_handle(multi_, curl);
+
+      if (transfer->callback) {
+        std::function<void(CURLcode)> callback = std::move(transfer->callback);
+        delete transfer;
+        callback(result);
+        continue;
+      }
+
+      // Notify while holding the lock, since the waiting thread destroys
+      // the transfer as soon as it observes that it is done
+      lock.lock();
+      transfer->result = result;
+      transfer->done = true;
+      transfer->cv.notify_one();
+      lock.unlock();
+    }
+
+    curl_multi_poll(multi_, NULL, 0, 1000, NULL);
+
+    lock.lock();
+  }
+#endif
+}
+
 /*
  * RequestHandler_curl
  */
 
 RequestHandler_curl::RequestHandler_curl(basic_Error & e)
+: policy_(RequestPolicy_default::get()), hedge_multi_(NULL), latencies_next_(0)
 {
   this->curl = curl_easy_init();
+
+  if (this->curl) {
+    std::call_once(tls_session_share_once, init_tls_session_share);
+    if (tls_session_share) { curl_easy_setopt(this->curl, CURLOPT_SHARE, tls_session_share); }
+
+    // Ask for a compressed response using any encoding supported by libcurl.
+    // Failure is not fatal, the response is then simply not compressed.
+    curl_easy_setopt(this->curl, CURLOPT_ACCEPT_ENCODING, "");
+  }
 }
 
 RequestHandler_curl::~RequestHandler_curl()
 {
   if (this->curl) {
+    // Saving the sessions is best effort here, since the error cannot be
+    // reported. Applications which need to know whether it succeeded call
+    // save_tls_sessions() before destroying the handle.
+    basic_Error e;
+    this->save_tls_sessions(e);
+
     curl_easy_cleanup(this->curl);
   }
+
+  if (hedge_multi_) { curl_multi_cleanup(hedge_multi_); }
 }
 
 RequestHandler_curl::PostBuilder
 RequestHandler_curl::post_request(basic_Error & e, char const* host, char const* endpoint)
 {
-  return RequestHandler_curl_PostBuilder(curl, host, endpoint);
+  return RequestHandler_curl_PostBuilder(curl, host, endpoint, this);
+}
+
+/**
+ * Sets a file used to store TLS sessions, such that connections made after
+ * the process restarts can resume a session instead of performing a full TLS
+ * handshake. Sessions already stored in the file are loaded immediately, and
+ * the file is updated when save_tls_sessions() is called or the
+ * RequestHandler is destroyed. Errors while saving the file from the
+ * destructor are ignored.
+ *
+ * The file contains secrets allowing a session to be resumed, and should
+ * only be readable by the current user.
+ *
+ * NOTE: Requires libcurl 8.12.0 or later, built with the SSLS-EXPORT
+ *       feature. Otherwise this method has no effect, and sessions are only
+ *       shared within the process.
+ */
+void
+RequestHandler_curl::set_tls_session_file(basic_Error & e, std::string path)
+{
+  if (e) { return; }
+
+  if (!this->curl) { e.set(api::main(), errors::Subsystem::RequestHandler, errors::RequestHandler_curl::CURL_NULL); return; }
+
+  tls_session_file_ = std::move(path);
+
+#if LIBCURL_VERSION_NUM >= 0x080c00
+  import_tls_sessions(this->curl, tls_session_file_);
+#endif
+}
+
+/**
+ * Writes the TLS sessions of the process to the file given to
+ * set_tls_session_file(). Does nothing if no file has been set.
+ *
+ * The file is replaced atomically, so several handles and processes may
+ * save the same file at the same time, and the last one to finish wins.
+ */
+void
+RequestHandler_curl::save_tls_sessions(basic_Error & e)
+{
+  if (e) { return; }
+
+  if (tls_session_file_.empty()) { return; }
+
+#if LIBCURL_VERSION_NUM >= 0x080c00
+  using namespace errors;
+  using namespace errors::RequestHandler_curl;
+  api::main api;
+
+  if (!this->curl) { e.set(api, Subsystem::RequestHandler, CURL_NULL); return; }
+
+  // Write to a temporary file first, so that the file is never left half written
+  std::string tmp = tls_session_tmp_file(tls_session_file_);
+  {
+    std::ofstream out(tmp.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(tls_session_file_magic, sizeof(tls_session_file_magic) - 1);
+
+    CURLcode cc = curl_easy_ssls_export(this->curl, export_tls_session, (void *)&out);
+    out.close();
+    // libcurl may be built without support for exporting sessions
+    if (cc == CURLE_NOT_BUILT_IN) { std::remove(tmp.c_str()); return; }
+    if (cc != CURLE_OK || !out) { std::remove(tmp.c_str()); e.set(api, Subsystem::RequestHandler, SAVE_TLS_SESSIONS, cc); return; }
+  }
+
+  if (std::rename(tmp.c_str(), tls_session_file_.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    e.set(api, Subsystem::RequestHandler, SAVE_TLS_SESSIONS);
+  }
+#endif
+}
+
+/**
+ * Pins the public key of the server, in addition to the normal verification
+ * of the certificate chain. The argument is given in the format accepted by
+ * CURLOPT_PINNEDPUBLICKEY, e.g. "sha256//AbCd...=" with the base64 encoded
+ * SHA256 hash of the SubjectPublicKeyInfo of the server certificate. Several
+ * hashes can be separated by ';' to allow for key rotation.
+ *
+ * An empty string removes the pin.
+ */
+void
+RequestHandler_curl::set_pinned_public_key(basic_Error & e, std::string pinned_public_key)
+{
+  if (e) { return; }
+
+  using namespace errors;
+  using namespace errors::RequestHandler_curl;
+  api::main api;
+
+  if (!this->curl) { e.set(api, Subsystem::RequestHandler, CURL_NULL); return; }
+
+  // libcurl keeps its own copy of the string
+  CURLcode cc = curl_easy_setopt(this->curl, CURLOPT_PINNEDPUBLICKEY, pinned_public_key.empty() ? NULL : pinned_public_key.c_str());
+  if (cc != CURLE_OK) { e.set(api, Subsystem::RequestHandler, SETOPT_PINNEDPUBLICKEY, cc); return; }
+}
+
+namespace {
+
+std::uint64_t
+get_time_info(CURL * curl, CURLINFO info)
+{
+#if LIBCURL_VERSION_NUM >= 0x073d00
+  curl_off_t t = 0;
+  if (curl_easy_getinfo(curl, info, &t) != CURLE_OK || t < 0) { return 0; }
+  return t;
+#else
+  double t = 0;
+  if (curl_easy_getinfo(curl, info, &t) != CURLE_OK || t < 0) { return 0; }
+  return t * 1000000;
+#endif
+}
+
+std::uint64_t
+get_size_info(CURL * curl, CURLINFO info)
+{
+#if LIBCURL_VERSION_NUM >= 0x073d00
+  curl_off_t n = 0;
+  if (curl_easy_getinfo(curl, info, &n) != CURLE_OK || n < 0) { return 0; }
+  return n;
+#else
+  double n = 0;
+  if (curl_easy_getinfo(curl, info, &n) != CURLE_OK || n < 0) { return 0; }
+  return n;
+#endif
+}
+
+} // namespace
+
+/**
+ * Enables or disables compression of responses from the Web API. This is
+ * enabled by default, in which case all encodings supported by libcurl,
+ * such as gzip and br, are offered to the server.
+ *
+ * Compression mainly matters for large responses, e.g. license keys with
+ * many activated machines or data objects.
+ */
+void
+RequestHandler_curl::set_response_compression(basic_Error & e, bool enabled)
+{
+  if (e) { return; }
+
+  using namespace errors;
+  using namespace errors::RequestHandler_curl;
+  api::main api;
+
+  if (!this->curl) { e.set(api, Subsystem::RequestHandler, CURL_NULL); return; }
+
+  CURLcode cc = curl_easy_setopt(this->curl, CURLOPT_ACCEPT_ENCODING, enabled ? "" : NULL);
+  if (cc != CURLE_OK) { e.set(api, Subsystem::RequestHandler, SETOPT_ACCEPT_ENCODING, cc); return; }
+}
+
+/**
+ * Enables or disables HTTP/2 with multiplexing. When enabled, the requests
+ * made by all RequestHandler_curl objects using this mode are performed
+ * by a shared engine, and concurrent requests to the same host are sent as
+ * streams on a shared connection instead of using one connection each.
+ *
+ * For https URLs the protocol is negotiated during the TLS handshake, thus
+ * HTTP/1.1 is used if the server does not support HTTP/2. Plain http URLs,
+ * such as a local mock server, are assumed to support HTTP/2 directly.
+ *
+ * NOTE: Requires libcurl 7.68.0 or later built with HTTP/2 support. Reusing
+ *       connections for plain http URLs requires libcurl 8.0.0 or later.
+ */
+void
+RequestHandler_curl::set_http2_multiplexing(basic_Error & e, bool enabled)
+{
+  if (e) { return; }
+
+  using namespace errors;
+  using namespace errors::RequestHandler_curl;
+  api::main api;
+
+  if (!this->curl) { e.set(api, Subsystem::RequestHandler, CURL_NULL); return; }
+
+#if LIBCURL_VERSION_NUM >= 0x074400
+  if (!enabled) {
+    multi_.reset();
+    curl_easy_setopt(this->curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_NONE);
+    curl_easy_setopt(this->curl, CURLOPT_PIPEWAIT, 0L);
+    return;
+  }
+
+  CURLcode cc = curl_easy_setopt(this->curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE);
+  if (cc != CURLE_OK) { e.set(api, Subsystem::RequestHandler, SETOPT_HTTP_VERSION, cc); return; }
+
+  // Wait for an existing connection to be available for multiplexing,
+  // instead of opening a new connection for each concurrent request
+  curl_easy_setopt(this->curl, CURLOPT_PIPEWAIT, 1L);
+
+  multi_ = RequestHandler_curl_Multi::acquire();
+  if (!multi_) { e.set(api, Subsystem::RequestHandler, MULTI_INIT); return; }
+#else
+  if (enabled) { e.set(api, Subsystem::RequestHandler, SETOPT_HTTP_VERSION, CURLE_NOT_BUILT_IN); }
+#endif
+}
+
+/**
+ * Sets the RequestPolicy used for subsequent requests. See the RequestPolicy
+ * class for a description of the available settings.
+ */
+void
+RequestHandler_curl::set_request_policy(basic_Error & e, RequestPolicy const& policy)
+{
+  if (e) { return; }
+
+  policy_ = policy;
+  latencies_.clear();
+  latencies_next_ = 0;
+}
+
+RequestPolicy
+RequestHandler_curl::get_request_policy() const
+{
+  return policy_;
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Number of recent latencies used for choosing the hedging delay, and the
+// number needed before any hedged requests are made
+size_t constexpr LATENCY_SAMPLES = 128;
+size_t constexpr LATENCY_SAMPLES_MIN = 20;
+
+/*
+ * Errors that may succeed if the request is made again
+ */
+bool
+is_transient(CURLcode cc)
+{
+  switch (cc) {
+  case CURLE_COULDNT_RESOLVE_HOST:
+  case CURLE_COULDNT_CONNECT:
+  case CURLE_OPERATION_TIMEDOUT:
+  case CURLE_SSL_CONNECT_ERROR:
+  case CURLE_SEND_ERROR:
+  case CURLE_RECV_ERROR:
+  case CURLE_GOT_NOTHING:
+  case CURLE_PARTIAL_FILE:
+  case CURLE_HTTP2:
+#if LIBCURL_VERSION_NUM >= 0x073100
+  case CURLE_HTTP2_STREAM:
+#endif
+    return true;
+  default:
+    return false;
+  }
+}
+
+bool
+is_transient_status(long status)
+{
+  return status == 502 || status == 503 || status == 504;
+}
+
+bool
+request_sent(CURL * curl)
+{
+  long request_size = 0;
+  curl_easy_getinfo(curl, CURLINFO_REQUEST_SIZE, &request_size);
+  return request_size > 0;
+}
+
+std::uint64_t
+elapsed_us(Clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+}
+
+} // namespace
+
+/*
+ * Performs the request set up on the easy handle according to the
+ * RequestPolicy, setting e if all attempts fail.
+ */
+void
+RequestHandler_curl::perform(basic_Error & e, std::string & response, bool idempotent)
+{
+  if (e) { return; }
+
+  using namespace errors;
+  using namespace errors::RequestHandler_curl;
+  api::main api;
+
+  Clock::time_point start = Clock::now();
+  std::uint64_t deadline = (std::uint64_t)policy_.deadline * 1000;
+
+  curl_easy_setopt(this->curl, CURLOPT_CONNECTTIMEOUT_MS, (long)policy_.connect_timeout);
+
+  unsigned retries = 0;
+  bool hedged = false;
+  bool deadline_exceeded = false;
+  CURLcode cc;
+  for (;;) {
+    // Each attempt must also finish before the deadline
+    long timeout = policy_.attempt_timeout;
+    if (deadline) {
+      long remaining = (long)((deadline - std::min(deadline, elapsed_us(start))) / 1000);
+      if (timeout == 0 || remaining < timeout) { timeout = std::max(remaining, 1L); }
+    }
+
+    response.clear();
+    Clock::time_point attempt_start = Clock::now();
+    long status = 0;
+    cc = perform_attempt(response, timeout, idempotent, status, hedged);
+
+    bool retry;
+    if (cc == CURLE_OK) {
+      if (policy_.hedge_percentile) {
+        std::uint32_t latency = (std::uint32_t)std::min<std::uint64_t>(elapsed_us(attempt_start), UINT32_MAX);
+        if (latencies_.size() < LATENCY_SAMPLES) { latencies_.push_back(latency); }
+        else                                     { latencies_[latencies_next_] = latency; }
+        latencies_next_ = (latencies_next_ + 1) % LATENCY_SAMPLES;
+      }
+
+      // Responses such as 503 Service Unavailable are passed on to the
+      // caller as before if they cannot be retried
+      retry = idempotent && is_transient_status(status);
+    } else {
+      retry = is_transient(cc) && (idempotent || !request_sent(this->curl));
+    }
+
+    if (!retry || retries >= policy_.max_retries) { break; }
+
+    // Exponential backoff with full jitter
+    static thread_local std::minstd_rand rng(std::random_device{}());
+    std::uint64_t backoff = std::min<std::uint64_t>(policy_.max_backoff, (std::uint64_t)policy_.initial_backoff << std::min(retries, 32u));
+    backoff = std::uniform_int_distribution<std::uint64_t>(0, backoff)(rng) * 1000;
+
+    // A retry that could only start after the deadline is not attempted
+    if (deadline && elapsed_us(start) + backoff >= deadline) { deadline_exceeded = true; break; }
+
+    std::this_thread::sleep_for(std::chrono::microseconds(backoff));
+    ++retries;
+  }
+
+  if (cc == CURLE_OK) { return; }
+
+  size_t extra = (size_t)cc | ((size_t)std::min(retries, 255u) << 16) | ((size_t)hedged << 24);
+  deadline_exceeded = deadline_exceeded || (deadline && elapsed_us(start) >= deadline);
+  e.set(api, Subsystem::RequestHandler, deadline_exceeded ? DEADLINE_EXCEEDED : PERFORM, extra);
+}
+
+/*
+ * Starts the request set up on the easy handle on the shared engine, calling
+ * done once it has finished. Only a single attempt is made, with the
+ * timeouts of the RequestPolicy, since there is no thread to wait on
+ * between retries.
+ */
+void
+RequestHandler_curl::perform_async(basic_Error & e, std::string & response, std::function<void()> done)
+{
+  using namespace errors;
+  using namespace errors::RequestHandler_curl;
+  api::main api;
+
+  if (e) { done(); return; }
+
+  if (!multi_ && !async_multi_) { async_multi_ = RequestHandler_curl_Multi::acquire(); }
+  RequestHandler_curl_Multi * engine = multi_ ? multi_.get() : async_multi_.get();
+  if (!engine) { e.set(api, Subsystem::RequestHandler, MULTI_INIT); done(); return; }
+
+  long timeout = policy_.attempt_timeout;
+  if (policy_.deadline && (timeout == 0 || policy_.deadline < timeout)) { timeout = policy_.deadline; }
+
+  curl_easy_setopt(this->curl, CURLOPT_CONNECTTIMEOUT_MS, (long)policy_.connect_timeout);
+  curl_easy_setopt(this->curl, CURLOPT_TIMEOUT_MS, timeout);
+  curl_easy_setopt(this->curl, CURLOPT_WRITEDATA, (void *)&response);
+
+  basic_Error * error = &e;
+  engine->perform_async(this->curl, [error, done](CURLcode cc) {
+    if (cc != CURLE_OK) { error->set(api::main(), Subsystem::RequestHandler, PERFORM, cc); }
+    done();
+  });
+}
+
+/*
+ * Makes a single attempt, setting status to the HTTP status of the response
+ * used. Only idempotent requests are hedged, since the server may act on
+ * both copies of the request.
+ */
+CURLcode
+RequestHandler_curl::perform_attempt(std::string & response, long timeout, bool idempotent, long & status, bool & hedged)
+{
+  curl_easy_setopt(this->curl, CURLOPT_WRITEDATA, (void *)&response);
+  curl_easy_setopt(this->curl, CURLOPT_TIMEOUT_MS, timeout);
+
+  if (!multi_ && idempotent && policy_.hedge_percentile) {
+    return perform_hedged(response, timeout, hedge_delay(), status, hedged);
+  }
+
+  CURLcode cc = multi_ ? multi_->perform(this->curl) : curl_easy_perform(this->curl);
+  curl_easy_getinfo(this->curl, CURLINFO_RESPONSE_CODE, &status);
+  return cc;
+}
+
+/*
+ * Returns the delay in microseconds after which a hedged request is sent,
+ * or UINT64_MAX if too few latencies have been observed.
+ */
+std::uint64_t
+RequestHandler_curl::hedge_delay() const
+{
+  if (latencies_.size() < LATENCY_SAMPLES_MIN) { return UINT64_MAX; }
+
+  std::vector<std::uint32_t> sorted(latencies_);
+  size_t i = (sorted.size() - 1) * std::min(policy_.hedge_percentile, 100u) / 100;
+  std::nth_element(sorted.begin(), sorted.begin() + i, sorted.end());
+
+  return std::max<std::uint64_t>(sorted[i], (std::uint64_t)policy_.hedge_min_delay * 1000);
+}
+
+/*
+ * Performs the request, and sends an identical request on a second easy
+ * handle if the first has not completed after hedge_delay microseconds.
+ * The response of whichever request succeeds first is used.
+ *
+ * Both requests are driven by a multi handle kept by this object, so that
+ * connections are reused between calls just like with curl_easy_perform().
+ */
+CURLcode
+RequestHandler_curl::perform_hedged(std::string & response, long timeout, std::uint64_t hedge_delay, long & status, bool & hedged)
+{
+#if LIBCURL_VERSION_NUM >= 0x074200
+  if (!hedge_multi_) { hedge_multi_ = curl_multi_init(); }
+  if (!hedge_multi_ || curl_multi_add_handle(hedge_multi_, this->curl) != CURLM_OK) {
+    CURLcode cc = curl_easy_perform(this->curl);
+    curl_easy_getinfo(this->curl, CURLINFO_RESPONSE_CODE, &status);
+    return cc;
+  }
+
+  Clock::time_point start = Clock::now();
+
+  CURL * hedge = NULL;
+  std::string hedge_response;
+  bool primary_done = false, hedge_done = false;
+  CURLcode primary_result = CURLE_OK, hedge_result = CURLE_OK;
+
+  for (;;) {
+    int running;
+    curl_multi_perform(hedge_multi_, &running);
+
+    CURLMsg * msg;
+    int queued;
+    while ((msg = curl_multi_info_read(hedge_multi_, &queued)) != NULL) {
+      if (msg->msg != CURLMSG_DONE) { continue; }
+
+      if (msg->easy_handle == this->curl) { primary_done = true; primary_result = msg->data.result; }
+      else                                { hedge_done = true; hedge_result = msg->data.result; }
+    }
+
+    if (primary_done && primary_result == CURLE_OK) { break; }
+    if (hedge_done && hedge_result == CURLE_OK) { response.swap(hedge_response); break; }
+    if (primary_done && (hedge == NULL || hedge_done)) { break; }
+
+    std::uint64_t elapsed = elapsed_us(start);
+    if (hedge == NULL && !primary_done && elapsed >= hedge_delay) {
+      hedge = curl_easy_duphandle(this->curl);
+      if (hedge) {
+        long hedge_timeout = std::max(1L, timeout - (long)(elapsed / 1000));
+        curl_easy_setopt(hedge, CURLOPT_WRITEDATA, (void *)&hedge_response);
+        curl_easy_setopt(hedge, CURLOPT_TIMEOUT_MS, timeout ? hedge_timeout : 0L);
+        if (curl_multi_add_handle(hedge_multi_, hedge) != CURLM_OK) {
+          curl_easy_cleanup(hedge);
+          hedge = NULL;
+          hedge_delay = UINT64_MAX;
+        } else {
+          hedged = true;
+        }
+      } else {
+        hedge_delay = UINT64_MAX;
+      }
+    }
+
+    int wait = 1000;
+    if (hedge == NULL && hedge_delay != UINT64_MAX) {
+      wait = (int)std::min<std::uint64_t>(wait, (hedge_delay - std::min(hedge_delay, elapsed_us(start)) + 999) / 1000);
+    }
+    curl_multi_poll(hedge_multi_, NULL, 0, wait, NULL);
+  }
+
+  // The status is that of the response used, which is the one of the hedged
+  // request if it won
+  bool hedge_won = hedge_done && hedge_result == CURLE_OK && !(primary_done && primary_result == CURLE_OK);
+  curl_easy_getinfo(hedge_won ? hedge : this->curl, CURLINFO_RESPONSE_CODE, &status);
+
+  curl_multi_remove_handle(hedge_multi_, this->curl);
+  if (hedge) {
+    curl_multi_remove_handle(hedge_multi_, hedge);
+    curl_easy_cleanup(hedge);
+  }
+
+  if (hedge_won) { return CURLE_OK; }
+  return primary_result;
+#else
+  CURLcode cc = curl_easy_perform(this->curl);
+  curl_easy_getinfo(this->curl, CURLINFO_RESPONSE_CODE, &status);
+  return cc;
+#endif
+}
+
+/**
+ * Returns timing information and transfer sizes for the last request made
+ * using this RequestHandler, as reported by libcurl.
+ */
+RequestStatistics
+RequestHandler_curl::get_last_request_statistics() const
+{
+  RequestStatistics s{0, 0, 0, 0, 0, 0, 0, 0};
+  if (!this->curl) { return s; }
+
+#if LIBCURL_VERSION_NUM >= 0x073d00
+  s.namelookup_time    = get_time_info(this->curl, CURLINFO_NAMELOOKUP_TIME_T);
+  s.connect_time       = get_time_info(this->curl, CURLINFO_CONNECT_TIME_T);
+  s.appconnect_time    = get_time_info(this->curl, CURLINFO_APPCONNECT_TIME_T);
+  s.pretransfer_time   = get_time_info(this->curl, CURLINFO_PRETRANSFER_TIME_T);
+  s.starttransfer_time = get_time_info(this->curl, CURLINFO_STARTTRANSFER_TIME_T);
+  s.total_time         = get_time_info(this->curl, CURLINFO_TOTAL_TIME_T);
+  s.bytes_sent         = get_size_info(this->curl, CURLINFO_SIZE_UPLOAD_T);
+  s.bytes_received     = get_size_info(this->curl, CURLINFO_SIZE_DOWNLOAD_T);
+#else
+  s.namelookup_time    = get_time_info(this->curl, CURLINFO_NAMELOOKUP_TIME);
+  s.connect_time       = get_time_info(this->curl, CURLINFO_CONNECT_TIME);
+  s.appconnect_time    = get_time_info(this->curl, CURLINFO_APPCONNECT_TIME);
+  s.pretransfer_time   = get_time_info(this->curl, CURLINFO_PRETRANSFER_TIME);
+  s.starttransfer_time = get_time_info(this->curl, CURLINFO_STARTTRANSFER_TIME);
+  s.total_time         = get_time_info(this->curl, CURLINFO_TOTAL_TIME);
+  s.bytes_sent         = get_size_info(this->curl, CURLINFO_SIZE_UPLOAD);
+  s.bytes_received     = get_size_info(this->curl, CURLINFO_SIZE_DOWNLOAD);
+#endif
+
+  return s;
 }
 
 /*
  * RequestHandler_curl_PostBuilder
  */
 
-RequestHandler_curl_PostBuilder::RequestHandler_curl_PostBuilder(CURL * curl, char const* host, char const* endpoint)
-: curl_(curl), separator_(' '), postfields_(), url_("https://")
+namespace {
+
+/*
+ * Web API methods that can safely be repeated, i.e. making the same request
+ * twice has the same effect as making it once. Other requests are only
+ * retried if the request was never sent.
+ */
+bool
+is_idempotent(char const* endpoint)
 {
+  static char const* const idempotent_endpoints[] =
+    { "/api/key/Activate"
+    , "/api/key/Deactivate"
+    , "/api/message/GetMessages"
+    };
+
+  if (endpoint == nullptr) { return false; }
+
+  for (char const* idempotent_endpoint : idempotent_endpoints) {
+    if (std::strcmp(endpoint, idempotent_endpoint) == 0) { return true; }
+  }
+
+  return false;
+}
+
+} // namespace
+
+RequestHandler_curl_PostBuilder::RequestHandler_curl_PostBuilder(CURL * curl, char const* host, char const* endpoint, RequestHandler_curl * handler)
+: curl_(curl), handler_(handler), idempotent_(is_idempotent(endpoint)), separator_(' '), postfields_(), url_()
+{
+  // The host may include the scheme, e.g. http://localhost:8080, otherwise https is used
+  if (std::strstr(host, "://") == nullptr) { url_ += "https://"; }
   url_ += host;
   if (url_.size() > 0 && url_.back() != '/' && endpoint != nullptr && *endpoint != '/') { url_ += '/'; }
   url_ += endpoint;
@@ -75,10 +1051,10 @@ RequestHandler_curl_PostBuilder::add_argument(basic_Error & e, char const* key,
 size_t
 handle_response(char * ptr, size_t size, size_t nmemb, void *userdata)
 {
-  std::string current{ptr, size*nmemb};
-
+  // With a compressed response, libcurl passes the decompressed data here
+  // as it is decoded, so the response is never held in compressed form
   std::string *response = (std::string *)userdata;
-  *response += current;
+  response->append(ptr, size*nmemb);
 
   return size*nmemb;
 }
@@ -87,11 +1063,51 @@ handle_response(char * ptr, size_t size, size_t nmemb, void *userdata)
 
 namespace cacerts {
 
-extern
-std::vector<std::string> pems;
+// Generated by util/mk-ca-bundle.pl
+extern unsigned char const der[];
+extern std::size_t const der_size;
 
 } // namespace cacerts
 
+namespace {
+
+X509_STORE * cacerts_store = NULL;
+std::once_flag cacerts_store_once;
+
+/*
+ * Decodes the embedded CA certificates into cacerts_store. This is done once
+ * per process, after which the store is shared by all SSL contexts. The store
+ * is never freed since SSL contexts may outlive any object of this library.
+ */
+void
+load_cacerts_store()
+{
+  X509_STORE * store = X509_STORE_new();
+  if (store == NULL) { return; }
+
+  unsigned char const* p = cacerts::der;
+  unsigned char const* end = cacerts::der + cacerts::der_size;
+  while (p < end) {
+    X509 * cert = d2i_X509(NULL, &p, (long)(end - p));
+    if (cert == NULL) { break; }
+
+    /* TODO: Currently this function does not report partial failure
+     *       since we are adding all CA certs as described at
+     *       https://curl.haxx.se/docs/caextract.html
+     *
+     *       The vast majority of these certificates are in fact not
+     *       needed to authenticate cryptolens.io, and a failure
+     *       adding most certificates is not a fatal error.
+     */
+    X509_STORE_add_cert(store, cert);
+    X509_free(cert);
+  }
+
+  cacerts_store = store;
+}
+
+} // namespace
+
 static
 CURLcode
 sslctx_function_setup_cacerts(CURL *curl, void *sslctx, void *parm)
@@ -151,39 +1167,68 @@ sslctx_function_setup_cacerts(CURL *curl, void *sslctx, void *parm)
    *
    */
 
-  basic_Error * e = (basic_Error*)parm;
+  std::call_once(cacerts_store_once, load_cacerts_store);
+  if (cacerts_store == NULL) { return CURLE_OUT_OF_MEMORY; }
 
-  for (std::string pem : cacerts::pems) {
-    /* TODO: Currently this function does not report partial failure
-     *       since we are adding all CA certs as described at
-     *       https://curl.haxx.se/docs/caextract.html
-     *
-     *       The vast majority of these certificates are in fact not
-     *       needed to authenticate cryptolens.io, and a failure
-     *       adding most certificates is not a fatal error.
-     */
-    BIO * bio = BIO_new_mem_buf((void *)pem.c_str(), -1);
-    X509 *cert = nullptr;
+  // The SSL context takes a reference to the shared store, instead of
+  // each context parsing and holding its own copy of the certificates.
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+  SSL_CTX_set1_cert_store((SSL_CTX *)sslctx, cacerts_store);
+#elif OPENSSL_VERSION_NUMBER >= 0x10100000L
+  X509_STORE_up_ref(cacerts_store);
+  SSL_CTX_set_cert_store((SSL_CTX *)sslctx, cacerts_store);
+#else
+  CRYPTO_add(&cacerts_store->references, 1, CRYPTO_LOCK_X509_STORE);
+  SSL_CTX_set_cert_store((SSL_CTX *)sslctx, cacerts_store);
+#endif
 
-    PEM_read_bio_X509(bio, &cert, 0, NULL);
-    if (cert == nullptr) {
-      BIO_free(bio);
-      continue;
-    }
+  return CURLE_OK;
+}
 
-    X509_STORE * store = SSL_CTX_get_cert_store((SSL_CTX *)sslctx);
+#endif /* CRYPTOLENS_CURL_EMBED_CACERTS */
 
-    if (X509_STORE_add_cert(store, cert) == 0) { /* TODO: Could add error handling */ }
+/**
+ * Starts the request without waiting for the response. Once the request has
+ * finished, the response has been stored in the response argument, and e
+ * has been set if the request failed, done is called from a thread owned by
+ * the library. done is always called exactly once, also if the request
+ * could not be started.
+ *
+ * This PostBuilder, the response string and e must be kept alive until done
+ * is called, and the RequestHandler must not be used for other requests in
+ * the meantime.
+ *
+ * NOTE: Requires libcurl 7.68.0 or later, otherwise the request is
+ *       performed before this method returns.
+ */
+void
+RequestHandler_curl_PostBuilder::make_async(basic_Error & e, std::string & response, std::function<void()> done)
+{
+  if (e) { done(); return; }
 
-    X509_free(cert);
-    BIO_free(bio);
-  }
+  using namespace errors;
+  using namespace errors::RequestHandler_curl;
+  api::main api;
 
-  return CURLE_OK;
-}
+  if (!this->curl_ || !this->handler_) { e.set(api, Subsystem::RequestHandler, CURL_NULL); done(); return; }
 
+  CURLcode cc;
+
+  cc = curl_easy_setopt(this->curl_, CURLOPT_URL, url_.c_str());
+  if (cc != CURLE_OK) { e.set(api, Subsystem::RequestHandler, SETOPT_URL, cc); done(); return; }
+  cc = curl_easy_setopt(this->curl_, CURLOPT_WRITEFUNCTION, handle_response);
+  if (cc != CURLE_OK) { e.set(api, Subsystem::RequestHandler, SETOPT_WRITEFUNCTION, cc); done(); return; }
+  cc = curl_easy_setopt(this->curl_, CURLOPT_POSTFIELDS, postfields_.c_str());
+  if (cc != CURLE_OK) { e.set(api, Subsystem::RequestHandler, SETOPT_POSTFIELDS, cc); done(); return; }
+
+#ifdef CRYPTOLENS_CURL_EMBED_CACERTS
+  curl_easy_setopt(this->curl_, CURLOPT_SSL_CTX_FUNCTION, *sslctx_function_setup_cacerts);
 #endif /* CRYPTOLENS_CURL_EMBED_CACERTS */
 
+  response.clear();
+  handler_->perform_async(e, response, std::move(done));
+}
+
 std::string
 RequestHandler_curl_PostBuilder::make(basic_Error & e)
 {
@@ -209,9 +1254,14 @@ RequestHandler_curl_PostBuilder::make(basic_Error & e)
 
 #ifdef CRYPTOLENS_CURL_EMBED_CACERTS
   curl_easy_setopt(this->curl_, CURLOPT_SSL_CTX_FUNCTION, *sslctx_function_setup_cacerts);
-  curl_easy_setopt(this->curl_, CURLOPT_SSL_CTX_DATA, (void*)&e);
 #endif /* CRYPTOLENS_CURL_EMBED_CACERTS */
 
+  if (handler_) {
+    handler_->perform(e, response, idempotent_);
+    if (e) { return ""; }
+    return response;
+  }
+
   cc = curl_easy_perform(this->curl_);
   if (cc != CURLE_OK) { e.set(api, Subsystem::RequestHandler, PERFORM, cc); return ""; }
 
@@ -1,39 +1,263 @@
+#include <climits>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
 #include "imports/ArduinoJson5/ArduinoJson.hpp"
 
 #include "api.hpp"
 #include "cryptolens_internals.hpp"
+#include "JsonScanner.hpp"
 #include "LicenseKeyInformation.hpp"
+#include "MemoryResource.hpp"
 #include "ResponseParser_ArduinoJson5.hpp"
 
 namespace cryptolens_io {
 
 namespace v20190401 {
 
+namespace {
+
+// The resource used by JsonBufferAllocator objects constructed on this thread
+thread_local MemoryResource * json_buffer_resource = nullptr;
+
+/*
+ * Sets the resource used by JsonBuffer objects constructed on this thread
+ * while the object is alive. The allocator of a DynamicJsonBuffer is default
+ * constructed and thus cannot be passed in directly.
+ */
+class ScopedJsonBufferResource {
+public:
+  explicit ScopedJsonBufferResource(MemoryResource * resource) : previous_(json_buffer_resource) { json_buffer_resource = resource; }
+  ~ScopedJsonBufferResource() { json_buffer_resource = previous_; }
+
+  ScopedJsonBufferResource(ScopedJsonBufferResource const&) = delete;
+  ScopedJsonBufferResource & operator=(ScopedJsonBufferResource const&) = delete;
+
+private:
+  MemoryResource * previous_;
+};
+
+/*
+ * Allocator for DynamicJsonBufferBase taking memory from a MemoryResource.
+ * The size is not passed when deallocating, so it is stored in front of
+ * each block.
+ */
+class JsonBufferAllocator {
+public:
+  JsonBufferAllocator() : resource_(json_buffer_resource ? json_buffer_resource : &new_delete_resource()) {}
+
+  void * allocate(size_t size)
+  {
+    char * p = static_cast<char *>(resource_->allocate(HEADER + size));
+    *reinterpret_cast<size_t *>(p) = HEADER + size;
+    return p + HEADER;
+  }
+
+  void deallocate(void * pointer)
+  {
+    if (!pointer) { return; }
+
+    char * p = static_cast<char *>(pointer) - HEADER;
+    resource_->deallocate(p, *reinterpret_cast<size_t *>(p));
+  }
+
+private:
+  static size_t constexpr HEADER = alignof(std::max_align_t);
+
+  MemoryResource * resource_;
+};
+
+using JsonBuffer = ArduinoJson::Internals::DynamicJsonBufferBase<JsonBufferAllocator>;
+
+MemoryResource *
+json_buffer_resource_for(std::allocator<char> const&)
+{
+  return nullptr;
+}
+
+MemoryResource *
+json_buffer_resource_for(PolymorphicAllocator<char> const& allocator)
+{
+  return allocator.resource();
+}
+
+/*
+ * Reads a GetMessages response in a single pass over the JSON, without
+ * building a document, keeping the messages with an integer id and created
+ * time and a string content. Nested values are interpreted the same way as
+ * by ArduinoJson.
+ */
+class MessagesScanner : private internal::JsonScanner {
+public:
+  explicit MessagesScanner(std::string const& response)
+  : JsonScanner(response.data(), response.size()), result_(false), has_message_(false)
+  {}
+
+  bool
+  scan(std::vector<Message> & messages)
+  {
+    if (!object_begin()) { return false; }
+
+    bool more;
+    if (!object_first(more)) { return false; }
+    while (more) {
+      std::string key;
+      if (!member_key(key)) { return false; }
+
+      if (key == "messages" && peek('[')) {
+        ++p_;
+        if (!scan_messages(messages)) { return false; }
+      } else {
+        Value v;
+        if (!value(v, 0)) { return false; }
+
+        if (key == "result") {
+          result_ = v.type == Value::JSON_NUMBER && v.number == 0;
+        } else if (key == "message") {
+          has_message_ = v.type == Value::JSON_STRING;
+          if (has_message_) { message_ = string_value(v); }
+        }
+      }
+
+      if (!object_next(more)) { return false; }
+    }
+
+    return at_end();
+  }
+
+  // Returns if the result field was 0
+  bool result() const { return result_; }
+
+  // Returns the message field, if it is a string
+  char const* message() const { return has_message_ ? message_.c_str() : NULL; }
+
+private:
+  bool result_;
+  bool has_message_;
+  std::string message_;
+
+  static bool
+  is_int(Value const& v)
+  {
+    return v.type == Value::JSON_NUMBER && v.number <= (std::uint64_t)INT_MAX;
+  }
+
+  // Reads the elements of the messages array, after the '['
+  bool
+  scan_messages(std::vector<Message> & messages)
+  {
+    bool more;
+    if (!array_first(more)) { return false; }
+    while (more) {
+      if (!peek('{')) {
+        Value v;
+        if (!value(v, 1)) { return false; }
+      } else {
+        ++p_;
+        if (!scan_message(messages)) { return false; }
+      }
+
+      if (!array_next(more)) { return false; }
+    }
+
+    return true;
+  }
+
+  bool
+  scan_message(std::vector<Message> & messages)
+  {
+    Value id{}, content{}, created{}, channel{};
+    id.type = content.type = created.type = channel.type = Value::JSON_NULL;
+
+    bool more;
+    if (!object_first(more)) { return false; }
+    while (more) {
+      std::string key;
+      if (!member_key(key)) { return false; }
+
+      Value v;
+      if (!value(v, 2)) { return false; }
+
+      if      (key == "id")      { id = v; }
+      else if (key == "content") { content = v; }
+      else if (key == "created") { created = v; }
+      else if (key == "channel") { channel = v; }
+
+      if (!object_next(more)) { return false; }
+    }
+
+    if (!is_int(id) || !is_int(created) || content.type != Value::JSON_STRING) { return true; }
+
+    messages.emplace_back( (int)id.number
+                         , string_value(content)
+                         , (std::int64_t)created.number
+                         , channel.type == Value::JSON_STRING ? string_value(channel) : std::string()
+                         );
+    return true;
+  }
+};
+
+} // namespace
+
 optional<LicenseKeyInformation>
 ResponseParser_ArduinoJson5::make_license_key_information(basic_Error & e, RawLicenseKey const& raw_license_key) const
 {
-  if (e) { return nullopt; }
-
-  return ResponseParser_ArduinoJson5::make_license_key_information_unsafe(e, raw_license_key.get_license());
+  return make_license_key_information(e, raw_license_key, std::allocator<char>());
 }
 
 optional<LicenseKeyInformation>
 ResponseParser_ArduinoJson5::make_license_key_information(basic_Error & e, optional<RawLicenseKey> const& raw_license_key) const
+{
+  return make_license_key_information(e, raw_license_key, std::allocator<char>());
+}
+
+optional<LicenseKeyInformation>
+ResponseParser_ArduinoJson5::make_license_key_information_unsafe(basic_Error & e, std::string const& license_key) const
+{
+  return make_license_key_information_unsafe(e, license_key, std::allocator<char>());
+}
+
+template<typename Allocator>
+optional<basic_LicenseKeyInformation<Allocator>>
+ResponseParser_ArduinoJson5::make_license_key_information(basic_Error & e, RawLicenseKey const& raw_license_key, Allocator const& allocator) const
+{
+  if (e) { return nullopt; }
+
+  return ResponseParser_ArduinoJson5::make_license_key_information_unsafe(e, raw_license_key.get_license(), allocator);
+}
+
+template<typename Allocator>
+optional<basic_LicenseKeyInformation<Allocator>>
+ResponseParser_ArduinoJson5::make_license_key_information(basic_Error & e, optional<RawLicenseKey> const& raw_license_key, Allocator const& allocator) const
 {
   if (e) { return nullopt; }
 
   if (!raw_license_key) { return nullopt; }
 
-  return ResponseParser_ArduinoJson5::make_license_key_information(e, *raw_license_key);
+  return ResponseParser_ArduinoJson5::make_license_key_information(e, *raw_license_key, allocator);
 }
 
-optional<LicenseKeyInformation>
-ResponseParser_ArduinoJson5::make_license_key_information_unsafe(basic_Error & e, std::string const& license_key) const
+/*
+ * Parses the license key information, allocating all strings and vectors of
+ * the result using the allocator. If the allocator is a PolymorphicAllocator,
+ * the temporary json tree is also placed in its MemoryResource.
+ */
+template<typename Allocator>
+optional<basic_LicenseKeyInformation<Allocator>>
+ResponseParser_ArduinoJson5::make_license_key_information_unsafe(basic_Error & e, std::string const& license_key, Allocator const& allocator) const
 {
   if (e) { return nullopt; }
 
+  using LicenseKeyInformation = basic_LicenseKeyInformation<Allocator>;
+  using string_type = typename LicenseKeyInformation::string_type;
+  using Customer = typename LicenseKeyInformation::Customer;
+  using ActivationDataTable = typename LicenseKeyInformation::ActivationDataTable;
+  using DataObjectList = typename LicenseKeyInformation::DataObjectList;
+
   using namespace ArduinoJson;
-  DynamicJsonBuffer jsonBuffer;
+  ScopedJsonBufferResource scoped_resource(json_buffer_resource_for(allocator));
+  JsonBuffer jsonBuffer;
   JsonObject & j = jsonBuffer.parseObject(license_key);
 
   if (!j.success()) { e.set(api::main(), errors::Subsystem::Json); return nullopt; }
@@ -58,15 +282,15 @@ ResponseParser_ArduinoJson5::make_license_key_information_unsafe(basic_Error & e
 
   if (mandatory_missing) { e.set(api::main(), errors::Subsystem::Json); return nullopt; }
 
-  optional<int>                         id;
-  optional<std::string>                 key;
-  optional<std::string>                 notes;
-  optional<int>                         global_id;
-  optional<Customer>                    customer;
-  optional<std::vector<ActivationData>> activated_machines;
-  optional<int>                         maxnoofmachines;
-  optional<std::string>                 allowed_machines;
-  optional<std::vector<DataObject>>     data_objects;
+  optional<int>                 id;
+  optional<string_type>         key;
+  optional<string_type>         notes;
+  optional<int>                 global_id;
+  optional<Customer>            customer;
+  optional<ActivationDataTable> activated_machines;
+  optional<int>                 maxnoofmachines;
+  optional<string_type>         allowed_machines;
+  optional<DataObjectList>      data_objects;
 
   // TODO: Refactor all of these if-blocks to separate functions which takes the
   //       json object by reference and which immediately returns the optional
@@ -75,12 +299,12 @@ ResponseParser_ArduinoJson5::make_license_key_information_unsafe(basic_Error & e
   }
 
   if (j["Key"].is<const char*>() && j["Key"].as<const char*>() != NULL) {
-    std::string x(j["Key"].as<const char*>());
+    string_type x(j["Key"].as<const char*>(), allocator);
     key = std::move(x);
   }
 
   if (j["Notes"].is<const char*>() && j["Notes"].as<const char*>() != NULL) {
-    std::string x(j["Notes"].as<const char*>());
+    string_type x(j["Notes"].as<const char*>(), allocator);
     notes = std::move(x);
   }
 
@@ -98,9 +322,9 @@ ResponseParser_ArduinoJson5::make_license_key_information_unsafe(basic_Error & e
     if (valid) {
       customer = Customer(
           c["Id"].as<unsigned long>()
-        , c["Name"].is<const char*>()        && c["Name"].as<const char*>() != NULL        ?  c["Name"].as<const char*>()        : ""
-        , c["Email"].is<const char*>()       && c["Email"].as<const char*>() != NULL       ?  c["Email"].as<const char*>()       : ""
-        , c["CompanyName"].is<const char*>() && c["CompanyName"].as<const char*>() != NULL ?  c["CompanyName"].as<const char*>() : ""
+        , string_type(c["Name"].is<const char*>()        && c["Name"].as<const char*>() != NULL        ?  c["Name"].as<const char*>()        : "", allocator)
+        , string_type(c["Email"].is<const char*>()       && c["Email"].as<const char*>() != NULL       ?  c["Email"].as<const char*>()       : "", allocator)
+        , string_type(c["CompanyName"].is<const char*>() && c["CompanyName"].as<const char*>() != NULL ?  c["CompanyName"].as<const char*>() : "", allocator)
         , c["Created"].as<unsigned long>()
         );
     }
@@ -108,8 +332,20 @@ ResponseParser_ArduinoJson5::make_license_key_information_unsafe(basic_Error & e
 
   if (j["ActivatedMachines"].is<const JsonArray&>()) {
     bool valid = true;
-    std::vector<ActivationData> v;
+    ActivationDataTable v(allocator);
     JsonArray const& array = j["ActivatedMachines"].as<const JsonArray&>();
+
+    // Size the table up front so that the machine ids take one allocation
+    size_t machines = 0, mid_bytes = 0;
+    for (auto const& x : array) {
+      ++machines;
+      if (x.is<const JsonObject&>()) {
+        char const* mid = x.as<const JsonObject&>()["Mid"].as<const char*>();
+        if (mid) { mid_bytes += std::strlen(mid); }
+      }
+    }
+    v.reserve(machines, mid_bytes);
+
     for (auto const& x : array) {
       if (!x.is<const JsonObject&>()) {
         valid = false;
@@ -121,7 +357,7 @@ ResponseParser_ArduinoJson5::make_license_key_information_unsafe(basic_Error & e
       if (machine["Mid"].is<const char*>() && machine["Mid"].as<const char*>() != NULL &&
           machine["IP"].is<const char*>() && machine["IP"].as<const char*>() != NULL &&
           machine["Time"].is<unsigned long>()) {
-        v.emplace_back(machine["Mid"], machine["IP"], machine["Time"]);
+        v.push_back(machine["Mid"].as<const char*>(), machine["IP"].as<const char*>(), machine["Time"].as<unsigned long>());
       } else {
         valid = false;
         break;
@@ -138,13 +374,13 @@ ResponseParser_ArduinoJson5::make_license_key_information_unsafe(basic_Error & e
   }
 
   if (j["AllowedMachines"].is<const char*>() && j["AllowedMachines"].as<const char*>() != NULL) {
-    std::string x = j["AllowedMachines"].as<const char*>();
+    string_type x(j["AllowedMachines"].as<const char*>(), allocator);
     allowed_machines = std::move(x);
   }
 
   if (j["DataObjects"].is<const JsonArray&>()) {
     bool valid = true;
-    std::vector<DataObject> v;
+    DataObjectList v(allocator);
     JsonArray const& array = j["DataObjects"].as<const JsonArray&>();
     for (auto const& x : array) {
       if (!x.is<const JsonObject&>()) {
@@ -161,8 +397,8 @@ ResponseParser_ArduinoJson5::make_license_key_information_unsafe(basic_Error & e
          )
       {
         v.emplace_back( dataobject["Id"].as<unsigned long>()
-                      , dataobject["Name"].as<const char*>()
-                      , dataobject["StringValue"].as<const char*>()
+                      , string_type(dataobject["Name"].as<const char*>(), allocator)
+                      , string_type(dataobject["StringValue"].as<const char*>(), allocator)
                       , dataobject["IntValue"].as<unsigned long>()
                       );
       } else {
@@ -205,6 +441,26 @@ ResponseParser_ArduinoJson5::make_license_key_information_unsafe(basic_Error & e
   ));
 }
 
+template
+optional<basic_LicenseKeyInformation<std::allocator<char>>>
+ResponseParser_ArduinoJson5::make_license_key_information(basic_Error & e, RawLicenseKey const& raw_license_key, std::allocator<char> const& allocator) const;
+template
+optional<basic_LicenseKeyInformation<std::allocator<char>>>
+ResponseParser_ArduinoJson5::make_license_key_information(basic_Error & e, optional<RawLicenseKey> const& raw_license_key, std::allocator<char> const& allocator) const;
+template
+optional<basic_LicenseKeyInformation<std::allocator<char>>>
+ResponseParser_ArduinoJson5::make_license_key_information_unsafe(basic_Error & e, std::string const& license_key, std::allocator<char> const& allocator) const;
+
+template
+optional<basic_LicenseKeyInformation<PolymorphicAllocator<char>>>
+ResponseParser_ArduinoJson5::make_license_key_information(basic_Error & e, RawLicenseKey const& raw_license_key, PolymorphicAllocator<char> const& allocator) const;
+template
+optional<basic_LicenseKeyInformation<PolymorphicAllocator<char>>>
+ResponseParser_ArduinoJson5::make_license_key_information(basic_Error & e, optional<RawLicenseKey> const& raw_license_key, PolymorphicAllocator<char> const& allocator) const;
+template
+optional<basic_LicenseKeyInformation<PolymorphicAllocator<char>>>
+ResponseParser_ArduinoJson5::make_license_key_information_unsafe(basic_Error & e, std::string const& license_key, PolymorphicAllocator<char> const& allocator) const;
+
 optional<std::pair<std::string, std::string>>
 ResponseParser_ArduinoJson5::parse_activate_response(basic_Error & e, std::string const& server_response) const
 {
@@ -223,8 +479,7 @@ ResponseParser_ArduinoJson5::parse_activate_response(basic_Error & e, std::strin
       return nullopt;
     }
 
-    int reason = internal::activate_parse_server_error_message(j["message"].as<char const*>());
-    e.set(api, Subsystem::Main, reason);
+    internal::activate_set_server_error(e, j["message"].as<char const*>());
     return nullopt;
   }
 
@@ -261,8 +516,7 @@ ResponseParser_ArduinoJson5::parse_create_trial_key_response(basic_Error & e, st
       return "";
     }
 
-    int reason = internal::activate_parse_server_error_message(j["message"].as<char const*>());
-    e.set(api, Subsystem::Main, reason);
+    internal::activate_set_server_error(e, j["message"].as<char const*>());
     return "";
   }
 
@@ -291,8 +545,32 @@ ResponseParser_ArduinoJson5::parse_deactivate_response(basic_Error & e, std::str
       return;
     }
 
-    int reason = internal::activate_parse_server_error_message(j["message"].as<char const*>());
-    e.set(api, Subsystem::Main, reason);
+    internal::activate_set_server_error(e, j["message"].as<char const*>());
+    return;
+  }
+}
+
+void
+ResponseParser_ArduinoJson5::parse_increment_int_value_response(basic_Error & e, std::string const& server_response) const
+{
+  if (e) { return; }
+
+  using namespace errors;
+  api::main api;
+
+  using namespace ArduinoJson;
+  DynamicJsonBuffer jsonBuffer;
+  JsonObject & j = jsonBuffer.parseObject(server_response);
+
+  if (!j.success()) { e.set(api, Subsystem::Json); return; }
+
+  if (!j["result"].is<int>() || j["result"].as<int>() != 0) {
+    if (!j["message"].is<const char*>() || j["message"].as<char const*>() == NULL) {
+      e.set(api, Subsystem::Main, Main::UNKNOWN_SERVER_REPLY);
+      return;
+    }
+
+    internal::activate_set_server_error(e, j["message"].as<char const*>());
     return;
   }
 }
@@ -316,8 +594,7 @@ ResponseParser_ArduinoJson5::parse_last_message_response(basic_Error & e, std::s
       return "";
     }
 
-    int reason = internal::activate_parse_server_error_message(j["message"].as<char const*>());
-    e.set(api, Subsystem::Main, reason);
+    internal::activate_set_server_error(e, j["message"].as<char const*>());
     return "";
   }
 
@@ -342,6 +619,34 @@ ResponseParser_ArduinoJson5::parse_last_message_response(basic_Error & e, std::s
   return "";
 }
 
+/**
+ * Returns the messages of a GetMessages response, in the order they were
+ * returned. Messages without an id, a created time or a content are left
+ * out.
+ */
+std::vector<Message>
+ResponseParser_ArduinoJson5::parse_get_messages_response(basic_Error & e, std::string const& server_response) const
+{
+  std::vector<Message> messages;
+  if (e) { return messages; }
+
+  using namespace errors;
+  api::main api;
+
+  MessagesScanner scanner(server_response);
+  if (!scanner.scan(messages)) { e.set(api, Subsystem::Json); messages.clear(); return messages; }
+
+  if (!scanner.result()) {
+    messages.clear();
+    if (scanner.message() == NULL) { e.set(api, Subsystem::Main, Main::UNKNOWN_SERVER_REPLY); return messages; }
+
+    internal::activate_set_server_error(e, scanner.message());
+    return messages;
+  }
+
+  return messages;
+}
+
 } // namespace v20190401
 
 } // namespace cryptolens_io
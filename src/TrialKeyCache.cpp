@@ -0,0 +1,122 @@
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+
+#include "api.hpp"
+#include "LicenseKeyFile.hpp"
+#include "TrialKeyCache.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace internal {
+
+/*
+ * Loads the keys saved in the file at path, which is then used by insert().
+ * A file which does not exist holds no keys.
+ *
+ * Each line of the file holds the product id, the key and the machine code,
+ * separated by a space. The machine code is last since it is not known to
+ * be free of spaces.
+ */
+void
+TrialKeyStore::load(basic_Error & e, std::string const& path)
+{
+  if (e) { return; }
+
+  using namespace errors;
+  api::main api;
+
+  std::map<std::pair<int, std::string>, std::string> keys;
+  std::ifstream in(path.c_str(), std::ios::binary);
+  std::string line;
+  while (in && std::getline(in, line)) {
+    // The last line is incomplete if the file was not written by save()
+    if (in.eof()) { break; }
+
+    int product_id;
+    int n = 0;
+    if (std::sscanf(line.c_str(), "%d %n", &product_id, &n) != 1 || n == 0) { continue; }
+
+    size_t k = line.find(' ', n);
+    if (k == std::string::npos || k == (size_t)n) { continue; }
+
+    keys[std::make_pair(product_id, line.substr(k + 1))] = line.substr(n, k - n);
+  }
+
+  if (in.bad()) { e.set(api, Subsystem::File, File::READ, errno); return; }
+
+  // Keys already cached are kept, and are saved to the new file together
+  // with the next key
+  for (auto & x : keys_) { keys.insert(std::move(x)); }
+
+  path_ = path;
+  keys_ = std::move(keys);
+}
+
+std::string const*
+TrialKeyStore::find(int product_id, std::string const& machine_code) const
+{
+  auto it = keys_.find(std::make_pair(product_id, machine_code));
+  return it == keys_.end() ? nullptr : &it->second;
+}
+
+TrialKeyStore::Snapshot
+TrialKeyStore::insert(int product_id, std::string const& machine_code, std::string const& key)
+{
+  keys_[std::make_pair(product_id, machine_code)] = key;
+  return snapshot();
+}
+
+TrialKeyStore::Snapshot
+TrialKeyStore::clear()
+{
+  keys_.clear();
+  return snapshot();
+}
+
+/*
+ * Writes the contents returned by insert() or clear() to the file, unless
+ * the contents of a later change have already been written.
+ */
+void
+TrialKeyStore::save(basic_Error & e, Snapshot const& snapshot)
+{
+  if (e) { return; }
+
+  if (snapshot.path.empty()) { return; }
+
+  std::lock_guard<std::mutex> lock(save_mutex_);
+  if (snapshot.version <= saved_version_) { return; }
+
+  replace_file(e, snapshot.path, snapshot.contents);
+  if (!e) { saved_version_ = snapshot.version; }
+}
+
+TrialKeyStore::Snapshot
+TrialKeyStore::snapshot()
+{
+  Snapshot snapshot;
+  if (path_.empty()) { return snapshot; }
+
+  char product_id[16];
+  for (auto const& x : keys_) {
+    std::snprintf(product_id, sizeof(product_id), "%d ", x.first.first);
+    snapshot.contents += product_id;
+    snapshot.contents += x.second;
+    snapshot.contents += ' ';
+    snapshot.contents += x.first.second;
+    snapshot.contents += '\n';
+  }
+
+  snapshot.path = path_;
+  snapshot.version = ++version_;
+  return snapshot;
+}
+
+} // namespace internal
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
@@ -0,0 +1,469 @@
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <system_error>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "api.hpp"
+#include "Executor.hpp"
+#include "UsageMeter.hpp"
+
+namespace cryptolens_io {
+
+namespace v20190401 {
+
+namespace internal {
+
+namespace {
+
+bool
+parse_delta(std::string const& line, UsageJournalRecord & record)
+{
+  unsigned long long seq;
+  long long delta;
+  int n = 0;
+  if (std::sscanf(line.c_str(), "D %llu %d %d %lld %n", &seq, &record.product_id, &record.data_object_id, &delta, &n) != 4 || n == 0) {
+    return false;
+  }
+
+  record.seq = seq;
+  record.delta = delta;
+  record.key = line.substr(n);
+  return true;
+}
+
+} // namespace
+
+UsageCounter::UsageCounter(int product_id, std::string key, int data_object_id)
+: product_id(product_id), key(std::move(key)), data_object_id(data_object_id)
+{}
+
+/*
+ * Returns the amount added since the last call and resets the stripes.
+ */
+std::int64_t
+UsageCounter::take()
+{
+  std::int64_t n = 0;
+  for (size_t i = 0; i < STRIPES; ++i) {
+    // Skipping stripes without anything added avoids taking their cache
+    // lines from the threads using them
+    if (stripes_[i].value.load(std::memory_order_relaxed) == 0) { continue; }
+    n += stripes_[i].value.exchange(0, std::memory_order_relaxed);
+  }
+
+  return n;
+}
+
+size_t
+UsageCounter::next_stripe()
+{
+  static std::atomic<size_t> next(0);
+  return next.fetch_add(1, std::memory_order_relaxed) % STRIPES;
+}
+
+/*
+ * Reads the journal at path, returning the records of the amounts which
+ * were not marked as sent. A journal which does not exist is empty.
+ */
+std::vector<UsageJournalRecord>
+UsageJournal::replay(basic_Error & e, std::string const& path)
+{
+  std::vector<UsageJournalRecord> records;
+  if (e) { return records; }
+
+  using namespace errors;
+  api::main api;
+
+  close();
+
+  std::map<std::uint64_t, UsageJournalRecord> outstanding;
+  std::ifstream in(path.c_str(), std::ios::binary);
+  std::string line;
+  while (in && std::getline(in, line)) {
+    // The last line is incomplete if the process stopped while writing it
+    if (in.eof()) { break; }
+
+    if (line[0] == 'D') {
+      UsageJournalRecord record;
+      if (parse_delta(line, record)) { outstanding[record.seq] = record; }
+    } else if (line[0] == 'S') {
+      unsigned long long seq;
+      if (std::sscanf(line.c_str(), "S %llu", &seq) == 1) { outstanding.erase(seq); }
+    }
+  }
+
+  if (in.bad()) { e.set(api, Subsystem::File, File::READ, errno); return records; }
+
+  for (auto & x : outstanding) { records.push_back(std::move(x.second)); }
+
+  path_ = path;
+  empty_ = false;
+  return records;
+}
+
+void
+UsageJournal::append_delta(UsageCounter const& counter, std::uint64_t seq, std::int64_t delta)
+{
+  if (!file_) { return; }
+
+  std::fprintf( file_, "D %llu %d %d %lld %s\n"
+              , (unsigned long long)seq, counter.product_id, counter.data_object_id, (long long)delta, counter.key.c_str());
+  empty_ = false;
+}
+
+void
+UsageJournal::append_sent(std::uint64_t seq)
+{
+  if (!file_) { return; }
+
+  std::fprintf(file_, "S %llu\n", (unsigned long long)seq);
+  empty_ = false;
+}
+
+void
+UsageJournal::sync(basic_Error & e)
+{
+  if (e) { return; }
+
+  using namespace errors;
+  api::main api;
+
+  if (!file_) { e.set(api, Subsystem::File, File::WRITE); return; }
+
+  int r = sync_file(file_);
+  if (r != 0) { e.set(api, Subsystem::File, File::WRITE, r); }
+}
+
+/*
+ * Removes all records, once every amount has been sent.
+ */
+void
+UsageJournal::clear(basic_Error & e)
+{
+  if (e) { return; }
+
+  using namespace errors;
+  api::main api;
+
+  if (empty_) { return; }
+  if (!file_) { e.set(api, Subsystem::File, File::WRITE); return; }
+
+  // Whatever is buffered is written first, since it would be written after
+  // the truncation otherwise
+  if (std::fflush(file_) != 0) { e.set(api, Subsystem::File, File::WRITE, errno); return; }
+#ifdef _WIN32
+  int r = _chsize(_fileno(file_), 0) == 0 ? 0 : errno;
+#else
+  int r = ftruncate(fileno(file_), 0) == 0 ? 0 : errno;
+#endif
+  if (r == 0) { r = sync_file(file_); }
+  if (r != 0) { e.set(api, Subsystem::File, File::WRITE, r); return; }
+
+  empty_ = true;
+}
+
+/*
+ * Replaces the journal with one holding only the given records, by writing
+ * a new file and renaming it over the journal. Used to start over after an
+ * error, when it is unknown which records were written, and to drop the
+ * records of amounts which have been sent.
+ */
+void
+UsageJournal::rewrite(basic_Error & e, std::vector<UsageJournalRecord> const& records)
+{
+  if (e) { return; }
+
+  using namespace errors;
+  api::main api;
+
+  close();
+
+  std::string contents;
+  char line[128];
+  for (auto const& x : records) {
+    std::snprintf( line, sizeof(line), "D %llu %d %d %lld "
+                 , (unsigned long long)x.seq, x.product_id, x.data_object_id, (long long)x.delta);
+    contents += line;
+    contents += x.key;
+    contents += '\n';
+  }
+
+  replace_file(e, path_, contents);
+  if (e) { return; }
+
+  file_ = std::fopen(path_.c_str(), "ab");
+  if (!file_) { e.set(api, Subsystem::File, File::OPEN, errno); return; }
+
+  empty_ = records.empty();
+}
+
+void
+UsageJournal::close()
+{
+  if (!file_) { return; }
+
+  std::fclose(file_);
+  file_ = NULL;
+}
+
+UsageMeterCore::UsageMeterCore(Send send)
+: send_(std::move(send)), flush_threshold_(0), flush_interval_(std::chrono::minutes(1))
+, flush_requested_(false), stopping_(false), journal_dirty_(false), last_seq_(0)
+{}
+
+UsageMeterCore::~UsageMeterCore()
+{
+  stop_thread();
+}
+
+UsageCounter *
+UsageMeterCore::counter(int product_id, std::string const& key, int data_object_id)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<UsageCounter> & counter = counters_[std::make_tuple(product_id, key, data_object_id)];
+  if (!counter) { counter.reset(new UsageCounter(product_id, key, data_object_id)); }
+  return counter.get();
+}
+
+std::vector<UsageCounter *>
+UsageMeterCore::counters()
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<UsageCounter *> counters;
+  counters.reserve(counters_.size());
+  for (auto const& x : counters_) { counters.push_back(x.second.get()); }
+  return counters;
+}
+
+void
+UsageMeterCore::set_journal(basic_Error & e, std::string const& path)
+{
+  if (e) { return; }
+
+  std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+
+  std::vector<UsageJournalRecord> records = journal_.replay(e, path);
+  if (e) { return; }
+
+  for (auto const& x : records) {
+    counter(x.product_id, x.key, x.data_object_id)->unsent.push_back(std::make_pair(x.seq, x.delta));
+  }
+
+  // The journal is rewritten with just the amounts not yet sent, which are
+  // numbered again since those replayed may use the same numbers as those
+  // already in the meter
+  std::vector<UsageCounter *> counters = this->counters();
+  last_seq_ = 0;
+  for (UsageCounter * c : counters) {
+    for (auto & x : c->unsent) { x.first = ++last_seq_; }
+  }
+
+  journal_dirty_ = true;
+  sync_journal(e, counters);
+}
+
+void
+UsageMeterCore::set_flush_interval(std::chrono::milliseconds flush_interval)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  flush_interval_ = flush_interval;
+}
+
+void
+UsageMeterCore::set_on_flush(OnFlush on_flush)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  on_flush_ = std::move(on_flush);
+}
+
+void
+UsageMeterCore::start(basic_Error & e)
+{
+  if (e) { return; }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (thread_.joinable()) { return; }
+
+  stopping_ = false;
+  try {
+    thread_ = std::thread(&UsageMeterCore::run, this);
+  } catch (std::system_error const&) {
+    e.set(api::main(), errors::Subsystem::Executor, errors::Executor::THREAD_CREATE);
+  }
+}
+
+void
+UsageMeterCore::stop()
+{
+  stop_thread();
+
+  basic_Error e;
+  flush(e);
+}
+
+void
+UsageMeterCore::stop_thread()
+{
+  std::thread thread;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    thread = std::move(thread_);
+  }
+  wake_.notify_all();
+
+  if (thread.joinable()) { thread.join(); }
+}
+
+void
+UsageMeterCore::request_flush()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    flush_requested_ = true;
+  }
+  wake_.notify_one();
+}
+
+void
+UsageMeterCore::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    wake_.wait_for(lock, flush_interval_, [this]() { return stopping_ || flush_requested_; });
+    if (stopping_) { break; }
+    flush_requested_ = false;
+
+    lock.unlock();
+    basic_Error e;
+    flush(e);
+    lock.lock();
+  }
+}
+
+void
+UsageMeterCore::flush(basic_Error & e)
+{
+  if (e) { return; }
+
+  {
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+    flush_(e);
+  }
+
+  OnFlush on_flush;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    on_flush = on_flush_;
+  }
+  if (on_flush) { on_flush(e); }
+}
+
+void
+UsageMeterCore::flush_(basic_Error & e)
+{
+  using namespace errors;
+  api::main api;
+
+  std::vector<UsageCounter *> counters = this->counters();
+
+  for (UsageCounter * c : counters) {
+    std::int64_t delta = c->take();
+    if (delta == 0) { continue; }
+
+    c->unsent.push_back(std::make_pair(++last_seq_, delta));
+    journal_.append_delta(*c, last_seq_, delta);
+  }
+
+  // Nothing is sent before it has been recorded in the journal
+  if (journal_.is_set()) {
+    bool outstanding = false;
+    for (UsageCounter * c : counters) { outstanding = outstanding || !c->unsent.empty(); }
+    if (!outstanding) { return; }
+
+    sync_journal(e, counters);
+    if (e) { return; }
+  }
+
+  for (UsageCounter * c : counters) {
+    if (c->unsent.empty()) { continue; }
+
+    std::int64_t total = 0;
+    for (auto const& x : c->unsent) { total += x.second; }
+
+    // Amounts not fitting in an int are sent using several requests
+    std::int64_t sent = 0;
+    basic_Error send_error;
+    while (sent != total) {
+      std::int64_t rest = total - sent;
+      int part = rest > INT_MAX ? INT_MAX : rest < -INT_MAX ? -INT_MAX : (int)rest;
+      send_(send_error, *c, part);
+      if (send_error) { break; }
+      sent += part;
+    }
+
+    if (send_error && !e) { e.set(api, send_error); }
+
+    if (sent == 0 && total != 0) { continue; }
+
+    // What was not sent is recorded again before the amounts it was part of
+    // are marked as sent, thus it is not lost if the process stops between
+    // the two records
+    std::vector<std::pair<std::uint64_t, std::int64_t>> done;
+    done.swap(c->unsent);
+    if (sent != total) {
+      c->unsent.push_back(std::make_pair(++last_seq_, total - sent));
+      journal_.append_delta(*c, last_seq_, total - sent);
+    }
+    for (auto const& x : done) { journal_.append_sent(x.first); }
+  }
+
+  if (journal_.is_set()) {
+    basic_Error journal_error;
+    sync_journal(journal_error, counters);
+    if (journal_error && !e) { e.set(api, journal_error); }
+  }
+}
+
+/*
+ * Makes what has been appended to the journal durable, starting over with a
+ * new file if an earlier write failed, or emptying it if everything has been
+ * sent.
+ */
+void
+UsageMeterCore::sync_journal(basic_Error & e, std::vector<UsageCounter *> const& counters)
+{
+  if (e) { return; }
+
+  std::vector<UsageJournalRecord> records;
+  for (UsageCounter * c : counters) {
+    for (auto const& x : c->unsent) {
+      UsageJournalRecord record;
+      record.seq = x.first;
+      record.product_id = c->product_id;
+      record.data_object_id = c->data_object_id;
+      record.delta = x.second;
+      record.key = c->key;
+      records.push_back(std::move(record));
+    }
+  }
+
+  if (journal_dirty_)       { journal_.rewrite(e, records); }
+  else if (records.empty()) { journal_.clear(e); }
+  else                      { journal_.sync(e); }
+
+  journal_dirty_ = (bool)e;
+}
+
+} // namespace internal
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
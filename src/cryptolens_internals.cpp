@@ -1,6 +1,7 @@
 #include <cstring>
 
 #include "basic_Error.hpp"
+#include "cryptolens_internals.hpp"
 
 namespace cryptolens_io {
 
@@ -8,6 +9,55 @@ namespace v20190401 {
 
 namespace internal {
 
+namespace {
+
+/*
+ * The messages returned by the Web API together with the corresponding
+ * reason in the Main subsystem. The table is indexed by reason, so entry i
+ * holds the message for reason i. Reasons without a server message have a
+ * NULL entry.
+ */
+struct ServerErrorMessage {
+  char const* message;
+  size_t length;
+};
+
+#define CRYPTOLENS_SERVER_ERROR_MESSAGE(s) { s, sizeof(s) - 1 }
+
+ServerErrorMessage const server_error_messages[] = {
+  /* 0                         */ { NULL, 0 },
+  /* UNKNOWN_SERVER_REPLY      */ { NULL, 0 },
+  /* INVALID_ACCESS_TOKEN      */ CRYPTOLENS_SERVER_ERROR_MESSAGE("Unable to authenticate."),
+  /* ACCESS_DENIED             */ CRYPTOLENS_SERVER_ERROR_MESSAGE("Access denied."),
+  /* INCORRECT_INPUT_PARAMETER */ CRYPTOLENS_SERVER_ERROR_MESSAGE("The input parameters were incorrect."),
+  /* PRODUCT_NOT_FOUND         */ CRYPTOLENS_SERVER_ERROR_MESSAGE("Could not find the product."),
+  /* KEY_NOT_FOUND             */ CRYPTOLENS_SERVER_ERROR_MESSAGE("Could not find the key."),
+  /* KEY_BLOCKED               */ CRYPTOLENS_SERVER_ERROR_MESSAGE("The key is blocked and cannot be accessed."),
+  /* DEVICE_LIMIT_REACHED      */ CRYPTOLENS_SERVER_ERROR_MESSAGE("Cannot activate the new device as the limit has been reached."),
+  /* KEY_EXPIRED               */ { NULL, 0 },
+};
+
+#undef CRYPTOLENS_SERVER_ERROR_MESSAGE
+
+int constexpr server_error_messages_size = sizeof(server_error_messages) / sizeof(server_error_messages[0]);
+
+bool
+matches(char const* server_response, size_t length, int reason)
+{
+  ServerErrorMessage const& m = server_error_messages[reason];
+  return m.length == length && 0 == std::memcmp(server_response, m.message, length);
+}
+
+} // namespace
+
+/*
+ * Maps an error message returned by the Web API to a reason in the Main
+ * subsystem.
+ *
+ * This is called for every error response, so instead of trying each known
+ * message in turn we dispatch on the length and the first character of the
+ * message, which leaves at most a single memcmp() against a candidate.
+ */
 int
 activate_parse_server_error_message(char const* server_response)
 {
@@ -15,37 +65,79 @@ activate_parse_server_error_message(char const* server_response)
 
   if (server_response == NULL) { return Main::UNKNOWN_SERVER_REPLY; }
 
-  if (0 == std::strcmp(server_response, "Unable to authenticate.")) {
-    return Main::INVALID_ACCESS_TOKEN;
-  }
+  size_t const length = std::strlen(server_response);
+  int candidate = Main::UNKNOWN_SERVER_REPLY;
 
-  if (0 == std::strcmp(server_response, "Access denied.")) {
-    return Main::ACCESS_DENIED;
-  }
+  switch (length) {
+  case sizeof("Access denied.") - 1:
+    candidate = Main::ACCESS_DENIED;
+  break;
 
-  if (0 == std::strcmp(server_response, "The input parameters were incorrect.")) {
-    return Main::INCORRECT_INPUT_PARAMETER;
-  }
+  case sizeof("Unable to authenticate.") - 1:
+    // Same length as "Could not find the key."
+    static_assert(sizeof("Unable to authenticate.") == sizeof("Could not find the key."), "");
+    candidate = server_response[0] == 'U' ? Main::INVALID_ACCESS_TOKEN : Main::KEY_NOT_FOUND;
+  break;
 
-  if (0 == std::strcmp(server_response, "Could not find the product.")) {
-    return Main::PRODUCT_NOT_FOUND;
-  }
+  case sizeof("The input parameters were incorrect.") - 1:
+    candidate = Main::INCORRECT_INPUT_PARAMETER;
+  break;
 
-  if (0 == std::strcmp(server_response, "Could not find the key.")) {
-    return Main::KEY_NOT_FOUND;
-  }
+  case sizeof("Could not find the product.") - 1:
+    candidate = Main::PRODUCT_NOT_FOUND;
+  break;
+
+  case sizeof("The key is blocked and cannot be accessed.") - 1:
+    candidate = Main::KEY_BLOCKED;
+  break;
 
-  if (0 == std::strcmp(server_response, "The key is blocked and cannot be accessed.")) {
-    return Main::KEY_BLOCKED;
+  case sizeof("Cannot activate the new device as the limit has been reached.") - 1:
+    candidate = Main::DEVICE_LIMIT_REACHED;
+  break;
+
+  default:
+  break;
   }
 
-  if (0 == std::strcmp(server_response, "Cannot activate the new device as the limit has been reached.")) {
-    return Main::DEVICE_LIMIT_REACHED;
+  if (candidate != Main::UNKNOWN_SERVER_REPLY && matches(server_response, length, candidate)) {
+    return candidate;
   }
 
   return Main::UNKNOWN_SERVER_REPLY;
 }
 
+/*
+ * Returns the message the Web API uses for the given reason in the Main
+ * subsystem, or NULL if there is no such message.
+ *
+ * The returned string has static storage duration, which allows the message
+ * to be recovered from an Error object on demand instead of keeping a copy of
+ * every server response around.
+ */
+char const*
+activate_server_error_message(int reason)
+{
+  if (reason < 0 || reason >= server_error_messages_size) { return NULL; }
+
+  return server_error_messages[reason].message;
+}
+
+/*
+ * Sets e to the reason in the Main subsystem for an error message returned by
+ * the Web API. Messages which do not map to a known reason are kept in e, so
+ * that they are available through basic_Error::get_server_message().
+ */
+void
+activate_set_server_error(basic_Error & e, char const* server_response)
+{
+  using namespace errors;
+  api::main api;
+
+  int reason = activate_parse_server_error_message(server_response);
+  e.set(api, Subsystem::Main, reason);
+  if (reason == Main::UNKNOWN_SERVER_REPLY) { e.set_server_message(api, server_response); }
+}
+
 } // namespace internal
 
 } // namespace v20190401
@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <vector>
+
+#include <openssl/evp.h>
+
+#include "Licenses.hpp"
+#include "SigningKey.hpp"
+
+namespace cryptolens_io {
+
+namespace testkit {
+
+std::string
+b64_encode(std::string const& s)
+{
+  std::vector<unsigned char> buffer(4 * ((s.size() + 2) / 3) + 1);
+  int n = EVP_EncodeBlock(buffer.data(), (unsigned char const*)s.data(), (int)s.size());
+  return std::string((char const*)buffer.data(), n);
+}
+
+std::string
+machine_code_for(int i)
+{
+  char buffer[65];
+  std::snprintf(buffer, sizeof(buffer), "%08x%056x", i, 0);
+  return buffer;
+}
+
+namespace {
+
+void
+append_machine(std::string & s, std::string const& machine_code, int i)
+{
+  s += "{\"Mid\":\"";
+  s += machine_code;
+  s += "\",\"IP\":\"198.51.";
+  s += std::to_string((i >> 8) & 0xff);
+  s += '.';
+  s += std::to_string(i & 0xff);
+  s += "\",\"Time\":";
+  s += std::to_string(1554113437 + i);
+  s += '}';
+}
+
+} // namespace
+
+std::string
+make_license(LicenseSpec const& spec)
+{
+  std::string s;
+  s.reserve(512 + spec.activated_machines * 120);
+
+  s += "{\"ProductId\":";
+  s += std::to_string(spec.product_id);
+  s += ",\"ID\":1,\"Key\":\"";
+  s += spec.key;
+  s += "\",\"Created\":";
+  s += std::to_string(spec.created);
+  s += ",\"Expires\":";
+  s += std::to_string(spec.expires);
+  s += ",\"Period\":30,\"F1\":true,\"F2\":false,\"F3\":true,\"F4\":false,\"F5\":true,\"F6\":false"
+       ",\"F7\":true,\"F8\":false,\"Notes\":\"Test license\",\"Block\":false,\"GlobalId\":123456"
+       ",\"Customer\":{\"Id\":42,\"Name\":\"Jane Doe\",\"Email\":\"jane@example.com\""
+       ",\"CompanyName\":\"Example Inc.\",\"Created\":1554113437},\"ActivatedMachines\":[";
+
+  int n = 0;
+  for (; n < spec.activated_machines; ++n) {
+    if (n > 0) { s += ','; }
+    append_machine(s, machine_code_for(n), n);
+  }
+
+  if (!spec.machine_code.empty()) {
+    if (n > 0) { s += ','; }
+    append_machine(s, spec.machine_code, n);
+    ++n;
+  }
+
+  s += "],\"TrialActivation\":false,\"MaxNoOfMachines\":";
+  s += std::to_string(n + 1);
+  s += ",\"AllowedMachines\":\"\",\"DataObjects\":["
+       "{\"Id\":1,\"Name\":\"usage\",\"StringValue\":\"\",\"IntValue\":17},"
+       "{\"Id\":2,\"Name\":\"tier\",\"StringValue\":\"enterprise\",\"IntValue\":0}"
+       "],\"SignDate\":";
+  s += std::to_string(spec.created);
+  s += '}';
+
+  return s;
+}
+
+std::string
+make_activate_response(SigningKey const& signing_key, std::string const& license)
+{
+  std::string s;
+
+  s += "{\"licenseKey\":\"";
+  s += b64_encode(license);
+  s += "\",\"signature\":\"";
+  s += signing_key.sign_base64(license);
+  s += "\",\"result\":0,\"message\":\"\"}";
+
+  return s;
+}
+
+std::string
+make_error_response(std::string const& message)
+{
+  std::string s;
+
+  s += "{\"result\":1,\"message\":\"";
+  s += message;
+  s += "\"}";
+
+  return s;
+}
+
+} // namespace testkit
+
+} // namespace cryptolens_io
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace cryptolens_io {
+
+namespace testkit {
+
+class SigningKey;
+
+/**
+ * Describes a license key in the format returned by the Cryptolens Web API.
+ */
+struct LicenseSpec {
+  int product_id = 3646;
+  std::string key = "MPDWY-PQAOW-FKSCH-SGAAU";
+  std::uint64_t created = 1554113437;
+  std::uint64_t expires = 4102444800;
+  // Number of generated machines in ActivatedMachines, see machine_code_for()
+  int activated_machines = 0;
+  // If non-empty, added as the last element of ActivatedMachines
+  std::string machine_code;
+};
+
+std::string b64_encode(std::string const& s);
+
+// A machine code in the format produced by the MachineCodeComputers, i.e. a
+// hex encoded SHA256 hash, unique for each i
+std::string machine_code_for(int i);
+
+// The license key as JSON
+std::string make_license(LicenseSpec const& spec);
+
+// The body of a successful response from the Activate method
+std::string make_activate_response(SigningKey const& signing_key, std::string const& license);
+
+// The body of an unsuccessful response from any method of the Web API
+std::string make_error_response(std::string const& message);
+
+} // namespace testkit
+
+} // namespace cryptolens_io
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+
+#include <openssl/evp.h>
+
+namespace cryptolens_io {
+
+namespace testkit {
+
+/**
+ * An RSA key used to sign license keys in the same way as the Cryptolens
+ * Web API, for use in benchmarks and tools. The public key is available in
+ * the format expected by SignatureVerifier::set_modulus_base64() and
+ * set_exponent_base64().
+ *
+ * NOTE: The key returned by test_key() is embedded in the source code and
+ *       must never be used for anything except testing.
+ */
+class SigningKey {
+public:
+  explicit SigningKey(std::string const& private_key_pem);
+  ~SigningKey();
+
+  SigningKey(SigningKey const&) = delete;
+  void operator=(SigningKey const&) = delete;
+
+  static SigningKey const& test_key();
+
+  // Returns the base64 encoded RSA-SHA256 signature of the message
+  std::string sign_base64(std::string const& message) const;
+
+  std::string const& get_modulus_base64() const { return modulus_base64_; }
+  std::string const& get_exponent_base64() const { return exponent_base64_; }
+
+private:
+  EVP_PKEY * pkey_;
+  std::string modulus_base64_;
+  std::string exponent_base64_;
+};
+
+} // namespace testkit
+
+} // namespace cryptolens_io
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <string>
+
+#include <cryptolens/api.hpp>
+#include <cryptolens/basic_Error.hpp>
+#include <cryptolens/Clock.hpp>
+#include <cryptolens/Instrumentation.hpp>
+#include <cryptolens/MachineCodeComputer_static.hpp>
+#include <cryptolens/ResponseParser_ArduinoJson5.hpp>
+#include <cryptolens/SignatureVerifier_OpenSSL.hpp>
+
+#include <cryptolens/validators/AndValidator.hpp>
+#include <cryptolens/validators/CorrectKeyValidator.hpp>
+#include <cryptolens/validators/CorrectProductValidator.hpp>
+#include <cryptolens/validators/NotExpiredValidator.hpp>
+#include <cryptolens/validators/OnValidMachineValidator.hpp>
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+
+/*
+ * A RequestHandler which makes no requests. Instead the endpoint and the
+ * arguments of each request are passed to the function in respond, and
+ * what it returns is used as the response. The function may set the error
+ * to make the request fail, as if the server could not be reached.
+ *
+ * By default each request fails.
+ */
+class RequestHandler_fake {
+public:
+  using Arguments = std::map<std::string, std::string>;
+  using Respond = std::function<std::string(cryptolens::basic_Error & e, std::string const& endpoint, Arguments const& arguments)>;
+
+  class PostBuilder {
+  public:
+    PostBuilder(Respond const& respond, char const* endpoint) : respond_(respond), endpoint_(endpoint) {}
+
+    PostBuilder & add_argument(cryptolens::basic_Error &, char const* key, char const* value)
+    {
+      arguments_[key] = value;
+      return *this;
+    }
+
+    std::string make(cryptolens::basic_Error & e)
+    {
+      if (e) { return ""; }
+      return respond_(e, endpoint_, arguments_);
+    }
+
+  private:
+    Respond const& respond_;
+    std::string endpoint_;
+    Arguments arguments_;
+  };
+
+  explicit RequestHandler_fake(cryptolens::basic_Error &) : respond(fail) {}
+
+  PostBuilder post_request(cryptolens::basic_Error &, char const*, char const* endpoint)
+  {
+    return PostBuilder(respond, endpoint);
+  }
+
+  static std::string fail(cryptolens::basic_Error & e, std::string const&, Arguments const&)
+  {
+    e.set(cryptolens::api::main(), cryptolens::errors::Subsystem::RequestHandler, 1);
+    return "";
+  }
+
+  Respond respond;
+};
+
+/*
+ * A configuration making requests using RequestHandler_fake and checking
+ * expiry against Clock_fake, for use with a handle whose machine code is set
+ * using MachineCodeComputer_static::set_machine_code().
+ */
+struct Configuration_fake {
+  using ResponseParser = cryptolens::ResponseParser_ArduinoJson5;
+  using RequestHandler = RequestHandler_fake;
+  using SignatureVerifier = cryptolens::SignatureVerifier_OpenSSL;
+  using MachineCodeComputer = cryptolens::MachineCodeComputer_static;
+  using Instrumentation = cryptolens::Instrumentation_none;
+
+  template<typename Env>
+  using ActivateValidator = cryptolens::AndValidator_<Env, cryptolens::CorrectKeyValidator_<Env>
+                          , cryptolens::AndValidator_<Env, cryptolens::CorrectProductValidator_<Env>
+                          , cryptolens::AndValidator_<Env, cryptolens::OnValidMachineValidator_<Env>
+                          ,                               cryptolens::NotExpiredValidator_<Env, cryptolens::Clock_fake>
+                          >>>;
+};
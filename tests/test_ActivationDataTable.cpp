@@ -0,0 +1,166 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+#include <cryptolens/MemoryResource.hpp>
+
+#include <Licenses.hpp>
+#include <SigningKey.hpp>
+
+#include "Configuration_fake.hpp"
+
+namespace testkit = ::cryptolens_io::testkit;
+
+namespace {
+
+struct Machine {
+  std::string mid;
+  std::string ip;
+  std::uint64_t time;
+};
+
+// IPs written as ip_format() writes them are stored as bytes, others as text,
+// including IPv4-mapped addresses written in IPv6 notation
+std::vector<Machine> const machines = {
+  { "machine-0", "198.51.100.7", 1554113437 },
+  { "machine-1", "2001:db8::1", 1554113438 },
+  { "machine-2", "::ffff:198.51.100.7", 1554113439 },
+  { "machine-3", "", 1554113440 },
+  { "machine-4", "198.051.100.7", 1554113441 },
+  { "machine-5", "2001:DB8::1", 1554113442 },
+  { "machine-6", "2001:db8:0:0:1::1", 1554113443 },
+  { "machine-7", "not an address", 1554113444 },
+  { "", "10.0.0.1", 1554113445 },
+};
+
+template<typename Table>
+void
+fill(Table & table)
+{
+  for (Machine const& m : machines) { table.push_back(m.mid, m.ip, m.time); }
+}
+
+template<typename Table>
+void
+expect_machines(Table const& table)
+{
+  ASSERT_EQ(machines.size(), table.size());
+
+  size_t i = 0;
+  for (cryptolens::ActivationDataRef m : table) {
+    EXPECT_EQ(machines[i].mid, m.get_mid().to_string());
+    EXPECT_EQ(machines[i].ip, m.get_ip());
+    EXPECT_EQ(machines[i].time, m.get_time());
+    ++i;
+  }
+  EXPECT_EQ(machines.size(), i);
+}
+
+} // namespace
+
+TEST(ActivationDataTable, PushBackAndIterate)
+{
+  cryptolens::ActivationDataTable table;
+  EXPECT_TRUE(table.empty());
+
+  fill(table);
+  expect_machines(table);
+
+  EXPECT_EQ((std::ptrdiff_t)machines.size(), table.end() - table.begin());
+  EXPECT_EQ("machine-2", table.begin()[2].get_mid().to_string());
+  EXPECT_EQ("machine-2", table[2].get_mid().to_string());
+}
+
+TEST(ActivationDataTable, IPKinds)
+{
+  cryptolens::ActivationDataTable table;
+  fill(table);
+
+  EXPECT_TRUE(table[0].is_ipv4());
+  EXPECT_TRUE(table[1].is_ipv6());
+  for (size_t i = 2; i < 8; ++i) {
+    EXPECT_FALSE(table[i].is_ipv4()) << machines[i].ip;
+    EXPECT_FALSE(table[i].is_ipv6()) << machines[i].ip;
+    EXPECT_EQ(nullptr, table[i].get_ip_bytes()) << machines[i].ip;
+  }
+
+  // IPv4 addresses are stored as IPv4-mapped IPv6 addresses
+  unsigned char const expected[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff, 198, 51, 100, 7 };
+  ASSERT_NE(nullptr, table[0].get_ip_bytes());
+  EXPECT_EQ(0, std::memcmp(expected, table[0].get_ip_bytes(), 16));
+}
+
+TEST(ActivationDataTable, FindMid)
+{
+  cryptolens::ActivationDataTable table;
+  EXPECT_FALSE(table.find_mid("machine-0"));
+
+  fill(table);
+  for (size_t i = 0; i < machines.size(); ++i) {
+    cryptolens::optional<size_t> k = table.find_mid(machines[i].mid);
+    ASSERT_TRUE(k) << machines[i].mid;
+    EXPECT_EQ(i, *k);
+  }
+
+  EXPECT_FALSE(table.find_mid("machine"));
+  EXPECT_FALSE(table.find_mid("machine-00"));
+}
+
+TEST(ActivationDataTable, ToList)
+{
+  cryptolens::ActivationDataTable table;
+  fill(table);
+
+  cryptolens::ActivationDataTable::ActivationDataList list = table.to_list();
+  ASSERT_EQ(machines.size(), list.size());
+  for (size_t i = 0; i < machines.size(); ++i) {
+    EXPECT_EQ(machines[i].mid, list[i].get_mid());
+    EXPECT_EQ(machines[i].ip, list[i].get_ip());
+    EXPECT_EQ(machines[i].time, list[i].get_time());
+  }
+}
+
+TEST(ActivationDataTable, MemoryResource)
+{
+  cryptolens::MonotonicBufferResource arena;
+  cryptolens::pmr::ActivationDataTable table(&arena);
+  table.reserve(machines.size(), 100);
+  fill(table);
+
+  expect_machines(table);
+  EXPECT_EQ(&arena, table.get_allocator().resource());
+  EXPECT_EQ(&arena, table.to_list().get_allocator().resource());
+}
+
+TEST(ActivationDataTable, LicenseKey)
+{
+  testkit::SigningKey const& signing_key = testkit::SigningKey::test_key();
+  testkit::LicenseSpec spec;
+  spec.activated_machines = 300;
+  std::string response = testkit::make_activate_response(signing_key, testkit::make_license(spec));
+
+  cryptolens::Error e;
+  cryptolens::basic_Cryptolens<Configuration_fake> cryptolens_handle(e);
+  cryptolens_handle.signature_verifier.set_modulus_base64(e, signing_key.get_modulus_base64());
+  cryptolens_handle.signature_verifier.set_exponent_base64(e, signing_key.get_exponent_base64());
+  auto license_key = cryptolens_handle.make_license_key(e, response);
+  ASSERT_FALSE(e);
+  ASSERT_TRUE(license_key);
+
+  auto const& list = *license_key->get_activated_machines();
+  auto const& table = *license_key->get_activated_machines_table();
+  ASSERT_EQ(300u, list.size());
+  ASSERT_EQ(list.size(), table.size());
+  for (size_t i = 0; i < list.size(); ++i) {
+    EXPECT_EQ(list[i].get_mid(), table[i].get_mid().to_string());
+    EXPECT_EQ(list[i].get_ip(), table[i].get_ip());
+    EXPECT_EQ(list[i].get_time(), table[i].get_time());
+    EXPECT_TRUE(table[i].is_ipv4());
+  }
+
+  EXPECT_EQ(299u, *table.find_mid(testkit::machine_code_for(299)));
+}
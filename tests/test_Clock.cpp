@@ -0,0 +1,134 @@
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+
+#include <Licenses.hpp>
+#include <SigningKey.hpp>
+
+#include "Configuration_fake.hpp"
+
+namespace testkit = ::cryptolens_io::testkit;
+
+namespace {
+
+std::int64_t const EXPIRES = 4102444800;
+
+// Activates a license key expiring at EXPIRES, checking expiry using Clock_fake
+void
+activate(cryptolens::basic_Error & e)
+{
+  testkit::SigningKey const& signing_key = testkit::SigningKey::test_key();
+
+  cryptolens::basic_Cryptolens<Configuration_fake> cryptolens_handle(e);
+  cryptolens_handle.signature_verifier.set_modulus_base64(e, signing_key.get_modulus_base64());
+  cryptolens_handle.signature_verifier.set_exponent_base64(e, signing_key.get_exponent_base64());
+  cryptolens_handle.machine_code_computer.set_machine_code(e, testkit::machine_code_for(1));
+  cryptolens_handle.request_handler.respond = [&signing_key](cryptolens::basic_Error &, std::string const&, RequestHandler_fake::Arguments const&) {
+    testkit::LicenseSpec spec;
+    spec.expires = EXPIRES;
+    spec.machine_code = testkit::machine_code_for(1);
+    return testkit::make_activate_response(signing_key, testkit::make_license(spec));
+  };
+
+  testkit::LicenseSpec spec;
+  cryptolens_handle.activate(e, "token", spec.product_id, spec.key);
+}
+
+/*
+ * Clock_fake is shared by all tests in the process, and the other tests rely
+ * on the initial time, thus tests changing it restore it when they finish.
+ */
+struct RestoreClock_fake {
+  ~RestoreClock_fake() { cryptolens::Clock_fake::set(0); }
+};
+
+} // namespace
+
+TEST(Clock_fake, OnlyChangesWhenTold)
+{
+  RestoreClock_fake restore;
+  cryptolens::Clock_fake::set(1000);
+  EXPECT_EQ(1000, cryptolens::Clock_fake::now());
+
+  cryptolens::Clock_fake::advance(5);
+  EXPECT_EQ(1005, cryptolens::Clock_fake::now());
+
+  cryptolens::Clock_fake::advance(-10);
+  EXPECT_EQ(995, cryptolens::Clock_fake::now());
+}
+
+TEST(Clock_coarse, FollowsSystemClock)
+{
+  std::int64_t before = (std::int64_t)std::time(NULL);
+  std::int64_t first = cryptolens::Clock_coarse::now();
+  EXPECT_GE(first, before);
+  EXPECT_LE(first, (std::int64_t)std::time(NULL));
+
+  // Read from the background thread from now on
+  std::this_thread::sleep_for(std::chrono::milliseconds(2100));
+
+  std::int64_t second = cryptolens::Clock_coarse::now();
+  EXPECT_GE(second, first + 2);
+  EXPECT_LE(second, (std::int64_t)std::time(NULL));
+}
+
+TEST(NotExpiredValidator, UsesClock)
+{
+  RestoreClock_fake restore;
+  cryptolens::Clock_fake::set(EXPIRES);
+  {
+    cryptolens::Error e;
+    activate(e);
+    EXPECT_FALSE(e);
+  }
+
+  cryptolens::Clock_fake::set(EXPIRES + 1);
+  {
+    cryptolens::Error e;
+    activate(e);
+    EXPECT_EQ(cryptolens::errors::Subsystem::Main, e.get_subsystem(cryptolens::api::main()));
+    EXPECT_EQ(cryptolens::errors::Main::KEY_EXPIRED, e.get_reason(cryptolens::api::main()));
+  }
+
+  cryptolens::Clock_fake::set(-1);
+  {
+    cryptolens::Error e;
+    activate(e);
+    EXPECT_EQ(cryptolens::errors::Main::KEY_EXPIRED, e.get_reason(cryptolens::api::main()));
+  }
+}
+
+TEST(LicenseKeyChecker, UsesClock)
+{
+  RestoreClock_fake restore;
+  testkit::LicenseSpec spec;
+  spec.expires = EXPIRES;
+  std::string response = testkit::make_activate_response(testkit::SigningKey::test_key(), testkit::make_license(spec));
+
+  cryptolens::Error e;
+  cryptolens::basic_Cryptolens<Configuration_fake> cryptolens_handle(e);
+  cryptolens_handle.signature_verifier.set_modulus_base64(e, testkit::SigningKey::test_key().get_modulus_base64());
+  cryptolens_handle.signature_verifier.set_exponent_base64(e, testkit::SigningKey::test_key().get_exponent_base64());
+  auto license_key = cryptolens_handle.make_license_key(e, response);
+  ASSERT_FALSE(e);
+  ASSERT_TRUE(license_key);
+
+  cryptolens::Clock_fake::set(EXPIRES - 1);
+  EXPECT_TRUE((bool)license_key->check().has_not_expired<cryptolens::Clock_fake>());
+  EXPECT_FALSE((bool)license_key->check().has_expired<cryptolens::Clock_fake>());
+
+  cryptolens::Clock_fake::set(EXPIRES + 1);
+  EXPECT_FALSE((bool)license_key->check().has_not_expired<cryptolens::Clock_fake>());
+  EXPECT_TRUE((bool)license_key->check().has_expired<cryptolens::Clock_fake>());
+
+  // Both checks fail if the time is not available
+  cryptolens::Clock_fake::set(-1);
+  EXPECT_FALSE((bool)license_key->check().has_not_expired<cryptolens::Clock_fake>());
+  EXPECT_FALSE((bool)license_key->check().has_expired<cryptolens::Clock_fake>());
+}
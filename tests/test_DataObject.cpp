@@ -0,0 +1,155 @@
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+
+#include <Licenses.hpp>
+#include <SigningKey.hpp>
+
+#include "Configuration_fake.hpp"
+
+namespace testkit = ::cryptolens_io::testkit;
+
+namespace {
+
+// The name and int value of a data object
+using NamedValue = std::pair<std::string, int>;
+
+class DataObjectTest : public ::testing::Test {
+protected:
+  DataObjectTest() : cryptolens_handle(e)
+  {
+    testkit::SigningKey const& signing_key = testkit::SigningKey::test_key();
+    cryptolens_handle.signature_verifier.set_modulus_base64(e, signing_key.get_modulus_base64());
+    cryptolens_handle.signature_verifier.set_exponent_base64(e, signing_key.get_exponent_base64());
+  }
+
+  // Replaces the data objects of the license generated by the testkit
+  static std::string
+  license_with_data_objects(std::string const& data_objects)
+  {
+    std::string license = testkit::make_license(testkit::LicenseSpec());
+    std::string::size_type begin = license.find("\"DataObjects\":[");
+    std::string::size_type end = license.find(']', begin) + 1;
+    return license.replace(begin, end - begin, data_objects);
+  }
+
+  cryptolens::optional<cryptolens::LicenseKey>
+  make_license_key(std::vector<NamedValue> const& values)
+  {
+    std::string data_objects = "\"DataObjects\":[";
+    for (size_t i = 0; i < values.size(); ++i) {
+      if (i > 0) { data_objects += ','; }
+      data_objects += "{\"Id\":" + std::to_string(i + 1) + ",\"Name\":\"" + values[i].first
+                    + "\",\"StringValue\":\"\",\"IntValue\":" + std::to_string(values[i].second) + "}";
+    }
+    data_objects += ']';
+
+    return make_license_key(license_with_data_objects(data_objects));
+  }
+
+  cryptolens::optional<cryptolens::LicenseKey>
+  make_license_key(std::string const& license)
+  {
+    auto license_key = cryptolens_handle.make_license_key(e, testkit::make_activate_response(testkit::SigningKey::test_key(), license));
+    EXPECT_FALSE(e);
+    return license_key;
+  }
+
+  cryptolens::Error e;
+  cryptolens::basic_Cryptolens<Configuration_fake> cryptolens_handle;
+};
+
+TEST_F(DataObjectTest, FindDataObject)
+{
+  // Added in reverse order, and with names which are prefixes of each other,
+  // so that the lookup depends on the index being sorted
+  std::vector<NamedValue> values;
+  for (int i = 99; i >= 0; --i) { values.push_back(NamedValue("name" + std::to_string(i), i)); }
+
+  auto license_key = make_license_key(values);
+  ASSERT_TRUE(license_key);
+
+  for (int i = 0; i < 100; ++i) {
+    std::string name = "name" + std::to_string(i);
+    auto data_object = license_key->find_data_object(name);
+    ASSERT_TRUE(data_object) << name;
+    EXPECT_EQ(name, data_object->get_name());
+    EXPECT_EQ(i, data_object->get_int_value());
+  }
+
+  EXPECT_FALSE(license_key->find_data_object("name"));
+  EXPECT_FALSE(license_key->find_data_object("name100"));
+  EXPECT_FALSE(license_key->find_data_object("a"));
+  EXPECT_FALSE(license_key->find_data_object("z"));
+  // The name is compared up to its length, not up to a null character
+  EXPECT_TRUE(license_key->find_data_object(cryptolens::StringView("name12", 5)));
+  EXPECT_EQ(1, license_key->find_data_object(cryptolens::StringView("name12", 5))->get_int_value());
+}
+
+TEST_F(DataObjectTest, DuplicateNames)
+{
+  auto license_key = make_license_key(std::vector<NamedValue>{
+    NamedValue("seats", 1), NamedValue("tier", 2), NamedValue("seats", 3), NamedValue("a", 4), NamedValue("seats", 5)});
+  ASSERT_TRUE(license_key);
+
+  // The first of the data objects with the name is found
+  auto data_object = license_key->find_data_object("seats");
+  ASSERT_TRUE(data_object);
+  EXPECT_EQ(1, data_object->get_id());
+  EXPECT_EQ(1, data_object->get_int_value());
+  EXPECT_EQ(1, license_key->int_value_or("seats", 0));
+
+  // The data objects are still listed in their original order
+  ASSERT_TRUE(license_key->get_data_objects());
+  auto const& data_objects = *license_key->get_data_objects();
+  ASSERT_EQ(5u, data_objects.size());
+  for (size_t i = 0; i < data_objects.size(); ++i) { EXPECT_EQ((int)i + 1, data_objects[i].get_id()); }
+}
+
+TEST_F(DataObjectTest, EmptyName)
+{
+  auto license_key = make_license_key(std::vector<NamedValue>{NamedValue("b", 1), NamedValue("", 2)});
+  ASSERT_TRUE(license_key);
+
+  EXPECT_EQ(2, license_key->int_value_or("", -1));
+  EXPECT_EQ(2, license_key->int_value_or(cryptolens::StringView(), -1));
+  EXPECT_EQ(1, license_key->int_value_or("b", -1));
+
+  license_key = make_license_key(std::vector<NamedValue>{NamedValue("b", 1)});
+  ASSERT_TRUE(license_key);
+  EXPECT_FALSE(license_key->find_data_object(""));
+}
+
+TEST_F(DataObjectTest, IntValueOr)
+{
+  auto license_key = make_license_key(std::vector<NamedValue>{NamedValue("max_users", 25), NamedValue("zero", 0)});
+  ASSERT_TRUE(license_key);
+
+  EXPECT_EQ(25, license_key->int_value_or("max_users", 5));
+  // A value of zero is not mistaken for a missing data object
+  EXPECT_EQ(0, license_key->int_value_or("zero", 5));
+  EXPECT_EQ(5, license_key->int_value_or("missing", 5));
+  EXPECT_EQ(-1, license_key->int_value_or("max_user", -1));
+}
+
+TEST_F(DataObjectTest, NoDataObjects)
+{
+  auto license_key = make_license_key(std::vector<NamedValue>());
+  ASSERT_TRUE(license_key);
+  EXPECT_FALSE(license_key->find_data_object("usage"));
+  EXPECT_EQ(5, license_key->int_value_or("usage", 5));
+
+  // Without the DataObjects field the license key has no list at all
+  license_key = make_license_key(license_with_data_objects("\"DataObjects\":null"));
+  ASSERT_TRUE(license_key);
+  EXPECT_FALSE(license_key->get_data_objects());
+  EXPECT_FALSE(license_key->find_data_object("usage"));
+  EXPECT_EQ(5, license_key->int_value_or("usage", 5));
+}
+
+} // namespace
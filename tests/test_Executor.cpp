@@ -0,0 +1,107 @@
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/Error.hpp>
+#include <cryptolens/Executor.hpp>
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+
+namespace {
+
+// Checks that parallel_for calls the body for ranges covering each index once
+void
+expect_covered(cryptolens::Executor & executor, size_t n)
+{
+  std::vector<std::atomic<int>> calls(n);
+  for (auto & x : calls) { x.store(0); }
+
+  cryptolens::internal::parallel_for(executor, n, [&calls](size_t begin, size_t end) {
+    EXPECT_LT(begin, end);
+    for (size_t i = begin; i < end; ++i) { calls[i].fetch_add(1); }
+  });
+
+  for (size_t i = 0; i < n; ++i) { EXPECT_EQ(1, calls[i].load()) << i << " of " << n; }
+}
+
+} // namespace
+
+TEST(Executor_inline, RunsOnCallingThread)
+{
+  cryptolens::Executor_inline executor;
+  EXPECT_EQ(1u, executor.concurrency());
+
+  std::thread::id id;
+  executor.execute([&id]() { id = std::this_thread::get_id(); });
+  EXPECT_EQ(std::this_thread::get_id(), id);
+}
+
+TEST(Executor_thread_pool, RunsAllTasks)
+{
+  cryptolens::Error e;
+  std::atomic<int> done(0);
+  {
+    cryptolens::Executor_thread_pool executor(e, 4);
+    ASSERT_FALSE(e);
+    EXPECT_EQ(4u, executor.concurrency());
+
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+    for (int i = 0; i < 1000; ++i) {
+      executor.execute([&]() {
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          threads.insert(std::this_thread::get_id());
+        }
+        done.fetch_add(1);
+      });
+    }
+
+    while (done.load() != 1000) { std::this_thread::yield(); }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(0u, threads.count(std::this_thread::get_id()));
+    EXPECT_LE(threads.size(), 4u);
+  }
+  EXPECT_EQ(1000, done.load());
+}
+
+TEST(parallel_for, Inline)
+{
+  cryptolens::Executor_inline executor;
+  for (size_t n : { 0, 1, 2, 3, 17, 1000 }) { expect_covered(executor, n); }
+}
+
+TEST(parallel_for, ThreadPool)
+{
+  cryptolens::Error e;
+  cryptolens::Executor_thread_pool executor(e, 4);
+  ASSERT_FALSE(e);
+
+  for (size_t n : { 0, 1, 2, 3, 4, 5, 17, 1000, 100000 }) { expect_covered(executor, n); }
+}
+
+TEST(parallel_for, DefaultExecutor)
+{
+  expect_covered(cryptolens::default_executor(), 1000);
+}
+
+TEST(parallel_for, Nested)
+{
+  // Calls from the threads of the pool finish even when all of them are busy
+  cryptolens::Error e;
+  cryptolens::Executor_thread_pool executor(e, 2);
+  ASSERT_FALSE(e);
+
+  std::atomic<int> calls(0);
+  cryptolens::internal::parallel_for(executor, 8, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      cryptolens::internal::parallel_for(executor, 100, [&calls](size_t b, size_t c) { calls.fetch_add((int)(c - b)); });
+    }
+  });
+  EXPECT_EQ(800, calls.load());
+}
@@ -0,0 +1,184 @@
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+#include <cryptolens/LicenseKeyFile.hpp>
+
+#include <Licenses.hpp>
+#include <SigningKey.hpp>
+
+#include "Configuration_fake.hpp"
+
+namespace testkit = ::cryptolens_io::testkit;
+
+namespace {
+
+namespace Subsystem = cryptolens::errors::Subsystem;
+namespace File = cryptolens::errors::File;
+
+class LicenseKeyFileTest : public ::testing::Test {
+protected:
+  LicenseKeyFileTest()
+  // ctest may run the tests in parallel, thus each uses its own directory
+  : directory(::testing::TempDir() + "cryptolens_test_license_keys_" + ::testing::UnitTest::GetInstance()->current_test_info()->name())
+  , cryptolens_handle(e)
+  {
+    clean();
+    mkdir(directory.c_str(), 0700);
+
+    testkit::SigningKey const& signing_key = testkit::SigningKey::test_key();
+    cryptolens_handle.signature_verifier.set_modulus_base64(e, signing_key.get_modulus_base64());
+    cryptolens_handle.signature_verifier.set_exponent_base64(e, signing_key.get_exponent_base64());
+  }
+
+  ~LicenseKeyFileTest() { clean(); }
+
+  std::string
+  path(std::string const& name) const
+  {
+    return directory + "/" + name;
+  }
+
+  void
+  write(std::string const& name, std::string const& contents)
+  {
+    std::ofstream out(path(name).c_str(), std::ios::binary);
+    out << contents;
+    created.push_back(name);
+  }
+
+  static std::string
+  activate_response(std::string const& key)
+  {
+    testkit::LicenseSpec spec;
+    spec.key = key;
+    return testkit::make_activate_response(testkit::SigningKey::test_key(), testkit::make_license(spec));
+  }
+
+  // The format written by LicenseKey::to_string()
+  std::string
+  saved(std::string const& key)
+  {
+    auto license_key = cryptolens_handle.make_license_key(e, activate_response(key));
+    EXPECT_FALSE(e);
+    return license_key ? license_key->to_string() : "";
+  }
+
+  void
+  clean()
+  {
+    for (auto const& name : created) { std::remove(path(name).c_str()); }
+    rmdir(path("subdirectory").c_str());
+    rmdir(directory.c_str());
+  }
+
+  std::string directory;
+  std::vector<std::string> created;
+  cryptolens::Error e;
+  cryptolens::basic_Cryptolens<Configuration_fake> cryptolens_handle;
+};
+
+TEST_F(LicenseKeyFileTest, ListLicenseKeyFiles)
+{
+  write("b", "");
+  write("a", "");
+  write(".hidden", "");
+  mkdir(path("subdirectory").c_str(), 0700);
+
+  std::vector<std::string> paths = cryptolens::list_license_key_files(e, directory);
+  ASSERT_FALSE(e);
+  ASSERT_EQ(2u, paths.size());
+  EXPECT_EQ(path("a"), paths[0]);
+  EXPECT_EQ(path("b"), paths[1]);
+
+  // A trailing separator is not repeated
+  paths = cryptolens::list_license_key_files(e, directory + "/");
+  ASSERT_EQ(2u, paths.size());
+  EXPECT_EQ(path("a"), paths[0]);
+}
+
+TEST_F(LicenseKeyFileTest, ListMissingDirectory)
+{
+  std::vector<std::string> paths = cryptolens::list_license_key_files(e, path("missing"));
+  EXPECT_TRUE(paths.empty());
+  EXPECT_EQ(Subsystem::File, e.get_subsystem(cryptolens::api::main()));
+  EXPECT_EQ(File::DIRECTORY, e.get_reason(cryptolens::api::main()));
+  EXPECT_EQ((size_t)ENOENT, e.get_extra(cryptolens::api::main()));
+}
+
+TEST_F(LicenseKeyFileTest, ReadLicenseKeyManifest)
+{
+  write("manifest",
+    "# Comments and empty lines are skipped\n"
+    "\n"
+    "   \t\n"
+    "a\n"
+    "  b  \r\n"
+    "keys/c\n"
+    "/absolute/d\n"
+    "  # indented comment\n"
+    "e");
+
+  std::vector<std::string> paths = cryptolens::read_license_key_manifest(e, path("manifest"));
+  ASSERT_FALSE(e);
+  ASSERT_EQ(5u, paths.size());
+  EXPECT_EQ(path("a"), paths[0]);
+  EXPECT_EQ(path("b"), paths[1]);
+  EXPECT_EQ(path("keys/c"), paths[2]);
+  EXPECT_EQ("/absolute/d", paths[3]);
+  EXPECT_EQ(path("e"), paths[4]);
+}
+
+TEST_F(LicenseKeyFileTest, ReadMissingManifest)
+{
+  std::vector<std::string> paths = cryptolens::read_license_key_manifest(e, path("missing"));
+  EXPECT_TRUE(paths.empty());
+  EXPECT_EQ(Subsystem::File, e.get_subsystem(cryptolens::api::main()));
+  EXPECT_EQ(File::OPEN, e.get_reason(cryptolens::api::main()));
+}
+
+TEST_F(LicenseKeyFileTest, LoadLicenseKeyFiles)
+{
+  write("1-saved", saved("BBBBB-BBBBB-BBBBB-BBBBB") + "\n");
+  write("2-response", "\n" + activate_response("AAAAA-AAAAA-AAAAA-AAAAA") + "\r\n");
+  write("3-same-key", saved("AAAAA-AAAAA-AAAAA-AAAAA"));
+  write("4-corrupt", "not a license key");
+  write("5-empty", "");
+
+  std::vector<std::string> paths = cryptolens::list_license_key_files(e, directory);
+  paths.push_back(path("6-missing"));
+
+  std::vector<cryptolens::basic_Error> errors;
+  std::vector<cryptolens::LicenseKeyFile> files = cryptolens_handle.load_license_key_files(e, paths, errors);
+
+  // Failures are reported for each file, not for the batch
+  EXPECT_FALSE(e);
+  ASSERT_EQ(6u, errors.size());
+  EXPECT_FALSE(errors[0]);
+  EXPECT_FALSE(errors[1]);
+  EXPECT_FALSE(errors[2]);
+  EXPECT_TRUE(errors[3]);
+  EXPECT_TRUE(errors[4]);
+  EXPECT_EQ(Subsystem::File, errors[5].get_subsystem(cryptolens::api::main()));
+  EXPECT_EQ(File::OPEN, errors[5].get_reason(cryptolens::api::main()));
+
+  // Sorted by key and then by path
+  ASSERT_EQ(3u, files.size());
+  EXPECT_EQ(path("2-response"), files[0].path);
+  EXPECT_EQ("AAAAA-AAAAA-AAAAA-AAAAA", *files[0].license_key.get_key());
+  EXPECT_EQ(path("3-same-key"), files[1].path);
+  EXPECT_EQ("AAAAA-AAAAA-AAAAA-AAAAA", *files[1].license_key.get_key());
+  EXPECT_EQ(path("1-saved"), files[2].path);
+  EXPECT_EQ("BBBBB-BBBBB-BBBBB-BBBBB", *files[2].license_key.get_key());
+}
+
+} // namespace
@@ -0,0 +1,158 @@
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+
+#include <Licenses.hpp>
+#include <SigningKey.hpp>
+
+#include "Configuration_fake.hpp"
+
+namespace testkit = ::cryptolens_io::testkit;
+
+namespace {
+
+class LicenseKeyViewTest : public ::testing::Test {
+protected:
+  LicenseKeyViewTest() : cryptolens_handle(e)
+  {
+    testkit::SigningKey const& signing_key = testkit::SigningKey::test_key();
+    cryptolens_handle.signature_verifier.set_modulus_base64(e, signing_key.get_modulus_base64());
+    cryptolens_handle.signature_verifier.set_exponent_base64(e, signing_key.get_exponent_base64());
+
+    testkit::LicenseSpec spec;
+    spec.activated_machines = 3;
+    std::string license = testkit::make_license(spec);
+
+    // Strings with escape sequences are stored in decoded form
+    std::string notes = "\"Test license\"";
+    license.replace(license.find(notes), notes.size(), "\"Test \\\"license\\\"\\n\"");
+
+    license_key = cryptolens_handle.make_license_key(e, testkit::make_activate_response(signing_key, license));
+    if (license_key) { binary = license_key->to_binary(e); }
+  }
+
+  cryptolens::optional<cryptolens::LicenseKeyView> make_view(std::string const& s)
+  {
+    return cryptolens_handle.make_license_key_view(e, s.data(), s.size());
+  }
+
+  cryptolens::Error e;
+  cryptolens::basic_Cryptolens<Configuration_fake> cryptolens_handle;
+  cryptolens::optional<cryptolens::LicenseKey> license_key;
+  std::string binary;
+};
+
+} // namespace
+
+TEST_F(LicenseKeyViewTest, RoundTrip)
+{
+  ASSERT_FALSE(e);
+  ASSERT_TRUE(license_key);
+
+  auto view = make_view(binary);
+  ASSERT_FALSE(e);
+  ASSERT_TRUE(view);
+
+  cryptolens::LicenseKey const& k = *license_key;
+  EXPECT_EQ(k.get_product_id(), view->get_product_id());
+  EXPECT_EQ(k.get_created(), view->get_created());
+  EXPECT_EQ(k.get_expires(), view->get_expires());
+  EXPECT_EQ(k.get_period(), view->get_period());
+  EXPECT_EQ(k.get_block(), view->get_block());
+  EXPECT_EQ(k.get_trial_activation(), view->get_trial_activation());
+  EXPECT_EQ(k.get_sign_date(), view->get_sign_date());
+  EXPECT_EQ(k.get_f1(), view->get_f1());
+  EXPECT_EQ(k.get_f2(), view->get_f2());
+  EXPECT_EQ(k.get_f8(), view->get_f8());
+
+  EXPECT_EQ(*k.get_id(), *view->get_id());
+  EXPECT_EQ(*k.get_key(), view->get_key()->to_string());
+  EXPECT_EQ("Test \"license\"\n", view->get_notes()->to_string());
+  EXPECT_EQ(*k.get_notes(), view->get_notes()->to_string());
+  EXPECT_EQ(*k.get_global_id(), *view->get_global_id());
+  EXPECT_EQ(*k.get_maxnoofmachines(), *view->get_maxnoofmachines());
+  EXPECT_EQ(*k.get_allowed_machines(), view->get_allowed_machines()->to_string());
+
+  ASSERT_TRUE(view->get_customer());
+  EXPECT_EQ(k.get_customer()->get_id(), view->get_customer()->get_id());
+  EXPECT_EQ(k.get_customer()->get_name(), view->get_customer()->get_name().to_string());
+  EXPECT_EQ(k.get_customer()->get_email(), view->get_customer()->get_email().to_string());
+  EXPECT_EQ(k.get_customer()->get_company_name(), view->get_customer()->get_company_name().to_string());
+  EXPECT_EQ(k.get_customer()->get_created(), view->get_customer()->get_created());
+
+  auto const& machines = *k.get_activated_machines();
+  ASSERT_EQ(machines.size(), *view->get_activated_machines_count());
+  for (size_t i = 0; i < machines.size(); ++i) {
+    cryptolens::ActivationDataView m = view->get_activated_machine(i);
+    EXPECT_EQ(machines[i].get_mid(), m.get_mid().to_string());
+    EXPECT_EQ(machines[i].get_ip(), m.get_ip().to_string());
+    EXPECT_EQ(machines[i].get_time(), m.get_time());
+  }
+
+  auto const& data_objects = *k.get_data_objects();
+  ASSERT_EQ(data_objects.size(), *view->get_data_objects_count());
+  for (size_t i = 0; i < data_objects.size(); ++i) {
+    cryptolens::DataObjectView d = view->get_data_object(i);
+    EXPECT_EQ(data_objects[i].get_id(), d.get_id());
+    EXPECT_EQ(data_objects[i].get_name(), d.get_name().to_string());
+    EXPECT_EQ(data_objects[i].get_string_value(), d.get_string_value().to_string());
+    EXPECT_EQ(data_objects[i].get_int_value(), d.get_int_value());
+  }
+}
+
+TEST_F(LicenseKeyViewTest, Truncated)
+{
+  ASSERT_FALSE(e);
+
+  for (size_t size : { (size_t)0, (size_t)4, (size_t)23, (size_t)24, binary.size() / 2, binary.size() - 1 }) {
+    auto view = make_view(binary.substr(0, size));
+    EXPECT_FALSE(view);
+    EXPECT_EQ(cryptolens::errors::Subsystem::Binary, e.get_subsystem(cryptolens::api::main())) << size;
+    e.reset(cryptolens::api::main());
+  }
+}
+
+TEST_F(LicenseKeyViewTest, Header)
+{
+  ASSERT_FALSE(e);
+
+  std::string s = binary;
+  s[0] = 'X';
+  EXPECT_FALSE(make_view(s));
+  EXPECT_EQ(cryptolens::errors::Binary::MAGIC, e.get_reason(cryptolens::api::main()));
+  e.reset(cryptolens::api::main());
+
+  s = binary;
+  s[4] = 2;
+  EXPECT_FALSE(make_view(s));
+  EXPECT_EQ(cryptolens::errors::Binary::VERSION, e.get_reason(cryptolens::api::main()));
+}
+
+TEST_F(LicenseKeyViewTest, IndexIsChecked)
+{
+  ASSERT_FALSE(e);
+
+  // The value of the first index entry, the product id, follows the 24 byte
+  // header and the kind and length of the entry
+  std::string s = binary;
+  s[24 + 8] ^= 1;
+  EXPECT_FALSE(make_view(s));
+  EXPECT_EQ(cryptolens::errors::Subsystem::Binary, e.get_subsystem(cryptolens::api::main()));
+  EXPECT_EQ(cryptolens::errors::Binary::INDEX_MISMATCH, e.get_reason(cryptolens::api::main()));
+}
+
+TEST_F(LicenseKeyViewTest, SignatureIsChecked)
+{
+  ASSERT_FALSE(e);
+
+  // Changes the product id in the signed license, which is found after the
+  // index without a matching change of the index
+  std::string s = binary;
+  size_t k = s.find("\"ProductId\":3646");
+  ASSERT_NE(std::string::npos, k);
+  s[k + 12] = '4';
+  EXPECT_FALSE(make_view(s));
+}
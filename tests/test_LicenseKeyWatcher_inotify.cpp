@@ -0,0 +1,225 @@
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+#include <cryptolens/LicenseKeyWatcher_inotify.hpp>
+
+#include <Licenses.hpp>
+#include <SigningKey.hpp>
+
+#include "Configuration_fake.hpp"
+
+namespace testkit = ::cryptolens_io::testkit;
+
+namespace {
+
+using Cryptolens = cryptolens::basic_Cryptolens<Configuration_fake>;
+
+// A call of the function set using LicenseKeyWatcher_inotify::set_on_reload()
+struct Reload {
+  std::string path;
+  std::shared_ptr<cryptolens::LicenseKey const> license_key;
+  bool error;
+};
+
+class LicenseKeyWatcherTest : public ::testing::Test {
+protected:
+  LicenseKeyWatcherTest()
+  // ctest may run the tests in parallel, thus each uses its own directory
+  : directory(::testing::TempDir() + "cryptolens_test_watcher_" + ::testing::UnitTest::GetInstance()->current_test_info()->name())
+  , path(directory + "/license.skm")
+  , cryptolens_handle(e)
+  {
+    clean();
+    mkdir(directory.c_str(), 0700);
+
+    testkit::SigningKey const& signing_key = testkit::SigningKey::test_key();
+    cryptolens_handle.signature_verifier.set_modulus_base64(e, signing_key.get_modulus_base64());
+    cryptolens_handle.signature_verifier.set_exponent_base64(e, signing_key.get_exponent_base64());
+  }
+
+  ~LicenseKeyWatcherTest() { clean(); }
+
+  // The format written by LicenseKey::to_string()
+  std::string
+  saved(std::string const& key)
+  {
+    testkit::LicenseSpec spec;
+    spec.key = key;
+    auto license_key = cryptolens_handle.make_license_key(e, testkit::make_activate_response(testkit::SigningKey::test_key(), testkit::make_license(spec)));
+    EXPECT_FALSE(e);
+    return license_key ? license_key->to_string() : "";
+  }
+
+  static void
+  write(std::string const& path, std::string const& contents)
+  {
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    out << contents;
+  }
+
+  // Replaces the file by renaming a new file over it
+  void
+  replace(std::string const& contents)
+  {
+    write(path + ".new", contents);
+    ASSERT_EQ(0, std::rename((path + ".new").c_str(), path.c_str()));
+  }
+
+  void
+  record_reloads(cryptolens::LicenseKeyWatcher_inotify<Cryptolens> & watcher)
+  {
+    watcher.set_on_reload(e,
+      [this](std::string const& path, std::shared_ptr<cryptolens::LicenseKey const> const& license_key, cryptolens::basic_Error const& e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        reloads.push_back(Reload{path, license_key, (bool)e});
+        reloaded.notify_all();
+      });
+  }
+
+  // Waits until the file has been loaded again n times in total
+  bool
+  wait_for_reloads(size_t n)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    return reloaded.wait_for(lock, std::chrono::seconds(10), [this, n]() { return reloads.size() >= n; });
+  }
+
+  Reload
+  last_reload()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return reloads.back();
+  }
+
+  void
+  clean()
+  {
+    std::remove(path.c_str());
+    std::remove((path + ".new").c_str());
+    rmdir(directory.c_str());
+  }
+
+  std::string directory;
+  std::string path;
+  cryptolens::Error e;
+  Cryptolens cryptolens_handle;
+
+  std::mutex mutex;
+  std::condition_variable reloaded;
+  std::vector<Reload> reloads;
+};
+
+TEST_F(LicenseKeyWatcherTest, LoadLicenseKeyFile)
+{
+  write(path, saved("AAAAA-AAAAA-AAAAA-AAAAA") + "\n");
+
+  auto license_key = cryptolens_handle.load_license_key_file(e, path);
+  ASSERT_FALSE(e);
+  ASSERT_TRUE(license_key);
+  EXPECT_EQ("AAAAA-AAAAA-AAAAA-AAAAA", *license_key->get_key());
+
+  license_key = cryptolens_handle.load_license_key_file(e, path + ".missing");
+  EXPECT_FALSE(license_key);
+  EXPECT_EQ(cryptolens::errors::Subsystem::File, e.get_subsystem(cryptolens::api::main()));
+  EXPECT_EQ(cryptolens::errors::File::OPEN, e.get_reason(cryptolens::api::main()));
+}
+
+TEST_F(LicenseKeyWatcherTest, LoadsFileWhenAdded)
+{
+  write(path, saved("AAAAA-AAAAA-AAAAA-AAAAA"));
+
+  cryptolens::LicenseKeyWatcher_inotify<Cryptolens> watcher(e, cryptolens_handle);
+  watcher.add(e, path);
+  ASSERT_FALSE(e);
+
+  ASSERT_TRUE(watcher.get(path));
+  EXPECT_EQ("AAAAA-AAAAA-AAAAA-AAAAA", *watcher.get(path)->get_key());
+  EXPECT_FALSE(watcher.get(path + ".other"));
+}
+
+TEST_F(LicenseKeyWatcherTest, ReloadsFileWrittenInPlace)
+{
+  write(path, saved("AAAAA-AAAAA-AAAAA-AAAAA"));
+
+  cryptolens::LicenseKeyWatcher_inotify<Cryptolens> watcher(e, cryptolens_handle);
+  record_reloads(watcher);
+  watcher.add(e, path);
+  ASSERT_FALSE(e);
+
+  write(path, saved("BBBBB-BBBBB-BBBBB-BBBBB"));
+  ASSERT_TRUE(wait_for_reloads(1));
+
+  Reload reload = last_reload();
+  EXPECT_EQ(path, reload.path);
+  EXPECT_FALSE(reload.error);
+  ASSERT_TRUE(reload.license_key);
+  EXPECT_EQ("BBBBB-BBBBB-BBBBB-BBBBB", *reload.license_key->get_key());
+  EXPECT_EQ("BBBBB-BBBBB-BBBBB-BBBBB", *watcher.get(path)->get_key());
+}
+
+TEST_F(LicenseKeyWatcherTest, ReloadsFileReplacedByRename)
+{
+  write(path, saved("AAAAA-AAAAA-AAAAA-AAAAA"));
+
+  cryptolens::LicenseKeyWatcher_inotify<Cryptolens> watcher(e, cryptolens_handle);
+  record_reloads(watcher);
+  watcher.add(e, path);
+  ASSERT_FALSE(e);
+
+  replace(saved("BBBBB-BBBBB-BBBBB-BBBBB"));
+  ASSERT_TRUE(wait_for_reloads(1));
+
+  EXPECT_EQ("BBBBB-BBBBB-BBBBB-BBBBB", *watcher.get(path)->get_key());
+}
+
+TEST_F(LicenseKeyWatcherTest, InvalidChangeKeepsPreviousLicenseKey)
+{
+  write(path, saved("AAAAA-AAAAA-AAAAA-AAAAA"));
+
+  cryptolens::LicenseKeyWatcher_inotify<Cryptolens> watcher(e, cryptolens_handle);
+  record_reloads(watcher);
+  watcher.add(e, path);
+  ASSERT_FALSE(e);
+
+  replace("not a license key");
+  ASSERT_TRUE(wait_for_reloads(1));
+
+  Reload reload = last_reload();
+  EXPECT_TRUE(reload.error);
+  ASSERT_TRUE(reload.license_key);
+  EXPECT_EQ("AAAAA-AAAAA-AAAAA-AAAAA", *reload.license_key->get_key());
+  EXPECT_EQ("AAAAA-AAAAA-AAAAA-AAAAA", *watcher.get(path)->get_key());
+}
+
+TEST_F(LicenseKeyWatcherTest, InvalidFileIsWatchedUntilValid)
+{
+  std::string valid = saved("AAAAA-AAAAA-AAAAA-AAAAA");
+  write(path, "not a license key");
+
+  cryptolens::LicenseKeyWatcher_inotify<Cryptolens> watcher(e, cryptolens_handle);
+  record_reloads(watcher);
+  watcher.add(e, path);
+  EXPECT_TRUE(e);
+  EXPECT_FALSE(watcher.get(path));
+
+  replace(valid);
+  ASSERT_TRUE(wait_for_reloads(1));
+
+  ASSERT_TRUE(watcher.get(path));
+  EXPECT_EQ("AAAAA-AAAAA-AAAAA-AAAAA", *watcher.get(path)->get_key());
+}
+
+} // namespace
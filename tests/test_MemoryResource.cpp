@@ -0,0 +1,154 @@
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/Error.hpp>
+#include <cryptolens/LicenseKeyInformation.hpp>
+#include <cryptolens/MemoryResource.hpp>
+
+#include <Licenses.hpp>
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+namespace testkit = ::cryptolens_io::testkit;
+
+namespace {
+
+// Forwards to new_delete_resource(), counting the calls
+class MemoryResource_counting : public cryptolens::MemoryResource {
+public:
+  MemoryResource_counting() : allocations(0), outstanding(0) {}
+
+  void * allocate(size_t bytes, size_t alignment) override
+  {
+    ++allocations;
+    ++outstanding;
+    return cryptolens::new_delete_resource().allocate(bytes, alignment);
+  }
+
+  void deallocate(void * p, size_t bytes, size_t alignment) override
+  {
+    --outstanding;
+    cryptolens::new_delete_resource().deallocate(p, bytes, alignment);
+  }
+
+  int allocations;
+  int outstanding;
+};
+
+bool
+is_aligned(void * p, size_t alignment)
+{
+  return reinterpret_cast<std::uintptr_t>(p) % alignment == 0;
+}
+
+} // namespace
+
+TEST(new_delete_resource, Alignment)
+{
+  cryptolens::MemoryResource & resource = cryptolens::new_delete_resource();
+
+  for (size_t alignment : { 1, 2, 8, 16, 64, 256, 4096 }) {
+    std::vector<void *> p;
+    for (size_t bytes : { 1, 7, 100, 5000 }) {
+      p.push_back(resource.allocate(bytes, alignment));
+      EXPECT_TRUE(is_aligned(p.back(), alignment)) << bytes << " " << alignment;
+      std::memset(p.back(), 0xAB, bytes);
+    }
+
+    size_t i = 0;
+    for (size_t bytes : { 1, 7, 100, 5000 }) { resource.deallocate(p[i++], bytes, alignment); }
+  }
+}
+
+TEST(MonotonicBufferResource, Alignment)
+{
+  cryptolens::MonotonicBufferResource arena(64);
+
+  char * previous = nullptr;
+  for (size_t alignment : { 1, 2, 8, 16, 64, 256, 1, 4096, 2 }) {
+    char * p = static_cast<char *>(arena.allocate(3, alignment));
+    EXPECT_TRUE(is_aligned(p, alignment)) << alignment;
+
+    // Allocations from the same block do not overlap
+    if (previous && p > previous) { EXPECT_GE(p, previous + 3); }
+    std::memset(p, 0xAB, 3);
+    previous = p;
+  }
+}
+
+TEST(MonotonicBufferResource, ReusesBlocksAfterRelease)
+{
+  MemoryResource_counting upstream;
+  {
+    cryptolens::MonotonicBufferResource arena(128, &upstream);
+
+    for (int i = 0; i < 100; ++i) { arena.allocate(50); }
+    int allocations = upstream.allocations;
+    EXPECT_GT(allocations, 1);
+
+    // The same allocations fit in the blocks already allocated
+    arena.release();
+    for (int i = 0; i < 100; ++i) { arena.allocate(50); }
+    EXPECT_EQ(allocations, upstream.allocations);
+
+    // Allocations larger than any block get a block of their own
+    void * p = arena.allocate(100000, 64);
+    EXPECT_TRUE(is_aligned(p, 64));
+    std::memset(p, 0xAB, 100000);
+    EXPECT_EQ(allocations + 1, upstream.allocations);
+  }
+
+  // All blocks are returned when the resource is destroyed
+  EXPECT_EQ(0, upstream.outstanding);
+}
+
+TEST(PolymorphicAllocator, Containers)
+{
+  MemoryResource_counting upstream;
+  {
+    cryptolens::MonotonicBufferResource arena(4096, &upstream);
+    cryptolens::PolymorphicAllocator<char> allocator(&arena);
+
+    std::vector<std::uint64_t, cryptolens::PolymorphicAllocator<std::uint64_t>> v(allocator);
+    for (std::uint64_t i = 0; i < 1000; ++i) { v.push_back(i); }
+    for (std::uint64_t i = 0; i < 1000; ++i) { EXPECT_EQ(i, v[i]); }
+
+    std::basic_string<char, std::char_traits<char>, cryptolens::PolymorphicAllocator<char>> s(allocator);
+    for (int i = 0; i < 1000; ++i) { s += 'x'; }
+    EXPECT_EQ(1000u, s.size());
+
+    EXPECT_GT(upstream.allocations, 0);
+    EXPECT_TRUE(v.get_allocator() == allocator);
+    EXPECT_TRUE(cryptolens::PolymorphicAllocator<char>() != allocator);
+  }
+
+  EXPECT_EQ(0, upstream.outstanding);
+}
+
+TEST(PolymorphicAllocator, ActivatedMachinesList)
+{
+  MemoryResource_counting resource;
+  {
+    cryptolens::Error e;
+    auto info = cryptolens::pmr::LicenseKeyInformation::make_unsafe(e, testkit::make_license(testkit::LicenseSpec()), &resource);
+    ASSERT_FALSE(e);
+    ASSERT_TRUE(info);
+
+    // The list of activated machines is built when first requested, and
+    // with no machines the only allocation is the list itself
+    int allocations = resource.allocations;
+    auto const& list = info->get_activated_machines();
+    ASSERT_TRUE(list);
+    EXPECT_TRUE(list->empty());
+    EXPECT_EQ(&resource, list->get_allocator().resource());
+    EXPECT_EQ(allocations + 1, resource.allocations);
+
+    EXPECT_EQ(&list, &info->get_activated_machines());
+    EXPECT_EQ(allocations + 1, resource.allocations);
+  }
+
+  EXPECT_EQ(0, resource.outstanding);
+}
@@ -0,0 +1,154 @@
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/Error.hpp>
+#include <cryptolens/MessageSubscription.hpp>
+
+#include "Configuration_fake.hpp"
+
+namespace {
+
+struct Posted {
+  int id;
+  std::int64_t created;
+};
+
+/*
+ * Answers GetMessages requests with the messages in posted created at or
+ * after the requested time, in the order they appear in posted, recording
+ * the requested times.
+ */
+class MessageSubscriptionTest : public ::testing::Test {
+protected:
+  MessageSubscriptionTest() : subscription(e, "token"), delay(0), fail(false)
+  {
+    subscription.get_cryptolens_handle().request_handler.respond =
+      [this](cryptolens::basic_Error & e, std::string const& endpoint, RequestHandler_fake::Arguments const& arguments) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fail) { return RequestHandler_fake::fail(e, endpoint, arguments); }
+
+        EXPECT_EQ("/api/message/GetMessages", endpoint);
+        EXPECT_EQ("token", arguments.at("token"));
+        EXPECT_EQ("stable", arguments.at("Channel"));
+        std::int64_t since = std::stoll(arguments.at("Time"));
+        times.push_back(since);
+
+        std::string response = "{\"messages\":[";
+        bool first = true;
+        for (Posted const& m : posted) {
+          if (m.created < since) { continue; }
+          if (!first) { response += ','; }
+          first = false;
+          response += "{\"id\":" + std::to_string(m.id) + ",\"content\":\"message " + std::to_string(m.id) + "\""
+                      ",\"created\":" + std::to_string(m.created) + ",\"channel\":\"stable\"}";
+        }
+        response += "],\"result\":0}";
+        return response;
+      };
+  }
+
+  std::vector<int> ids(std::vector<cryptolens::Message> const& messages)
+  {
+    std::vector<int> ids;
+    for (cryptolens::Message const& m : messages) { ids.push_back(m.get_id()); }
+    return ids;
+  }
+
+  cryptolens::Error e;
+  cryptolens::MessageSubscription<Configuration_fake> subscription;
+
+  std::mutex mutex;
+  std::vector<Posted> posted;
+  std::vector<std::int64_t> times;
+  int delay;
+  bool fail;
+};
+
+} // namespace
+
+TEST_F(MessageSubscriptionTest, Cursor)
+{
+  posted = { { 3, 105 }, { 1, 100 }, { 2, 105 } };
+
+  EXPECT_EQ((std::vector<int>{ 1, 2, 3 }), ids(subscription.poll(e, "stable")));
+  ASSERT_FALSE(e);
+
+  // The second of the latest message is requested again, since more
+  // messages may be posted during it
+  posted.push_back({ 4, 105 });
+  posted.push_back({ 5, 107 });
+  EXPECT_EQ((std::vector<int>{ 4, 5 }), ids(subscription.poll(e, "stable")));
+  EXPECT_EQ((std::vector<int>{}), ids(subscription.poll(e, "stable")));
+  ASSERT_FALSE(e);
+
+  EXPECT_EQ((std::vector<std::int64_t>{ 0, 104, 106 }), times);
+  EXPECT_EQ((std::vector<int>{ 1, 2, 3, 4, 5 }), ids(subscription.get_messages("stable")));
+  EXPECT_EQ(0u, subscription.get_messages("beta").size());
+
+  cryptolens::Message m = subscription.get_messages("stable")[0];
+  EXPECT_EQ("message 1", m.get_content());
+  EXPECT_EQ(100, m.get_created());
+  EXPECT_EQ("stable", m.get_channel());
+}
+
+TEST_F(MessageSubscriptionTest, StartTime)
+{
+  posted = { { 1, 100 }, { 2, 200 } };
+
+  subscription.set_start_time(e, "stable", 150);
+  EXPECT_EQ((std::vector<int>{ 2 }), ids(subscription.poll(e, "stable")));
+
+  // No effect once polled
+  subscription.set_start_time(e, "stable", 0);
+  subscription.poll(e, "stable");
+  ASSERT_FALSE(e);
+
+  EXPECT_EQ((std::vector<std::int64_t>{ 150, 199 }), times);
+}
+
+TEST_F(MessageSubscriptionTest, FailedPoll)
+{
+  posted = { { 1, 100 } };
+
+  fail = true;
+  EXPECT_EQ(0u, subscription.poll(e, "stable").size());
+  EXPECT_EQ(cryptolens::errors::Subsystem::RequestHandler, e.get_subsystem(cryptolens::api::main()));
+  e.reset(cryptolens::api::main());
+
+  fail = false;
+  EXPECT_EQ((std::vector<int>{ 1 }), ids(subscription.poll(e, "stable")));
+  ASSERT_FALSE(e);
+  EXPECT_EQ((std::vector<std::int64_t>{ 0 }), times);
+}
+
+TEST_F(MessageSubscriptionTest, ConcurrentPollsShareRequest)
+{
+  posted = { { 1, 100 }, { 2, 101 } };
+  delay = 500;
+
+  int constexpr THREADS = 8;
+  std::atomic<bool> go(false);
+  std::vector<std::vector<int>> results(THREADS);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < THREADS; ++i) {
+    threads.emplace_back([this, &go, &results, i]() {
+      while (!go.load()) { std::this_thread::yield(); }
+      cryptolens::Error e;
+      results[i] = ids(subscription.poll(e, "stable"));
+      EXPECT_FALSE(e);
+    });
+  }
+  go.store(true);
+  for (auto & t : threads) { t.join(); }
+
+  EXPECT_EQ(1u, times.size());
+  for (int i = 0; i < THREADS; ++i) { EXPECT_EQ((std::vector<int>{ 1, 2 }), results[i]); }
+}
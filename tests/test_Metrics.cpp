@@ -0,0 +1,148 @@
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+#include <cryptolens/Instrumentation_metrics.hpp>
+#include <cryptolens/Metrics.hpp>
+
+#include "Configuration_fake.hpp"
+
+namespace {
+
+namespace Stage = cryptolens::instrumentation::Stage;
+
+/*
+ * The Metrics object is shared by the whole process, thus the tests compare
+ * the counters before and after, rather than expecting particular values.
+ */
+std::uint64_t
+prometheus_value(std::string const& name)
+{
+  std::string text = "\n" + cryptolens::Metrics::get().format_prometheus();
+  std::string::size_type i = text.find("\n" + name + " ");
+  if (i == std::string::npos) { return 0; }
+  return std::strtoull(text.c_str() + i + name.size() + 2, NULL, 10);
+}
+
+// Returns a field of the histogram of a stage in the JSON document
+std::uint64_t
+stage_field(std::string const& stage, std::string const& field)
+{
+  std::string json = cryptolens::Metrics::get().format_json();
+  std::string::size_type i = json.find("\"" + stage + "\":{");
+  if (i == std::string::npos) { return 0; }
+  std::string::size_type j = json.find("\"" + field + "\":", i);
+  if (j == std::string::npos || j > json.find('}', i)) { return 0; }
+  return std::strtoull(json.c_str() + j + field.size() + 3, NULL, 10);
+}
+
+TEST(Metrics, ActivationsAndFailures)
+{
+  cryptolens::api::main api;
+  char const* blocked = "cryptolens_activation_failures_total{subsystem=\"Main\",reason=\"7\"}";
+  char const* other = "cryptolens_activation_failures_total{subsystem=\"Json\",reason=\"other\"}";
+
+  std::uint64_t activations = prometheus_value("cryptolens_activations_total");
+  std::uint64_t blocked_before = prometheus_value(blocked);
+  std::uint64_t other_before = prometheus_value(other);
+
+  cryptolens::Error e;
+  cryptolens::Metrics::get().record_activation(e);
+  e.set(api, cryptolens::errors::Subsystem::Main, cryptolens::errors::Main::KEY_BLOCKED);
+  cryptolens::Metrics::get().record_activation(e);
+  // Reasons too large to have a counter of their own are counted together
+  e.reset();
+  e.set(api, cryptolens::errors::Subsystem::Json, 1000);
+  cryptolens::Metrics::get().record_activation(e);
+
+  EXPECT_EQ(activations + 3, prometheus_value("cryptolens_activations_total"));
+  EXPECT_EQ(blocked_before + 1, prometheus_value(blocked));
+  EXPECT_EQ(other_before + 1, prometheus_value(other));
+}
+
+TEST(Metrics, CountsOfAllThreadsAreCombined)
+{
+  std::uint64_t cache_hits = prometheus_value("cryptolens_cache_hits_total");
+
+  // The counts of threads which have exited are kept
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([]() {
+      for (int j = 0; j < 1000; ++j) { cryptolens::Metrics::get().record_cache_hit(); }
+    });
+  }
+  for (auto & thread : threads) { thread.join(); }
+
+  EXPECT_EQ(cache_hits + 4000, prometheus_value("cryptolens_cache_hits_total"));
+}
+
+TEST(Metrics, RequestWithoutTimings)
+{
+  std::uint64_t requests = prometheus_value("cryptolens_requests_total");
+  std::uint64_t bytes_sent = prometheus_value("cryptolens_bytes_sent_total");
+  std::uint64_t bytes_received = prometheus_value("cryptolens_bytes_received_total");
+  std::uint64_t total = stage_field("total", "count");
+
+  cryptolens::Metrics::get().record_request(cryptolens::RequestStatistics{0, 0, 0, 0, 0, 0, 100, 2000});
+
+  EXPECT_EQ(requests + 1, prometheus_value("cryptolens_requests_total"));
+  EXPECT_EQ(bytes_sent + 100, prometheus_value("cryptolens_bytes_sent_total"));
+  EXPECT_EQ(bytes_received + 2000, prometheus_value("cryptolens_bytes_received_total"));
+  // A total time of zero means that the phases were not measured
+  EXPECT_EQ(total, stage_field("total", "count"));
+}
+
+TEST(Metrics, StageQuantiles)
+{
+  // No other test records the base64_decode stage
+  for (std::uint64_t i = 1; i <= 1000; ++i) { cryptolens::Metrics::get().record_stage(Stage::BASE64_DECODE, i * 1000); }
+
+  EXPECT_EQ(1000u, stage_field("base64_decode", "count"));
+  EXPECT_EQ(500500000u, stage_field("base64_decode", "sum_ns"));
+  EXPECT_EQ(1000000u, stage_field("base64_decode", "max_ns"));
+
+  // The histogram has a relative error of at most 1/16
+  std::uint64_t p50 = stage_field("base64_decode", "p50_ns");
+  EXPECT_GE(p50, 500000u);
+  EXPECT_LE(p50, 500000u + 500000u / 16);
+  std::uint64_t p99 = stage_field("base64_decode", "p99_ns");
+  EXPECT_GE(p99, 990000u);
+  EXPECT_LE(p99, 1000000u);
+
+  // Stages out of range are ignored
+  cryptolens::Metrics::get().record_stage(Stage::COUNT, 1);
+  cryptolens::Metrics::get().record_stage(-1, 1);
+}
+
+struct Configuration_metrics : Configuration_fake {
+  using Instrumentation = cryptolens::Instrumentation_metrics;
+};
+
+TEST(Instrumentation_metrics, FailedActivation)
+{
+  char const* failures = "cryptolens_activation_failures_total{subsystem=\"RequestHandler\",reason=\"1\"}";
+  std::uint64_t activations = prometheus_value("cryptolens_activations_total");
+  std::uint64_t failures_before = prometheus_value(failures);
+  std::uint64_t activate_stage = stage_field("activate", "count");
+  std::uint64_t request_stage = stage_field("request", "count");
+
+  // RequestHandler_fake fails each request by default
+  cryptolens::Error e;
+  cryptolens::basic_Cryptolens<Configuration_metrics> cryptolens_handle(e);
+  auto license_key = cryptolens_handle.activate(e, "token", 3646, "key");
+  EXPECT_TRUE(e);
+  EXPECT_FALSE(license_key);
+
+  EXPECT_EQ(activations + 1, prometheus_value("cryptolens_activations_total"));
+  EXPECT_EQ(failures_before + 1, prometheus_value(failures));
+  EXPECT_EQ(activate_stage + 1, stage_field("activate", "count"));
+  EXPECT_EQ(request_stage + 1, stage_field("request", "count"));
+}
+
+} // namespace
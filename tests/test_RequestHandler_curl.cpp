@@ -0,0 +1,280 @@
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/Error.hpp>
+#include <cryptolens/RequestHandler_curl.hpp>
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+
+namespace {
+
+/*
+ * Starts the mock server from tools on a free port for each test. The
+ * MockId, MockDelay and MockUnavailable arguments control how the server
+ * answers a request, and /mock/requests tells how many copies of a request
+ * the server received.
+ */
+class RequestHandlerCurlTest : public ::testing::Test {
+protected:
+  RequestHandlerCurlTest()
+  : pid(-1)
+  {
+    int fds[2];
+    if (pipe(fds) != 0) { return; }
+
+    pid = fork();
+    if (pid == 0) {
+      dup2(fds[1], STDOUT_FILENO);
+      close(fds[0]);
+      close(fds[1]);
+      execl(CRYPTOLENS_MOCK_SERVER, CRYPTOLENS_MOCK_SERVER, "--port", "0", (char *)NULL);
+      _exit(127);
+    }
+    close(fds[1]);
+
+    FILE * out = fdopen(fds[0], "r");
+    if (!out) { close(fds[0]); return; }
+
+    int port = 0;
+    if (std::fscanf(out, "Listening on http://127.0.0.1:%d", &port) == 1) {
+      host = "http://127.0.0.1:" + std::to_string(port);
+    }
+    std::fclose(out);
+  }
+
+  ~RequestHandlerCurlTest()
+  {
+    if (pid > 0) {
+      kill(pid, SIGTERM);
+      waitpid(pid, NULL, 0);
+    }
+  }
+
+  void SetUp() override
+  {
+    ASSERT_FALSE(host.empty()) << "could not start " << CRYPTOLENS_MOCK_SERVER;
+  }
+
+  std::string
+  post(cryptolens::RequestHandler_curl & handler, cryptolens::basic_Error & e, char const* endpoint, char const* id, int delay = 0, int unavailable = 0)
+  {
+    std::string d = std::to_string(delay);
+    std::string u = std::to_string(unavailable);
+    return handler.post_request(e, host.c_str(), endpoint)
+                  .add_argument(e, "MockId", id)
+                  .add_argument(e, "MockDelay", d.c_str())
+                  .add_argument(e, "MockUnavailable", u.c_str())
+                  .make(e);
+  }
+
+  unsigned long
+  requests(char const* id)
+  {
+    cryptolens::Error e;
+    cryptolens::RequestHandler_curl handler(e);
+    std::string count = handler.post_request(e, host.c_str(), "/mock/requests").add_argument(e, "MockId", id).make(e);
+    EXPECT_FALSE(e);
+    return std::strtoul(count.c_str(), NULL, 10);
+  }
+
+  /*
+   * Makes enough fast requests for the handler to start hedging, after which
+   * requests are hedged after hedge_min_delay.
+   */
+  void
+  warm_up(cryptolens::RequestHandler_curl & handler)
+  {
+    cryptolens::Error e;
+    for (int i = 0; i < 25; ++i) { post(handler, e, "/api/key/Deactivate", "warm-up"); }
+    ASSERT_FALSE(e);
+  }
+
+  static cryptolens::RequestPolicy
+  hedging_policy()
+  {
+    return cryptolens::RequestPolicy{2000, 5000, 10000, 0, 10, 100, 50, 20};
+  }
+
+  static cryptolens::RequestPolicy
+  retry_policy()
+  {
+    return cryptolens::RequestPolicy{2000, 5000, 10000, 2, 10, 100, 0, 0};
+  }
+
+  static unsigned
+  retries(cryptolens::basic_Error & e)
+  {
+    cryptolens::api::main api;
+    return cryptolens::errors::RequestHandler_curl::perform_error_retries(e.get_extra(api));
+  }
+
+  pid_t pid;
+  std::string host;
+};
+
+TEST_F(RequestHandlerCurlTest, IdempotentRequestIsHedged)
+{
+  cryptolens::Error e;
+  cryptolens::RequestHandler_curl handler(e);
+  handler.set_request_policy(e, hedging_policy());
+  warm_up(handler);
+
+  std::string response = post(handler, e, "/api/key/Deactivate", "deactivate", 300);
+
+  ASSERT_FALSE(e);
+  EXPECT_EQ("{\"result\":0,\"message\":\"\"}", response);
+  EXPECT_EQ(2u, requests("deactivate"));
+}
+
+TEST_F(RequestHandlerCurlTest, NonIdempotentRequestIsNotHedged)
+{
+  cryptolens::Error e;
+  cryptolens::RequestHandler_curl handler(e);
+  handler.set_request_policy(e, hedging_policy());
+  warm_up(handler);
+
+  post(handler, e, "/api/Key/CreateTrialKey", "trial", 300);
+  post(handler, e, "/api/data/IncrementIntValueToKey", "increment", 300);
+  post(handler, e, "/api/data/DecrementIntValueToKey", "decrement", 300);
+
+  ASSERT_FALSE(e);
+  EXPECT_EQ(1u, requests("trial"));
+  EXPECT_EQ(1u, requests("increment"));
+  EXPECT_EQ(1u, requests("decrement"));
+}
+
+TEST_F(RequestHandlerCurlTest, IdempotentRequestIsRetriedOnUnavailable)
+{
+  cryptolens::Error e;
+  cryptolens::RequestHandler_curl handler(e);
+  handler.set_request_policy(e, retry_policy());
+
+  std::string response = post(handler, e, "/api/key/Deactivate", "deactivate", 0, 2);
+
+  ASSERT_FALSE(e);
+  EXPECT_EQ("{\"result\":0,\"message\":\"\"}", response);
+  EXPECT_EQ(3u, requests("deactivate"));
+}
+
+TEST_F(RequestHandlerCurlTest, NonIdempotentRequestIsNotRetriedOnUnavailable)
+{
+  cryptolens::Error e;
+  cryptolens::RequestHandler_curl handler(e);
+  handler.set_request_policy(e, retry_policy());
+
+  // The 503 response is passed on to the caller
+  std::string response = post(handler, e, "/api/data/IncrementIntValueToKey", "increment", 0, 1);
+
+  ASSERT_FALSE(e);
+  EXPECT_EQ("Service Unavailable", response);
+  EXPECT_EQ(1u, requests("increment"));
+}
+
+TEST_F(RequestHandlerCurlTest, RetriesStopAtMaxRetries)
+{
+  cryptolens::Error e;
+  cryptolens::RequestHandler_curl handler(e);
+  handler.set_request_policy(e, retry_policy());
+
+  std::string response = post(handler, e, "/api/key/Activate", "activate", 0, 10);
+
+  ASSERT_FALSE(e);
+  EXPECT_EQ("Service Unavailable", response);
+  EXPECT_EQ(3u, requests("activate"));
+}
+
+TEST_F(RequestHandlerCurlTest, NonIdempotentRequestIsNotRetriedAfterTimeout)
+{
+  cryptolens::Error e;
+  cryptolens::RequestHandler_curl handler(e);
+  handler.set_request_policy(e, cryptolens::RequestPolicy{2000, 100, 10000, 2, 10, 100, 0, 0});
+
+  post(handler, e, "/api/Key/CreateTrialKey", "trial", 300);
+
+  cryptolens::api::main api;
+  ASSERT_TRUE(e);
+  EXPECT_EQ(cryptolens::errors::Subsystem::RequestHandler, e.get_subsystem(api));
+  EXPECT_EQ(cryptolens::errors::RequestHandler_curl::PERFORM, e.get_reason(api));
+  EXPECT_EQ(0u, retries(e));
+  EXPECT_EQ(1u, requests("trial"));
+}
+
+TEST_F(RequestHandlerCurlTest, IdempotentRequestIsRetriedAfterTimeout)
+{
+  cryptolens::Error e;
+  cryptolens::RequestHandler_curl handler(e);
+  handler.set_request_policy(e, cryptolens::RequestPolicy{2000, 100, 10000, 2, 10, 100, 0, 0});
+
+  post(handler, e, "/api/key/Deactivate", "deactivate", 300);
+
+  cryptolens::api::main api;
+  ASSERT_TRUE(e);
+  EXPECT_EQ(cryptolens::errors::RequestHandler_curl::PERFORM, e.get_reason(api));
+  EXPECT_EQ(2u, retries(e));
+  EXPECT_EQ(3u, requests("deactivate"));
+}
+
+TEST_F(RequestHandlerCurlTest, DeadlineLimitsRetries)
+{
+  cryptolens::Error e;
+  cryptolens::RequestHandler_curl handler(e);
+  handler.set_request_policy(e, cryptolens::RequestPolicy{2000, 100, 300, 10, 10, 20, 0, 0});
+
+  post(handler, e, "/api/key/Deactivate", "deactivate", 500);
+
+  // About three attempts fit within the deadline
+  cryptolens::api::main api;
+  ASSERT_TRUE(e);
+  EXPECT_EQ(cryptolens::errors::RequestHandler_curl::DEADLINE_EXCEEDED, e.get_reason(api));
+  EXPECT_LT(retries(e), 6u);
+}
+
+TEST_F(RequestHandlerCurlTest, RequestIsRetriedIfNeverSent)
+{
+  cryptolens::Error e;
+  cryptolens::RequestHandler_curl handler(e);
+  handler.set_request_policy(e, retry_policy());
+
+  // Nothing listens on the port of the mock server once it has exited
+  kill(pid, SIGTERM);
+  waitpid(pid, NULL, 0);
+  pid = -1;
+
+  post(handler, e, "/api/Key/CreateTrialKey", "trial");
+
+  cryptolens::api::main api;
+  ASSERT_TRUE(e);
+  EXPECT_EQ(cryptolens::errors::RequestHandler_curl::PERFORM, e.get_reason(api));
+  EXPECT_EQ(2u, retries(e));
+}
+
+TEST(RequestHandler_curl, ConcurrentSavesOfTlsSessions)
+{
+  std::string path = std::string("cryptolens-test-tls-sessions-") + ::testing::UnitTest::GetInstance()->current_test_info()->name();
+
+  // Each save writes its own temporary file before replacing the session
+  // file, so concurrent saves do not fail
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&path]() {
+      cryptolens::Error e;
+      cryptolens::RequestHandler_curl handler(e);
+      handler.set_tls_session_file(e, path);
+      for (int j = 0; j < 50; ++j) { handler.save_tls_sessions(e); }
+      EXPECT_FALSE(e);
+    });
+  }
+  for (auto & thread : threads) { thread.join(); }
+
+  std::remove(path.c_str());
+}
+
+} // namespace
@@ -0,0 +1,257 @@
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/Error.hpp>
+#include <cryptolens/TrialKeyCache.hpp>
+
+#include "Configuration_fake.hpp"
+
+namespace {
+
+/*
+ * Answers CreateTrialKey requests with a key derived from the product id and
+ * machine code, counting the requests.
+ */
+class TrialKeyCacheTest : public ::testing::Test {
+protected:
+  TrialKeyCacheTest()
+  // ctest may run the tests in parallel, thus each uses its own file
+  : path(::testing::TempDir() + "cryptolens_test_trial_keys_" + ::testing::UnitTest::GetInstance()->current_test_info()->name())
+  , requests(0), delay(0), fail(false)
+  {
+    std::remove(path.c_str());
+  }
+
+  ~TrialKeyCacheTest() { std::remove(path.c_str()); }
+
+  void connect(cryptolens::TrialKeyCache<Configuration_fake> & cache, std::string const& machine_code)
+  {
+    cryptolens::Error e;
+    cache.get_cryptolens_handle().machine_code_computer.set_machine_code(e, machine_code);
+    cache.get_cryptolens_handle().request_handler.respond =
+      [this](cryptolens::basic_Error & e, std::string const& endpoint, RequestHandler_fake::Arguments const& arguments) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+
+        requests.fetch_add(1);
+        if (fail) { return RequestHandler_fake::fail(e, endpoint, arguments); }
+
+        EXPECT_EQ("/api/Key/CreateTrialKey", endpoint);
+        EXPECT_EQ("token", arguments.at("token"));
+        return "{\"key\":\"" + key_for(arguments.at("ProductId"), arguments.at("MachineCode")) + "\",\"result\":0,\"message\":\"\"}";
+      };
+  }
+
+  static std::string key_for(std::string const& product_id, std::string const& machine_code)
+  {
+    return "TRIAL-" + product_id + "-" + machine_code;
+  }
+
+  std::string path;
+  std::atomic<int> requests;
+  int delay;
+  bool fail;
+};
+
+} // namespace
+
+TEST_F(TrialKeyCacheTest, Caches)
+{
+  cryptolens::Error e;
+  cryptolens::TrialKeyCache<Configuration_fake> cache(e, "token");
+  connect(cache, "machine-1");
+
+  EXPECT_EQ(key_for("3646", "machine-1"), cache.create_trial_key(e, 3646));
+  EXPECT_EQ(key_for("3646", "machine-1"), cache.create_trial_key(e, 3646));
+  EXPECT_EQ(key_for("3647", "machine-1"), cache.create_trial_key(e, 3647));
+  ASSERT_FALSE(e);
+  EXPECT_EQ(2, requests.load());
+
+  cache.clear(e);
+  EXPECT_EQ(key_for("3646", "machine-1"), cache.create_trial_key(e, 3646));
+  ASSERT_FALSE(e);
+  EXPECT_EQ(3, requests.load());
+}
+
+TEST_F(TrialKeyCacheTest, FailuresAreNotCached)
+{
+  cryptolens::Error e;
+  cryptolens::TrialKeyCache<Configuration_fake> cache(e, "token");
+  connect(cache, "machine-1");
+
+  fail = true;
+  EXPECT_EQ("", cache.create_trial_key(e, 3646));
+  EXPECT_EQ(cryptolens::errors::Subsystem::RequestHandler, e.get_subsystem(cryptolens::api::main()));
+  e.reset(cryptolens::api::main());
+
+  fail = false;
+  EXPECT_EQ(key_for("3646", "machine-1"), cache.create_trial_key(e, 3646));
+  ASSERT_FALSE(e);
+  EXPECT_EQ(2, requests.load());
+}
+
+TEST_F(TrialKeyCacheTest, ConcurrentCallsShareRequest)
+{
+  cryptolens::Error e;
+  cryptolens::TrialKeyCache<Configuration_fake> cache(e, "token");
+  connect(cache, "machine-1");
+  delay = 500;
+
+  int constexpr THREADS = 8;
+  std::atomic<bool> go(false);
+  std::vector<std::string> keys(THREADS);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < THREADS; ++i) {
+    threads.emplace_back([&cache, &go, &keys, i]() {
+      while (!go.load()) { std::this_thread::yield(); }
+      cryptolens::Error e;
+      keys[i] = cache.create_trial_key(e, 3646);
+      EXPECT_FALSE(e);
+    });
+  }
+  go.store(true);
+  for (auto & t : threads) { t.join(); }
+
+  EXPECT_EQ(1, requests.load());
+  for (int i = 0; i < THREADS; ++i) { EXPECT_EQ(key_for("3646", "machine-1"), keys[i]); }
+}
+
+TEST_F(TrialKeyCacheTest, ConcurrentFailuresAreShared)
+{
+  cryptolens::Error e;
+  cryptolens::TrialKeyCache<Configuration_fake> cache(e, "token");
+  connect(cache, "machine-1");
+  delay = 500;
+  fail = true;
+
+  int constexpr THREADS = 8;
+  std::atomic<bool> go(false);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < THREADS; ++i) {
+    threads.emplace_back([&cache, &go]() {
+      while (!go.load()) { std::this_thread::yield(); }
+      cryptolens::Error e;
+      EXPECT_EQ("", cache.create_trial_key(e, 3646));
+      EXPECT_EQ(cryptolens::errors::Subsystem::RequestHandler, e.get_subsystem(cryptolens::api::main()));
+    });
+  }
+  go.store(true);
+  for (auto & t : threads) { t.join(); }
+
+  EXPECT_EQ(1, requests.load());
+}
+
+TEST_F(TrialKeyCacheTest, ServerMessageIsShared)
+{
+  cryptolens::Error e;
+  cryptolens::TrialKeyCache<Configuration_fake> cache(e, "token");
+  connect(cache, "machine-1");
+  cache.get_cryptolens_handle().request_handler.respond =
+    [this](cryptolens::basic_Error &, std::string const&, RequestHandler_fake::Arguments const&) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+      requests.fetch_add(1);
+      return std::string("{\"result\":1,\"message\":\"Something went wrong.\"}");
+    };
+
+  // Both the caller making the request and those waiting for it see the
+  // message sent by the server
+  int constexpr THREADS = 4;
+  std::atomic<bool> go(false);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < THREADS; ++i) {
+    threads.emplace_back([&cache, &go]() {
+      while (!go.load()) { std::this_thread::yield(); }
+      cryptolens::Error e;
+      EXPECT_EQ("", cache.create_trial_key(e, 3646));
+      EXPECT_EQ(cryptolens::errors::Main::UNKNOWN_SERVER_REPLY, e.get_reason(cryptolens::api::main()));
+      EXPECT_STREQ("Something went wrong.", e.get_server_message(cryptolens::api::main()));
+    });
+  }
+  go.store(true);
+  for (auto & t : threads) { t.join(); }
+
+  EXPECT_EQ(1, requests.load());
+}
+
+TEST_F(TrialKeyCacheTest, Persistence)
+{
+  {
+    cryptolens::Error e;
+    cryptolens::TrialKeyCache<Configuration_fake> cache(e, "token");
+    connect(cache, "machine-1");
+    cache.set_file(e, path);
+    EXPECT_EQ(key_for("3646", "machine-1"), cache.create_trial_key(e, 3646));
+    EXPECT_EQ(key_for("3647", "machine-1"), cache.create_trial_key(e, 3647));
+    ASSERT_FALSE(e);
+  }
+  EXPECT_EQ(2, requests.load());
+
+  // Loaded from the file without making a request
+  fail = true;
+  {
+    cryptolens::Error e;
+    cryptolens::TrialKeyCache<Configuration_fake> cache(e, "token");
+    connect(cache, "machine-1");
+    cache.set_file(e, path);
+    EXPECT_EQ(key_for("3646", "machine-1"), cache.create_trial_key(e, 3646));
+    EXPECT_EQ(key_for("3647", "machine-1"), cache.create_trial_key(e, 3647));
+    ASSERT_FALSE(e);
+  }
+  EXPECT_EQ(2, requests.load());
+
+  // Keys created for another machine code are not used
+  fail = false;
+  {
+    cryptolens::Error e;
+    cryptolens::TrialKeyCache<Configuration_fake> cache(e, "token");
+    connect(cache, "machine-2");
+    cache.set_file(e, path);
+    EXPECT_EQ(key_for("3646", "machine-2"), cache.create_trial_key(e, 3646));
+    ASSERT_FALSE(e);
+  }
+  EXPECT_EQ(3, requests.load());
+
+  // Cleared keys are removed from the file
+  {
+    cryptolens::Error e;
+    cryptolens::TrialKeyCache<Configuration_fake> cache(e, "token");
+    connect(cache, "machine-1");
+    cache.set_file(e, path);
+    cache.clear(e);
+    ASSERT_FALSE(e);
+  }
+  {
+    cryptolens::Error e;
+    cryptolens::TrialKeyCache<Configuration_fake> cache(e, "token");
+    connect(cache, "machine-1");
+    cache.set_file(e, path);
+    EXPECT_EQ(key_for("3646", "machine-1"), cache.create_trial_key(e, 3646));
+    ASSERT_FALSE(e);
+  }
+  EXPECT_EQ(4, requests.load());
+}
+
+TEST_F(TrialKeyCacheTest, SaveFailure)
+{
+  cryptolens::Error e;
+  cryptolens::TrialKeyCache<Configuration_fake> cache(e, "token");
+  connect(cache, "machine-1");
+  cache.set_file(e, ::testing::TempDir() + "cryptolens_test_missing_directory/trial_keys");
+  ASSERT_FALSE(e);
+
+  // The key is returned, and cached in memory, even though it could not be
+  // saved
+  EXPECT_EQ(key_for("3646", "machine-1"), cache.create_trial_key(e, 3646));
+  EXPECT_EQ(cryptolens::errors::Subsystem::File, e.get_subsystem(cryptolens::api::main()));
+  e.reset(cryptolens::api::main());
+
+  EXPECT_EQ(key_for("3646", "machine-1"), cache.create_trial_key(e, 3646));
+  EXPECT_FALSE(e);
+  EXPECT_EQ(1, requests.load());
+}
@@ -0,0 +1,185 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/Error.hpp>
+#include <cryptolens/UsageMeter.hpp>
+
+#include "Configuration_fake.hpp"
+
+namespace {
+
+// A request made by a UsageMeter
+struct Sent {
+  std::string endpoint;
+  std::string key;
+  std::string id;
+  std::string int_value;
+};
+
+class UsageMeterTest : public ::testing::Test {
+protected:
+  UsageMeterTest()
+  // ctest may run the tests in parallel, thus each uses its own journal
+  : journal(::testing::TempDir() + "cryptolens_test_usage_journal_" + ::testing::UnitTest::GetInstance()->current_test_info()->name())
+  , fail(false)
+  {
+    std::remove(journal.c_str());
+  }
+
+  ~UsageMeterTest() { std::remove(journal.c_str()); }
+
+  // Makes the meter send its requests to this fixture
+  void connect(cryptolens::UsageMeter<Configuration_fake> & meter)
+  {
+    meter.get_cryptolens_handle().request_handler.respond =
+      [this](cryptolens::basic_Error & e, std::string const& endpoint, RequestHandler_fake::Arguments const& arguments) {
+        if (fail) { return RequestHandler_fake::fail(e, endpoint, arguments); }
+
+        EXPECT_EQ("token", arguments.at("token"));
+        EXPECT_EQ("3646", arguments.at("ProductId"));
+        Sent x = { endpoint, arguments.at("Key"), arguments.at("Id"), arguments.at("IntValue") };
+        sent.push_back(x);
+        return std::string("{\"result\":0}");
+      };
+  }
+
+  void write_journal(std::string const& contents)
+  {
+    std::ofstream out(journal.c_str(), std::ios::binary);
+    out << contents;
+  }
+
+  std::string journal;
+  bool fail;
+  std::vector<Sent> sent;
+};
+
+} // namespace
+
+TEST_F(UsageMeterTest, SendsCounted)
+{
+  cryptolens::Error e;
+  cryptolens::UsageMeter<Configuration_fake> meter(e, "token");
+  connect(meter);
+
+  auto documents = meter.counter(e, 3646, "KEY-A", 1);
+  auto pages = meter.counter(e, 3646, "KEY-A", 2);
+  documents.add();
+  documents.add(2);
+  pages.add(-4);
+  meter.flush(e);
+  ASSERT_FALSE(e);
+
+  ASSERT_EQ(2u, sent.size());
+  EXPECT_EQ("/api/data/IncrementIntValueToKey", sent[0].endpoint);
+  EXPECT_EQ("KEY-A", sent[0].key);
+  EXPECT_EQ("1", sent[0].id);
+  EXPECT_EQ("3", sent[0].int_value);
+  EXPECT_EQ("/api/data/DecrementIntValueToKey", sent[1].endpoint);
+  EXPECT_EQ("2", sent[1].id);
+  EXPECT_EQ("4", sent[1].int_value);
+
+  // Nothing is sent twice
+  meter.flush(e);
+  EXPECT_EQ(2u, sent.size());
+}
+
+TEST_F(UsageMeterTest, KeepsUnsent)
+{
+  cryptolens::Error e;
+  cryptolens::UsageMeter<Configuration_fake> meter(e, "token");
+  connect(meter);
+
+  auto counter = meter.counter(e, 3646, "KEY-A", 1);
+  counter.add(3);
+
+  fail = true;
+  meter.flush(e);
+  EXPECT_EQ(cryptolens::errors::Subsystem::RequestHandler, e.get_subsystem(cryptolens::api::main()));
+  e.reset(cryptolens::api::main());
+
+  // The amount which failed to be sent is added to what was counted since
+  fail = false;
+  counter.add(4);
+  meter.flush(e);
+  ASSERT_FALSE(e);
+  ASSERT_EQ(1u, sent.size());
+  EXPECT_EQ("7", sent[0].int_value);
+}
+
+TEST_F(UsageMeterTest, ReplaysJournal)
+{
+  // The amount with sequence number 4 was sent, and the last line is
+  // incomplete since the process stopped while writing it
+  write_journal("D 4 3646 1 5 KEY-A\nS 4\nD 9 3646 1 7 KEY-B\nD 10 3646 2 -2 KEY-B\nD 11 3646 1 100 KEY-C");
+
+  {
+    cryptolens::Error e;
+    cryptolens::UsageMeter<Configuration_fake> meter(e, "token");
+    connect(meter);
+    meter.set_journal(e, journal);
+    ASSERT_FALSE(e);
+
+    meter.flush(e);
+    ASSERT_FALSE(e);
+  }
+
+  ASSERT_EQ(2u, sent.size());
+  EXPECT_EQ("KEY-B", sent[0].key);
+  EXPECT_EQ("1", sent[0].id);
+  EXPECT_EQ("7", sent[0].int_value);
+  EXPECT_EQ("KEY-B", sent[1].key);
+  EXPECT_EQ("2", sent[1].id);
+  EXPECT_EQ("/api/data/DecrementIntValueToKey", sent[1].endpoint);
+  EXPECT_EQ("2", sent[1].int_value);
+
+  // Everything replayed has been marked as sent
+  sent.clear();
+  {
+    cryptolens::Error e;
+    cryptolens::UsageMeter<Configuration_fake> meter(e, "token");
+    connect(meter);
+    meter.set_journal(e, journal);
+    meter.flush(e);
+    ASSERT_FALSE(e);
+  }
+  EXPECT_EQ(0u, sent.size());
+}
+
+TEST_F(UsageMeterTest, SendsAfterRestart)
+{
+  fail = true;
+  {
+    cryptolens::Error e;
+    cryptolens::UsageMeter<Configuration_fake> meter(e, "token");
+    connect(meter);
+    meter.set_journal(e, journal);
+    ASSERT_FALSE(e);
+
+    meter.counter(e, 3646, "KEY-A", 1).add(5);
+    meter.flush(e);
+    EXPECT_TRUE(e);
+  }
+
+  fail = false;
+  {
+    cryptolens::Error e;
+    cryptolens::UsageMeter<Configuration_fake> meter(e, "token");
+    connect(meter);
+    meter.set_journal(e, journal);
+    ASSERT_FALSE(e);
+
+    // Added to the amount replayed from the journal
+    meter.counter(e, 3646, "KEY-A", 1).add(1);
+    meter.flush(e);
+    ASSERT_FALSE(e);
+  }
+
+  ASSERT_EQ(1u, sent.size());
+  EXPECT_EQ("KEY-A", sent[0].key);
+  EXPECT_EQ("6", sent[0].int_value);
+}
@@ -0,0 +1,89 @@
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+
+#include "Configuration_fake.hpp"
+
+// The asynchronous methods are only tested when building as C++20 with
+// coroutine support, e.g. with -DCMAKE_CXX_STANDARD=20
+#ifdef CRYPTOLENS_HAS_COROUTINES
+
+namespace {
+
+/*
+ * An executor queueing the functions passed to it, which are then run on
+ * the thread of the test using run_one().
+ */
+class QueueExecutor {
+public:
+  void
+  operator()(std::function<void()> f)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(f));
+    cv_.notify_one();
+  }
+
+  void
+  run_one()
+  {
+    std::function<void()> f;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return !queue_.empty(); });
+      f = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    f();
+  }
+
+private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> queue_;
+};
+
+TEST(DeactivateAsync, BlockingRequestDoesNotRunOnExecutor)
+{
+  cryptolens::Error e;
+  cryptolens::basic_Cryptolens<Configuration_fake> cryptolens_handle(e);
+  cryptolens_handle.machine_code_computer.set_machine_code(e, "machine");
+
+  std::thread::id request_thread;
+  cryptolens_handle.request_handler.respond =
+    [&request_thread](cryptolens::basic_Error &, std::string const& endpoint, RequestHandler_fake::Arguments const&) {
+      EXPECT_EQ("/api/key/Deactivate", endpoint);
+      request_thread = std::this_thread::get_id();
+      return std::string("{\"result\":0,\"message\":\"\"}");
+    };
+
+  QueueExecutor queue;
+  auto executor = [&queue](std::function<void()> f) { queue(std::move(f)); };
+
+  bool done = false;
+  std::thread::id resumed_thread;
+  cryptolens::spawn(cryptolens_handle.deactivate_async(executor, e, "token", 3646, "key"),
+    [&done, &resumed_thread]() { done = true; resumed_thread = std::this_thread::get_id(); });
+
+  // The coroutine is resumed through the executor once the request is done
+  EXPECT_FALSE(done);
+  queue.run_one();
+
+  ASSERT_TRUE(done);
+  EXPECT_FALSE(e);
+  EXPECT_EQ(std::this_thread::get_id(), resumed_thread);
+  EXPECT_NE(std::thread::id(), request_thread);
+  EXPECT_NE(std::this_thread::get_id(), request_thread);
+}
+
+} // namespace
+
+#endif /* CRYPTOLENS_HAS_COROUTINES */
@@ -0,0 +1,127 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+
+#include <Licenses.hpp>
+#include <SigningKey.hpp>
+
+#include "Configuration_fake.hpp"
+
+namespace testkit = ::cryptolens_io::testkit;
+
+namespace {
+
+namespace Subsystem = cryptolens::errors::Subsystem;
+
+class BasicCryptolensTest : public ::testing::Test {
+protected:
+  BasicCryptolensTest()
+  : cryptolens_handle(e)
+  {
+    testkit::SigningKey const& signing_key = testkit::SigningKey::test_key();
+    cryptolens_handle.signature_verifier.set_modulus_base64(e, signing_key.get_modulus_base64());
+    cryptolens_handle.signature_verifier.set_exponent_base64(e, signing_key.get_exponent_base64());
+  }
+
+  static std::string
+  activate_response(std::string const& key)
+  {
+    testkit::LicenseSpec spec;
+    spec.key = key;
+    return testkit::make_activate_response(testkit::SigningKey::test_key(), testkit::make_license(spec));
+  }
+
+  // The format written by LicenseKey::to_string()
+  std::string
+  saved(std::string const& key)
+  {
+    auto license_key = cryptolens_handle.make_license_key(e, activate_response(key));
+    EXPECT_FALSE(e);
+    return license_key ? license_key->to_string() : "";
+  }
+
+  cryptolens::Error e;
+  cryptolens::basic_Cryptolens<Configuration_fake> cryptolens_handle;
+};
+
+TEST_F(BasicCryptolensTest, MakeLicenseKeyFromActivateResponse)
+{
+  // Leading whitespace does not hide that the input is JSON
+  auto license_key = cryptolens_handle.make_license_key(e, " \r\n\t" + activate_response("AAAAA-BBBBB-CCCCC-DDDDD"));
+  ASSERT_FALSE(e);
+  ASSERT_TRUE(license_key);
+  ASSERT_TRUE(license_key->get_key());
+  EXPECT_EQ("AAAAA-BBBBB-CCCCC-DDDDD", *license_key->get_key());
+}
+
+TEST_F(BasicCryptolensTest, MakeLicenseKeyFromSavedFormat)
+{
+  std::string s = saved("AAAAA-BBBBB-CCCCC-DDDDD");
+
+  auto license_key = cryptolens_handle.make_license_key(e, s);
+  ASSERT_FALSE(e);
+  ASSERT_TRUE(license_key);
+  ASSERT_TRUE(license_key->get_key());
+  EXPECT_EQ("AAAAA-BBBBB-CCCCC-DDDDD", *license_key->get_key());
+  EXPECT_EQ(s, license_key->to_string());
+}
+
+TEST_F(BasicCryptolensTest, MakeLicenseKeyFromMalformedJson)
+{
+  // Reported as a JSON error, rather than as a string in the saved format
+  auto license_key = cryptolens_handle.make_license_key(e, "{\"licenseKey\":-");
+  EXPECT_FALSE(license_key);
+  EXPECT_EQ(Subsystem::Json, e.get_subsystem(cryptolens::api::main()));
+}
+
+TEST_F(BasicCryptolensTest, MakeLicenseKeyFromMalformedSavedFormat)
+{
+  auto license_key = cryptolens_handle.make_license_key(e, "no dashes");
+  EXPECT_FALSE(license_key);
+  EXPECT_EQ(Subsystem::Main, e.get_subsystem(cryptolens::api::main()));
+  EXPECT_EQ(cryptolens::errors::Main::UNKNOWN_SERVER_REPLY, e.get_reason(cryptolens::api::main()));
+}
+
+TEST_F(BasicCryptolensTest, MakeLicenseKeyFromTamperedSavedFormat)
+{
+  std::string s = saved("AAAAA-BBBBB-CCCCC-DDDDD");
+  size_t i = s.rfind('-') + 1;
+  s[i] = s[i] == 'A' ? 'B' : 'A';
+
+  auto license_key = cryptolens_handle.make_license_key(e, s);
+  EXPECT_TRUE(e);
+  EXPECT_FALSE(license_key);
+}
+
+TEST_F(BasicCryptolensTest, MakeLicenseKeys)
+{
+  std::vector<std::string> s;
+  s.push_back(activate_response("AAAAA-AAAAA-AAAAA-AAAAA"));
+  s.push_back("no dashes");
+  s.push_back(saved("BBBBB-BBBBB-BBBBB-BBBBB"));
+
+  std::vector<cryptolens::basic_Error> errors;
+  auto license_keys = cryptolens_handle.make_license_keys(e, s, errors);
+
+  // Failures are reported for each license key, not for the batch
+  EXPECT_FALSE(e);
+  ASSERT_EQ(3u, license_keys.size());
+  ASSERT_EQ(3u, errors.size());
+
+  ASSERT_TRUE(license_keys[0]);
+  EXPECT_EQ("AAAAA-AAAAA-AAAAA-AAAAA", *license_keys[0]->get_key());
+  EXPECT_FALSE(errors[0]);
+
+  EXPECT_FALSE(license_keys[1]);
+  EXPECT_TRUE(errors[1]);
+
+  ASSERT_TRUE(license_keys[2]);
+  EXPECT_EQ("BBBBB-BBBBB-BBBBB-BBBBB", *license_keys[2]->get_key());
+  EXPECT_FALSE(errors[2]);
+}
+
+} // namespace
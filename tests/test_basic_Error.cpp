@@ -0,0 +1,126 @@
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/cryptolens_internals.hpp>
+#include <cryptolens/Error.hpp>
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+
+namespace {
+
+namespace Main = cryptolens::errors::Main;
+namespace Subsystem = cryptolens::errors::Subsystem;
+
+int
+parse(char const* message)
+{
+  return cryptolens::internal::activate_parse_server_error_message(message);
+}
+
+TEST(ServerErrorMessage, KnownMessages)
+{
+  EXPECT_EQ(Main::INVALID_ACCESS_TOKEN, parse("Unable to authenticate."));
+  EXPECT_EQ(Main::ACCESS_DENIED, parse("Access denied."));
+  EXPECT_EQ(Main::INCORRECT_INPUT_PARAMETER, parse("The input parameters were incorrect."));
+  EXPECT_EQ(Main::PRODUCT_NOT_FOUND, parse("Could not find the product."));
+  EXPECT_EQ(Main::KEY_NOT_FOUND, parse("Could not find the key."));
+  EXPECT_EQ(Main::KEY_BLOCKED, parse("The key is blocked and cannot be accessed."));
+  EXPECT_EQ(Main::DEVICE_LIMIT_REACHED, parse("Cannot activate the new device as the limit has been reached."));
+}
+
+TEST(ServerErrorMessage, SameLengthAsKnownMessage)
+{
+  // Each length has a candidate, which must also match byte for byte
+  EXPECT_EQ(Main::UNKNOWN_SERVER_REPLY, parse("Access denied!"));
+  EXPECT_EQ(Main::UNKNOWN_SERVER_REPLY, parse("The input parameters were incorrekt."));
+  EXPECT_EQ(Main::UNKNOWN_SERVER_REPLY, parse("Could not find the produkt."));
+  EXPECT_EQ(Main::UNKNOWN_SERVER_REPLY, parse("The key is blocked and cannot be accessed!"));
+  EXPECT_EQ(Main::UNKNOWN_SERVER_REPLY, parse("Cannot activate the new device as the limit has been reached!"));
+
+  // Two messages have the same length, and the first byte picks the candidate
+  EXPECT_EQ(Main::UNKNOWN_SERVER_REPLY, parse("Unable to authenticate!"));
+  EXPECT_EQ(Main::UNKNOWN_SERVER_REPLY, parse("Could not find the kex."));
+  EXPECT_EQ(Main::UNKNOWN_SERVER_REPLY, parse("Xnable to authenticate."));
+}
+
+TEST(ServerErrorMessage, UnknownMessages)
+{
+  EXPECT_EQ(Main::UNKNOWN_SERVER_REPLY, parse(NULL));
+  EXPECT_EQ(Main::UNKNOWN_SERVER_REPLY, parse(""));
+  EXPECT_EQ(Main::UNKNOWN_SERVER_REPLY, parse("Something went wrong."));
+  EXPECT_EQ(Main::UNKNOWN_SERVER_REPLY, parse("Access denied"));
+}
+
+TEST(ServerErrorMessage, MessageForReason)
+{
+  for (int reason = Main::INVALID_ACCESS_TOKEN; reason <= Main::DEVICE_LIMIT_REACHED; ++reason) {
+    char const* message = cryptolens::internal::activate_server_error_message(reason);
+    ASSERT_NE(nullptr, message) << reason;
+    EXPECT_EQ(reason, parse(message));
+  }
+
+  EXPECT_EQ(nullptr, cryptolens::internal::activate_server_error_message(0));
+  EXPECT_EQ(nullptr, cryptolens::internal::activate_server_error_message(Main::UNKNOWN_SERVER_REPLY));
+  EXPECT_EQ(nullptr, cryptolens::internal::activate_server_error_message(Main::KEY_EXPIRED));
+  EXPECT_EQ(nullptr, cryptolens::internal::activate_server_error_message(-1));
+  EXPECT_EQ(nullptr, cryptolens::internal::activate_server_error_message(1000));
+}
+
+TEST(basic_Error, ServerMessage)
+{
+  cryptolens::api::main api;
+  cryptolens::Error e;
+  EXPECT_STREQ("", e.get_server_message(api));
+
+  // Known messages are recovered from the reason
+  cryptolens::internal::activate_set_server_error(e, "Could not find the key.");
+  EXPECT_EQ(Subsystem::Main, e.get_subsystem());
+  EXPECT_EQ(Main::KEY_NOT_FOUND, e.get_reason());
+  EXPECT_STREQ("Could not find the key.", e.get_server_message(api));
+
+  e.reset();
+  cryptolens::internal::activate_set_server_error(e, "Something went wrong.");
+  EXPECT_EQ(Main::UNKNOWN_SERVER_REPLY, e.get_reason());
+  EXPECT_STREQ("Something went wrong.", e.get_server_message(api));
+
+  e.reset();
+  EXPECT_STREQ("", e.get_server_message(api));
+}
+
+TEST(basic_Error, SetClearsServerMessage)
+{
+  cryptolens::api::main api;
+  cryptolens::Error e;
+
+  cryptolens::internal::activate_set_server_error(e, "Something went wrong.");
+  e.set(api, Subsystem::RequestHandler, 1);
+  EXPECT_STREQ("", e.get_server_message(api));
+
+  cryptolens::internal::activate_set_server_error(e, "Something went wrong.");
+  e.set(api, Subsystem::Main, Main::KEY_BLOCKED);
+  EXPECT_STREQ("The key is blocked and cannot be accessed.", e.get_server_message(api));
+}
+
+TEST(basic_Error, SetFromError)
+{
+  cryptolens::api::main api;
+  cryptolens::Error source;
+  cryptolens::internal::activate_set_server_error(source, "Something went wrong.");
+
+  cryptolens::Error e;
+  e.set(api, source);
+  EXPECT_EQ(Subsystem::Main, e.get_subsystem());
+  EXPECT_EQ(Main::UNKNOWN_SERVER_REPLY, e.get_reason());
+  EXPECT_STREQ("Something went wrong.", e.get_server_message(api));
+
+  source.reset();
+  source.set(api, Subsystem::RequestHandler, 8, 7);
+  e.set(api, source);
+  EXPECT_EQ(Subsystem::RequestHandler, e.get_subsystem());
+  EXPECT_EQ(8, e.get_reason());
+  EXPECT_EQ(7u, e.get_extra());
+  EXPECT_STREQ("", e.get_server_message(api));
+}
+
+} // namespace
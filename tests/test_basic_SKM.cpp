@@ -0,0 +1,149 @@
+#include <limits>
+#include <map>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+#include <cryptolens/RequestHandler_v20190401_to_v20180502.hpp>
+#include <cryptolens/SignatureVerifier_v20190401_to_v20180502.hpp>
+
+#include <Licenses.hpp>
+#include <SigningKey.hpp>
+
+#include "Configuration_fake.hpp"
+
+namespace testkit = ::cryptolens_io::testkit;
+namespace cryptolens_v20180502 = ::cryptolens_io::v20180502;
+
+namespace {
+
+// The last request made using RequestHandler_recording
+std::string recorded_endpoint;
+RequestHandler_fake::Arguments recorded_arguments;
+std::string response;
+
+/*
+ * The request handler adapter constructs the request handler it wraps
+ * itself, thus the requests are recorded in globals instead.
+ */
+class RequestHandler_recording : public RequestHandler_fake {
+public:
+  explicit RequestHandler_recording(cryptolens::basic_Error & e)
+  : RequestHandler_fake(e)
+  {
+    respond = [](cryptolens::basic_Error &, std::string const& endpoint, Arguments const& arguments) {
+      recorded_endpoint = endpoint;
+      recorded_arguments = arguments;
+      return response;
+    };
+  }
+};
+
+using SKM = cryptolens_v20180502::basic_SKM
+  < ::cryptolens_io::internal::RequestHandler_v20190401_to_v20180502<RequestHandler_recording>
+  , ::cryptolens_io::internal::SignatureVerifier_v20190401_to_v20180502<cryptolens::SignatureVerifier_OpenSSL>
+  >;
+
+class BasicSKMTest : public ::testing::Test {
+protected:
+  BasicSKMTest()
+  {
+    recorded_endpoint.clear();
+    recorded_arguments.clear();
+
+    testkit::LicenseSpec spec;
+    spec.key = "AAAAA-BBBBB-CCCCC-DDDDD";
+    response = testkit::make_activate_response(testkit::SigningKey::test_key(), testkit::make_license(spec));
+
+    testkit::SigningKey const& signing_key = testkit::SigningKey::test_key();
+    skm.signature_verifier.set_modulus_base64(e, signing_key.get_modulus_base64());
+    skm.signature_verifier.set_exponent_base64(e, signing_key.get_exponent_base64());
+  }
+
+  cryptolens::Error e;
+  SKM skm;
+};
+
+TEST_F(BasicSKMTest, Activate)
+{
+  auto license_key = skm.activate(e, "token", "3646", "AAAAA-BBBBB-CCCCC-DDDDD", "machine", 17);
+  ASSERT_FALSE(e);
+  ASSERT_TRUE(license_key);
+  EXPECT_EQ("AAAAA-BBBBB-CCCCC-DDDDD", *license_key->get_key());
+
+  RequestHandler_fake::Arguments expected =
+    { { "token"         , "token"                   }
+    , { "ProductId"     , "3646"                    }
+    , { "Key"           , "AAAAA-BBBBB-CCCCC-DDDDD" }
+    , { "Sign"          , "true"                    }
+    , { "MachineCode"   , "machine"                 }
+    , { "FieldsToReturn", "17"                      }
+    , { "SignMethod"    , "1"                       }
+    , { "v"             , "1"                       }
+    };
+  EXPECT_EQ("/api/key/Activate", recorded_endpoint);
+  EXPECT_EQ(expected, recorded_arguments);
+}
+
+TEST_F(BasicSKMTest, ActivateRaw)
+{
+  auto raw_license_key = skm.activate_raw(e, "token", "3646", "AAAAA-BBBBB-CCCCC-DDDDD", "machine", -1);
+  ASSERT_FALSE(e);
+  EXPECT_TRUE(raw_license_key);
+
+  EXPECT_EQ("/api/key/Activate", recorded_endpoint);
+  EXPECT_EQ("-1", recorded_arguments["FieldsToReturn"]);
+  EXPECT_EQ(8u, recorded_arguments.size());
+}
+
+TEST_F(BasicSKMTest, ActivateFloating)
+{
+  long floating_time_interval = std::numeric_limits<long>::max();
+  auto license_key = skm.activate_floating(e, "token", "3646", "AAAAA-BBBBB-CCCCC-DDDDD", "machine", floating_time_interval);
+  ASSERT_FALSE(e);
+  ASSERT_TRUE(license_key);
+
+  RequestHandler_fake::Arguments expected =
+    { { "token"               , "token"                                  }
+    , { "ProductId"           , "3646"                                   }
+    , { "Key"                 , "AAAAA-BBBBB-CCCCC-DDDDD"                }
+    , { "Sign"                , "true"                                   }
+    , { "MachineCode"         , "machine"                                }
+    , { "FieldsToReturn"      , "0"                                      }
+    , { "SignMethod"          , "1"                                      }
+    , { "v"                   , "1"                                      }
+    , { "FloatingTimeInterval", std::to_string(floating_time_interval)   }
+    };
+  EXPECT_EQ("/api/key/Activate", recorded_endpoint);
+  EXPECT_EQ(expected, recorded_arguments);
+}
+
+TEST_F(BasicSKMTest, ActivateWithInvalidSignature)
+{
+  std::string signature = "\"signature\":\"";
+  std::string::size_type i = response.find(signature) + signature.size();
+  response[i] = response[i] == 'A' ? 'B' : 'A';
+
+  auto license_key = skm.activate(e, "token", "3646", "AAAAA-BBBBB-CCCCC-DDDDD", "machine");
+  EXPECT_TRUE(e);
+  EXPECT_FALSE(license_key);
+}
+
+TEST_F(BasicSKMTest, RequestWithLongMethodName)
+{
+  // Too long for the endpoint to be built on the stack
+  std::string method(100, 'm');
+
+  // The arguments may also be given as strings
+  std::map<std::string, std::string> arguments = { { "a", "1" }, { "b", "" } };
+
+  response = "response";
+  EXPECT_EQ("response", skm.request_handler.make_request(e, method.c_str(), arguments));
+  EXPECT_FALSE(e);
+  EXPECT_EQ("/api/key/" + method, recorded_endpoint);
+  EXPECT_EQ(arguments, recorded_arguments);
+}
+
+} // namespace
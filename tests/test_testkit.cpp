@@ -0,0 +1,118 @@
+#include <set>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+
+#include <Licenses.hpp>
+#include <SigningKey.hpp>
+
+#include "Configuration_fake.hpp"
+
+namespace testkit = ::cryptolens_io::testkit;
+
+namespace {
+
+/*
+ * The benchmarks, the mock server and the other tests rely on the testkit
+ * producing responses that the library accepts as if they came from the
+ * Web API.
+ */
+class TestkitTest : public ::testing::Test {
+protected:
+  TestkitTest()
+  : cryptolens_handle(e)
+  {
+    testkit::SigningKey const& signing_key = testkit::SigningKey::test_key();
+    cryptolens_handle.signature_verifier.set_modulus_base64(e, signing_key.get_modulus_base64());
+    cryptolens_handle.signature_verifier.set_exponent_base64(e, signing_key.get_exponent_base64());
+  }
+
+  cryptolens::Error e;
+  cryptolens::basic_Cryptolens<Configuration_fake> cryptolens_handle;
+};
+
+TEST_F(TestkitTest, ActivateResponseIsAccepted)
+{
+  testkit::LicenseSpec spec;
+  spec.activated_machines = 100;
+  spec.machine_code = testkit::machine_code_for(1000);
+  std::string response = testkit::make_activate_response(testkit::SigningKey::test_key(), testkit::make_license(spec));
+
+  auto license_key = cryptolens_handle.make_license_key(e, response);
+  ASSERT_FALSE(e);
+  ASSERT_TRUE(license_key);
+
+  EXPECT_EQ(spec.product_id, license_key->get_product_id());
+  EXPECT_EQ(spec.created, license_key->get_created());
+  EXPECT_EQ(spec.expires, license_key->get_expires());
+  ASSERT_TRUE(license_key->get_key());
+  EXPECT_EQ(spec.key, *license_key->get_key());
+
+  // The generated machines come first, followed by spec.machine_code
+  ASSERT_TRUE(license_key->get_activated_machines());
+  auto const& machines = *license_key->get_activated_machines();
+  ASSERT_EQ(101u, machines.size());
+  EXPECT_EQ(testkit::machine_code_for(0), machines.front().get_mid());
+  EXPECT_EQ(spec.machine_code, machines.back().get_mid());
+}
+
+TEST_F(TestkitTest, ActivateThroughFakeRequestHandler)
+{
+  testkit::LicenseSpec spec;
+  spec.machine_code = testkit::machine_code_for(1);
+  cryptolens_handle.machine_code_computer.set_machine_code(e, spec.machine_code);
+  cryptolens_handle.request_handler.respond =
+    [&spec](cryptolens::basic_Error &, std::string const& endpoint, RequestHandler_fake::Arguments const& arguments) {
+      EXPECT_EQ("/api/key/Activate", endpoint);
+      EXPECT_EQ(spec.key, arguments.at("Key"));
+      EXPECT_EQ(spec.machine_code, arguments.at("MachineCode"));
+      return testkit::make_activate_response(testkit::SigningKey::test_key(), testkit::make_license(spec));
+    };
+
+  auto license_key = cryptolens_handle.activate(e, "token", spec.product_id, spec.key);
+  EXPECT_FALSE(e);
+  EXPECT_TRUE(license_key);
+}
+
+TEST_F(TestkitTest, TamperedSignatureIsRejected)
+{
+  std::string response = testkit::make_activate_response(testkit::SigningKey::test_key(), testkit::make_license(testkit::LicenseSpec()));
+
+  size_t i = response.find("\"signature\":\"") + 13;
+  response[i] = response[i] == 'A' ? 'B' : 'A';
+
+  auto license_key = cryptolens_handle.make_license_key(e, response);
+  EXPECT_TRUE(e);
+  EXPECT_FALSE(license_key);
+}
+
+TEST_F(TestkitTest, ErrorResponseIsReported)
+{
+  cryptolens_handle.request_handler.respond =
+    [](cryptolens::basic_Error &, std::string const&, RequestHandler_fake::Arguments const&) {
+      return testkit::make_error_response("The key is blocked and cannot be accessed.");
+    };
+
+  testkit::LicenseSpec spec;
+  auto license_key = cryptolens_handle.activate(e, "token", spec.product_id, spec.key);
+  EXPECT_FALSE(license_key);
+  EXPECT_EQ(cryptolens::errors::Subsystem::Main, e.get_subsystem(cryptolens::api::main()));
+  EXPECT_EQ(cryptolens::errors::Main::KEY_BLOCKED, e.get_reason(cryptolens::api::main()));
+}
+
+TEST(Testkit, MachineCodesAreDistinct)
+{
+  std::set<std::string> machine_codes;
+  for (int i = 0; i < 1000; ++i) {
+    std::string machine_code = testkit::machine_code_for(i);
+    EXPECT_EQ(64u, machine_code.size());
+    EXPECT_EQ(std::string::npos, machine_code.find_first_not_of("0123456789abcdef"));
+    machine_codes.insert(machine_code);
+  }
+  EXPECT_EQ(1000u, machine_codes.size());
+}
+
+} // namespace
@@ -0,0 +1,133 @@
+/*
+ * Loads a directory or manifest of saved license key files using
+ * basic_Cryptolens::load_license_key_files() and lists the license keys
+ * together with the files that could not be loaded.
+ *
+ *     cryptolens_load_licenses --modulus B64 --exponent B64 --dir /etc/licenses
+ *
+ * Options:
+ *   --dir D           load the files in the directory D
+ *   --manifest M      load the files listed in the manifest M, one path per line
+ *   --modulus B64     modulus of the public key of the account, in base64
+ *   --exponent B64    exponent of the public key of the account, in base64
+ *   --test-key        use the public key of the test key of the testkit instead
+ *   --threads N       number of threads, 0 for one per core (default 0)
+ *   --quiet           only print the summary
+ *
+ * The exit status is 0 if all files were loaded and 1 otherwise.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+#include <cryptolens/Configuration_Unix.hpp>
+#include <cryptolens/MachineCodeComputer_static.hpp>
+
+#include <SigningKey.hpp>
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+using Cryptolens = cryptolens::basic_Cryptolens<cryptolens::Configuration_Unix<cryptolens::MachineCodeComputer_static>>;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+  std::string dir;
+  std::string manifest;
+  std::string modulus;
+  std::string exponent;
+  unsigned threads = 0;
+  bool quiet = false;
+};
+
+void
+print_error(char const* what, cryptolens::basic_Error const& e)
+{
+  cryptolens::api::main api;
+  std::fprintf( stderr, "%s: error subsystem %d reason %d extra %lu\n"
+              , what, e.get_subsystem(api), e.get_reason(api), (unsigned long)e.get_extra(api));
+}
+
+void
+usage(char const* name)
+{
+  std::fprintf(stderr, "Usage: %s (--dir D | --manifest M) (--modulus B64 --exponent B64 | --test-key)\n"
+                       "       [--threads N] [--quiet]\n", name);
+  std::exit(2);
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+  Options options;
+
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--quiet") == 0) { options.quiet = true; continue; }
+    if (std::strcmp(argv[i], "--test-key") == 0) {
+      cryptolens_io::testkit::SigningKey const& signing_key = cryptolens_io::testkit::SigningKey::test_key();
+      options.modulus = signing_key.get_modulus_base64();
+      options.exponent = signing_key.get_exponent_base64();
+      continue;
+    }
+    if (i + 1 >= argc) { usage(argv[0]); }
+
+    if      (std::strcmp(argv[i], "--dir") == 0)      { options.dir = argv[++i]; }
+    else if (std::strcmp(argv[i], "--manifest") == 0) { options.manifest = argv[++i]; }
+    else if (std::strcmp(argv[i], "--modulus") == 0)  { options.modulus = argv[++i]; }
+    else if (std::strcmp(argv[i], "--exponent") == 0) { options.exponent = argv[++i]; }
+    else if (std::strcmp(argv[i], "--threads") == 0)  { options.threads = (unsigned)std::atoi(argv[++i]); }
+    else                                              { usage(argv[0]); }
+  }
+
+  if (options.dir.empty() == options.manifest.empty()) { usage(argv[0]); }
+  if (options.modulus.empty() || options.exponent.empty()) { usage(argv[0]); }
+
+  Clock::time_point start = Clock::now();
+
+  cryptolens::Error e;
+  cryptolens::Executor_thread_pool pool(e, options.threads);
+  Cryptolens cryptolens_handle(e);
+  cryptolens_handle.set_executor(e, pool);
+  cryptolens_handle.signature_verifier.set_modulus_base64(e, options.modulus);
+  cryptolens_handle.signature_verifier.set_exponent_base64(e, options.exponent);
+  if (e) { print_error("Failed to set up handle", e); return 2; }
+
+  std::vector<std::string> paths =
+    options.dir.empty() ? cryptolens::read_license_key_manifest(e, options.manifest)
+                        : cryptolens::list_license_key_files(e, options.dir);
+  if (e) { print_error(options.dir.empty() ? options.manifest.c_str() : options.dir.c_str(), e); return 2; }
+
+  std::vector<cryptolens::basic_Error> errors;
+  std::vector<cryptolens::LicenseKeyFile> files = cryptolens_handle.load_license_key_files(e, paths, errors);
+  if (e) { print_error("Failed to load license keys", e); return 2; }
+
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  if (!options.quiet) {
+    for (auto const& file : files) {
+      cryptolens::LicenseKey const& license_key = file.license_key;
+      std::printf( "%s\tproduct %d\texpires %llu\t%s\n"
+                 , license_key.get_key() ? license_key.get_key()->c_str() : "-"
+                 , license_key.get_product_id()
+                 , (unsigned long long)license_key.get_expires()
+                 , file.path.c_str());
+    }
+  }
+
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (errors[i]) { print_error(paths[i].c_str(), errors[i]); }
+  }
+
+  std::fprintf( stderr, "Loaded %lu of %lu files in %.3f s using %u threads\n"
+              , (unsigned long)files.size(), (unsigned long)paths.size(), elapsed, pool.concurrency());
+
+  return files.size() == paths.size() ? 0 : 1;
+}
@@ -0,0 +1,235 @@
+/*
+ * Drives basic_Cryptolens at a fixed rate of requests and reports the
+ * latency distribution and the number of heap allocations per request.
+ *
+ * Intended to be used together with cryptolens_mock_server:
+ *
+ *     cryptolens_mock_server --port 8080 &
+ *     cryptolens_loadgen --url http://127.0.0.1:8080 --qps 500 --duration 10
+ *
+ * Options:
+ *   --url URL         base url of the Web API (default http://127.0.0.1:8080)
+ *   --qps N           target number of requests per second, over all threads (default 100)
+ *   --duration S      length of the run in seconds (default 10)
+ *   --threads N       number of threads, each with its own handle (default 4)
+ *   --method M        activate, deactivate, create_trial_key or last_message (default activate)
+ *   --http2           use HTTP/2 multiplexing over shared connections instead of
+ *                     one HTTP/1.1 keep-alive connection per thread
+ *   --no-compression  do not ask for compressed responses
+ *   --timeout MS      timeout of each attempt (default 30000)
+ *   --retries N       maximum number of retries (default 2)
+ *   --hedge P         send a hedged request after the P:th percentile latency (default off)
+ *
+ * Latencies are measured from the time a request was scheduled to start, so
+ * that the requests delayed by a slow request are accounted for. The time
+ * spent in the library call alone is reported as the service time.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <curl/curl.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+#include <cryptolens/Configuration_Unix.hpp>
+#include <cryptolens/MachineCodeComputer_static.hpp>
+
+#include <Licenses.hpp>
+#include <SigningKey.hpp>
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+using Cryptolens = cryptolens::basic_Cryptolens<cryptolens::Configuration_Unix<cryptolens::MachineCodeComputer_static>>;
+
+/*
+ * Count heap allocations made by each thread
+ */
+
+namespace {
+
+thread_local std::uint64_t allocations = 0;
+
+} // namespace
+
+void * operator new(std::size_t size)
+{
+  ++allocations;
+  void * p = std::malloc(size == 0 ? 1 : size);
+  if (p == NULL) { throw std::bad_alloc(); }
+  return p;
+}
+
+void operator delete(void * p) noexcept { std::free(p); }
+void operator delete(void * p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::string const token = "loadgen";
+
+struct Options {
+  std::string url = "http://127.0.0.1:8080";
+  double qps = 100;
+  double duration = 10;
+  int threads = 4;
+  std::string method = "activate";
+  bool http2 = false;
+  bool compression = true;
+  cryptolens::RequestPolicy policy = cryptolens::RequestPolicy_default::get();
+};
+
+struct Result {
+  std::vector<std::uint64_t> latencies;
+  std::vector<std::uint64_t> service_times;
+  std::uint64_t errors = 0;
+  std::uint64_t allocations = 0;
+  std::uint64_t bytes_received = 0;
+};
+
+void
+run(Options const& options, int index, Clock::time_point start, Result & result)
+{
+  cryptolens_io::testkit::SigningKey const& signing_key = cryptolens_io::testkit::SigningKey::test_key();
+  cryptolens_io::testkit::LicenseSpec spec;
+
+  cryptolens::Error e;
+  Cryptolens cryptolens_handle(e);
+  cryptolens_handle.set_base_url(e, options.url);
+  if (options.http2) { cryptolens_handle.request_handler.set_http2_multiplexing(e, true); }
+  if (!options.compression) { cryptolens_handle.request_handler.set_response_compression(e, false); }
+  cryptolens_handle.request_handler.set_request_policy(e, options.policy);
+  cryptolens_handle.signature_verifier.set_modulus_base64(e, signing_key.get_modulus_base64());
+  cryptolens_handle.signature_verifier.set_exponent_base64(e, signing_key.get_exponent_base64());
+  cryptolens_handle.machine_code_computer.set_machine_code(e, cryptolens_io::testkit::machine_code_for(1000000 + index));
+  if (e) { std::fprintf(stderr, "Failed to set up handle\n"); std::exit(1); }
+
+  std::chrono::nanoseconds interval((std::int64_t)(1e9 * options.threads / options.qps));
+  Clock::time_point end = start + std::chrono::nanoseconds((std::int64_t)(1e9 * options.duration));
+  Clock::time_point next = start + interval * index / options.threads;
+
+  for (; next < end; next += interval) {
+    std::this_thread::sleep_until(next);
+
+    std::uint64_t a0 = allocations;
+    Clock::time_point t0 = Clock::now();
+
+    if (options.method == "activate") {
+      cryptolens_handle.activate(e, token, spec.product_id, spec.key);
+    } else if (options.method == "deactivate") {
+      cryptolens_handle.deactivate(e, token, spec.product_id, spec.key);
+    } else if (options.method == "create_trial_key") {
+      cryptolens_handle.create_trial_key(e, token, spec.product_id);
+    } else {
+      cryptolens_handle.last_message(e, token, "stable", 0);
+    }
+
+    Clock::time_point t1 = Clock::now();
+    result.allocations += allocations - a0;
+    result.bytes_received += cryptolens_handle.request_handler.get_last_request_statistics().bytes_received;
+
+    result.latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - next).count());
+    result.service_times.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+
+    if (e) {
+      if (result.errors == 0) {
+        std::fprintf(stderr, "Request failed: subsystem %d, reason %d, extra %lu\n", e.get_subsystem(), e.get_reason(), (unsigned long)e.get_extra());
+      }
+      ++result.errors;
+      e.reset(cryptolens::api::main());
+    }
+  }
+}
+
+double
+percentile_ms(std::vector<std::uint64_t> const& sorted, double q)
+{
+  if (sorted.empty()) { return 0; }
+  size_t i = std::min(sorted.size() - 1, (size_t)(q * sorted.size()));
+  return sorted[i] / 1e6;
+}
+
+void
+report(char const* name, std::vector<std::uint64_t> & v)
+{
+  std::sort(v.begin(), v.end());
+  std::printf( "%-13s p50 %8.3f ms  p90 %8.3f ms  p99 %8.3f ms  p99.9 %8.3f ms  max %8.3f ms\n"
+             , name
+             , percentile_ms(v, 0.5), percentile_ms(v, 0.9), percentile_ms(v, 0.99), percentile_ms(v, 0.999)
+             , v.empty() ? 0 : v.back() / 1e6);
+}
+
+void
+usage(char const* name)
+{
+  std::fprintf(stderr, "Usage: %s [--url URL] [--qps N] [--duration S] [--threads N] [--method M] [--http2] [--no-compression]\n"
+                       "       [--timeout MS] [--retries N] [--hedge P]\n", name);
+  std::exit(1);
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+  Options options;
+
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--http2") == 0)          { options.http2 = true; continue; }
+    if (std::strcmp(argv[i], "--no-compression") == 0) { options.compression = false; continue; }
+    if (i + 1 >= argc) { usage(argv[0]); }
+
+    if      (std::strcmp(argv[i], "--url") == 0)      { options.url = argv[++i]; }
+    else if (std::strcmp(argv[i], "--qps") == 0)      { options.qps = std::atof(argv[++i]); }
+    else if (std::strcmp(argv[i], "--duration") == 0) { options.duration = std::atof(argv[++i]); }
+    else if (std::strcmp(argv[i], "--threads") == 0)  { options.threads = std::atoi(argv[++i]); }
+    else if (std::strcmp(argv[i], "--method") == 0)   { options.method = argv[++i]; }
+    else if (std::strcmp(argv[i], "--timeout") == 0)  { options.policy.attempt_timeout = std::atoi(argv[++i]); }
+    else if (std::strcmp(argv[i], "--retries") == 0)  { options.policy.max_retries = std::atoi(argv[++i]); }
+    else if (std::strcmp(argv[i], "--hedge") == 0)    { options.policy.hedge_percentile = std::atoi(argv[++i]); }
+    else                                              { usage(argv[0]); }
+  }
+
+  if (options.qps <= 0 || options.duration <= 0 || options.threads <= 0) { usage(argv[0]); }
+
+  curl_global_init(CURL_GLOBAL_SSL);
+
+  std::vector<Result> results(options.threads);
+  std::vector<std::thread> threads;
+
+  Clock::time_point start = Clock::now();
+  for (int i = 0; i < options.threads; ++i) {
+    threads.emplace_back(run, std::cref(options), i, start, std::ref(results[i]));
+  }
+  for (auto & t : threads) { t.join(); }
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  Result total;
+  for (auto const& r : results) {
+    total.latencies.insert(total.latencies.end(), r.latencies.begin(), r.latencies.end());
+    total.service_times.insert(total.service_times.end(), r.service_times.begin(), r.service_times.end());
+    total.errors += r.errors;
+    total.allocations += r.allocations;
+    total.bytes_received += r.bytes_received;
+  }
+
+  size_t requests = total.latencies.size();
+  std::printf("Requests:     %lu (%lu failed)\n", (unsigned long)requests, (unsigned long)total.errors);
+  std::printf("Throughput:   %.1f requests/s (target %.1f)\n", requests / elapsed, options.qps);
+  report("Latency:", total.latencies);
+  report("Service time:", total.service_times);
+  std::printf("Allocations:  %.1f per request\n", requests ? (double)total.allocations / requests : 0.0);
+  std::printf("Received:     %.0f bytes per request\n", requests ? (double)total.bytes_received / requests : 0.0);
+
+  curl_global_cleanup();
+
+  return total.errors == 0 ? 0 : 1;
+}
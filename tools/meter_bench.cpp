@@ -0,0 +1,203 @@
+/*
+ * Measures how many usage events per second can be metered, either using
+ * UsageMeter or by sending one IncrementIntValueToKey request per event.
+ *
+ * Intended to be used together with cryptolens_mock_server:
+ *
+ *     cryptolens_mock_server --port 8080 &
+ *     cryptolens_meter_bench --url http://127.0.0.1:8080 --mode meter
+ *     cryptolens_meter_bench --url http://127.0.0.1:8080 --mode direct
+ *
+ * Options:
+ *   --url URL          base url of the Web API (default http://127.0.0.1:8080)
+ *   --mode M           meter or direct (default meter)
+ *   --duration S       length of the run in seconds (default 5)
+ *   --threads N        number of threads adding events (default 4)
+ *   --counters N       number of license keys events are spread over (default 4)
+ *   --flush-interval MS  flush interval of the meter (default 100)
+ *   --journal PATH     journal of the meter (default none)
+ *
+ * In direct mode each thread uses its own handle, since the handles are not
+ * thread safe.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <curl/curl.h>
+
+#include <cryptolens/core.hpp>
+#include <cryptolens/Error.hpp>
+#include <cryptolens/Configuration_Unix.hpp>
+#include <cryptolens/MachineCodeComputer_static.hpp>
+#include <cryptolens/UsageMeter.hpp>
+
+namespace cryptolens = ::cryptolens_io::v20190401;
+using Configuration = cryptolens::Configuration_Unix<cryptolens::MachineCodeComputer_static>;
+using Cryptolens = cryptolens::basic_Cryptolens<Configuration>;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::string const token = "meter_bench";
+int const product_id = 3646;
+int const data_object_id = 1;
+
+struct Options {
+  std::string url = "http://127.0.0.1:8080";
+  std::string mode = "meter";
+  double duration = 5;
+  int threads = 4;
+  int counters = 4;
+  int flush_interval = 100;
+  std::string journal;
+};
+
+std::string
+key_for(int i)
+{
+  char key[32];
+  std::snprintf(key, sizeof(key), "METER-%05d-AAAAA-BBBBB", i);
+  return key;
+}
+
+std::uint64_t
+run_meter(Options const& options, Clock::time_point end, std::uint64_t & requests, std::uint64_t & errors)
+{
+  cryptolens::Error e;
+  cryptolens::UsageMeter<Configuration> meter(e, token);
+  meter.get_cryptolens_handle().set_base_url(e, options.url);
+  meter.set_flush_interval(e, std::chrono::milliseconds(options.flush_interval));
+  if (!options.journal.empty()) { meter.set_journal(e, options.journal); }
+
+  std::atomic<std::uint64_t> flushes(0);
+  std::atomic<std::uint64_t> failed(0);
+  meter.set_on_flush(e, [&flushes, &failed](cryptolens::basic_Error const& e) {
+    ++flushes;
+    if (e) { ++failed; }
+  });
+
+  std::vector<cryptolens::UsageMeter<Configuration>::Counter> counters;
+  for (int i = 0; i < options.counters; ++i) { counters.push_back(meter.counter(e, product_id, key_for(i), data_object_id)); }
+
+  meter.start(e);
+  if (e) { std::fprintf(stderr, "Failed to set up meter\n"); std::exit(1); }
+
+  std::vector<std::uint64_t> events(options.threads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < options.threads; ++t) {
+    threads.emplace_back([&, t]() {
+      std::uint64_t n = 0;
+      cryptolens::UsageMeter<Configuration>::Counter counter = counters[t % counters.size()];
+      while (Clock::now() < end) {
+        for (int i = 0; i < 1000; ++i) { counter.add(1); }
+        n += 1000;
+      }
+      events[t] = n;
+    });
+  }
+  for (auto & t : threads) { t.join(); }
+
+  // Includes the final flush
+  meter.stop();
+
+  requests = flushes;
+  errors = failed;
+
+  std::uint64_t total = 0;
+  for (std::uint64_t n : events) { total += n; }
+  return total;
+}
+
+std::uint64_t
+run_direct(Options const& options, Clock::time_point end, std::uint64_t & requests, std::uint64_t & errors)
+{
+  std::vector<std::uint64_t> events(options.threads);
+  std::vector<std::uint64_t> failed(options.threads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < options.threads; ++t) {
+    threads.emplace_back([&, t]() {
+      cryptolens::Error e;
+      Cryptolens cryptolens_handle(e);
+      cryptolens_handle.set_base_url(e, options.url);
+      if (e) { std::fprintf(stderr, "Failed to set up handle\n"); std::exit(1); }
+
+      std::string key = key_for(t % options.counters);
+      std::uint64_t n = 0;
+      while (Clock::now() < end) {
+        cryptolens_handle.increment_int_value(e, token, product_id, key, data_object_id, 1);
+        ++n;
+        if (e) { ++failed[t]; e.reset(cryptolens::api::main()); }
+      }
+      events[t] = n;
+    });
+  }
+  for (auto & t : threads) { t.join(); }
+
+  std::uint64_t total = 0;
+  errors = 0;
+  for (int t = 0; t < options.threads; ++t) { total += events[t]; errors += failed[t]; }
+  requests = total;
+  return total;
+}
+
+void
+usage(char const* name)
+{
+  std::fprintf(stderr, "Usage: %s [--url URL] [--mode meter|direct] [--duration S] [--threads N] [--counters N]\n"
+                       "       [--flush-interval MS] [--journal PATH]\n", name);
+  std::exit(1);
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+  Options options;
+
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 >= argc) { usage(argv[0]); }
+
+    if      (std::strcmp(argv[i], "--url") == 0)            { options.url = argv[++i]; }
+    else if (std::strcmp(argv[i], "--mode") == 0)           { options.mode = argv[++i]; }
+    else if (std::strcmp(argv[i], "--duration") == 0)       { options.duration = std::atof(argv[++i]); }
+    else if (std::strcmp(argv[i], "--threads") == 0)        { options.threads = std::atoi(argv[++i]); }
+    else if (std::strcmp(argv[i], "--counters") == 0)       { options.counters = std::atoi(argv[++i]); }
+    else if (std::strcmp(argv[i], "--flush-interval") == 0) { options.flush_interval = std::atoi(argv[++i]); }
+    else if (std::strcmp(argv[i], "--journal") == 0)        { options.journal = argv[++i]; }
+    else                                                    { usage(argv[0]); }
+  }
+
+  if (options.duration <= 0 || options.threads <= 0 || options.counters <= 0) { usage(argv[0]); }
+  if (options.mode != "meter" && options.mode != "direct") { usage(argv[0]); }
+
+  curl_global_init(CURL_GLOBAL_SSL);
+
+  std::uint64_t requests = 0, errors = 0;
+  Clock::time_point start = Clock::now();
+  Clock::time_point end = start + std::chrono::nanoseconds((std::int64_t)(1e9 * options.duration));
+  std::uint64_t events = options.mode == "meter" ? run_meter(options, end, requests, errors)
+                                                 : run_direct(options, end, requests, errors);
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::printf("Events:       %lu\n", (unsigned long)events);
+  std::printf("Throughput:   %.0f events/s\n", events / elapsed);
+  if (options.mode == "meter") {
+    std::printf("Flushes:      %lu (%lu failed)\n", (unsigned long)requests, (unsigned long)errors);
+  } else {
+    std::printf("Requests:     %lu (%lu failed)\n", (unsigned long)requests, (unsigned long)errors);
+  }
+
+  curl_global_cleanup();
+
+  return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,718 @@
+/*
+ * A local stand-in for the Cryptolens Web API, for load testing and
+ * development without making requests to app.cryptolens.io.
+ *
+ * Serves plain HTTP/1.1 with keep-alive and supports the methods used by
+ * basic_Cryptolens: Activate, Deactivate, CreateTrialKey, GetMessages,
+ * IncrementIntValueToKey and DecrementIntValueToKey.
+ * When built with nghttp2, HTTP/2 without TLS (h2c) is also served to clients
+ * that start the connection with the HTTP/2 preface, which is what
+ * RequestHandler_curl does with HTTP/2 multiplexing enabled. Larger
+ * responses are compressed with br or gzip if the client accepts it and the
+ * server was built with brotli or zlib, respectively.
+ * Activate responses are signed with the test key from the testkit, thus
+ * clients must use the public key printed on startup.
+ *
+ * Usage:
+ *
+ *     cryptolens_mock_server [--port 8080] [--machines N] [--messages N] [--slow P:MS] [--unavailable P]
+ *
+ * where --machines sets the number of additional machines listed in the
+ * ActivatedMachines field of each license key, and --messages the number of
+ * messages in each channel (default 1). Activating a license key
+ * whose key string starts with "BLOCKED" fails with the same message as
+ * the Web API uses for blocked keys.
+ *
+ * For testing timeouts, retries and hedging, --slow delays P percent of the
+ * responses by MS milliseconds, and --unavailable answers P percent of the
+ * requests with 503 Service Unavailable. A delayed HTTP/2 response holds up
+ * the other streams on the same connection.
+ *
+ * Tests can control single requests with the additional arguments MockId,
+ * MockDelay and MockUnavailable. Requests are delayed by MockDelay
+ * milliseconds, and the first MockUnavailable requests with the same MockId
+ * are answered with 503 Service Unavailable. The number of requests received
+ * with a given MockId is returned by /mock/requests. With --port 0 the server
+ * listens on any free port, which is printed on startup.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef CRYPTOLENS_MOCK_SERVER_HTTP2
+#include <nghttp2/nghttp2.h>
+#endif
+
+#ifdef CRYPTOLENS_MOCK_SERVER_GZIP
+#include <zlib.h>
+#endif
+
+#ifdef CRYPTOLENS_MOCK_SERVER_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include <Licenses.hpp>
+#include <SigningKey.hpp>
+
+using namespace ::cryptolens_io::testkit;
+
+namespace {
+
+int activated_machines = 0;
+int messages = 1;
+std::time_t start_time = 0;
+
+double slow_percent = 0;
+int slow_ms = 0;
+double unavailable_percent = 0;
+
+// The cache is emptied once it holds this many responses, so that a load
+// generator using fresh keys or machine codes does not grow it without bound
+size_t constexpr ACTIVATE_CACHE_MAX_SIZE = 100000;
+
+std::mutex mock_requests_mutex;
+std::unordered_map<std::string, unsigned long> mock_requests;
+
+std::mutex activate_cache_mutex;
+std::unordered_map<std::string, std::string> activate_cache;
+
+int hex_value(char c)
+{
+  if (c >= '0' && c <= '9') { return c - '0'; }
+  if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+  if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+  return -1;
+}
+
+std::string
+url_decode(std::string const& s)
+{
+  std::string r;
+  r.reserve(s.size());
+
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (s[i] == '+') {
+      r += ' ';
+    } else if (s[i] == '%' && i + 2 < s.size() && hex_value(s[i+1]) >= 0 && hex_value(s[i+2]) >= 0) {
+      r += (char)(hex_value(s[i+1]) * 16 + hex_value(s[i+2]));
+      i += 2;
+    } else {
+      r += s[i];
+    }
+  }
+
+  return r;
+}
+
+std::map<std::string, std::string>
+parse_form(std::string const& body)
+{
+  std::map<std::string, std::string> form;
+
+  size_t start = 0;
+  while (start < body.size()) {
+    size_t end = body.find('&', start);
+    if (end == std::string::npos) { end = body.size(); }
+
+    std::string pair = body.substr(start, end - start);
+    size_t k = pair.find('=');
+    if (k == std::string::npos) { form[url_decode(pair)] = ""; }
+    else                        { form[url_decode(pair.substr(0, k))] = url_decode(pair.substr(k + 1)); }
+
+    start = end + 1;
+  }
+
+  return form;
+}
+
+std::string
+lowercase(std::string s)
+{
+  for (char & c : s) { c = (char)std::tolower((unsigned char)c); }
+  return s;
+}
+
+std::string
+get(std::map<std::string, std::string> const& form, char const* key)
+{
+  auto it = form.find(key);
+  return it == form.end() ? std::string() : it->second;
+}
+
+std::string
+activate(std::map<std::string, std::string> const& form)
+{
+  std::string key = get(form, "Key");
+  if (key.compare(0, 7, "BLOCKED") == 0) { return make_error_response("The key is blocked and cannot be accessed."); }
+
+  std::string cache_key = get(form, "ProductId") + '\n' + key + '\n' + get(form, "MachineCode");
+  {
+    std::lock_guard<std::mutex> lock(activate_cache_mutex);
+    auto it = activate_cache.find(cache_key);
+    if (it != activate_cache.end()) { return it->second; }
+  }
+
+  LicenseSpec spec;
+  spec.product_id = std::atoi(get(form, "ProductId").c_str());
+  spec.key = key;
+  spec.activated_machines = activated_machines;
+  spec.machine_code = get(form, "MachineCode");
+
+  // Signing is much more expensive than the work done by the client, thus the
+  // responses are cached so that the server does not become the bottleneck
+  std::string response = make_activate_response(SigningKey::test_key(), make_license(spec));
+
+  std::lock_guard<std::mutex> lock(activate_cache_mutex);
+  if (activate_cache.size() >= ACTIVATE_CACHE_MAX_SIZE) { activate_cache.clear(); }
+  activate_cache[cache_key] = response;
+  return response;
+}
+
+std::string
+create_trial_key(std::map<std::string, std::string> const&)
+{
+  static std::mutex mutex;
+  static unsigned long counter = 0;
+
+  unsigned long n;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    n = ++counter;
+  }
+
+  char key[32];
+  std::snprintf(key, sizeof(key), "TRIAL-%05lu-%05lu", (n / 100000) % 100000, n % 100000);
+
+  return std::string("{\"key\":\"") + key + "\",\"result\":0,\"message\":\"\"}";
+}
+
+/*
+ * Each channel has the same messages, created one minute apart with the
+ * last one created when the server started. Only the messages created after
+ * Time are returned.
+ */
+std::string
+get_messages(std::map<std::string, std::string> const& form)
+{
+  std::string channel = get(form, "Channel");
+  long long since = std::atoll(get(form, "Time").c_str());
+
+  std::string s = "{\"messages\":[";
+  bool first = true;
+  for (int i = 0; i < messages; ++i) {
+    long long created = (long long)start_time - 60LL * (messages - 1 - i);
+    if (created <= since) { continue; }
+
+    if (!first) { s += ','; }
+    first = false;
+    s += "{\"id\":" + std::to_string(i + 1) + ",\"content\":\"Hello from the mock server";
+    if (i > 0) { s += " (" + std::to_string(i + 1) + ")"; }
+    s += "\",\"created\":" + std::to_string(created) + ",\"channel\":\"" + channel + "\"}";
+  }
+  s += "],\"result\":0,\"message\":\"\"}";
+
+  return s;
+}
+
+bool
+chance(double percent)
+{
+  static thread_local std::minstd_rand rng(std::random_device{}());
+  return percent > 0 && std::uniform_real_distribution<double>(0, 100)(rng) < percent;
+}
+
+/*
+ * Produces the response body, returning the HTTP status code
+ */
+int
+handle(std::string const& path, std::string const& body, std::string & response)
+{
+  std::map<std::string, std::string> form = parse_form(body);
+  std::string p = lowercase(path);
+  std::string mock_id = get(form, "MockId");
+
+  if (p == "/mock/requests") {
+    std::lock_guard<std::mutex> lock(mock_requests_mutex);
+    response = std::to_string(mock_requests[mock_id]);
+    return 200;
+  }
+
+  // Requests are counted on arrival, so that a duplicate is seen even while
+  // the first request is still being delayed
+  unsigned long seen = 0;
+  if (!mock_id.empty()) {
+    std::lock_guard<std::mutex> lock(mock_requests_mutex);
+    seen = ++mock_requests[mock_id];
+  }
+
+  if (chance(slow_percent)) { std::this_thread::sleep_for(std::chrono::milliseconds(slow_ms)); }
+  int delay = std::atoi(get(form, "MockDelay").c_str());
+  if (delay > 0) { std::this_thread::sleep_for(std::chrono::milliseconds(delay)); }
+
+  if (chance(unavailable_percent)) { response = "Service Unavailable"; return 503; }
+  if (seen > 0 && seen <= std::strtoul(get(form, "MockUnavailable").c_str(), NULL, 10)) { response = "Service Unavailable"; return 503; }
+
+  if      (p == "/api/key/activate")       { response = activate(form); }
+  else if (p == "/api/key/deactivate")     { response = "{\"result\":0,\"message\":\"\"}"; }
+  else if (p == "/api/key/createtrialkey") { response = create_trial_key(form); }
+  else if (p == "/api/message/getmessages"){ response = get_messages(form); }
+  else if (p == "/api/data/incrementintvaluetokey" ||
+           p == "/api/data/decrementintvaluetokey") { response = "{\"result\":0,\"message\":\"\"}"; }
+  else                                     { return 404; }
+
+  return 200;
+}
+
+/*
+ * Content encoding
+ */
+
+// Responses smaller than this are not worth compressing
+size_t const min_compressed_size = 1024;
+
+std::mutex encoded_cache_mutex;
+std::unordered_map<std::string, std::string> encoded_cache;
+
+bool
+accepts_encoding(std::string const& accept_encoding, char const* encoding)
+{
+  size_t n = std::strlen(encoding);
+
+  size_t start = 0;
+  while (start < accept_encoding.size()) {
+    size_t end = accept_encoding.find(',', start);
+    if (end == std::string::npos) { end = accept_encoding.size(); }
+
+    std::string item = lowercase(accept_encoding.substr(start, end - start));
+    size_t i = item.find_first_not_of(' ');
+    if (i != std::string::npos && item.compare(i, n, encoding) == 0 &&
+        (i + n == item.size() || item[i + n] == ' ' || item[i + n] == ';'))
+    {
+      // An encoding listed with q=0 is explicitly not acceptable
+      size_t q = item.find("q=", i + n);
+      return q == std::string::npos || std::atof(item.c_str() + q + 2) > 0;
+    }
+
+    start = end + 1;
+  }
+
+  return false;
+}
+
+std::string
+choose_encoding(std::string const& accept_encoding, std::string const& body)
+{
+  if (body.size() < min_compressed_size) { return ""; }
+
+#ifdef CRYPTOLENS_MOCK_SERVER_BROTLI
+  if (accepts_encoding(accept_encoding, "br")) { return "br"; }
+#endif
+#ifdef CRYPTOLENS_MOCK_SERVER_GZIP
+  if (accepts_encoding(accept_encoding, "gzip")) { return "gzip"; }
+#endif
+
+  return "";
+}
+
+std::string
+compress(std::string const& body, std::string const& encoding)
+{
+  std::string r;
+
+#ifdef CRYPTOLENS_MOCK_SERVER_BROTLI
+  if (encoding == "br") {
+    size_t n = BrotliEncoderMaxCompressedSize(body.size());
+    r.resize(n);
+    if (!BrotliEncoderCompress(5, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, body.size(), (uint8_t const*)body.data(), &n, (uint8_t *)&r[0])) { return body; }
+    r.resize(n);
+  }
+#endif
+
+#ifdef CRYPTOLENS_MOCK_SERVER_GZIP
+  if (encoding == "gzip") {
+    z_stream z;
+    std::memset(&z, 0, sizeof(z));
+    // A window of 15 bits, plus 16 for a gzip header instead of a zlib header
+    if (deflateInit2(&z, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) { return body; }
+
+    r.resize(deflateBound(&z, body.size()));
+    z.next_in = (Bytef *)body.data();
+    z.avail_in = (uInt)body.size();
+    z.next_out = (Bytef *)&r[0];
+    z.avail_out = (uInt)r.size();
+    int status = deflate(&z, Z_FINISH);
+    r.resize(z.total_out);
+    deflateEnd(&z);
+
+    if (status != Z_STREAM_END) { return body; }
+  }
+#endif
+
+  return r;
+}
+
+/*
+ * Returns the body encoded with the given encoding. The same large responses
+ * are served repeatedly, thus the encoded responses are cached like the
+ * signed responses.
+ */
+std::string
+encode(std::string const& body, std::string const& encoding)
+{
+  if (encoding.empty()) { return body; }
+
+  std::string cache_key = encoding + '\n' + body;
+  {
+    std::lock_guard<std::mutex> lock(encoded_cache_mutex);
+    auto it = encoded_cache.find(cache_key);
+    if (it != encoded_cache.end()) { return it->second; }
+  }
+
+  std::string encoded = compress(body, encoding);
+
+  std::lock_guard<std::mutex> lock(encoded_cache_mutex);
+  if (encoded_cache.size() >= 1000) { encoded_cache.clear(); }
+  encoded_cache[cache_key] = encoded;
+  return encoded;
+}
+
+bool
+send_all(int fd, std::string const& s)
+{
+  size_t sent = 0;
+  while (sent < s.size()) {
+    ssize_t n = send(fd, s.data() + sent, s.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) { return false; }
+    sent += n;
+  }
+  return true;
+}
+
+#ifdef CRYPTOLENS_MOCK_SERVER_HTTP2
+
+/*
+ * HTTP/2 without TLS. Streams are answered in the order their requests
+ * complete; since the responses are produced without blocking, there is no
+ * need to handle streams on separate threads.
+ */
+
+struct Http2Stream {
+  std::string path;
+  std::string accept_encoding;
+  std::string body;
+  std::string response;
+  size_t sent = 0;
+};
+
+struct Http2Connection {
+  int fd;
+  std::map<int32_t, Http2Stream> streams;
+};
+
+ssize_t
+http2_send(nghttp2_session * session, uint8_t const* data, size_t length, int flags, void * user_data)
+{
+  Http2Connection * c = (Http2Connection *)user_data;
+  if (!send_all(c->fd, std::string((char const*)data, length))) { return NGHTTP2_ERR_CALLBACK_FAILURE; }
+  return (ssize_t)length;
+}
+
+int
+http2_on_begin_headers(nghttp2_session * session, nghttp2_frame const* frame, void * user_data)
+{
+  Http2Connection * c = (Http2Connection *)user_data;
+  if (frame->hd.type == NGHTTP2_HEADERS && frame->headers.cat == NGHTTP2_HCAT_REQUEST) {
+    c->streams[frame->hd.stream_id] = Http2Stream();
+  }
+  return 0;
+}
+
+int
+http2_on_header
+  ( nghttp2_session * session
+  , nghttp2_frame const* frame
+  , uint8_t const* name
+  , size_t namelen
+  , uint8_t const* value
+  , size_t valuelen
+  , uint8_t flags
+  , void * user_data
+  )
+{
+  Http2Connection * c = (Http2Connection *)user_data;
+  auto it = c->streams.find(frame->hd.stream_id);
+  if (it == c->streams.end()) { return 0; }
+
+  std::string header((char const*)name, namelen);
+  if      (header == ":path")           { it->second.path.assign((char const*)value, valuelen); }
+  else if (header == "accept-encoding") { it->second.accept_encoding.assign((char const*)value, valuelen); }
+  return 0;
+}
+
+int
+http2_on_data_chunk_recv(nghttp2_session * session, uint8_t flags, int32_t stream_id, uint8_t const* data, size_t len, void * user_data)
+{
+  Http2Connection * c = (Http2Connection *)user_data;
+  auto it = c->streams.find(stream_id);
+  if (it != c->streams.end()) { it->second.body.append((char const*)data, len); }
+  return 0;
+}
+
+ssize_t
+http2_read_response
+  ( nghttp2_session * session
+  , int32_t stream_id
+  , uint8_t * buf
+  , size_t length
+  , uint32_t * data_flags
+  , nghttp2_data_source * source
+  , void * user_data
+  )
+{
+  Http2Stream * stream = (Http2Stream *)source->ptr;
+
+  size_t n = std::min(length, stream->response.size() - stream->sent);
+  std::memcpy(buf, stream->response.data() + stream->sent, n);
+  stream->sent += n;
+  if (stream->sent == stream->response.size()) { *data_flags |= NGHTTP2_DATA_FLAG_EOF; }
+
+  return (ssize_t)n;
+}
+
+int
+http2_on_frame_recv(nghttp2_session * session, nghttp2_frame const* frame, void * user_data)
+{
+  Http2Connection * c = (Http2Connection *)user_data;
+
+  if (frame->hd.type != NGHTTP2_HEADERS && frame->hd.type != NGHTTP2_DATA) { return 0; }
+  if (!(frame->hd.flags & NGHTTP2_FLAG_END_STREAM)) { return 0; }
+
+  auto it = c->streams.find(frame->hd.stream_id);
+  if (it == c->streams.end()) { return 0; }
+  Http2Stream & stream = it->second;
+
+  std::string response_body;
+  std::string status = std::to_string(handle(stream.path, stream.body, response_body));
+  char const* content_type = "application/json; charset=utf-8";
+
+  std::string encoding = choose_encoding(stream.accept_encoding, response_body);
+  stream.response = encode(response_body, encoding);
+
+  nghttp2_nv headers[] =
+    { { (uint8_t *)":status", (uint8_t *)status.c_str(), 7, status.size(), NGHTTP2_NV_FLAG_NONE }
+    , { (uint8_t *)"content-type", (uint8_t *)content_type, 12, std::strlen(content_type), NGHTTP2_NV_FLAG_NONE }
+    , { (uint8_t *)"content-encoding", (uint8_t *)encoding.c_str(), 16, encoding.size(), NGHTTP2_NV_FLAG_NONE }
+    };
+
+  nghttp2_data_provider provider;
+  provider.source.ptr = &stream;
+  provider.read_callback = http2_read_response;
+
+  size_t n = encoding.empty() ? 2 : 3;
+  return nghttp2_submit_response(session, frame->hd.stream_id, headers, n, &provider) == 0 ? 0 : NGHTTP2_ERR_CALLBACK_FAILURE;
+}
+
+int
+http2_on_stream_close(nghttp2_session * session, int32_t stream_id, uint32_t error_code, void * user_data)
+{
+  Http2Connection * c = (Http2Connection *)user_data;
+  c->streams.erase(stream_id);
+  return 0;
+}
+
+void
+serve_http2(int fd, std::string const& received)
+{
+  nghttp2_session_callbacks * callbacks;
+  nghttp2_session_callbacks_new(&callbacks);
+  nghttp2_session_callbacks_set_send_callback(callbacks, http2_send);
+  nghttp2_session_callbacks_set_on_begin_headers_callback(callbacks, http2_on_begin_headers);
+  nghttp2_session_callbacks_set_on_header_callback(callbacks, http2_on_header);
+  nghttp2_session_callbacks_set_on_data_chunk_recv_callback(callbacks, http2_on_data_chunk_recv);
+  nghttp2_session_callbacks_set_on_frame_recv_callback(callbacks, http2_on_frame_recv);
+  nghttp2_session_callbacks_set_on_stream_close_callback(callbacks, http2_on_stream_close);
+
+  Http2Connection c;
+  c.fd = fd;
+
+  nghttp2_session * session;
+  nghttp2_session_server_new(&session, callbacks, &c);
+  nghttp2_session_callbacks_del(callbacks);
+
+  nghttp2_settings_entry settings[] = { { NGHTTP2_SETTINGS_MAX_CONCURRENT_STREAMS, 100 } };
+  nghttp2_submit_settings(session, NGHTTP2_FLAG_NONE, settings, 1);
+
+  char chunk[16384];
+  ssize_t n = (ssize_t)received.size();
+  bool ok = nghttp2_session_mem_recv(session, (uint8_t const*)received.data(), received.size()) == n;
+
+  while (ok && nghttp2_session_send(session) == 0) {
+    if (!nghttp2_session_want_read(session) && !nghttp2_session_want_write(session)) { break; }
+
+    n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) { break; }
+
+    ok = nghttp2_session_mem_recv(session, (uint8_t const*)chunk, n) == n;
+  }
+
+  nghttp2_session_del(session);
+  close(fd);
+}
+
+#endif
+
+void
+serve_connection(int fd)
+{
+  std::string buffer;
+  char chunk[16384];
+
+#ifdef CRYPTOLENS_MOCK_SERVER_HTTP2
+  // Clients using HTTP/2 with prior knowledge start with the connection preface
+  static char const preface[] = "PRI * HTTP/2.0";
+  while (buffer.size() < sizeof(preface) - 1 && buffer.compare(0, buffer.size(), preface, buffer.size()) == 0) {
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) { close(fd); return; }
+    buffer.append(chunk, n);
+  }
+  if (buffer.compare(0, sizeof(preface) - 1, preface) == 0) { serve_http2(fd, buffer); return; }
+#endif
+
+  for (;;) {
+    size_t header_end;
+    while ((header_end = buffer.find("\r\n\r\n")) == std::string::npos) {
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) { close(fd); return; }
+      buffer.append(chunk, n);
+    }
+
+    std::string header = buffer.substr(0, header_end);
+    std::string header_lower = lowercase(header);
+
+    size_t content_length = 0;
+    size_t k = header_lower.find("\r\ncontent-length:");
+    if (k != std::string::npos) { content_length = std::strtoul(header.c_str() + k + 17, NULL, 10); }
+
+    bool keep_alive = header_lower.find("\r\nconnection: close") == std::string::npos;
+
+    std::string accept_encoding;
+    k = header_lower.find("\r\naccept-encoding:");
+    if (k != std::string::npos) {
+      size_t end = header.find("\r\n", k + 2);
+      accept_encoding = header.substr(k + 18, end == std::string::npos ? std::string::npos : end - k - 18);
+    }
+
+    while (buffer.size() < header_end + 4 + content_length) {
+      ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+      if (n <= 0) { close(fd); return; }
+      buffer.append(chunk, n);
+    }
+
+    std::string body = buffer.substr(header_end + 4, content_length);
+    buffer.erase(0, header_end + 4 + content_length);
+
+    // Request line: METHOD SP PATH SP VERSION
+    size_t a = header.find(' ');
+    size_t b = a == std::string::npos ? std::string::npos : header.find(' ', a + 1);
+    std::string path = b == std::string::npos ? std::string() : header.substr(a + 1, b - a - 1);
+
+    std::string response_body;
+    int code = handle(path, body, response_body);
+    std::string status = code == 200 ? "200 OK" : code == 404 ? "404 Not Found" : "503 Service Unavailable";
+
+    std::string encoding = choose_encoding(accept_encoding, response_body);
+    response_body = encode(response_body, encoding);
+
+    std::string response = "HTTP/1.1 " + status + "\r\n"
+                           "Content-Type: application/json; charset=utf-8\r\n"
+                           "Content-Length: " + std::to_string(response_body.size()) + "\r\n";
+    if (!encoding.empty()) { response += "Content-Encoding: " + encoding + "\r\n"; }
+    if (!keep_alive) { response += "Connection: close\r\n"; }
+    response += "\r\n";
+    response += response_body;
+
+    if (!send_all(fd, response) || !keep_alive) { close(fd); return; }
+  }
+}
+
+void
+usage(char const* name)
+{
+  std::fprintf(stderr, "Usage: %s [--port PORT] [--machines N] [--messages N] [--slow P:MS] [--unavailable P]\n", name);
+  std::exit(1);
+}
+
+} // namespace
+
+int main(int argc, char ** argv)
+{
+  int port = 8080;
+
+  for (int i = 1; i < argc; ++i) {
+    if      (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc)     { port = std::atoi(argv[++i]); }
+    else if (std::strcmp(argv[i], "--machines") == 0 && i + 1 < argc) { activated_machines = std::atoi(argv[++i]); }
+    else if (std::strcmp(argv[i], "--messages") == 0 && i + 1 < argc) { messages = std::atoi(argv[++i]); }
+    else if (std::strcmp(argv[i], "--slow") == 0 && i + 1 < argc) {
+      char * end;
+      slow_percent = std::strtod(argv[++i], &end);
+      if (*end != ':') { usage(argv[0]); }
+      slow_ms = std::atoi(end + 1);
+    }
+    else if (std::strcmp(argv[i], "--unavailable") == 0 && i + 1 < argc) { unavailable_percent = std::atof(argv[++i]); }
+    else                                                              { usage(argv[0]); }
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  start_time = std::time(NULL);
+
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd < 0) { std::perror("socket"); return 1; }
+
+  int one = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  sockaddr_in addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+
+  if (bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) != 0) { std::perror("bind"); return 1; }
+  if (listen(listen_fd, 128) != 0) { std::perror("listen"); return 1; }
+
+  socklen_t addr_len = sizeof(addr);
+  if (getsockname(listen_fd, (sockaddr *)&addr, &addr_len) == 0) { port = ntohs(addr.sin_port); }
+
+  SigningKey const& key = SigningKey::test_key();
+  std::printf("Listening on http://127.0.0.1:%d\n", port);
+  std::printf("Modulus:  %s\n", key.get_modulus_base64().c_str());
+  std::printf("Exponent: %s\n", key.get_exponent_base64().c_str());
+  std::fflush(stdout);
+
+  for (;;) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) { continue; }
+
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    std::thread(serve_connection, fd).detach();
+  }
+}
@@ -30,6 +30,12 @@
 # dependency is the OpenSSL commandline tool for optional text listing.
 # Hacked by Guenter Knauf.
 #
+# Modified to output a C++ source file with the certificates as a single
+# DER encoded blob, to be saved as src/RequestHandler_curl_cacerts.cpp and
+# used with the CRYPTOLENS_CURL_EMBED_CACERTS build option:
+#
+#   $ perl util/mk-ca-bundle.pl src/RequestHandler_curl_cacerts.cpp
+#
 use Encode;
 use Getopt::Std;
 use MIME::Base64;
@@ -391,8 +397,7 @@ if( $stdout ) {
     open(CRT,">$crt.~") or die "Couldn't open $crt.~: $!\n";
 }
 print CRT <<EOT;
-#include <string>
-#include <vector>
+#include <cstddef>
 
 /*
  * Bundle of CA Root Certificates
@@ -404,16 +409,23 @@ print CRT <<EOT;
  * file (certdata.txt).  This file can be found in the mozilla source tree:
  * ${url}
  *
+ * The certificates are stored DER encoded one after another, and can be
+ * decoded by repeatedly calling d2i_X509().
+ *
  * This file is (mostly) automatically generated.
  *
  * Conversion done with mk-ca-bundle.pl version $version as available in at
- * github.com/SerialKeyManager/SKM-Client-API-CPP
+ * github.com/Cryptolens/cryptolens-cpp
  * SHA256: $newhash
  */
 
-namespace serialkeymanager_com {
+namespace cryptolens_io {
+
+namespace v20190401 {
 
-std::vector<std::string> pems {
+namespace cacerts {
+
+extern unsigned char const der[] = {
 EOT
 
 report "Processing  '$txt' ...";
@@ -426,6 +438,7 @@ my @precert;
 open(TXT,"$txt") or die "Couldn't open $txt: $!\n";
 while (<TXT>) {
   if (/\*\*\*\*\* BEGIN LICENSE BLOCK \*\*\*\*\*/) {
+    print CRT "  /*\n";
     print CRT;
     print if ($opt_l);
     while (<TXT>) {
@@ -433,6 +446,7 @@ while (<TXT>) {
       print if ($opt_l);
       last if (/\*\*\*\*\* END LICENSE BLOCK \*\*\*\*\*/);
     }
+    print CRT "  */\n";
   }
   elsif(/^# (Issuer|Serial Number|Subject|Not Valid Before|Not Valid After |Fingerprint \(MD5\)|Fingerprint \(SHA1\)):/) {
       push @precert, $_;
@@ -487,28 +501,18 @@ while (<TXT>) {
     } else {
       my $encoded = MIME::Base64::encode_base64($data, '');
       $encoded =~ s/(.{1,${opt_w}})/$1\n/g;
-      my $skm_encoded = $encoded;
-      $skm_encoded =~ s/^/      "/g;
-      $skm_encoded =~ s/\n/\\n"\n      "/g;
-      my $pem = "      \"-----BEGIN CERTIFICATE-----\\n\"\n"
-              . $skm_encoded
-              . "-----END CERTIFICATE-----\\n\"\n";
-      print CRT "\n  , std::string {";
-      print CRT "\n      \"$caname\\n\"\n";
-      print CRT @precert if($opt_m);
-      my $maxStringLength = length(decode('UTF-8', $caname, Encode::FB_CROAK));
+      my $pem = "-----BEGIN CERTIFICATE-----\n"
+              . $encoded
+              . "-----END CERTIFICATE-----\n";
+      print CRT "\n  // $caname\n";
+      if ($opt_m) {
+        print CRT map { "  //$_" } map { my $x = $_; $x =~ s/^#//; $x } @precert;
+      }
       if ($opt_t) {
+        print CRT "  /*\n";
         foreach my $key (keys %trust_purposes_by_level) {
-           my $string = $key . ": " . join(", ", @{$trust_purposes_by_level{$key}});
-           $maxStringLength = List::Util::max( length($string), $maxStringLength );
-           print CRT $string . "\n";
+           print CRT "   " . $key . ": " . join(", ", @{$trust_purposes_by_level{$key}}) . "\n";
         }
-      }
-      print CRT ("      \"" . "=" x $maxStringLength . "\\n\"\n");
-      if (!$opt_t) {
-        print CRT $pem;
-        print CRT "    }\n";
-      } else {
         my $pipe = "";
         foreach my $hash (@included_signature_algorithms) {
           $pipe = "|$openssl x509 -" . $hash . " -fingerprint -noout -inform PEM";
@@ -534,6 +538,12 @@ while (<TXT>) {
         if (!$stdout) {
           open(CRT, ">>$crt.~") or die "Couldn't open $crt.~: $!";
         }
+        print CRT "  */\n";
+      }
+      my @bytes = unpack("C*", $data);
+      for (my $i = 0; $i < @bytes; $i += 16) {
+        my $last = List::Util::min($i + 15, $#bytes);
+        print CRT "  " . join(", ", map { sprintf("0x%02x", $_) } @bytes[$i .. $last]) . ",\n";
       }
       report "Parsing: $caname" if ($opt_v);
       $certnum ++;
@@ -544,6 +554,17 @@ while (<TXT>) {
 
 }
 close(TXT) or die "Couldn't close $txt: $!\n";
+print CRT <<EOT;
+};
+
+extern std::size_t const der_size = sizeof(der);
+
+} // namespace cacerts
+
+} // namespace v20190401
+
+} // namespace cryptolens_io
+EOT
 close(CRT) or die "Couldn't close $crt.~: $!\n";
 unless( $stdout ) {
     if ($opt_b && -e $crt) {
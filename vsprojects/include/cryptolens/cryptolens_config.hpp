@@ -0,0 +1,11 @@
+#pragma once
+
+/*
+ * Configuration of the library for the Visual Studio projects, which do not
+ * run CMake. This is the default configuration written by CMake from
+ * include/cryptolens/cryptolens_config.hpp.in, and is used both by the
+ * library and by the projects linking against it.
+ */
+
+/* Set by the CMake option CRYPTOLENS_NONVIRTUAL_ERROR, see basic_Error */
+#define CRYPTOLENS_CONFIG_NONVIRTUAL_ERROR 0